@@ -53,6 +53,7 @@ FLUIDSYNTH_API void delete_fluid_synth(fluid_synth_t *synth);
 /** @endlifecycle */
 
 FLUIDSYNTH_API double fluid_synth_get_cpu_load(fluid_synth_t *synth);
+FLUIDSYNTH_API int fluid_synth_get_event_queue_stats(fluid_synth_t *synth, int *size, int *high_water, int *dropped);
 FLUID_DEPRECATED FLUIDSYNTH_API const char *fluid_synth_error(fluid_synth_t *synth);
 /** @} */
 
@@ -68,6 +69,8 @@ FLUID_DEPRECATED FLUIDSYNTH_API const char *fluid_synth_error(fluid_synth_t *syn
  */
 FLUIDSYNTH_API int fluid_synth_noteon(fluid_synth_t *synth, int chan, int key, int vel);
 FLUIDSYNTH_API int fluid_synth_noteoff(fluid_synth_t *synth, int chan, int key);
+FLUIDSYNTH_API int fluid_synth_noteon_at(fluid_synth_t *synth, int chan, int key, int vel, int frame);
+FLUIDSYNTH_API int fluid_synth_noteoff_at(fluid_synth_t *synth, int chan, int key, int frame);
 FLUIDSYNTH_API int fluid_synth_cc(fluid_synth_t *synth, int chan, int ctrl, int val);
 FLUIDSYNTH_API int fluid_synth_get_cc(fluid_synth_t *synth, int chan, int ctrl, int *pval);
 FLUIDSYNTH_API int fluid_synth_sysex(fluid_synth_t *synth, const char *data, int len,
@@ -140,6 +143,24 @@ FLUIDSYNTH_API int fluid_synth_sfreload(fluid_synth_t *synth, int id);
 FLUIDSYNTH_API int fluid_synth_sfunload(fluid_synth_t *synth, int id, int reset_presets);
 FLUIDSYNTH_API int fluid_synth_add_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont);
 FLUIDSYNTH_API int fluid_synth_remove_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont);
+
+/**
+ * Status of an asynchronous SoundFont load, see fluid_synth_sfload_async().
+ */
+enum fluid_sfload_status
+{
+    FLUID_SFLOAD_LOADING,   /**< The SoundFont is being loaded */
+    FLUID_SFLOAD_DONE,      /**< The SoundFont has been loaded and added to the synth */
+    FLUID_SFLOAD_FAILED,    /**< Loading the SoundFont failed */
+    FLUID_SFLOAD_CANCELLED  /**< Loading was cancelled */
+};
+
+FLUIDSYNTH_API fluid_sfload_t *fluid_synth_sfload_async(fluid_synth_t *synth, const char *filename, int reset_presets);
+FLUIDSYNTH_API int fluid_sfload_get_status(fluid_sfload_t *load);
+FLUIDSYNTH_API double fluid_sfload_get_progress(fluid_sfload_t *load);
+FLUIDSYNTH_API void fluid_sfload_cancel(fluid_sfload_t *load);
+FLUIDSYNTH_API int fluid_sfload_join(fluid_sfload_t *load);
+FLUIDSYNTH_API void delete_fluid_sfload(fluid_sfload_t *load);
 FLUIDSYNTH_API int fluid_synth_sfcount(fluid_synth_t *synth);
 FLUIDSYNTH_API fluid_sfont_t *fluid_synth_get_sfont(fluid_synth_t *synth, unsigned int num);
 FLUIDSYNTH_API fluid_sfont_t *fluid_synth_get_sfont_by_id(fluid_synth_t *synth, int id);
@@ -596,6 +617,12 @@ FLUIDSYNTH_API fluid_preset_t *fluid_synth_get_channel_preset(fluid_synth_t *syn
 /** @ingroup midi_input */
 FLUIDSYNTH_API int fluid_synth_handle_midi_event(void *data, fluid_midi_event_t *event);
 
+/** @ingroup midi_input */
+FLUIDSYNTH_API int fluid_synth_handle_midi_events(fluid_synth_t *synth, fluid_midi_event_t **events, int count);
+
+/** @ingroup midi_input */
+FLUIDSYNTH_API int fluid_synth_handle_midi_event_at(fluid_synth_t *synth, fluid_midi_event_t *event, int frame);
+
 /** @ingroup soundfonts */
 FLUIDSYNTH_API
 int fluid_synth_pin_preset(fluid_synth_t *synth, int sfont_id, int bank_num, int preset_num);
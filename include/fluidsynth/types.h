@@ -39,6 +39,7 @@ typedef struct _fluid_synth_t fluid_synth_t;                    /**< Synthesizer
 typedef struct _fluid_voice_t fluid_voice_t;                    /**< Synthesis voice instance */
 typedef struct _fluid_sfloader_t fluid_sfloader_t;              /**< SoundFont loader plugin */
 typedef struct _fluid_sfont_t fluid_sfont_t;                    /**< SoundFont */
+typedef struct _fluid_sfload_t fluid_sfload_t;                  /**< Asynchronous SoundFont load */
 typedef struct _fluid_preset_t fluid_preset_t;                  /**< SoundFont preset */
 typedef struct _fluid_sample_t fluid_sample_t;                  /**< SoundFont sample */
 typedef struct _fluid_mod_t fluid_mod_t;                        /**< SoundFont modulator */
@@ -98,6 +98,9 @@
 /* Define to 1 if you have the <sys/mman.h> header file. */
 #cmakedefine HAVE_SYS_MMAN_H @HAVE_SYS_MMAN_H@
 
+/* Define to 1 if you have the shm_open() function. */
+#cmakedefine HAVE_SHM_OPEN @HAVE_SHM_OPEN@
+
 /* Define to 1 if you have the <sys/socket.h> header file. */
 #cmakedefine HAVE_SYS_SOCKET_H @HAVE_SYS_SOCKET_H@
 
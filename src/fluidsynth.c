@@ -379,7 +379,8 @@ int main(int argc, char **argv)
     int audio_channels = 0;
     int dump = 0;
     int fast_render = 0;
-    static const char optchars[] = "+a:b:C:c:dE:f:F:G:g:hijK:L:lm:nO:o:p:QqR:r:sT:Vvz:";
+    int compile_sf = 0;
+    static const char optchars[] = "+a:b:C:c:dE:f:F:G:g:hijK:L:lm:nO:o:p:QqR:r:sS:T:Vvz:";
 
 #if defined(_WIN32) && defined(_UNICODE)
 // WC_ERR_INVALID_CHARS is only supported on Windows Vista and newer. To support older Windows, our only chance is to use zero for this flag.
@@ -468,6 +469,7 @@ int main(int argc, char **argv)
             {"audio-groups", 1, 0, 'G'},
             {"bank-offset", 1, 0, 'b'},
             {"chorus", 1, 0, 'C'},
+            {"compile-sf", 1, 0, 'S'},
             {"connect-jack-outputs", 0, 0, 'j'},
             {"disable-lash", 0, 0, 'l'},
             {"dump", 0, 0, 'd'},
@@ -765,6 +767,19 @@ int main(int argc, char **argv)
 #endif
             break;
 
+        case 'S':
+            if(fluid_settings_setstr(settings, "synth.compiled-sfont-dir", optarg) != FLUID_OK)
+            {
+                fprintf(stderr, "Failed to set the compiled SoundFont directory\n");
+                goto cleanup;
+            }
+
+            /* Only the presets are compiled, don't bother loading the sample data */
+            fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1);
+            fluid_settings_setint(settings, "synth.lazy-preset-loading", 0);
+            compile_sf = 1;
+            break;
+
         case 'T':
             if(FLUID_STRCMP(optarg, "help") == 0)
             {
@@ -953,6 +968,19 @@ int main(int argc, char **argv)
         }
     }
 
+    /* The SoundFonts have been compiled while loading them */
+    if(compile_sf)
+    {
+        if(fluid_synth_sfcount(synth) == 0)
+        {
+            fprintf(stderr, "No SoundFont to compile specified\n");
+            goto cleanup;
+        }
+
+        result = 0;
+        goto cleanup;
+    }
+
     /* Try to load the default soundfont, if no soundfont specified */
     if(fluid_synth_get_sfont(synth, 0) == NULL)
     {
@@ -1315,6 +1343,9 @@ print_help(fluid_settings_t *settings)
            "    Turn the reverb on or off [0|1|yes|no, default = on]\n");
     printf(" -s, --server\n"
            "    Start FluidSynth as a server process\n");
+    printf(" -S, --compile-sf=[dir]\n"
+           "    Compile the given SoundFonts to images in dir and quit,\n"
+           "    see synth.compiled-sfont-dir\n");
     printf(" -T, --audio-file-type\n"
            "    Audio file type for fast rendering or aufile driver (\"help\" for list)\n");
     printf(" -v, --verbose\n"
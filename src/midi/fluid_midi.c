@@ -54,6 +54,8 @@ static int fluid_player_load(fluid_player_t *player, fluid_playlist_item *item);
 static void fluid_player_advancefile(fluid_player_t *player);
 static void fluid_player_playlist_load(fluid_player_t *player, unsigned int msec);
 static void fluid_player_update_tempo(fluid_player_t *player);
+static int fluid_player_playback(fluid_player_t *player, fluid_midi_event_t *event);
+static void fluid_player_playback_done(fluid_player_t *player);
 
 static fluid_midi_file *new_fluid_midi_file(const char *buffer, size_t length);
 static void delete_fluid_midi_file(fluid_midi_file *mf);
@@ -1620,7 +1622,7 @@ fluid_track_send_events(fluid_track_t *track,
             if(player->playback_callback)
             {
                 int *chan_is_playing = &player->channel_isplaying[event->channel % MAX_NUMBER_OF_CHANNELS];
-                player->playback_callback(player->playback_userdata, event);
+                fluid_player_playback(player, event);
                 if(event->type == NOTE_ON && event->param2 != 0 && !*chan_is_playing)
                 {
                     *chan_is_playing = TRUE;
@@ -1718,6 +1720,7 @@ new_fluid_player(fluid_synth_t *synth)
     player->cur_ticks = 0;
     player->end_msec = -1;
     player->end_pedals_disabled = 0;
+    player->synth_api_entered = FALSE;
     player->last_callback_ticks = -1;
     fluid_atomic_int_set(&player->seek_ticks, -1);
     fluid_player_set_playback_callback(player, fluid_synth_handle_midi_event, synth);
@@ -2146,10 +2149,11 @@ fluid_player_callback(void *data, unsigned int msec)
                 if(player->channel_isplaying[i])
                 {
                     fluid_midi_event_set_channel(&mute_event, i);
-                    player->playback_callback(player->playback_userdata, &mute_event);
+                    fluid_player_playback(player, &mute_event);
                     player->channel_isplaying[i] = FALSE;
                 }
             }
+            fluid_player_playback_done(player);
             fluid_atomic_int_set(&player->stopping, 0);
         }
         return 1;
@@ -2194,7 +2198,7 @@ fluid_player_callback(void *data, unsigned int msec)
                 if(player->channel_isplaying[i])
                 {
                     fluid_midi_event_set_channel(&mute_event, i);
-                    player->playback_callback(player->playback_userdata, &mute_event);
+                    fluid_player_playback(player, &mute_event);
                     player->channel_isplaying[i] = FALSE;
                 }
             }
@@ -2209,6 +2213,8 @@ fluid_player_callback(void *data, unsigned int msec)
             }
         }
 
+        fluid_player_playback_done(player);
+
         if(seek_ticks >= 0)
         {
             player->start_ticks = seek_ticks;   /* tick position of last tempo value (which is now) */
@@ -2283,6 +2289,35 @@ fluid_player_callback(void *data, unsigned int msec)
     return 1;
 }
 
+/*
+ * Passes an event to the playback callback. If that is the synth the player was
+ * created for, the synth API is entered on the first event and kept until
+ * fluid_player_playback_done(), so that all events due at once are handled in one go.
+ */
+static int
+fluid_player_playback(fluid_player_t *player, fluid_midi_event_t *event)
+{
+    if(!player->synth_api_entered
+            && player->playback_callback == fluid_synth_handle_midi_event
+            && player->playback_userdata == player->synth)
+    {
+        fluid_synth_api_enter(player->synth);
+        player->synth_api_entered = TRUE;
+    }
+
+    return player->playback_callback(player->playback_userdata, event);
+}
+
+static void
+fluid_player_playback_done(fluid_player_t *player)
+{
+    if(player->synth_api_entered)
+    {
+        player->synth_api_entered = FALSE;
+        fluid_synth_api_exit(player->synth);
+    }
+}
+
 /**
  * Activates play mode for a MIDI player if not already playing.
  * @param player MIDI player instance
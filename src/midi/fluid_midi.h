@@ -333,6 +333,7 @@ struct _fluid_player_t
     void *tick_userdata; /* pointer to user-defined data passed to tick_callback function */
 
     int channel_isplaying[MAX_NUMBER_OF_CHANNELS]; /* flags indicating channels on which notes have played */
+    int synth_api_entered; /* TRUE while the player callback dispatches a batch of events within one synth API call */
 };
 
 #define FLUID_PLAYER_STOP_GRACE_MS 2000
@@ -66,6 +66,13 @@ struct _fluid_sequencer_t
     // Pointer to the C++ event queue
     void *queue;
     fluid_rec_mutex_t mutex;
+
+    // The event currently dispatched from the queue, NULL otherwise
+    const fluid_event_t *queued_evt;
+
+    // Called when the run of due events the current batch belongs to ends, see fluid_sequencer_begin_batch()
+    void (*batch_end)(void *data);
+    void *batch_data;
 };
 
 /* Private data for clients */
@@ -622,6 +629,57 @@ fluid_sequencer_process(fluid_sequencer_t *seq, unsigned int msec)
 }
 
 
+/**
+ * @internal
+ * only used privately by fluid_seq_queue_process(), with the sequencer mutex held:
+ * sends an event taken from the queue to its client.
+ */
+void
+fluid_sequencer_dispatch_queued(fluid_sequencer_t *seq, fluid_event_t *evt)
+{
+    seq->queued_evt = evt;
+    fluid_sequencer_send_now(seq, evt);
+    seq->queued_evt = NULL;
+}
+
+/**
+ * @internal
+ * only used privately by fluid_seqbind and only from sequencer callback, thus lock acquire is not needed.
+ * If @p evt is dispatched from the queue, registers @p end to be called once the run of due events
+ * addressed to the same client ends, and returns TRUE. Returns FALSE otherwise, e.g. for events
+ * sent with fluid_sequencer_send_now(), or if a batch has been begun already.
+ */
+int
+fluid_sequencer_begin_batch(fluid_sequencer_t *seq, const fluid_event_t *evt, void (*end)(void *data), void *data)
+{
+    if(evt != seq->queued_evt || seq->batch_end != NULL)
+    {
+        return FALSE;
+    }
+
+    seq->batch_end = end;
+    seq->batch_data = data;
+    return TRUE;
+}
+
+/**
+ * @internal
+ * only used privately by fluid_seq_queue_process() and fluid_seqbind, with the sequencer mutex held:
+ * ends the current batch, if any.
+ */
+void
+fluid_sequencer_end_batch(fluid_sequencer_t *seq)
+{
+    void (*end)(void *data) = seq->batch_end;
+
+    if(end != NULL)
+    {
+        seq->batch_end = NULL;
+        end(seq->batch_data);
+    }
+}
+
+
 /**
  * @internal
  * only used privately by fluid_seqbind and only from sequencer callback, thus lock acquire is not needed.
@@ -238,15 +238,26 @@ void fluid_seq_queue_process(void *que, fluid_sequencer_t *seq, unsigned int cur
             // however, most client function receive a non-const fluid_event_t pointer
             fluid_event_t local_evt = top;
 
+            fluid_seq_id_t dest = fluid_event_get_dest(&local_evt);
+
             // Then, pop the queue, so that client-callbacks may add new events without
             // messing up the heap structure while we are still processing
             fluid_seq_queue_pop(queue);
-            fluid_sequencer_send_now(seq, &local_evt);
+            fluid_sequencer_dispatch_queued(seq, &local_evt);
+
+            // A client may handle a run of consecutive events to it as a batch,
+            // which ends before any other client gets an event
+            if(queue.empty() || queue.front().time > cur_ticks || fluid_event_get_dest(&queue.front()) != dest)
+            {
+                fluid_sequencer_end_batch(seq);
+            }
         }
         else
         {
             break;
         }
     }
+
+    fluid_sequencer_end_batch(seq);
 }
 
@@ -36,6 +36,10 @@ void fluid_seq_queue_remove(void *queue, fluid_seq_id_t src, fluid_seq_id_t dest
 void fluid_seq_queue_process(void *que, fluid_sequencer_t *seq, unsigned int cur_ticks);
 void fluid_seq_queue_invalidate_note_private(void *que, fluid_seq_id_t dest, fluid_note_id_t id);
 
+/* implemented in fluid_seq.c */
+void fluid_sequencer_dispatch_queued(fluid_sequencer_t *seq, fluid_event_t *evt);
+void fluid_sequencer_end_batch(fluid_sequencer_t *seq);
+
 int event_compare_for_test(const fluid_event_t* left, const fluid_event_t* right);
 
 #ifdef __cplusplus
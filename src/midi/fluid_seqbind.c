@@ -44,10 +44,14 @@ struct _fluid_seqbind_t
     fluid_sample_timer_t *sample_timer;
     fluid_seq_id_t client_id;
     void* note_container;
+    int synth_api_entered; /* TRUE while a batch of queued events is handled within one synth API call */
 };
 typedef struct _fluid_seqbind_t fluid_seqbind_t;
 
 extern void fluid_sequencer_invalidate_note(fluid_sequencer_t *seq, fluid_seq_id_t dest, fluid_note_id_t id);
+extern int fluid_sequencer_begin_batch(fluid_sequencer_t *seq, const fluid_event_t *evt,
+                                       void (*end)(void *data), void *data);
+extern void fluid_sequencer_end_batch(fluid_sequencer_t *seq);
 
 int fluid_seqbind_timer_callback(void *data, unsigned int msec);
 void fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *event, fluid_sequencer_t *seq, void *data);
@@ -174,6 +178,16 @@ fluid_seqbind_timer_callback(void *data, unsigned int msec)
     return 1;
 }
 
+/* Called by the sequencer when a run of queued events to this client ends */
+static void
+fluid_seqbind_batch_end(void *data)
+{
+    fluid_seqbind_t *seqbind = (fluid_seqbind_t *) data;
+
+    seqbind->synth_api_entered = FALSE;
+    fluid_synth_api_exit(seqbind->synth);
+}
+
 /* Callback for midi events */
 void
 fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_sequencer_t *seq, void *data)
@@ -182,6 +196,16 @@ fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_seque
     fluid_seqbind_t *seqbind = (fluid_seqbind_t *) data;
     synth = seqbind->synth;
 
+    /* Handle consecutive events from the queue within a single synth API call. The
+     * sequencer mutex is held already, which keeps the lock order of the sequencer
+     * calling into the synth. */
+    if(!seqbind->synth_api_entered && fluid_event_get_type(evt) != FLUID_SEQ_UNREGISTERING
+            && fluid_sequencer_begin_batch(seq, evt, fluid_seqbind_batch_end, seqbind))
+    {
+        fluid_synth_api_enter(synth);
+        seqbind->synth_api_entered = TRUE;
+    }
+
     switch(fluid_event_get_type(evt))
     {
     case FLUID_SEQ_NOTEON:
@@ -317,6 +341,11 @@ fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_seque
         break;
 
     case FLUID_SEQ_UNREGISTERING: /* free ourselves */
+        if(seqbind->synth_api_entered)
+        {
+            fluid_sequencer_end_batch(seq);
+        }
+
         delete_fluid_seqbind(seqbind);
         break;
 
@@ -288,6 +288,40 @@ fluid_rvoice_check_sample_sanity(fluid_rvoice_t *voice)
 }
 
 
+/*
+ * Checks whether the sample data read by the next block of a streamed voice is
+ * resident.
+ */
+static FLUID_INLINE int
+fluid_rvoice_stream_ready(fluid_rvoice_t *voice, int is_looping)
+{
+    int first, need;
+
+    if(voice->stream == NULL)
+    {
+        return TRUE;
+    }
+
+    first = fluid_phase_index(voice->dsp.phase);
+    need = first + (int)(voice->dsp.phase_incr * FLUID_BUFSIZE) + FLUID_RVOICE_STREAM_GUARD;
+
+    /* a looping voice never reads beyond the loop end, but returns to the loop start */
+    if(is_looping)
+    {
+        if(need > voice->dsp.loopend + FLUID_RVOICE_STREAM_GUARD)
+        {
+            need = voice->dsp.loopend + FLUID_RVOICE_STREAM_GUARD;
+        }
+
+        if(first > voice->dsp.loopstart)
+        {
+            first = voice->dsp.loopstart;
+        }
+    }
+
+    return fluid_rvoice_stream_request(voice->stream, first - FLUID_RVOICE_STREAM_GUARD, need);
+}
+
 /**
  * Synthesize a voice to a buffer.
  *
@@ -427,6 +461,7 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
      * since that's what polyphone does (PR #1400) */
     if(voice->dsp.samplemode == FLUID_START_ON_RELEASE && fluid_adsr_env_get_section(&voice->envlfo.volenv) < FLUID_VOICE_ENVRELEASE)
     {
+        voice->dsp.start_delay = 0;
         return -1;
     }
 
@@ -463,26 +498,41 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
      * Depending on the position in the loop and the loop size, this
      * may require several runs. */
 
+    if(voice->dsp.start_delay > 0)
+    {
+        // The voice has been started within this block by a timestamped event, the dsp
+        // routines only fill the buffer from the start delay on.
+        FLUID_MEMSET(dsp_buf, 0, voice->dsp.start_delay * sizeof(fluid_real_t));
+    }
+
     if(count < 0)
     {
         // The voice is quite, i.e. either in delay phase or zero volume.
         // We need to update the rvoice's dsp phase, as the delay phase shall not "postpone" the sound, rather
         // it should be played silently, see https://github.com/FluidSynth/fluidsynth/issues/1312
-        return fluid_rvoice_dsp_silence(voice, dsp_buf, is_looping);
+        count = fluid_rvoice_dsp_silence(voice, dsp_buf, is_looping);
     }
+    else if(!fluid_rvoice_stream_ready(voice, is_looping))
+    {
+        // The sample data hasn't been read from disk yet. Rather than waiting for it, play
+        // silence and keep the phase running, so that the voice stays in time.
+        count = fluid_rvoice_dsp_silence(voice, dsp_buf, is_looping);
+    }
+    else
+    {
+        count = fluid_rvoice_dsp_interpolate(voice, dsp_buf, is_looping);
 
-    count = fluid_rvoice_dsp_interpolate(voice, dsp_buf, is_looping);
-
-    fluid_check_fpe("voice_write interpolation");
+        fluid_check_fpe("voice_write interpolation");
 
-    if (count == 0)
-    {
-        // voice has finished
-        return count;
+        // unless the voice has finished
+        if(count != 0)
+        {
+            fluid_iir_filter_apply(&voice->resonant_filter, &voice->resonant_custom_filter, dsp_buf, count);
+            fluid_check_fpe("voice_filter fluid_iir_filter_apply()");
+        }
     }
-    
-    fluid_iir_filter_apply(&voice->resonant_filter, &voice->resonant_custom_filter, dsp_buf, count);
-    fluid_check_fpe("voice_filter fluid_iir_filter_apply()");
+
+    voice->dsp.start_delay = 0;
 
     return count;
 }
@@ -573,6 +623,8 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_reset)
     fluid_iir_filter_reset(&voice->resonant_filter);
     fluid_iir_filter_reset(&voice->resonant_custom_filter);
 
+    voice->dsp.start_delay = 0;
+
     /* Clear finished callback */
     voice->finished_cb = NULL;
     voice->finished_cb_voice = NULL;
@@ -956,4 +1008,81 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_finished_callback)
     voice->finished_cb_data = param[2].ptr;
 }
 
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_start_delay)
+{
+    fluid_rvoice_t *voice = obj;
+    int delay = param[0].i;
+
+    fluid_clip(delay, 0, FLUID_BUFSIZE - 1);
+
+    voice->dsp.start_delay = delay;
+}
+
+
+
+
+struct _fluid_rvoice_arena_t
+{
+    void *mem;        /* the unaligned allocation */
+    char *base;       /* first rvoice, aligned to FLUID_DEFAULT_ALIGNMENT */
+    size_t stride;    /* distance between two rvoices, multiple of FLUID_DEFAULT_ALIGNMENT */
+    int count;
+};
+
+/*
+ * new_fluid_rvoice_arena
+ * Allocates count zero-initialized rvoices as one contiguous block.
+ */
+fluid_rvoice_arena_t *
+new_fluid_rvoice_arena(int count)
+{
+    fluid_rvoice_arena_t *arena;
+    size_t size;
+
+    fluid_return_val_if_fail(count > 0, NULL);
+
+    arena = FLUID_NEW(fluid_rvoice_arena_t);
+
+    if(arena == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    /* round up to whole cache lines so that no two rvoices share a line */
+    arena->stride = (sizeof(fluid_rvoice_t) + FLUID_DEFAULT_ALIGNMENT - 1) & ~((size_t)FLUID_DEFAULT_ALIGNMENT - 1);
+    arena->count = count;
+
+    size = arena->stride * count;
+    arena->mem = FLUID_MALLOC(size + FLUID_DEFAULT_ALIGNMENT - 1);
+
+    if(arena->mem == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(arena);
+        return NULL;
+    }
+
+    arena->base = fluid_align_ptr(arena->mem, FLUID_DEFAULT_ALIGNMENT);
+    FLUID_MEMSET(arena->base, 0, size);
+
+    return arena;
+}
+
+void
+delete_fluid_rvoice_arena(fluid_rvoice_arena_t *arena)
+{
+    fluid_return_if_fail(arena != NULL);
+
+    FLUID_FREE(arena->mem);
+    FLUID_FREE(arena);
+}
+
+fluid_rvoice_t *
+fluid_rvoice_arena_get(fluid_rvoice_arena_t *arena, int idx)
+{
+    fluid_return_val_if_fail(arena != NULL, NULL);
+    fluid_return_val_if_fail(idx >= 0 && idx < arena->count, NULL);
 
+    return (fluid_rvoice_t *)(arena->base + arena->stride * idx);
+}
@@ -27,6 +27,7 @@
 #include "fluid_lfo.h"
 #include "fluid_phase.h"
 #include "fluid_sfont.h"
+#include "fluid_rvoice_stream.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -82,18 +83,17 @@ struct _fluid_rvoice_envlfo_t
 
 /*
  * rvoice parameters needed for dsp interpolation
+ *
+ * Members are ordered by access frequency: the interpolation loop state comes
+ * first, followed by the per-block pitch and amplitude parameters. Members only
+ * touched when the voice is (re)started are at the end.
  */
 struct _fluid_rvoice_dsp_t
 {
-    /* interpolation method, as in fluid_interp in fluidsynth.h */
-    enum fluid_interp interp_method;
-    enum fluid_loop samplemode;
-
-    /* Flag that is set as soon as the first loop is completed. */
-    char has_looped;
+    /* Dynamic input to the interpolator below */
 
-    /* Flag that initiates, that sample-related parameters have to be checked. */
-    char check_sample_sanity_flag;
+    fluid_phase_t phase;             /* the phase (current sample offset) of the sample wave */
+    fluid_real_t phase_incr;	/* the phase increment for the next FLUID_BUFSIZE samples */
 
     fluid_sample_t *sample;
 
@@ -103,6 +103,20 @@ struct _fluid_rvoice_dsp_t
     int loopstart;
     int loopend;	/* Note: first point following the loop (superimposed on loopstart) */
 
+    /* Sample-accurate start: the first block of a voice is only rendered from
+     * this offset (0 .. FLUID_BUFSIZE-1) on, the samples before stay silent */
+    int start_delay;
+
+    /* interpolation method, as in fluid_interp in fluidsynth.h */
+    enum fluid_interp interp_method;
+    enum fluid_loop samplemode;
+
+    /* Flag that is set as soon as the first loop is completed. */
+    char has_looped;
+
+    /* Flag that initiates, that sample-related parameters have to be checked. */
+    char check_sample_sanity_flag;
+
     /* Stuff needed for portamento calculations */
     fluid_real_t pitchoffset;        /* the portamento range in midicents */
     fluid_real_t pitchinc;           /* the portamento increment in midicents */
@@ -116,18 +130,15 @@ struct _fluid_rvoice_dsp_t
     /* Stuff needed for amplitude calculations */
 
     fluid_real_t attenuation;        /* the attenuation in centibels */
-    fluid_real_t prev_attenuation;   /* the previous attenuation in centibels
-					used by fluid_rvoice_multi_retrigger_attack() */
     fluid_real_t min_attenuation_cB; /* Estimate on the smallest possible attenuation
 					  * during the lifetime of the voice */
     fluid_real_t amplitude_that_reaches_noise_floor_nonloop;
     fluid_real_t amplitude_that_reaches_noise_floor_loop;
     fluid_real_t synth_gain; 	/* master gain */
 
-    /* Dynamic input to the interpolator below */
-
-    fluid_phase_t phase;             /* the phase (current sample offset) of the sample wave */
-    fluid_real_t phase_incr;	/* the phase increment for the next FLUID_BUFSIZE samples */
+    /* Only used when (re)triggering the voice */
+    fluid_real_t prev_attenuation;   /* the previous attenuation in centibels
+					used by fluid_rvoice_multi_retrigger_attack() */
 };
 
 /* Currently left, right, reverb, chorus. To be changed if we
@@ -155,14 +166,25 @@ struct _fluid_rvoice_buffers_t
 
 /*
  * Hard realtime parameters needed to synthesize a voice
+ *
+ * The members used by fluid_rvoice_write() on every block come first, the
+ * control-only members are kept at the end, so that rendering a voice touches
+ * as few cache lines as possible.
  */
 struct _fluid_rvoice_t
 {
-    fluid_rvoice_envlfo_t envlfo;
+    /* render-hot */
     fluid_rvoice_dsp_t dsp;
+    fluid_rvoice_envlfo_t envlfo;
     fluid_iir_filter_t resonant_filter; /* IIR resonant dsp filter */
-    fluid_iir_filter_t resonant_custom_filter; /* optional custom/general-purpose IIR resonant filter */
     fluid_rvoice_buffers_t buffers;
+    fluid_iir_filter_t resonant_custom_filter; /* optional custom/general-purpose IIR resonant filter */
+
+    /* Disk streaming state of the sample, NULL if streaming is disabled.
+     * Only exchanged by the synth while the rvoice isn't rendered. */
+    fluid_rvoice_stream_t *stream;
+
+    /* control-only */
 
     /* Finished callback, invoked from the render thread when the rvoice
      * finishes and is about to be removed from the mixer's active list. */
@@ -171,6 +193,16 @@ struct _fluid_rvoice_t
     void *finished_cb_data;  /* user data passed as second arg */
 };
 
+/*
+ * A block of rvoices allocated in one go. Each rvoice starts on its own cache line
+ * and rvoices that are allocated together are adjacent in memory.
+ */
+typedef struct _fluid_rvoice_arena_t fluid_rvoice_arena_t;
+
+fluid_rvoice_arena_t *new_fluid_rvoice_arena(int count);
+void delete_fluid_rvoice_arena(fluid_rvoice_arena_t *arena);
+fluid_rvoice_t *fluid_rvoice_arena_get(fluid_rvoice_arena_t *arena, int idx);
+
 
 int fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf);
 
@@ -202,6 +234,7 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_loopend);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_samplemode);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_sample);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_finished_callback);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_start_delay);
 
 
 int fluid_rvoice_dsp_silence(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf, int looping);
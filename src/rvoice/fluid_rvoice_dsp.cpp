@@ -92,7 +92,7 @@ static int fluid_rvoice_dsp_silence_local(fluid_rvoice_t *rvoice, fluid_real_t *
     fluid_rvoice_dsp_t *voice = &rvoice->dsp;
     fluid_phase_t dsp_phase = voice->phase;
     fluid_phase_t dsp_phase_incr;
-    unsigned short dsp_i = 0;
+    unsigned short dsp_i = voice->start_delay;
     unsigned int dsp_phase_index;
     unsigned int end_index;
 
@@ -158,7 +158,7 @@ fluid_rvoice_dsp_interpolate_none_local(fluid_rvoice_t *rvoice, fluid_real_t *FL
     fluid_phase_t dsp_phase_incr;
     const short int *FLUID_RESTRICT dsp_data = voice->sample->data;
     const char *FLUID_RESTRICT dsp_data24 = voice->sample->data24;
-    unsigned short dsp_i = 0;
+    unsigned short dsp_i = voice->start_delay;
     unsigned int dsp_phase_index;
     unsigned int end_index;
 
@@ -223,7 +223,7 @@ fluid_rvoice_dsp_interpolate_linear_local(fluid_rvoice_t *rvoice, fluid_real_t *
     fluid_phase_t dsp_phase_incr;
     const short int *FLUID_RESTRICT dsp_data = voice->sample->data;
     const char *FLUID_RESTRICT dsp_data24 = voice->sample->data24;
-    unsigned short dsp_i = 0;
+    unsigned short dsp_i = voice->start_delay;
     unsigned int dsp_phase_index;
     unsigned int end_index;
     fluid_real_t point;
@@ -333,7 +333,7 @@ fluid_rvoice_dsp_interpolate_4th_order_local(fluid_rvoice_t *rvoice, fluid_real_
     fluid_phase_t dsp_phase_incr;
     const short int *FLUID_RESTRICT dsp_data = voice->sample->data;
     const char *FLUID_RESTRICT dsp_data24 = voice->sample->data24;
-    unsigned short dsp_i = 0;
+    unsigned short dsp_i = voice->start_delay;
     unsigned int dsp_phase_index;
     unsigned int start_index, end_index;
     fluid_real_t start_point, end_point1, end_point2;
@@ -516,7 +516,7 @@ fluid_rvoice_dsp_interpolate_sinc_local(fluid_rvoice_t *rvoice, fluid_real_t *FL
     fluid_phase_t dsp_phase_incr;
     const short int *FLUID_RESTRICT dsp_data = voice->sample->data;
     const char *FLUID_RESTRICT dsp_data24 = voice->sample->data24;
-    unsigned short dsp_i = 0;
+    unsigned short dsp_i = voice->start_delay;
     unsigned int dsp_phase_index;
     unsigned int start_index, end_index;
 
@@ -23,8 +23,10 @@
 #include "fluid_iir_filter.h"
 #include "fluid_lfo.h"
 #include "fluid_adsr_env.h"
+#include "fluid_synth.h"
 
 static int fluid_rvoice_eventhandler_push_LOCAL(fluid_rvoice_eventhandler_t *handler, const fluid_rvoice_event_t *src_event);
+static DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_eventhandler_wait);
 
 static FLUID_INLINE void
 fluid_rvoice_event_dispatch(fluid_rvoice_event_t *event)
@@ -32,6 +34,17 @@ fluid_rvoice_event_dispatch(fluid_rvoice_event_t *event)
     event->method(event->object, event->param);
 }
 
+/*
+ * Returns TRUE if event is a marker holding back the events behind it while
+ * rendering the block ending before tick.
+ */
+static FLUID_INLINE int
+fluid_rvoice_event_is_waiting(const fluid_rvoice_event_t *event, unsigned int tick)
+{
+    return event->method == fluid_rvoice_eventhandler_wait
+           && (int)((unsigned int)event->param[0].i - tick) >= 0;
+}
+
 
 /**
  * In order to be able to push more than one event atomically,
@@ -77,22 +90,206 @@ fluid_rvoice_eventhandler_push_ptr(fluid_rvoice_eventhandler_t *handler,
     return fluid_rvoice_eventhandler_push_LOCAL(handler, &local_event);
 }
 
+/*
+ * Marker pushed by fluid_rvoice_eventhandler_push_wait(), dispatching it does
+ * nothing.
+ */
+static DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_eventhandler_wait)
+{
+}
+
+/*
+ * Hold back the events pushed after this one until the renderer is about to
+ * render the block containing the sample tick, see
+ * fluid_rvoice_eventhandler_dispatch_until().
+ */
+int
+fluid_rvoice_eventhandler_push_wait(fluid_rvoice_eventhandler_t *handler, unsigned int tick)
+{
+    fluid_rvoice_event_t local_event;
+
+    local_event.method = fluid_rvoice_eventhandler_wait;
+    local_event.object = handler;
+    local_event.param[0].i = (int)tick;
+
+    return fluid_rvoice_eventhandler_push_LOCAL(handler, &local_event);
+}
+
+/*
+ * Setter events whose effect is completely determined by their last
+ * occurrence: the renderer only ever sees the final value of a pending run of
+ * these. fluid_rvoice_set_attenuation() isn't one of them, as it also keeps
+ * the previous value to ramp the amplitude from. Returns the key distinguishing independent targets of the same
+ * method and object, or -1 if the event cannot be coalesced.
+ */
+static int
+fluid_rvoice_event_coalesce_key(const fluid_rvoice_event_t *event)
+{
+    fluid_rvoice_function_t method = event->method;
+
+    if(method == fluid_rvoice_buffers_set_amp)
+    {
+        return event->param[0].i;
+    }
+
+    if(method == fluid_rvoice_set_pitch
+            || method == fluid_rvoice_set_min_attenuation_cB
+            || method == fluid_rvoice_set_viblfo_to_pitch
+            || method == fluid_rvoice_set_modlfo_to_pitch
+            || method == fluid_rvoice_set_modlfo_to_vol
+            || method == fluid_rvoice_set_modlfo_to_fc
+            || method == fluid_rvoice_set_modenv_to_fc
+            || method == fluid_rvoice_set_modenv_to_pitch
+            || method == fluid_iir_filter_set_fres)
+    {
+        return 0;
+    }
+
+    return -1;
+}
+
+/*
+ * Invalidate all coalescing candidates. Called on flush, because flushed
+ * events belong to the renderer, and before any event which is not a plain
+ * setter, so that coalescing never reorders a setter across e.g. a noteoff
+ * or a voice (re)start.
+ */
+void
+fluid_rvoice_eventhandler_coalesce_reset(fluid_rvoice_eventhandler_t *handler)
+{
+    if(++handler->coalesce_gen == 0)
+    {
+        /* wrapped around, make sure no stale entry looks valid */
+        FLUID_MEMSET(handler->coalesce, 0, sizeof(handler->coalesce));
+        handler->coalesce_gen = 1;
+    }
+}
+
+/*
+ * Called by the producer when the queue is full: move the pending events into
+ * a segment of twice the size and publish it for the renderer to adopt once it
+ * has drained the current one. Only one grown segment can be in flight at a
+ * time, further overflows until the renderer caught up are dropped. The queue
+ * never grows from the render thread, e.g. for the events of the sequencer,
+ * as that must not allocate memory.
+ */
+static int
+fluid_rvoice_eventhandler_grow_LOCAL(fluid_rvoice_eventhandler_t *handler, int pending)
+{
+    fluid_ringbuffer_t *queue = handler->queue;
+    fluid_ringbuffer_t *retired;
+    fluid_ringbuffer_t *grown;
+    int size, i;
+
+    if(fluid_atomic_pointer_get(&handler->queue_next) != NULL || fluid_synth_in_render_context())
+    {
+        return FLUID_FAILED;
+    }
+
+    /* the renderer sets queue_retired before clearing queue_next */
+    retired = fluid_atomic_pointer_get(&handler->queue_retired);
+
+    if(retired != NULL)
+    {
+        fluid_atomic_pointer_set(&handler->queue_retired, NULL);
+        delete_fluid_ringbuffer(retired);
+    }
+
+    if(queue->totalcount >= handler->queue_size_max)
+    {
+        return FLUID_FAILED;
+    }
+
+    size = 2 * queue->totalcount;
+
+    if(size > handler->queue_size_max)
+    {
+        size = handler->queue_size_max;
+    }
+
+    grown = new_fluid_ringbuffer(size, sizeof(fluid_rvoice_event_t));
+
+    if(grown == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* pending events keep their offsets, so coalescing entries stay valid */
+    for(i = 0; i < pending; i++)
+    {
+        FLUID_MEMCPY(fluid_ringbuffer_get_inptr(grown, i),
+                     fluid_ringbuffer_get_inptr(queue, i), sizeof(fluid_rvoice_event_t));
+    }
+
+    FLUID_LOG(FLUID_DBG, "Growing rvoice event queue to %d events", size);
+
+    handler->queue = grown;
+    fluid_atomic_pointer_set(&handler->queue_next, grown);
+
+    return FLUID_OK;
+}
+
 static int fluid_rvoice_eventhandler_push_LOCAL(fluid_rvoice_eventhandler_t *handler, const fluid_rvoice_event_t *src_event)
 {
     fluid_rvoice_event_t *event;
-    int old_queue_stored = fluid_atomic_int_add(&handler->queue_stored, 1);
+    fluid_rvoice_coalesce_t *entry = NULL;
+    int old_queue_stored;
+    int key = fluid_rvoice_event_coalesce_key(src_event);
+
+    if(key < 0)
+    {
+        fluid_rvoice_eventhandler_coalesce_reset(handler);
+    }
+    else
+    {
+        uintptr_t hash = (uintptr_t)src_event->object;
+
+        hash ^= hash >> 7;
+        hash += (uintptr_t)src_event->method >> 4;
+        hash += (uintptr_t)key * 31;
+        entry = &handler->coalesce[hash & (FLUID_RVOICE_COALESCE_SIZE - 1)];
+
+        if(entry->gen == handler->coalesce_gen
+                && entry->method == src_event->method
+                && entry->object == src_event->object
+                && entry->key == key)
+        {
+            /* a pending event sets the same parameter and has not been
+             * handed to the renderer yet, simply overwrite its value */
+            event = fluid_ringbuffer_get_inptr(handler->queue, entry->offset);
+            FLUID_MEMCPY(event, src_event, sizeof(*event));
+            return FLUID_OK;
+        }
+    }
+
+    old_queue_stored = fluid_atomic_int_add(&handler->queue_stored, 1);
 
     event = fluid_ringbuffer_get_inptr(handler->queue, old_queue_stored);
 
+    if(event == NULL && fluid_rvoice_eventhandler_grow_LOCAL(handler, old_queue_stored) == FLUID_OK)
+    {
+        event = fluid_ringbuffer_get_inptr(handler->queue, old_queue_stored);
+    }
+
     if(event == NULL)
     {
         fluid_atomic_int_add(&handler->queue_stored, -1);
-        FLUID_LOG(FLUID_WARN, "Ringbuffer full, try increasing synth.polyphony!");
+        fluid_atomic_int_add(&handler->queue_dropped, 1);
+        FLUID_LOG(FLUID_WARN, "Rvoice event queue full, dropping event. Try increasing synth.polyphony!");
         return FLUID_FAILED; // Buffer full...
     }
 
     FLUID_MEMCPY(event, src_event, sizeof(*event));
 
+    if(entry != NULL)
+    {
+        entry->method = src_event->method;
+        entry->object = src_event->object;
+        entry->key = key;
+        entry->offset = old_queue_stored;
+        entry->gen = handler->coalesce_gen;
+    }
+
     return FLUID_OK;
 }
 
@@ -136,9 +333,18 @@ new_fluid_rvoice_eventhandler(int queuesize,
 
     eventhandler->mixer = NULL;
     eventhandler->queue = NULL;
+    eventhandler->queue_out = NULL;
+    eventhandler->queue_next = NULL;
+    eventhandler->queue_retired = NULL;
     eventhandler->finished_voices = NULL;
 
     fluid_atomic_int_set(&eventhandler->queue_stored, 0);
+    fluid_atomic_int_set(&eventhandler->queue_high_water, 0);
+    fluid_atomic_int_set(&eventhandler->queue_dropped, 0);
+    eventhandler->queue_size_max = queuesize * FLUID_RVOICE_QUEUE_GROW_MAX;
+
+    FLUID_MEMSET(eventhandler->coalesce, 0, sizeof(eventhandler->coalesce));
+    eventhandler->coalesce_gen = 1;
 
     eventhandler->finished_voices = new_fluid_ringbuffer(finished_voices_size,
                                     sizeof(fluid_rvoice_t *));
@@ -155,6 +361,8 @@ new_fluid_rvoice_eventhandler(int queuesize,
         goto error_recovery;
     }
 
+    eventhandler->queue_out = eventhandler->queue;
+
     eventhandler->mixer = new_fluid_rvoice_mixer(bufs, fx_bufs, fx_units,
                           sample_rate_max, sample_rate, reverb_type,
                           eventhandler, extra_threads, prio);
@@ -171,31 +379,141 @@ error_recovery:
     return NULL;
 }
 
+/*
+ * Called by the renderer: switch over to a grown segment once the current one
+ * is drained.
+ * @return TRUE if a new segment has been adopted
+ */
+static int
+fluid_rvoice_eventhandler_adopt_LOCAL(fluid_rvoice_eventhandler_t *handler)
+{
+    fluid_ringbuffer_t *next = fluid_atomic_pointer_get(&handler->queue_next);
+
+    /* the producer flushes everything into the old segment before publishing
+     * the new one, so it is only safe to switch if still empty after that */
+    if(next == NULL || fluid_ringbuffer_get_count(handler->queue_out) != 0)
+    {
+        return FALSE;
+    }
+
+    fluid_atomic_pointer_set(&handler->queue_retired, handler->queue_out);
+    handler->queue_out = next;
+    fluid_atomic_pointer_set(&handler->queue_next, NULL);
+
+    return TRUE;
+}
+
 int
 fluid_rvoice_eventhandler_dispatch_count(fluid_rvoice_eventhandler_t *handler)
 {
-    return fluid_ringbuffer_get_count(handler->queue);
+    fluid_ringbuffer_t *next;
+    int count = fluid_ringbuffer_get_count(handler->queue_out);
+
+    if(count == 0 && (next = fluid_atomic_pointer_get(&handler->queue_next)) != NULL)
+    {
+        count = fluid_ringbuffer_get_count(next);
+    }
+
+    return count;
 }
 
+/*
+ * Returns the number of events fluid_rvoice_eventhandler_dispatch_until()
+ * could dispatch right now, or 0 if the next event is a marker holding the
+ * following events back beyond tick.
+ */
+int
+fluid_rvoice_eventhandler_dispatch_count_until(fluid_rvoice_eventhandler_t *handler, unsigned int tick)
+{
+    fluid_ringbuffer_t *queue = handler->queue_out;
+    fluid_ringbuffer_t *next;
+    fluid_rvoice_event_t *event;
+
+    if(fluid_ringbuffer_get_count(queue) == 0
+            && (next = fluid_atomic_pointer_get(&handler->queue_next)) != NULL)
+    {
+        queue = next;
+    }
+
+    if((event = fluid_ringbuffer_get_outptr(queue)) != NULL
+            && fluid_rvoice_event_is_waiting(event, tick))
+    {
+        return 0;
+    }
+
+    return fluid_ringbuffer_get_count(queue);
+}
+
+static int
+fluid_rvoice_eventhandler_dispatch_LOCAL(fluid_rvoice_eventhandler_t *handler, int wait, unsigned int tick)
+{
+    fluid_rvoice_event_t *event;
+    int result = 0;
+
+    do
+    {
+        while(NULL != (event = fluid_ringbuffer_get_outptr(handler->queue_out)))
+        {
+            if(wait && fluid_rvoice_event_is_waiting(event, tick))
+            {
+                return result;
+            }
+
+            fluid_rvoice_event_dispatch(event);
+            result++;
+            fluid_ringbuffer_next_outptr(handler->queue_out);
+        }
+    }
+    while(fluid_rvoice_eventhandler_adopt_LOCAL(handler));
+
+    return result;
+}
 
 /**
- * Call fluid_rvoice_event_dispatch for all events in queue
+ * Call fluid_rvoice_event_dispatch for all events in queue, regardless of
+ * markers pushed by fluid_rvoice_eventhandler_push_wait()
  * @return number of events dispatched
  */
 int
 fluid_rvoice_eventhandler_dispatch_all(fluid_rvoice_eventhandler_t *handler)
 {
-    fluid_rvoice_event_t *event;
-    int result = 0;
+    return fluid_rvoice_eventhandler_dispatch_LOCAL(handler, FALSE, 0);
+}
 
-    while(NULL != (event = fluid_ringbuffer_get_outptr(handler->queue)))
+/**
+ * Call fluid_rvoice_event_dispatch for the events in queue that are due before
+ * tick, i.e. up to the first marker pushed by fluid_rvoice_eventhandler_push_wait()
+ * with a tick not before it.
+ * @return number of events dispatched
+ */
+int
+fluid_rvoice_eventhandler_dispatch_until(fluid_rvoice_eventhandler_t *handler, unsigned int tick)
+{
+    return fluid_rvoice_eventhandler_dispatch_LOCAL(handler, TRUE, tick);
+}
+
+/*
+ * Retrieve the current size of the event queue, the maximum number of events
+ * that have been queued at once and the number of events dropped so far.
+ */
+void
+fluid_rvoice_eventhandler_get_queue_stats(fluid_rvoice_eventhandler_t *handler,
+        int *size, int *high_water, int *dropped)
+{
+    if(size != NULL)
     {
-        fluid_rvoice_event_dispatch(event);
-        result++;
-        fluid_ringbuffer_next_outptr(handler->queue);
+        *size = handler->queue->totalcount;
     }
 
-    return result;
+    if(high_water != NULL)
+    {
+        *high_water = fluid_atomic_int_get(&handler->queue_high_water);
+    }
+
+    if(dropped != NULL)
+    {
+        *dropped = fluid_atomic_int_get(&handler->queue_dropped);
+    }
 }
 
 
@@ -205,7 +523,14 @@ delete_fluid_rvoice_eventhandler(fluid_rvoice_eventhandler_t *handler)
     fluid_return_if_fail(handler != NULL);
 
     delete_fluid_rvoice_mixer(handler->mixer);
+    /* queue_next, if any, is the same segment as queue */
+    if(handler->queue_out != handler->queue)
+    {
+        delete_fluid_ringbuffer(handler->queue_out);
+    }
+
     delete_fluid_ringbuffer(handler->queue);
+    delete_fluid_ringbuffer(handler->queue_retired);
     delete_fluid_ringbuffer(handler->finished_voices);
     FLUID_FREE(handler);
 }
@@ -38,17 +38,54 @@ struct _fluid_rvoice_event_t
     fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
 };
 
+/* Size of the direct-mapped table used to coalesce pending setter events,
+ * must be a power of two. */
+#define FLUID_RVOICE_COALESCE_SIZE 256
+
+typedef struct _fluid_rvoice_coalesce_t
+{
+    fluid_rvoice_function_t method;
+    void *object;
+    int key;            /**< param[0].i for indexed setters, 0 otherwise */
+    int offset;         /**< position of the event in the pending region */
+    unsigned int gen;   /**< entry is valid only if equal to handler->coalesce_gen */
+} fluid_rvoice_coalesce_t;
+
+/* Upper limit for growing the event queue, as a multiple of its initial size */
+#define FLUID_RVOICE_QUEUE_GROW_MAX 16
+
 /*
  * Bridge between the renderer thread and the midi state thread.
  * fluid_rvoice_eventhandler_fetch_all() can be called in parallel
  * with fluid_rvoice_eventhandler_push/flush()
+ *
+ * When the queue runs full, the producer allocates a larger segment, moves its
+ * pending (unflushed) events there and publishes it in queue_next. The
+ * renderer keeps dispatching from queue_out until it is drained, then adopts
+ * queue_next and hands the old segment back via queue_retired, where the
+ * producer frees it. Neither side ever blocks.
+ *
+ * Events can be held back until a given sample tick by pushing a marker with
+ * fluid_rvoice_eventhandler_push_wait() in front of them. The renderer stops
+ * dispatching at the marker until it renders the block containing that tick.
  */
 struct _fluid_rvoice_eventhandler_t
 {
-    fluid_ringbuffer_t *queue; /**< List of fluid_rvoice_event_t */
+    fluid_ringbuffer_t *queue; /**< Producer side: segment of fluid_rvoice_event_t pushed to */
     fluid_atomic_int_t queue_stored; /**< Extras pushed but not flushed */
+    fluid_ringbuffer_t *queue_out; /**< Renderer side: segment dispatched from */
+    fluid_ringbuffer_t *queue_next; /**< Atomic: grown segment, waiting to be adopted by the renderer */
+    fluid_ringbuffer_t *queue_retired; /**< Atomic: drained segment, waiting to be freed by the producer */
+    int queue_size_max; /**< Size limit for growing the queue */
+    fluid_atomic_int_t queue_high_water; /**< Maximum number of events queued at once */
+    fluid_atomic_int_t queue_dropped; /**< Number of events dropped because the queue was full */
     fluid_ringbuffer_t *finished_voices; /**< return queue from handler, list of fluid_rvoice_t* */
     fluid_rvoice_mixer_t *mixer;
+
+    /* Producer side only: setter events pushed since the last flush which
+     * may still be overwritten in place, see fluid_rvoice_eventhandler_push_LOCAL() */
+    unsigned int coalesce_gen;
+    fluid_rvoice_coalesce_t coalesce[FLUID_RVOICE_COALESCE_SIZE];
 };
 
 fluid_rvoice_eventhandler_t *new_fluid_rvoice_eventhandler(
@@ -59,9 +96,14 @@ fluid_rvoice_eventhandler_t *new_fluid_rvoice_eventhandler(
 void delete_fluid_rvoice_eventhandler(fluid_rvoice_eventhandler_t *);
 
 int fluid_rvoice_eventhandler_dispatch_all(fluid_rvoice_eventhandler_t *);
+int fluid_rvoice_eventhandler_dispatch_until(fluid_rvoice_eventhandler_t *, unsigned int tick);
 int fluid_rvoice_eventhandler_dispatch_count(fluid_rvoice_eventhandler_t *);
+int fluid_rvoice_eventhandler_dispatch_count_until(fluid_rvoice_eventhandler_t *, unsigned int tick);
 void fluid_rvoice_eventhandler_finished_voice_callback(fluid_rvoice_eventhandler_t *eventhandler,
         fluid_rvoice_t *rvoice);
+void fluid_rvoice_eventhandler_coalesce_reset(fluid_rvoice_eventhandler_t *handler);
+void fluid_rvoice_eventhandler_get_queue_stats(fluid_rvoice_eventhandler_t *handler,
+        int *size, int *high_water, int *dropped);
 
 static FLUID_INLINE void
 fluid_rvoice_eventhandler_flush(fluid_rvoice_eventhandler_t *handler)
@@ -70,6 +112,15 @@ fluid_rvoice_eventhandler_flush(fluid_rvoice_eventhandler_t *handler)
 
     if(queue_stored > 0)
     {
+        int queued = fluid_ringbuffer_get_count(handler->queue) + queue_stored;
+
+        if(queued > fluid_atomic_int_get(&handler->queue_high_water))
+        {
+            fluid_atomic_int_set(&handler->queue_high_water, queued);
+        }
+
+        /* events handed over to the renderer must not be modified anymore */
+        fluid_rvoice_eventhandler_coalesce_reset(handler);
         fluid_atomic_int_set(&handler->queue_stored, 0);
         fluid_ringbuffer_next_inptr(handler->queue, queue_stored);
     }
@@ -105,6 +156,8 @@ int fluid_rvoice_eventhandler_push(fluid_rvoice_eventhandler_t *handler,
                                    fluid_rvoice_function_t method, void *object,
                                    fluid_rvoice_param_t param[MAX_EVENT_PARAMS]);
 
+int fluid_rvoice_eventhandler_push_wait(fluid_rvoice_eventhandler_t *handler, unsigned int tick);
+
 static FLUID_INLINE void
 fluid_rvoice_eventhandler_add_rvoice(fluid_rvoice_eventhandler_t *handler,
                                      fluid_rvoice_t *rvoice)
@@ -0,0 +1,653 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_rvoice_stream.h"
+#include "fluid_samplecodec.h"
+
+/* Interval of the I/O thread in milliseconds */
+#define FLUID_RVOICE_STREAMER_INTERVAL 2
+
+/* Count of frames paged in before the progress is published to the renderer */
+#define FLUID_RVOICE_STREAM_CHUNK 16384
+
+/* Distance between two samples touched to fault in a page */
+#define FLUID_RVOICE_STREAM_PAGE_FRAMES (4096 / sizeof(short))
+
+/* Minimum interval in milliseconds between two underrun warnings */
+#define FLUID_RVOICE_STREAMER_REPORT_INTERVAL 1000
+
+/* Count of spare streams allocated at once */
+#define FLUID_RVOICE_STREAM_SPARES 4
+
+typedef struct _fluid_rvoice_stream_block_t fluid_rvoice_stream_block_t;
+
+/* The streams of a voice chunk. Like voice chunks, blocks live as long as the
+ * streamer, so that the I/O thread can walk them without synchronization. */
+struct _fluid_rvoice_stream_block_t
+{
+    fluid_rvoice_stream_block_t *next; /* never changes once the block has been published */
+    int count;
+    fluid_rvoice_stream_t *streams;
+};
+
+struct _fluid_rvoice_streamer_t
+{
+    fluid_rvoice_stream_block_t *blocks; /**< Atomic: list of all stream blocks, only ever prepended to */
+    fluid_atomic_int_t pending;          /**< Atomic: count of streams holding a sample reference for the synth */
+    int lookahead;                       /**< frames to keep resident ahead of the renderer */
+
+    /* I/O thread only */
+    int reported_underruns;
+    unsigned int last_report;
+    int lock_failed;                     /**< TRUE once locking sample data failed, it's only paged in then */
+
+    fluid_timer_t *timer;
+};
+
+static int fluid_rvoice_streamer_run(void *data, unsigned int msec);
+static void fluid_rvoice_stream_fill(fluid_rvoice_streamer_t *streamer, fluid_rvoice_stream_t *stream);
+static void fluid_rvoice_stream_page_in(const fluid_sample_t *sample, int from, int to);
+static void fluid_rvoice_stream_lock(fluid_rvoice_streamer_t *streamer, fluid_rvoice_stream_t *stream, int from, int to);
+static void fluid_rvoice_stream_unlock(fluid_rvoice_streamer_t *streamer, const fluid_rvoice_stream_t *stream, int from, int to);
+static void fluid_rvoice_stream_trim(fluid_rvoice_streamer_t *streamer, fluid_rvoice_stream_t *stream, int start);
+static void fluid_rvoice_stream_reclaim(fluid_rvoice_stream_t *stream);
+static void fluid_rvoice_stream_unuse(const fluid_sample_t *sample);
+static fluid_rvoice_stream_t *fluid_rvoice_streamer_get_spare(fluid_rvoice_streamer_t *streamer,
+        fluid_rvoice_stream_t *stream);
+
+/*
+ * new_fluid_rvoice_streamer
+ *
+ * Starts the I/O thread, that keeps lookahead frames of every streamed voice
+ * resident ahead of the renderer.
+ */
+fluid_rvoice_streamer_t *
+new_fluid_rvoice_streamer(int lookahead)
+{
+    fluid_rvoice_streamer_t *streamer = FLUID_NEW(fluid_rvoice_streamer_t);
+
+    if(streamer == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(streamer, 0, sizeof(*streamer));
+    streamer->lookahead = lookahead;
+
+    streamer->timer = new_fluid_timer(FLUID_RVOICE_STREAMER_INTERVAL, fluid_rvoice_streamer_run,
+                                      streamer, TRUE, FALSE, FALSE);
+
+    if(streamer->timer == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the sample streaming thread");
+        FLUID_FREE(streamer);
+        return NULL;
+    }
+
+    return streamer;
+}
+
+/*
+ * delete_fluid_rvoice_streamer
+ *
+ * Stops the I/O thread and drops the sample references still held by streams.
+ * Must be called after all voices have been stopped and before the SoundFonts
+ * are unloaded.
+ */
+void
+delete_fluid_rvoice_streamer(fluid_rvoice_streamer_t *streamer)
+{
+    fluid_rvoice_stream_block_t *block, *next;
+    int i;
+
+    fluid_return_if_fail(streamer != NULL);
+
+    delete_fluid_timer(streamer->timer);
+
+    /* Finish the streams released since the I/O thread last ran */
+    for(block = streamer->blocks; block != NULL; block = block->next)
+    {
+        for(i = 0; i < block->count; i++)
+        {
+            if(fluid_atomic_int_get(&block->streams[i].state) == FLUID_RVOICE_STREAM_RELEASED)
+            {
+                fluid_rvoice_stream_trim(streamer, &block->streams[i], INT_MAX);
+                fluid_atomic_int_set(&block->streams[i].state, FLUID_RVOICE_STREAM_DONE);
+            }
+        }
+    }
+
+    fluid_rvoice_streamer_reclaim(streamer);
+
+    for(block = streamer->blocks; block != NULL; block = next)
+    {
+        next = block->next;
+        FLUID_FREE(block->streams);
+        FLUID_FREE(block);
+    }
+
+    FLUID_FREE(streamer);
+}
+
+/*
+ * Creates an array of count idle streams for a voice chunk, owned by its
+ * rvoices. May be called from any thread.
+ */
+fluid_rvoice_stream_t *
+fluid_rvoice_streamer_new_streams(fluid_rvoice_streamer_t *streamer, int count)
+{
+    fluid_rvoice_stream_block_t *block;
+    int i;
+
+    block = FLUID_NEW(fluid_rvoice_stream_block_t);
+
+    if(block == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    block->streams = FLUID_ARRAY(fluid_rvoice_stream_t, count);
+
+    if(block->streams == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(block);
+        return NULL;
+    }
+
+    FLUID_MEMSET(block->streams, 0, count * sizeof(*block->streams));
+
+    for(i = 0; i < count; i++)
+    {
+        block->streams[i].streamer = streamer;
+        block->streams[i].owned = TRUE;
+    }
+
+    block->count = count;
+
+    do
+    {
+        block->next = fluid_atomic_pointer_get(&streamer->blocks);
+    }
+    while(!fluid_atomic_pointer_compare_and_exchange(&streamer->blocks, block->next, block));
+
+    return block->streams;
+}
+
+/*
+ * Drops the sample references, that streams took over from finished voices
+ * while the I/O thread was busy with them. Called from the synthesis context.
+ */
+void
+fluid_rvoice_streamer_reclaim(fluid_rvoice_streamer_t *streamer)
+{
+    fluid_rvoice_stream_block_t *block;
+    int i;
+
+    if(fluid_atomic_int_get(&streamer->pending) == 0)
+    {
+        return;
+    }
+
+    for(block = fluid_atomic_pointer_get(&streamer->blocks); block != NULL; block = block->next)
+    {
+        for(i = 0; i < block->count; i++)
+        {
+            fluid_rvoice_stream_reclaim(&block->streams[i]);
+        }
+    }
+}
+
+/*
+ * Returns the count of blocks that have been silenced because their sample
+ * data was not resident in time.
+ */
+int
+fluid_rvoice_streamer_get_underruns(fluid_rvoice_streamer_t *streamer)
+{
+    fluid_rvoice_stream_block_t *block;
+    int i, underruns = 0;
+
+    for(block = fluid_atomic_pointer_get(&streamer->blocks); block != NULL; block = block->next)
+    {
+        for(i = 0; i < block->count; i++)
+        {
+            underruns += fluid_atomic_int_get(&block->streams[i].underruns);
+        }
+    }
+
+    return underruns;
+}
+
+/*
+ * Attaches a stream to the sample of a starting voice. Samples which are not
+ * streamed leave the stream idle. Called from the synthesis context before the
+ * rvoice is handed to the renderer.
+ *
+ * @return the stream to be used by the rvoice from now on, a spare one if the
+ *   I/O thread is still about to finish with the previous voice of the given
+ *   stream, or NULL if no spare stream could be allocated. The voice must not
+ *   be started then, it would read data that isn't resident.
+ */
+fluid_rvoice_stream_t *
+fluid_rvoice_stream_start(fluid_rvoice_stream_t *stream, fluid_sample_t *sample)
+{
+    int ready;
+
+    fluid_rvoice_stream_reclaim(stream);
+
+    if(sample->stream_preload == 0)
+    {
+        return stream;
+    }
+
+    if(fluid_atomic_int_get(&stream->state) != FLUID_RVOICE_STREAM_IDLE)
+    {
+        stream = fluid_rvoice_streamer_get_spare(stream->streamer, stream);
+
+        if(stream == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    stream->sample = sample;
+    stream->end = sample->end + 1;
+
+    ready = sample->start + sample->stream_preload;
+
+    if(ready > stream->end)
+    {
+        ready = stream->end;
+    }
+
+    fluid_atomic_int_set(&stream->ready_end, ready);
+    fluid_atomic_int_set(&stream->request_start, sample->start);
+    fluid_atomic_int_set(&stream->request_end, ready);
+
+    /* Keep the decoded data of compressed samples while the voice plays */
+    if(sample->codec != NULL)
+    {
+        fluid_samplecodec_use(sample->codec);
+    }
+
+    fluid_atomic_int_set(&stream->state, FLUID_RVOICE_STREAM_ACTIVE);
+
+    return stream;
+}
+
+/*
+ * Exchanges a stream the I/O thread is still busy with for an idle spare one.
+ * The given stream becomes a spare stream, that is reused once the I/O thread
+ * is done with it. Called from the synthesis context.
+ */
+static fluid_rvoice_stream_t *
+fluid_rvoice_streamer_get_spare(fluid_rvoice_streamer_t *streamer, fluid_rvoice_stream_t *stream)
+{
+    fluid_rvoice_stream_block_t *block;
+    fluid_rvoice_stream_t *spare = NULL;
+    int i;
+
+    for(block = fluid_atomic_pointer_get(&streamer->blocks); block != NULL && spare == NULL; block = block->next)
+    {
+        for(i = 0; i < block->count; i++)
+        {
+            if(!block->streams[i].owned)
+            {
+                fluid_rvoice_stream_reclaim(&block->streams[i]);
+
+                if(fluid_atomic_int_get(&block->streams[i].state) == FLUID_RVOICE_STREAM_IDLE)
+                {
+                    spare = &block->streams[i];
+                    break;
+                }
+            }
+        }
+    }
+
+    if(spare == NULL)
+    {
+        spare = fluid_rvoice_streamer_new_streams(streamer, FLUID_RVOICE_STREAM_SPARES);
+
+        if(spare == NULL)
+        {
+            return NULL;
+        }
+
+        for(i = 1; i < FLUID_RVOICE_STREAM_SPARES; i++)
+        {
+            spare[i].owned = FALSE;
+        }
+    }
+
+    stream->owned = FALSE;
+    return spare;
+}
+
+/*
+ * Detaches a stream from the sample of a finished voice. Called from the
+ * synthesis context.
+ *
+ * @return TRUE if the caller shall drop its reference to the sample, FALSE if
+ *   the stream took the reference over, because the I/O thread is still reading
+ *   the sample or has to unlock its data. It is dropped later by
+ *   fluid_rvoice_streamer_reclaim().
+ */
+int
+fluid_rvoice_stream_stop(fluid_rvoice_stream_t *stream)
+{
+    for(;;)
+    {
+        switch(fluid_atomic_int_get(&stream->state))
+        {
+        case FLUID_RVOICE_STREAM_ACTIVE:
+            /* Mapped data may be locked, which only the I/O thread knows */
+            if(stream->sample->codec == NULL)
+            {
+                if(fluid_atomic_int_compare_and_exchange(&stream->state, FLUID_RVOICE_STREAM_ACTIVE,
+                        FLUID_RVOICE_STREAM_RELEASED))
+                {
+                    fluid_atomic_int_add(&stream->streamer->pending, 1);
+                    return FALSE;
+                }
+            }
+            else if(fluid_atomic_int_compare_and_exchange(&stream->state, FLUID_RVOICE_STREAM_ACTIVE,
+                    FLUID_RVOICE_STREAM_IDLE))
+            {
+                fluid_rvoice_stream_unuse(stream->sample);
+                stream->sample = NULL;
+                return TRUE;
+            }
+
+            break;
+
+        case FLUID_RVOICE_STREAM_BUSY:
+            if(fluid_atomic_int_compare_and_exchange(&stream->state, FLUID_RVOICE_STREAM_BUSY,
+                    FLUID_RVOICE_STREAM_RELEASED))
+            {
+                /* The renderer is done with the data, only the I/O thread still works on it */
+                fluid_rvoice_stream_unuse(stream->sample);
+                fluid_atomic_int_add(&stream->streamer->pending, 1);
+                return FALSE;
+            }
+
+            break;
+
+        default:
+            return TRUE;
+        }
+    }
+}
+
+static void
+fluid_rvoice_stream_reclaim(fluid_rvoice_stream_t *stream)
+{
+    if(fluid_atomic_int_compare_and_exchange(&stream->state, FLUID_RVOICE_STREAM_DONE,
+            FLUID_RVOICE_STREAM_IDLE))
+    {
+        fluid_sample_decr_ref(stream->sample);
+        stream->sample = NULL;
+        fluid_atomic_int_add(&stream->streamer->pending, -1);
+    }
+}
+
+static void
+fluid_rvoice_stream_unuse(const fluid_sample_t *sample)
+{
+    if(sample->codec != NULL)
+    {
+        fluid_samplecodec_unuse(sample->codec);
+    }
+}
+
+/*
+ * Timer callback of the I/O thread.
+ */
+static int
+fluid_rvoice_streamer_run(void *data, unsigned int msec)
+{
+    fluid_rvoice_streamer_t *streamer = data;
+    fluid_rvoice_stream_block_t *block;
+    int i, underruns;
+
+    for(block = fluid_atomic_pointer_get(&streamer->blocks); block != NULL; block = block->next)
+    {
+        for(i = 0; i < block->count; i++)
+        {
+            fluid_rvoice_stream_fill(streamer, &block->streams[i]);
+        }
+    }
+
+    if(msec - streamer->last_report >= FLUID_RVOICE_STREAMER_REPORT_INTERVAL)
+    {
+        underruns = fluid_rvoice_streamer_get_underruns(streamer);
+
+        if(underruns != streamer->reported_underruns)
+        {
+            FLUID_LOG(FLUID_WARN, "Sample streaming: %d blocks were silenced because the sample data wasn't read in time",
+                      underruns - streamer->reported_underruns);
+            streamer->reported_underruns = underruns;
+        }
+
+        streamer->last_report = msec;
+    }
+
+    return 1;
+}
+
+/*
+ * Pages in or decodes the sample data of a stream up to lookahead frames ahead
+ * of the renderer's request, and unlocks the data the renderer has passed.
+ */
+static void
+fluid_rvoice_stream_fill(fluid_rvoice_streamer_t *streamer, fluid_rvoice_stream_t *stream)
+{
+    int ready, target, chunk_end;
+
+    if(fluid_atomic_int_get(&stream->state) == FLUID_RVOICE_STREAM_RELEASED)
+    {
+        /* Only the I/O thread moves a stream on from RELEASED */
+        fluid_rvoice_stream_trim(streamer, stream, INT_MAX);
+        fluid_atomic_int_set(&stream->state, FLUID_RVOICE_STREAM_DONE);
+        return;
+    }
+
+    if(!fluid_atomic_int_compare_and_exchange(&stream->state, FLUID_RVOICE_STREAM_ACTIVE,
+            FLUID_RVOICE_STREAM_BUSY))
+    {
+        return;
+    }
+
+    /* The sample stays valid while busy: the voice hands its reference over
+     * to the stream if it finishes meanwhile. */
+    ready = fluid_atomic_int_get(&stream->ready_end);
+    target = fluid_atomic_int_get(&stream->request_end) + streamer->lookahead;
+
+    if(target > stream->end)
+    {
+        target = stream->end;
+    }
+
+    while(ready < target && fluid_atomic_int_get(&stream->state) == FLUID_RVOICE_STREAM_BUSY)
+    {
+        chunk_end = ready + FLUID_RVOICE_STREAM_CHUNK;
+
+        if(chunk_end > target)
+        {
+            chunk_end = target;
+        }
+
+        if(stream->sample->codec != NULL)
+        {
+            fluid_samplecodec_decode(stream->sample->codec, chunk_end);
+        }
+        else
+        {
+            fluid_rvoice_stream_page_in(stream->sample, ready, chunk_end);
+            fluid_rvoice_stream_lock(streamer, stream, ready, chunk_end);
+        }
+
+        ready = chunk_end;
+        fluid_atomic_int_set(&stream->ready_end, ready);
+    }
+
+    fluid_rvoice_stream_trim(streamer, stream, fluid_atomic_int_get(&stream->request_start));
+
+    if(!fluid_atomic_int_compare_and_exchange(&stream->state, FLUID_RVOICE_STREAM_BUSY,
+            FLUID_RVOICE_STREAM_ACTIVE))
+    {
+        /* The voice has been released meanwhile, let the synth drop the reference */
+        fluid_rvoice_stream_trim(streamer, stream, INT_MAX);
+        fluid_atomic_int_set(&stream->state, FLUID_RVOICE_STREAM_DONE);
+    }
+}
+
+/*
+ * Faults in the pages holding the sample data [from, to), so that the renderer
+ * doesn't have to wait for the disk when reading them.
+ */
+static void
+fluid_rvoice_stream_page_in(const fluid_sample_t *sample, int from, int to)
+{
+    const volatile short *data = sample->data;
+    const volatile char *data24 = sample->data24;
+    int i;
+
+    fluid_file_map_prefetch(sample->data + from, (to - from) * sizeof(short));
+
+    if(data24 != NULL)
+    {
+        fluid_file_map_prefetch(sample->data24 + from, to - from);
+    }
+
+    for(i = from; i < to; i += FLUID_RVOICE_STREAM_PAGE_FRAMES)
+    {
+        (void)data[i];
+
+        if(data24 != NULL)
+        {
+            (void)data24[i];
+        }
+    }
+
+    (void)data[to - 1];
+}
+
+/*
+ * Locks the sample data [from, to) in memory, which directly follows the data
+ * already locked by the stream. Otherwise the kernel could page it out again
+ * before the renderer gets to it, if memory is short.
+ */
+static void
+fluid_rvoice_stream_lock(fluid_rvoice_streamer_t *streamer, fluid_rvoice_stream_t *stream, int from, int to)
+{
+    const fluid_sample_t *sample = stream->sample;
+
+    if(streamer->lock_failed)
+    {
+        return;
+    }
+
+    if(fluid_mlock(sample->data + from, (to - from) * sizeof(short)) != 0
+            || (sample->data24 != NULL && fluid_mlock(sample->data24 + from, to - from) != 0))
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to lock streamed sample data in memory, it may be paged out before it is played. "
+                  "Consider raising the limit of locked memory.");
+        streamer->lock_failed = TRUE;
+        return;
+    }
+
+    if(stream->locked_start == stream->locked_end)
+    {
+        stream->locked_start = from;
+    }
+
+    stream->locked_end = to;
+}
+
+/*
+ * Unlocks the sample data [from, to) of a stream, except for the data other
+ * streams playing the same sample data keep locked.
+ */
+static void
+fluid_rvoice_stream_unlock(fluid_rvoice_streamer_t *streamer, const fluid_rvoice_stream_t *stream, int from, int to)
+{
+    const fluid_rvoice_stream_block_t *block;
+    const fluid_rvoice_stream_t *other;
+    int i;
+
+    if(from >= to)
+    {
+        return;
+    }
+
+    for(block = fluid_atomic_pointer_get(&streamer->blocks); block != NULL; block = block->next)
+    {
+        for(i = 0; i < block->count; i++)
+        {
+            other = &block->streams[i];
+
+            /* Streams with locked data keep their sample */
+            if(other == stream || other->locked_start == other->locked_end
+                    || other->sample->data != stream->sample->data
+                    || other->locked_start >= to || other->locked_end <= from)
+            {
+                continue;
+            }
+
+            fluid_rvoice_stream_unlock(streamer, stream, from, other->locked_start);
+            fluid_rvoice_stream_unlock(streamer, stream, other->locked_end, to);
+            return;
+        }
+    }
+
+    fluid_file_map_unlock(stream->sample->data + from, (to - from) * sizeof(short));
+
+    if(stream->sample->data24 != NULL)
+    {
+        fluid_file_map_unlock(stream->sample->data24 + from, to - from);
+    }
+}
+
+/*
+ * Unlocks the data a stream keeps locked before start.
+ */
+static void
+fluid_rvoice_stream_trim(fluid_rvoice_streamer_t *streamer, fluid_rvoice_stream_t *stream, int start)
+{
+    int from = stream->locked_start;
+    int to = stream->locked_end;
+
+    if(start <= from || from == to)
+    {
+        return;
+    }
+
+    if(start >= to)
+    {
+        stream->locked_start = stream->locked_end = 0;
+        fluid_rvoice_stream_unlock(streamer, stream, from, to);
+        return;
+    }
+
+    stream->locked_start = start;
+    fluid_rvoice_stream_unlock(streamer, stream, from, start);
+}
@@ -0,0 +1,134 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FLUID_RVOICE_STREAM_H
+#define _FLUID_RVOICE_STREAM_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_sys.h"
+#include "fluid_sfont.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Disk streaming of sample data.
+ *
+ * Samples that are streamed are memory mapped from the SoundFont file and only
+ * their head (fluid_sample_t::stream_preload frames) is kept resident. Every
+ * rvoice owns a stream, through which the renderer announces how far into the
+ * sample its next block will read. A background I/O thread pages the data in
+ * ahead of that position, locks it in memory until the renderer has passed it
+ * and publishes how much of the sample is resident. If the data is not there in
+ * time, the renderer outputs silence for the block instead of waiting for the
+ * page fault (underrun). An rvoice whose stream is still in use by the I/O
+ * thread when it starts again gets a spare stream.
+ *
+ * Compressed samples (see fluid_samplecodec.c) are streamed the same way, the
+ * I/O thread decodes their data instead of paging it in.
+ */
+
+/* Count of sample points ahead of the playhead read by the interpolation */
+#define FLUID_RVOICE_STREAM_GUARD 8
+
+typedef struct _fluid_rvoice_stream_t fluid_rvoice_stream_t;
+typedef struct _fluid_rvoice_streamer_t fluid_rvoice_streamer_t;
+
+enum fluid_rvoice_stream_state
+{
+    FLUID_RVOICE_STREAM_IDLE,     /* not used by a voice, owned by the synth */
+    FLUID_RVOICE_STREAM_ACTIVE,   /* used by a playing voice */
+    FLUID_RVOICE_STREAM_BUSY,     /* used by a playing voice, the I/O thread is paging in data */
+    FLUID_RVOICE_STREAM_RELEASED, /* voice finished while the I/O thread was busy or kept data locked, the stream holds the voice's sample reference */
+    FLUID_RVOICE_STREAM_DONE      /* like RELEASED, but the I/O thread is done with it */
+};
+
+struct _fluid_rvoice_stream_t
+{
+    fluid_atomic_int_t state;       /**< Atomic: enum fluid_rvoice_stream_state */
+    fluid_atomic_int_t request_start; /**< Atomic: start of the data the renderer may still read, set by the renderer */
+    fluid_atomic_int_t request_end; /**< Atomic: end of the data the renderer is going to read, set by the renderer */
+    fluid_atomic_int_t ready_end;   /**< Atomic: all data from the sample start up to here is resident, set by the I/O thread */
+    fluid_atomic_int_t underruns;   /**< Atomic: count of blocks that were silenced because data was missing */
+
+    /* Only written by the synth while the stream is idle */
+    fluid_sample_t *sample;
+    int end;                        /**< first index behind the sample data */
+    int owned;                      /**< TRUE if the stream belongs to an rvoice, FALSE for spare streams */
+    fluid_rvoice_streamer_t *streamer;
+
+    /* I/O thread only: the sample data [locked_start, locked_end) is locked in
+     * memory, the range is empty unless the stream is active, busy or released */
+    int locked_start;
+    int locked_end;
+};
+
+fluid_rvoice_streamer_t *new_fluid_rvoice_streamer(int lookahead);
+void delete_fluid_rvoice_streamer(fluid_rvoice_streamer_t *streamer);
+
+fluid_rvoice_stream_t *fluid_rvoice_streamer_new_streams(fluid_rvoice_streamer_t *streamer, int count);
+void fluid_rvoice_streamer_reclaim(fluid_rvoice_streamer_t *streamer);
+int fluid_rvoice_streamer_get_underruns(fluid_rvoice_streamer_t *streamer);
+
+fluid_rvoice_stream_t *fluid_rvoice_stream_start(fluid_rvoice_stream_t *stream, fluid_sample_t *sample);
+int fluid_rvoice_stream_stop(fluid_rvoice_stream_t *stream);
+
+/**
+ * Announce the data needed for the next block and check whether it is resident.
+ * Called by the renderer, never blocks.
+ *
+ * @param stream the stream of the rvoice
+ * @param first index of the first sample the voice may still read, in this or any later block
+ * @param need index behind the last sample the next block will read
+ * @return TRUE if the block can be rendered, FALSE on underrun
+ */
+static FLUID_INLINE int
+fluid_rvoice_stream_request(fluid_rvoice_stream_t *stream, int first, int need)
+{
+    int state = fluid_atomic_int_get(&stream->state);
+
+    if(state != FLUID_RVOICE_STREAM_ACTIVE && state != FLUID_RVOICE_STREAM_BUSY)
+    {
+        return TRUE;
+    }
+
+    if(need > stream->end)
+    {
+        need = stream->end;
+    }
+
+    fluid_atomic_int_set(&stream->request_start, first);
+    fluid_atomic_int_set(&stream->request_end, need);
+
+    if(need > fluid_atomic_int_get(&stream->ready_end))
+    {
+        fluid_atomic_int_add(&stream->underruns, 1);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_RVOICE_STREAM_H */
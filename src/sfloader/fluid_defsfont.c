@@ -25,6 +25,9 @@
 #include "fluid_sys.h"
 #include "fluid_synth.h"
 #include "fluid_samplecache.h"
+#include "fluid_samplededup.h"
+#include "fluid_samplecodec.h"
+#include "fluid_sfimage.h"
 #include "fluid_chan.h"
 
 /* EMU8k/10k hardware applies this factor to initial attenuation generator values set at preset and
@@ -32,17 +35,45 @@
  * compatible as most existing soundfonts expect exactly this (strange, non-standard) behaviour. */
 #define EMU_ATTENUATION_FACTOR (0.4f)
 
+/* Size of the memory chunks the presets, instruments and zones of a SoundFont are allocated from */
+#define FLUID_DEFSFONT_ARENA_CHUNK (64 * 1024)
+
+/* Maximum time in milliseconds pinning a preset waits for its samples to be
+ * loaded in the background */
+#define FLUID_DEFSFONT_PIN_TIMEOUT 10000
+
 /* Dynamic sample loading functions */
 static int pin_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static int unpin_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static void unload_sample(fluid_sample_t *sample);
+static int unload_sample_data(fluid_sample_t *sample);
+static int queue_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
+static void load_samples(fluid_defsfont_t *defsfont, SFData *sffile, fluid_list_t *samples);
+static int wait_preset_samples(fluid_preset_t *preset);
+static int wait_sample(fluid_sample_t *sample, unsigned int deadline);
+static fluid_thread_return_t dynamic_samples_thread(void *data);
+static void stop_dynamic_samples_thread(fluid_defsfont_t *defsfont);
 static int dynamic_samples_preset_notify(fluid_preset_t *preset, int reason, int chan);
+static int fluid_defpreset_preset_notify(fluid_preset_t *preset, int reason, int chan);
+static int fluid_defpreset_import_zones(fluid_defpreset_t *defpreset, SFPreset *sfpreset, SFData *sfdata);
 static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason);
-static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone);
+static int shared_samples_sample_notify(fluid_sample_t *sample, int reason);
 static fluid_inst_t *find_inst_by_idx(fluid_defsfont_t *defsfont, int idx);
 
+/* Shared SoundFont functions */
+static fluid_sfont_t *new_fluid_defsfont_sfont(fluid_settings_t *settings);
+static int fluid_defsfont_load_shared(fluid_defsfont_t *defsfont, fluid_settings_t *settings,
+                                      const fluid_file_callbacks_t *fcbs, const char *file);
+static int fluid_defsfont_attach(fluid_defsfont_t *defsfont, fluid_defsfont_t *shared);
+static int fluid_defsfont_unshare(fluid_defsfont_t *defsfont);
+static fluid_defsfont_t *sample_owner(fluid_defsfont_t *defsfont);
+
+/* Incremental reload functions */
+static int reload_sample_reuse(fluid_defsfont_t *defsfont, SFData *sfdata, fluid_sample_t *sample);
+static int ref_sample_data(fluid_sample_t *sample);
+
 
 /***************************************************************
  *
@@ -76,11 +107,46 @@ fluid_sfloader_t *new_fluid_defsfloader(fluid_settings_t *settings)
 }
 
 fluid_sfont_t *fluid_defsfloader_load(fluid_sfloader_t *loader, const char *filename)
+{
+    fluid_settings_t *settings = fluid_sfloader_get_data(loader);
+    fluid_defsfont_t *defsfont;
+    fluid_sfont_t *sfont;
+    int ret;
+
+    sfont = new_fluid_defsfont_sfont(settings);
+
+    if(sfont == NULL)
+    {
+        return NULL;
+    }
+
+    defsfont = fluid_sfont_get_data(sfont);
+
+    if(defsfont->sharing)
+    {
+        ret = fluid_defsfont_load_shared(defsfont, settings, &loader->file_callbacks, filename);
+    }
+    else
+    {
+        ret = fluid_defsfont_load(defsfont, &loader->file_callbacks, filename);
+    }
+
+    if(ret == FLUID_FAILED)
+    {
+        fluid_defsfont_sfont_delete(sfont);
+        return NULL;
+    }
+
+    return sfont;
+}
+
+/* Creates an empty SoundFont together with its virtual SoundFont instance */
+static fluid_sfont_t *new_fluid_defsfont_sfont(fluid_settings_t *settings)
 {
     fluid_defsfont_t *defsfont;
     fluid_sfont_t *sfont;
 
-    defsfont = new_fluid_defsfont(fluid_sfloader_get_data(loader));
+    defsfont = new_fluid_defsfont(settings);
 
     if(defsfont == NULL)
     {
@@ -103,15 +169,483 @@ fluid_sfont_t *fluid_defsfloader_load(fluid_sfloader_t *loader, const char *file
 
     defsfont->sfont = sfont;
 
-    if(fluid_defsfont_load(defsfont, &loader->file_callbacks, filename) == FLUID_FAILED)
+    return sfont;
+}
+
+
+/***************************************************************
+ *
+ *                           SHARED SOUNDFONTS
+ */
+
+/* With synth.sfont-sharing, the presets, instruments and samples of a SoundFont
+ * file are loaded only once per process. They are owned by a hidden SoundFont,
+ * which is never added to a synth and is freed together with the last SoundFont
+ * using it. Every load of the file still creates its own fluid_defsfont_t with
+ * its own virtual SoundFont and presets, which refer to the data of the hidden
+ * one. This way the SoundFont ID, the bank offset, the preset iteration and the
+ * pinned presets stay separate for every synth. */
+
+/* The hidden SoundFonts. The mutex also serializes loading them, so that a file
+ * loaded by several synths at the same time is parsed only once. */
+static fluid_list_t *shared_defsfonts = NULL;
+static fluid_mutex_t shared_defsfonts_mutex = FLUID_MUTEX_INIT;
+
+/* The presets of a shared SoundFont can be selected by several synths at the
+ * same time, and the voices of any of them can release its samples. This mutex
+ * protects the preset_count and the data of those samples. */
+static fluid_mutex_t shared_samples_mutex = FLUID_MUTEX_INIT;
+
+/* Returns TRUE if both directories are unset or equal */
+static int shared_dir_matches(const char *shared_dir, const char *dir)
+{
+    if(shared_dir == NULL || dir == NULL)
+    {
+        return shared_dir == dir;
+    }
+
+    return FLUID_STRCMP(shared_dir, dir) == 0;
+}
+
+/* Returns TRUE if the data of shared can be used for a SoundFont loaded from the
+ * given file with the settings of defsfont */
+static int shared_defsfont_matches(const fluid_defsfont_t *shared, const fluid_defsfont_t *defsfont,
+                                   const fluid_file_callbacks_t *fcbs, const char *file, time_t mtime)
+{
+    return FLUID_STRCMP(shared->filename, file) == 0
+           && shared->mtime == mtime
+           && FLUID_MEMCMP(&shared->fcbs, fcbs, sizeof(*fcbs)) == 0
+           && shared->mlock == defsfont->mlock
+           && shared->dynamic_samples == defsfont->dynamic_samples
+           && shared->async_samples == defsfont->async_samples
+           && shared->mmap == defsfont->mmap
+           && shared->shm == defsfont->shm
+           && shared->streaming == defsfont->streaming
+           && shared->stream_preload == defsfont->stream_preload
+           && shared->dedup == defsfont->dedup
+           && shared->compression == defsfont->compression
+           && shared->lazy_presets == defsfont->lazy_presets
+           && shared->incremental == defsfont->incremental
+           && shared_dir_matches(shared->sample_cache_dir, defsfont->sample_cache_dir)
+           && shared_dir_matches(shared->compiled_dir, defsfont->compiled_dir);
+}
+
+/* Loads a SoundFont using the data of an already loaded one if possible */
+static int fluid_defsfont_load_shared(fluid_defsfont_t *defsfont, fluid_settings_t *settings,
+                                      const fluid_file_callbacks_t *fcbs, const char *file)
+{
+    fluid_defsfont_t *shared = NULL;
+    fluid_sfont_t *sfont;
+    fluid_list_t *list;
+    fluid_stat_buf_t buf;
+    time_t mtime = 0;
+
+    /* Files that aren't on disk are identified by their name only, like in the sample cache */
+    if(fluid_stat(file, &buf) == 0)
+    {
+        mtime = buf.st_mtime;
+    }
+
+    fluid_mutex_lock(shared_defsfonts_mutex);
+
+    for(list = shared_defsfonts; list; list = fluid_list_next(list))
+    {
+        if(shared_defsfont_matches(fluid_list_get(list), defsfont, fcbs, file, mtime))
+        {
+            shared = fluid_list_get(list);
+            break;
+        }
+    }
+
+    if(shared != NULL)
+    {
+        FLUID_LOG(FLUID_DBG, "Using the already loaded data of '%s'", file);
+    }
+    else
+    {
+        sfont = new_fluid_defsfont_sfont(settings);
+
+        if(sfont != NULL)
+        {
+            shared = fluid_sfont_get_data(sfont);
+            shared->mtime = mtime;
+
+            if(fluid_defsfont_load(shared, fcbs, file) == FLUID_OK)
+            {
+                shared_defsfonts = fluid_list_prepend(shared_defsfonts, shared);
+            }
+            else
+            {
+                fluid_defsfont_sfont_delete(sfont);
+                shared = NULL;
+            }
+        }
+    }
+
+    if(shared != NULL)
+    {
+        shared->share_count++;
+        defsfont->shared = shared;
+    }
+
+    fluid_mutex_unlock(shared_defsfonts_mutex);
+
+    if(shared == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* If this fails, deleting the SoundFont drops the reference again */
+    return fluid_defsfont_attach(defsfont, shared);
+}
+
+/* Makes defsfont refer to the data of shared and creates its presets */
+static int fluid_defsfont_attach(fluid_defsfont_t *defsfont, fluid_defsfont_t *shared)
+{
+    fluid_mod_t *mods;
+    int mod_count;
+    int i;
+
+    defsfont->filename = FLUID_STRDUP(shared->filename);
+
+    if(defsfont->filename == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    defsfont->fcbs = shared->fcbs;
+    defsfont->mtime = shared->mtime;
+    defsfont->samplepos = shared->samplepos;
+    defsfont->samplesize = shared->samplesize;
+    defsfont->sampledata = shared->sampledata;
+    defsfont->sample24pos = shared->sample24pos;
+    defsfont->sample24size = shared->sample24size;
+    defsfont->sample24data = shared->sample24data;
+    defsfont->sample = shared->sample;
+    defsfont->inst = shared->inst;
+    defsfont->inst_count = shared->inst_count;
+
+    /* The samples use the default modulators of the shared SoundFont, the copy
+     * can be changed with fluid_sfont_set_default_mod() */
+    if(shared->sfont->default_mod_list != NULL)
+    {
+        mod_count = fluid_sfont_get_default_mod(shared->sfont, &mods);
+
+        if(mod_count == FLUID_FAILED)
+        {
+            return FLUID_FAILED;
+        }
+
+        i = fluid_sfont_set_default_mod(defsfont->sfont, mods, mod_count);
+        FLUID_FREE(mods);
+
+        if(i != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    for(i = 0; i < shared->preset_count; i++)
+    {
+        if(fluid_defsfont_add_preset(defsfont, fluid_preset_get_data(shared->preset[i])) == FLUID_FAILED)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/* Drops the reference of defsfont to its shared SoundFont, which is freed if
+ * defsfont was the last SoundFont using it. Fails if that is the case, but
+ * voices still play its samples. */
+static int fluid_defsfont_unshare(fluid_defsfont_t *defsfont)
+{
+    fluid_defsfont_t *shared = defsfont->shared;
+    fluid_list_t *list;
+    fluid_sample_t *sample;
+    int last;
+
+    fluid_mutex_lock(shared_defsfonts_mutex);
+
+    last = (shared->share_count == 1);
+
+    if(last)
+    {
+        for(list = shared->sample; list; list = fluid_list_next(list))
+        {
+            sample = fluid_list_get(list);
+
+            if(fluid_atomic_int_get(&sample->refcount) != 0)
+            {
+                fluid_mutex_unlock(shared_defsfonts_mutex);
+                return FLUID_FAILED;
+            }
+        }
+
+        shared_defsfonts = fluid_list_remove(shared_defsfonts, shared);
+    }
+
+    shared->share_count--;
+    defsfont->shared = NULL;
+
+    fluid_mutex_unlock(shared_defsfonts_mutex);
+
+    if(last && fluid_defsfont_sfont_delete(shared->sfont) != 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Unable to free the shared data of '%s'", defsfont->filename);
+    }
+
+    return FLUID_OK;
+}
+
+/* Returns the SoundFont that owns the samples of defsfont */
+static fluid_defsfont_t *sample_owner(fluid_defsfont_t *defsfont)
+{
+    return (defsfont->shared != NULL) ? defsfont->shared : defsfont;
+}
+
+/* Only used for tests */
+int fluid_defsfont_count_shared(void)
+{
+    int count;
+
+    fluid_mutex_lock(shared_defsfonts_mutex);
+    count = fluid_list_size(shared_defsfonts);
+    fluid_mutex_unlock(shared_defsfonts_mutex);
+
+    return count;
+}
+
+
+/***************************************************************
+ *
+ *                           INCREMENTAL RELOAD
+ */
+
+/* With synth.incremental-reload, reloading a SoundFont creates a new one,
+ * whose samples take over the data of the samples of the loaded one if their
+ * data and their header are unchanged, by taking another reference to it. So
+ * only the data of new or modified samples is read and decoded. The loaded
+ * SoundFont itself stays untouched, its voices keep playing until it is
+ * unloaded.
+ *
+ * Samples are compared by a hash of their data as stored in the file. Loading
+ * a SoundFont doesn't hash anything: the first reload hashes the loaded data
+ * of uncompressed samples instead, and the samples of a reloaded SoundFont are
+ * loaded individually and hashed in the file, like SF3 samples. */
+
+/* Returns the position of a loop point relative to the sample */
+static unsigned int reload_sample_offset(const fluid_sample_t *sample, unsigned int pos)
+{
+    /* Ogg Vorbis loop points are relative to the sample already */
+    if(sample->sampletype & FLUID_SAMPLETYPE_OGG_VORBIS)
+    {
+        return pos;
+    }
+
+    return pos - sample->source_start;
+}
+
+static unsigned int reload_sample_hash(const void *v)
+{
+    const fluid_sample_t *sample = v;
+
+    return (unsigned int)(sample->source_hash ^ (sample->source_hash >> 32));
+}
+
+/* Compares everything that goes into the loaded data of two samples */
+static int reload_sample_equal(const void *a, const void *b)
+{
+    const fluid_sample_t *sample_a = a, *sample_b = b;
+
+    return sample_a->source_hash == sample_b->source_hash
+           && sample_a->source_end - sample_a->source_start == sample_b->source_end - sample_b->source_start
+           && reload_sample_offset(sample_a, sample_a->source_loopstart) == reload_sample_offset(sample_b, sample_b->source_loopstart)
+           && reload_sample_offset(sample_a, sample_a->source_loopend) == reload_sample_offset(sample_b, sample_b->source_loopend)
+           && sample_a->sampletype == sample_b->sampletype;
+}
+
+/* Hashes the loaded data of a sample of the SoundFont being reloaded that
+ * hasn't been hashed yet, like fluid_sffile_hash_sample_data() hashes it in
+ * the file. Only uncompressed 16 bit data on little-endian machines is the
+ * same in memory, the hash of other samples stays 0. */
+static void reload_sample_hash_loaded(fluid_sample_t *sample)
+{
+    unsigned int count = sample->end + 1 - sample->start;
+    uint64_t hash;
+
+    if(sample->source_hash != 0 || sample->codec != NULL || FLUID_IS_BIG_ENDIAN
+            || (sample->sampletype & FLUID_SAMPLETYPE_OGG_VORBIS)
+            || count != sample->source_end + 1 - sample->source_start)
+    {
+        return;
+    }
+
+    hash = fluid_fnv1a64(FLUID_FNV1A64_INIT, sample->data + sample->start, count * sizeof(short));
+
+    if(sample->data24 != NULL)
+    {
+        hash = fluid_fnv1a64(hash, sample->data24 + sample->start, count);
+    }
+
+    sample->source_hash = hash;
+}
+
+/* Hashes the data of a sample in the file and takes over the loaded data of
+ * an unchanged sample of the SoundFont being reloaded. Returns TRUE if it did,
+ * FALSE if its data has to be loaded. Called concurrently for all samples of
+ * the SoundFont. */
+static int reload_sample_reuse(fluid_defsfont_t *defsfont, SFData *sfdata, fluid_sample_t *sample)
+{
+    fluid_sample_t *loaded;
+
+    if(fluid_sffile_hash_sample_data(sfdata, sample->source_start, sample->source_end,
+                                     sample->sampletype, &sample->source_hash) == FLUID_FAILED)
+    {
+        /* Can't be compared, loading the data reports the error */
+        sample->source_hash = 0;
+        return FALSE;
+    }
+
+    loaded = fluid_hashtable_lookup(defsfont->reload_samples, sample);
+
+    if(loaded == NULL || ref_sample_data(loaded) == FLUID_FAILED)
+    {
+        return FALSE;
+    }
+
+    /* The loop points have been sanitized and the noise floor calculated already */
+    sample->data = loaded->data;
+    sample->data24 = loaded->data24;
+    sample->codec = loaded->codec;
+    sample->stream_preload = loaded->stream_preload;
+    sample->start = loaded->start;
+    sample->end = loaded->end;
+    sample->loopstart = loaded->loopstart;
+    sample->loopend = loaded->loopend;
+    sample->amplitude_that_reaches_noise_floor_is_valid = loaded->amplitude_that_reaches_noise_floor_is_valid;
+    sample->amplitude_that_reaches_noise_floor = loaded->amplitude_that_reaches_noise_floor;
+
+    return TRUE;
+}
+
+/* Returns TRUE if the SoundFont has been loaded by the default loader with
+ * synth.incremental-reload, so that fluid_defsfloader_reload() can be used */
+int fluid_defsfont_can_reload(fluid_sfont_t *sfont)
+{
+    fluid_defsfont_t *defsfont;
+
+    if(sfont->free != fluid_defsfont_sfont_delete)
+    {
+        return FALSE;
+    }
+
+    defsfont = fluid_sfont_get_data(sfont);
+    return defsfont->incremental;
+}
+
+/* Imports a lazily loaded preset that is played without having been selected
+ * on a channel, see fluid_synth_start(). Presets of other loaders are left
+ * alone. */
+int fluid_defsfont_import_preset(fluid_preset_t *preset)
+{
+    if(preset->sfont->free != fluid_defsfont_sfont_delete)
+    {
+        return FLUID_OK;
+    }
+
+    return fluid_defpreset_import_lazy(fluid_preset_get_data(preset));
+}
+
+/* Loads the file of a SoundFont again with the loader that loaded it, taking
+ * over the data of its unchanged samples. The given SoundFont isn't modified,
+ * the caller replaces it by the returned one. Returns NULL on error, or if the
+ * SoundFont hasn't been loaded by this loader. Called without the synth's API
+ * lock, the caller has to keep a reference to the SoundFont. */
+fluid_sfont_t *fluid_defsfloader_reload(fluid_sfloader_t *loader, fluid_sfont_t *sfont)
+{
+    fluid_defsfont_t *loaded = fluid_sfont_get_data(sfont);
+    fluid_defsfont_t *defsfont;
+    fluid_sfont_t *reloaded;
+    fluid_list_t *list;
+    fluid_sample_t *sample;
+    int ret;
+
+    if(loader->load != fluid_defsfloader_load
+            || FLUID_MEMCMP(&loader->file_callbacks, &loaded->fcbs, sizeof(loaded->fcbs)) != 0)
     {
-        fluid_defsfont_sfont_delete(sfont);
         return NULL;
     }
 
-    return sfont;
+    reloaded = new_fluid_defsfont_sfont(fluid_sfloader_get_data(loader));
+
+    if(reloaded == NULL)
+    {
+        return NULL;
+    }
+
+    defsfont = fluid_sfont_get_data(reloaded);
+
+    /* The settings might have changed since the SoundFont was loaded */
+    if(defsfont->incremental)
+    {
+        defsfont->reload_samples = new_fluid_hashtable(reload_sample_hash, reload_sample_equal);
+
+        if(defsfont->reload_samples == NULL)
+        {
+            fluid_defsfont_sfont_delete(reloaded);
+            return NULL;
+        }
+
+        for(list = loaded->sample; list; list = fluid_list_next(list))
+        {
+            sample = fluid_list_get(list);
+
+            if(sample->data != NULL)
+            {
+                reload_sample_hash_loaded(sample);
+            }
+
+            if(sample->data != NULL && sample->source_hash != 0)
+            {
+                fluid_hashtable_insert(defsfont->reload_samples, sample, sample);
+            }
+        }
+    }
+
+    ret = fluid_defsfont_load(defsfont, &loader->file_callbacks, loaded->filename);
+
+    delete_fluid_hashtable(defsfont->reload_samples);
+    defsfont->reload_samples = NULL;
+
+    if(ret == FLUID_FAILED)
+    {
+        fluid_defsfont_sfont_delete(reloaded);
+        return NULL;
+    }
+
+    return reloaded;
 }
 
+/* Takes another reference to the data of an individually loaded sample, for a
+ * sample of a reloaded SoundFont. Counterpart of unload_sample_data(). */
+static int ref_sample_data(fluid_sample_t *sample)
+{
+    if(sample->codec != NULL)
+    {
+        fluid_samplecodec_ref(sample->codec);
+        return FLUID_OK;
+    }
+
+    if(fluid_samplededup_ref(sample->data) == FLUID_OK)
+    {
+        return FLUID_OK;
+    }
+
+    return fluid_samplecache_ref(sample->data);
+}
 
 
 /***************************************************************
@@ -153,18 +687,7 @@ fluid_preset_t *fluid_defsfont_sfont_iteration_next(fluid_sfont_t *sfont)
 
 void fluid_defpreset_preset_delete(fluid_preset_t *preset)
 {
-    fluid_defsfont_t *defsfont;
-    fluid_defpreset_t *defpreset;
-
-    defsfont = fluid_sfont_get_data(preset->sfont);
-    defpreset = fluid_preset_get_data(preset);
-
-    if(defsfont)
-    {
-        defsfont->preset = fluid_list_remove(defsfont->preset, defpreset);
-    }
-
-    delete_fluid_defpreset(defpreset);
+    /* The fluid_defpreset_t lives in the arena of the SoundFont */
     delete_fluid_preset(preset);
 }
 
@@ -201,6 +724,8 @@ int fluid_defpreset_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth,
 fluid_defsfont_t *new_fluid_defsfont(fluid_settings_t *settings)
 {
     fluid_defsfont_t *defsfont;
+    int cache_size;
+    int codec_cache_size;
 
     defsfont = FLUID_NEW(fluid_defsfont_t);
 
@@ -212,8 +737,92 @@ fluid_defsfont_t *new_fluid_defsfont(fluid_settings_t *settings)
 
     FLUID_MEMSET(defsfont, 0, sizeof(*defsfont));
 
+    defsfont->arena = new_fluid_arena(FLUID_DEFSFONT_ARENA_CHUNK);
+
+    if(defsfont->arena == NULL)
+    {
+        FLUID_FREE(defsfont);
+        return NULL;
+    }
+
     fluid_settings_getint(settings, "synth.lock-memory", &defsfont->mlock);
     fluid_settings_getint(settings, "synth.dynamic-sample-loading", &defsfont->dynamic_samples);
+    fluid_settings_getint(settings, "synth.sample-mmap", &defsfont->mmap);
+    fluid_settings_getint(settings, "synth.sample-shm", &defsfont->shm);
+    fluid_settings_getint(settings, "synth.sample-streaming", &defsfont->streaming);
+    fluid_settings_getint(settings, "synth.sample-streaming-preload", &defsfont->stream_preload);
+    fluid_settings_getint(settings, "synth.sfont-sharing", &defsfont->sharing);
+
+    /* Shared SoundFonts are imported completely, the synths sharing them would
+     * otherwise import their presets concurrently */
+    if(!defsfont->sharing)
+    {
+        fluid_settings_getint(settings, "synth.lazy-preset-loading", &defsfont->lazy_presets);
+    }
+
+    /* Streamed samples have to stay mapped from the file, compressed samples aren't shared */
+    if(!defsfont->streaming)
+    {
+        fluid_settings_getint(settings, "synth.sample-compression", &defsfont->compression);
+
+        if(!defsfont->compression)
+        {
+            fluid_settings_getint(settings, "synth.sample-dedup", &defsfont->dedup);
+        }
+    }
+
+    /* Samples that are loaded on demand, streamed or shared with other synths aren't taken over when reloading */
+    if(!defsfont->dynamic_samples && !defsfont->streaming && !defsfont->sharing)
+    {
+        fluid_settings_getint(settings, "synth.incremental-reload", &defsfont->incremental);
+    }
+
+    if(defsfont->dynamic_samples)
+    {
+        fluid_settings_getint(settings, "synth.dynamic-sample-loading-async", &defsfont->async_samples);
+    }
+
+    if(defsfont->async_samples)
+    {
+        defsfont->async_mutex = new_fluid_cond_mutex();
+        defsfont->async_cond = new_fluid_cond();
+
+        if(defsfont->async_mutex == NULL || defsfont->async_cond == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            delete_fluid_defsfont(defsfont);
+            return NULL;
+        }
+    }
+
+    if(fluid_settings_dupstr(settings, "synth.sample-cache-dir", &defsfont->sample_cache_dir) == FLUID_OK
+            && defsfont->sample_cache_dir != NULL && defsfont->sample_cache_dir[0] == '\0')
+    {
+        FLUID_FREE(defsfont->sample_cache_dir);
+        defsfont->sample_cache_dir = NULL;
+    }
+
+    if(fluid_settings_dupstr(settings, "synth.compiled-sfont-dir", &defsfont->compiled_dir) == FLUID_OK
+            && defsfont->compiled_dir != NULL && defsfont->compiled_dir[0] == '\0')
+    {
+        FLUID_FREE(defsfont->compiled_dir);
+        defsfont->compiled_dir = NULL;
+    }
+
+    /* The sample cache is shared by the whole process, a SoundFont loaded
+     * without a cache size must not evict the data another synth keeps */
+    if(fluid_settings_getint(settings, "synth.sample-cache-size", &cache_size) == FLUID_OK
+            && cache_size > 0)
+    {
+        fluid_samplecache_grow_size((fluid_long_long_t)cache_size * 1024 * 1024);
+    }
+
+    /* Same for the decoded data of compressed samples */
+    if(defsfont->compression
+            && fluid_settings_getint(settings, "synth.sample-compression-cache-size", &codec_cache_size) == FLUID_OK)
+    {
+        fluid_samplecodec_set_cache_size((fluid_long_long_t)codec_cache_size * 1024 * 1024);
+    }
 
     return defsfont;
 }
@@ -224,79 +833,114 @@ fluid_defsfont_t *new_fluid_defsfont(fluid_settings_t *settings)
 int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
 {
     fluid_list_t *list;
-    fluid_preset_t *preset;
     fluid_sample_t *sample;
+    int i;
 
     fluid_return_val_if_fail(defsfont != NULL, FLUID_OK);
 
     /* If we use dynamic sample loading, make sure we unpin any
      * pinned presets before removing this soundfont */
-    if(defsfont->dynamic_samples)
+    if(defsfont->dynamic_samples && defsfont->pinned != NULL)
     {
-        for(list = defsfont->preset; list; list = fluid_list_next(list))
+        if(defsfont->sharing)
         {
-            preset = (fluid_preset_t *)fluid_list_get(list);
-            unpin_preset_samples(defsfont, preset);
+            fluid_mutex_lock(shared_samples_mutex);
         }
-    }
 
-    /* Check that no samples are currently used */
-    for(list = defsfont->sample; list; list = fluid_list_next(list))
-    {
-        sample = (fluid_sample_t *) fluid_list_get(list);
+        for(i = 0; i < defsfont->preset_count; i++)
+        {
+            unpin_preset_samples(defsfont, defsfont->preset[i]);
+        }
 
-        if(sample->refcount != 0)
+        if(defsfont->sharing)
         {
-            return FLUID_FAILED;
+            fluid_mutex_unlock(shared_samples_mutex);
         }
     }
 
-    if(defsfont->filename != NULL)
+    if(defsfont->shared != NULL)
     {
-        FLUID_FREE(defsfont->filename);
+        /* The samples and presets belong to the shared SoundFont */
+        if(fluid_defsfont_unshare(defsfont) == FLUID_FAILED)
+        {
+            return FLUID_FAILED;
+        }
     }
-
-    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    else
     {
-        sample = (fluid_sample_t *) fluid_list_get(list);
+        stop_dynamic_samples_thread(defsfont);
 
-        /* If the sample data pointer is different to the sampledata chunk of
-         * the soundfont, then the sample has been loaded individually (SF3)
-         * and needs to be unloaded explicitly. This is safe even if using
-         * dynamic sample loading, as the sample_unload mechanism sets
-         * sample->data to NULL after unload. */
-        if ((sample->data != NULL) && (sample->data != defsfont->sampledata))
+        /* Check that no samples are currently used */
+        for(list = defsfont->sample; list; list = fluid_list_next(list))
         {
-            fluid_samplecache_unload(sample->data);
+            sample = (fluid_sample_t *) fluid_list_get(list);
+
+            if(fluid_atomic_int_get(&sample->refcount) != 0)
+            {
+                return FLUID_FAILED;
+            }
         }
-        delete_fluid_sample(sample);
-    }
 
-    if(defsfont->sample)
-    {
-        delete_fluid_list(defsfont->sample);
+        for(list = defsfont->sample; list; list = fluid_list_next(list))
+        {
+            sample = (fluid_sample_t *) fluid_list_get(list);
+
+            /* If the sample data pointer is different to the sampledata chunk of
+             * the soundfont, then the sample has been loaded individually (SF3)
+             * and needs to be unloaded explicitly. This is safe even if using
+             * dynamic sample loading, as the sample_unload mechanism sets
+             * sample->data to NULL after unload. */
+            if ((sample->data != NULL) && (sample->data != defsfont->sampledata))
+            {
+                unload_sample_data(sample);
+            }
+            delete_fluid_sample(sample);
+        }
+
+        if(defsfont->sample)
+        {
+            delete_fluid_list(defsfont->sample);
+        }
+
+        if(defsfont->sampledata != NULL)
+        {
+            fluid_samplecache_unload(defsfont->sampledata);
+        }
+
+        if(defsfont->sfdata != NULL)
+        {
+            fluid_sffile_close(defsfont->sfdata);
+        }
     }
 
-    if(defsfont->sampledata != NULL)
+    if(defsfont->filename != NULL)
     {
-        fluid_samplecache_unload(defsfont->sampledata);
+        FLUID_FREE(defsfont->filename);
     }
 
-    for(list = defsfont->preset; list; list = fluid_list_next(list))
+    for(i = 0; i < defsfont->preset_count; i++)
     {
-        preset = (fluid_preset_t *)fluid_list_get(list);
-        fluid_defpreset_preset_delete(preset);
+        fluid_defpreset_preset_delete(defsfont->preset[i]);
     }
 
-    delete_fluid_list(defsfont->preset);
+    FLUID_FREE(defsfont->preset);
+    FLUID_FREE(defsfont->pinned);
 
-    for(list = defsfont->inst; list; list = fluid_list_next(list))
+    /* Frees the presets, instruments, zones and modulators at once */
+    delete_fluid_arena(defsfont->arena);
+
+    if(defsfont->async_cond != NULL)
     {
-        delete_fluid_inst(fluid_list_get(list));
+        delete_fluid_cond(defsfont->async_cond);
     }
 
-    delete_fluid_list(defsfont->inst);
+    if(defsfont->async_mutex != NULL)
+    {
+        delete_fluid_cond_mutex(defsfont->async_mutex);
+    }
 
+    FLUID_FREE(defsfont->sample_cache_dir);
+    FLUID_FREE(defsfont->compiled_dir);
     FLUID_FREE(defsfont);
     return FLUID_OK;
 }
@@ -309,6 +953,75 @@ const char *fluid_defsfont_get_name(fluid_defsfont_t *defsfont)
     return defsfont->filename;
 }
 
+/* Keeps the head of a memory mapped sample resident and marks the sample for
+ * streaming, the synth reads the rest from disk while the sample is playing. */
+static void fluid_defsfont_preload_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    unsigned int frames = sample->end + 1 - sample->start;
+
+    if(frames > (unsigned int)defsfont->stream_preload)
+    {
+        frames = defsfont->stream_preload;
+    }
+
+    fluid_file_map_prefetch(sample->data + sample->start, frames * sizeof(short));
+
+    if(sample->data24 != NULL)
+    {
+        fluid_file_map_prefetch(sample->data24 + sample->start, frames);
+    }
+
+    if(defsfont->mlock)
+    {
+        /* It's okay if this fails, the head is paged in by the synth then */
+        fluid_mlock(sample->data + sample->start, frames * sizeof(short));
+
+        if(sample->data24 != NULL)
+        {
+            fluid_mlock(sample->data24 + sample->start, frames);
+        }
+    }
+
+    sample->stream_preload = frames;
+}
+
+/* Replaces the loaded data of a sample by compressed data, which is decoded
+ * while the sample is playing. Must be called once the sample has been
+ * sanitized and optimized. The sample keeps its uncompressed data if it can't
+ * be compressed. */
+static void fluid_defsfont_compress_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    fluid_samplecodec_t *codec;
+    short *data;
+    unsigned int frames = sample->end + 1;
+
+    /* 24 bit samples are rare, they are kept uncompressed */
+    if(!defsfont->compression || sample->data == NULL || sample->data24 != NULL || sample->start == sample->end)
+    {
+        return;
+    }
+
+    codec = fluid_samplecodec_compress(sample->data, frames, defsfont->stream_preload, defsfont->mlock, &data);
+
+    if(codec == NULL)
+    {
+        FLUID_LOG(FLUID_DBG, "Keeping sample '%s' uncompressed", sample->name);
+        return;
+    }
+
+    fluid_samplecache_unload(sample->data);
+
+    if(frames > (unsigned int)defsfont->stream_preload)
+    {
+        frames = defsfont->stream_preload;
+    }
+
+    /* The synth decodes the rest of the data while the sample is playing */
+    sample->data = data;
+    sample->codec = codec;
+    sample->stream_preload = frames;
+}
+
 /* Load sample data for a single sample from the Soundfont file.
  * Returns FLUID_OK on error, otherwise FLUID_FAILED
  */
@@ -318,7 +1031,9 @@ int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, f
 
     num_samples = fluid_samplecache_load(
                       sfdata, sample->source_start, sample->source_end, sample->sampletype,
-                      defsfont->mlock, &sample->data, &sample->data24);
+                      defsfont->mlock && !defsfont->streaming && !defsfont->dedup && !defsfont->compression,
+                      defsfont->mmap || defsfont->streaming, defsfont->shm,
+                      defsfont->sample_cache_dir, &sample->data, &sample->data24);
 
     if(num_samples < 0)
     {
@@ -345,11 +1060,39 @@ int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, f
     sample->start = 0;
     sample->end = num_samples - 1;
 
+    if(defsfont->dedup)
+    {
+        short *data;
+        char *data24;
+        int ret = fluid_samplededup_acquire(sample->data, sample->data24, num_samples,
+                                            sample->loopstart, sample->loopend, defsfont->mlock,
+                                            &data, &data24);
+
+        /* The data read from the file isn't needed anymore, either way */
+        fluid_samplecache_unload(sample->data);
+        sample->data = NULL;
+        sample->data24 = NULL;
+
+        if(ret == FLUID_FAILED)
+        {
+            return FLUID_FAILED;
+        }
+
+        sample->data = data;
+        sample->data24 = data24;
+    }
+
+    if(defsfont->streaming && fluid_samplecache_is_mapped(sample->data))
+    {
+        fluid_defsfont_preload_sample(defsfont, sample);
+    }
+
     return FLUID_OK;
 }
 
 /* Loads the sample data for all samples from the Soundfont file. For SF2 files, it loads the data in
- * one large block. For SF3 files, each compressed sample gets loaded individually.
+ * one large block. For SF3 files, each compressed sample gets loaded individually, as well as
+ * SF2 samples if they are shared by their content or taken over when reloading.
  * Returns FLUID_OK on success, otherwise FLUID_FAILED
  */
 int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata)
@@ -357,16 +1100,25 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
     fluid_list_t *list;
     fluid_sample_t *sample;
     int sf3_file = (sfdata->version.major == 3);
+    int individual = sf3_file || defsfont->dedup || defsfont->compression || defsfont->reload_samples != NULL;
     int sample_parsing_result = FLUID_OK;
     int invalid_loops_were_sanitized = FALSE;
+    int stream = FALSE;
+    fluid_sfload_t *load = fluid_sfload_get_current();
+    int sample_count = fluid_list_size(defsfont->sample);
+    int samples_done = 0;
+    int samples_reused = 0;
 
     /* For SF2 files, we load the sample data in one large block */
-    if(!sf3_file)
+    if(!individual)
     {
         int read_samples;
         int num_samples = sfdata->samplesize / sizeof(short);
 
-        read_samples = fluid_samplecache_load(sfdata, 0, num_samples - 1, 0, defsfont->mlock,
+        read_samples = fluid_samplecache_load(sfdata, 0, num_samples - 1, 0,
+                                              defsfont->mlock && !defsfont->streaming,
+                                              defsfont->mmap || defsfont->streaming, defsfont->shm,
+                                              defsfont->sample_cache_dir,
                                               &defsfont->sampledata, &defsfont->sample24data);
 
         if(read_samples != num_samples)
@@ -375,6 +1127,8 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
                       num_samples, read_samples);
             return FLUID_FAILED;
         }
+
+        stream = defsfont->streaming && fluid_samplecache_is_mapped(defsfont->sampledata);
     }
 
     #pragma omp parallel
@@ -383,13 +1137,29 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
     {
         sample = fluid_list_get(list);
 
-        if(sf3_file)
+        if(individual)
         {
             /* SF3 samples get loaded individually, as most (or all) of them are in Ogg Vorbis format
              * anyway */
-            #pragma omp task firstprivate(sample,sfdata,defsfont) shared(sample_parsing_result, invalid_loops_were_sanitized) default(none)
+            #pragma omp task firstprivate(sample,sfdata,defsfont,load,sample_count) shared(sample_parsing_result, invalid_loops_were_sanitized, samples_done, samples_reused) default(none)
             {
-                if(fluid_defsfont_load_sampledata(defsfont, sfdata, sample) == FLUID_FAILED)
+                int done;
+
+                if(fluid_sfload_is_cancelled(load))
+                {
+                    #pragma omp critical
+                    {
+                        sample_parsing_result = FLUID_FAILED;
+                    }
+                }
+                else if(defsfont->reload_samples != NULL && reload_sample_reuse(defsfont, sfdata, sample))
+                {
+                    #pragma omp critical
+                    {
+                        samples_reused++;
+                    }
+                }
+                else if(fluid_defsfont_load_sampledata(defsfont, sfdata, sample) == FLUID_FAILED)
                 {
                     #pragma omp critical
                     {
@@ -408,12 +1178,21 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
                         }
                     }
                     fluid_voice_optimize_sample(sample);
+                    fluid_defsfont_compress_sample(defsfont, sample);
                 }
+
+                #pragma omp critical
+                {
+                    done = ++samples_done;
+                }
+
+                /* Decoding takes most of the time of loading an SF3 file */
+                fluid_sfload_set_progress(load, 0.1f + 0.8f * done / sample_count);
             }
         }
         else
         {
-            #pragma omp task firstprivate(sample, defsfont) shared(invalid_loops_were_sanitized) default(none)
+            #pragma omp task firstprivate(sample, defsfont, stream) shared(invalid_loops_were_sanitized) default(none)
             {
                 int modified;
                 /* Data pointers of SF2 samples point to large sample data block loaded above */
@@ -428,6 +1207,11 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
                     }
                 }
                 fluid_voice_optimize_sample(sample);
+
+                if(stream)
+                {
+                    fluid_defsfont_preload_sample(defsfont, sample);
+                }
             }
         }
     }
@@ -439,12 +1223,65 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
                   "start fluidsynth in verbose mode for detailed information.");
     }
 
+    if(defsfont->reload_samples != NULL)
+    {
+        FLUID_LOG(FLUID_DBG, "Reloading took over the data of %d of %d samples", samples_reused, sample_count);
+    }
+
     return sample_parsing_result;
 }
 
 // declared here so it can be used for default modulators in fluid_defsfont_load
 static int
-fluid_mod_import_sfont(fluid_mod_t **mod, fluid_list_t *sfmod);
+fluid_mod_import_sfont(fluid_arena_t *arena, fluid_mod_t **mod, fluid_list_t *sfmod);
+
+/* Builds the tables to look up the instruments and samples of the parsed
+ * Soundfont by their index, instead of walking the lists for every zone. */
+static int fluid_defsfont_index_sfdata(fluid_defsfont_t *defsfont, SFData *sfdata)
+{
+    fluid_list_t *p;
+    SFInst *sfinst;
+    SFSample *sfsample;
+    int inst_count = 0, sample_count = 0;
+
+    for(p = sfdata->inst; p != NULL; p = fluid_list_next(p))
+    {
+        sfinst = fluid_list_get(p);
+        inst_count = (sfinst->idx >= inst_count) ? sfinst->idx + 1 : inst_count;
+    }
+
+    for(p = sfdata->sample; p != NULL; p = fluid_list_next(p))
+    {
+        sfsample = fluid_list_get(p);
+        sample_count = (sfsample->idx >= sample_count) ? sfsample->idx + 1 : sample_count;
+    }
+
+    defsfont->inst = FLUID_ARENA_ARRAY(defsfont->arena, fluid_inst_t *, inst_count);
+    defsfont->sfinst = FLUID_ARENA_ARRAY(defsfont->arena, SFInst *, inst_count);
+    defsfont->sfsample = FLUID_ARENA_ARRAY(defsfont->arena, SFSample *, sample_count);
+
+    if(defsfont->inst == NULL || defsfont->sfinst == NULL || defsfont->sfsample == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    defsfont->inst_count = inst_count;
+    defsfont->sfsample_count = sample_count;
+
+    for(p = sfdata->inst; p != NULL; p = fluid_list_next(p))
+    {
+        sfinst = fluid_list_get(p);
+        defsfont->sfinst[sfinst->idx] = sfinst;
+    }
+
+    for(p = sfdata->sample; p != NULL; p = fluid_list_next(p))
+    {
+        sfsample = fluid_list_get(p);
+        defsfont->sfsample[sfsample->idx] = sfsample;
+    }
+
+    return FLUID_OK;
+}
 
 /*
  * fluid_defsfont_load
@@ -457,7 +1294,13 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
     SFPreset *sfpreset;
     SFSample *sfsample;
     fluid_sample_t *sample;
-    fluid_defpreset_t *defpreset = NULL;
+    fluid_defpreset_t *defpreset;
+    double start_time = fluid_utime();
+    double parse_time, decode_time;
+    fluid_sfload_t *load = fluid_sfload_get_current();
+    fluid_sfimage_t *image = NULL;
+    int preset_count, presets_done = 0;
+    int from_image;
 
     defsfont->filename = FLUID_STRDUP(file);
 
@@ -478,21 +1321,41 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
         return FLUID_FAILED;
     }
 
-    if(fluid_sffile_parse_presets(sfdata) == FLUID_FAILED)
+    /* A compiled image of the SoundFont replaces parsing the preset data */
+    if(defsfont->compiled_dir != NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Couldn't parse presets from soundfont file");
-        goto err_exit;
+        image = fluid_sfimage_open(sfdata, defsfont->compiled_dir);
     }
 
-    dmod_data = sfdata->default_mod_list;
-    if (dmod_data != NULL)
+    from_image = (image != NULL);
+
+    if(from_image)
+    {
+        if(fluid_sfimage_get_samples(image, sfdata) != FLUID_OK
+                || fluid_sfimage_get_default_mods(image, &defsfont->sfont->default_mod_list) != FLUID_OK)
+        {
+            fluid_sfimage_invalidate(image);
+            goto err_exit;
+        }
+    }
+    else
     {
-        /* Load the default modulators*/
-        if (fluid_mod_import_sfont(&defsfont->sfont->default_mod_list, dmod_data) != FLUID_OK)
+        if(fluid_sffile_parse_presets(sfdata) == FLUID_FAILED)
         {
-            FLUID_LOG(FLUID_ERR, "Unable to load the default modulators");
+            FLUID_LOG(FLUID_ERR, "Couldn't parse presets from soundfont file");
             goto err_exit;
         }
+
+        dmod_data = sfdata->default_mod_list;
+        if (dmod_data != NULL)
+        {
+            /* Load the default modulators*/
+            if (fluid_mod_import_sfont(NULL, &defsfont->sfont->default_mod_list, dmod_data) != FLUID_OK)
+            {
+                FLUID_LOG(FLUID_ERR, "Unable to load the default modulators");
+                goto err_exit;
+            }
+        }
     }
 
     /* Keep track of the position and size of the sample data because
@@ -502,6 +1365,11 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
     defsfont->sample24pos = sfdata->sample24pos;
     defsfont->sample24size = sfdata->sample24size;
 
+    if(fluid_defsfont_index_sfdata(defsfont, sfdata) == FLUID_FAILED)
+    {
+        goto err_exit;
+    }
+
     /* Create all samples from sample headers */
     p = sfdata->sample;
 
@@ -532,23 +1400,53 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
         p = fluid_list_next(p);
     }
 
+    parse_time = fluid_utime();
+    fluid_sfload_set_progress(load, 0.1f);
+
     /* If dynamic sample loading is disabled, load all samples in the Soundfont */
     if(!defsfont->dynamic_samples)
     {
         if(fluid_defsfont_load_all_sampledata(defsfont, sfdata) == FLUID_FAILED)
         {
-            FLUID_LOG(FLUID_ERR, "Unable to load all sample data");
+            if(!fluid_sfload_is_cancelled(load))
+            {
+                FLUID_LOG(FLUID_ERR, "Unable to load all sample data");
+            }
+
+            goto err_exit;
+        }
+    }
+
+    decode_time = fluid_utime();
+    fluid_sfload_set_progress(load, 0.9f);
+
+    if(from_image)
+    {
+        if(fluid_sfimage_import(image, defsfont) != FLUID_OK)
+        {
+            fluid_sfimage_invalidate(image);
             goto err_exit;
         }
+
+        fluid_sfimage_close(image);
+        image = NULL;
     }
 
     /* Load all the presets */
     p = sfdata->preset;
+    preset_count = fluid_list_size(p);
 
     while(p != NULL)
     {
+        if(fluid_sfload_is_cancelled(load))
+        {
+            goto err_exit;
+        }
+
+        fluid_sfload_set_progress(load, 0.9f + 0.1f * presets_done++ / preset_count);
+
         sfpreset = (SFPreset *)fluid_list_get(p);
-        defpreset = new_fluid_defpreset();
+        defpreset = new_fluid_defpreset(defsfont->arena);
 
         if(defpreset == NULL)
         {
@@ -568,13 +1466,41 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
         p = fluid_list_next(p);
     }
 
-    fluid_sffile_close(sfdata);
+    if(defsfont->lazy_presets && !from_image)
+    {
+        /* Keep the parsed preset data for importing the presets on first use,
+         * but don't hold on to the file handle. */
+        sfdata->fcbs->fclose(sfdata->sffd);
+        sfdata->sffd = NULL;
+        defsfont->sfdata = sfdata;
+    }
+    else
+    {
+        /* Compile the imported presets for the next time the SoundFont is loaded */
+        if(defsfont->compiled_dir != NULL && !from_image)
+        {
+            fluid_sfimage_save(defsfont, sfdata, defsfont->compiled_dir);
+        }
+
+        defsfont->sfinst = NULL;
+        defsfont->sfsample = NULL;
+        fluid_sffile_close(sfdata);
+    }
+
+    fluid_sfload_set_progress(load, 1.0f);
+
+    FLUID_LOG(FLUID_DBG, "Loaded '%s' in %.1f ms (parse %.1f ms, sample data %.1f ms, import %.1f ms)",
+              file, (fluid_utime() - start_time) / 1000.0, (parse_time - start_time) / 1000.0,
+              (decode_time - parse_time) / 1000.0, (fluid_utime() - decode_time) / 1000.0);
 
     return FLUID_OK;
 
 err_exit:
+    /* Presets imported so far are freed with the arena of the SoundFont */
+    fluid_sfimage_close(image);
+    defsfont->sfinst = NULL;
+    defsfont->sfsample = NULL;
     fluid_sffile_close(sfdata);
-    delete_fluid_defpreset(defpreset);
     return FLUID_FAILED;
 }
 
@@ -608,14 +1534,30 @@ int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *def
         return FLUID_FAILED;
     }
 
-    if(defsfont->dynamic_samples)
+    if(defsfont->dynamic_samples || defsfont->lazy_presets)
     {
-        preset->notify = dynamic_samples_preset_notify;
+        preset->notify = fluid_defpreset_preset_notify;
     }
 
     fluid_preset_set_data(preset, defpreset);
 
-    defsfont->preset = fluid_list_append(defsfont->preset, preset);
+    if(defsfont->preset_count == defsfont->preset_size)
+    {
+        int size = (defsfont->preset_size > 0) ? 2 * defsfont->preset_size : 128;
+        fluid_preset_t **presets = FLUID_REALLOC(defsfont->preset, size * sizeof(*presets));
+
+        if(presets == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            delete_fluid_preset(preset);
+            return FLUID_FAILED;
+        }
+
+        defsfont->preset = presets;
+        defsfont->preset_size = size;
+    }
+
+    defsfont->preset[defsfont->preset_count++] = preset;
 
     return FLUID_OK;
 }
@@ -625,16 +1567,16 @@ int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *def
  */
 fluid_preset_t *fluid_defsfont_get_preset(fluid_defsfont_t *defsfont, int bank, int num)
 {
-    fluid_preset_t *preset;
-    fluid_list_t *list;
+    fluid_defpreset_t *defpreset;
+    int i;
 
-    for(list = defsfont->preset; list != NULL; list = fluid_list_next(list))
+    for(i = 0; i < defsfont->preset_count; i++)
     {
-        preset = (fluid_preset_t *)fluid_list_get(list);
+        defpreset = fluid_preset_get_data(defsfont->preset[i]);
 
-        if((fluid_preset_get_banknum(preset) == bank) && (fluid_preset_get_num(preset) == num))
+        if((defpreset->bank == (unsigned int)bank) && (defpreset->num == (unsigned int)num))
         {
-            return preset;
+            return defsfont->preset[i];
         }
     }
 
@@ -646,7 +1588,7 @@ fluid_preset_t *fluid_defsfont_get_preset(fluid_defsfont_t *defsfont, int bank,
  */
 void fluid_defsfont_iteration_start(fluid_defsfont_t *defsfont)
 {
-    defsfont->preset_iter_cur = defsfont->preset;
+    defsfont->preset_iter_cur = 0;
 }
 
 /*
@@ -654,11 +1596,12 @@ void fluid_defsfont_iteration_start(fluid_defsfont_t *defsfont)
  */
 fluid_preset_t *fluid_defsfont_iteration_next(fluid_defsfont_t *defsfont)
 {
-    fluid_preset_t *preset = (fluid_preset_t *)fluid_list_get(defsfont->preset_iter_cur);
-
-    defsfont->preset_iter_cur = fluid_list_next(defsfont->preset_iter_cur);
+    if(defsfont->preset_iter_cur >= defsfont->preset_count)
+    {
+        return NULL;
+    }
 
-    return preset;
+    return defsfont->preset[defsfont->preset_iter_cur++];
 }
 
 /***************************************************************
@@ -670,9 +1613,9 @@ fluid_preset_t *fluid_defsfont_iteration_next(fluid_defsfont_t *defsfont)
  * new_fluid_defpreset
  */
 fluid_defpreset_t *
-new_fluid_defpreset(void)
+new_fluid_defpreset(fluid_arena_t *arena)
 {
-    fluid_defpreset_t *defpreset = FLUID_NEW(fluid_defpreset_t);
+    fluid_defpreset_t *defpreset = FLUID_ARENA_NEW(arena, fluid_defpreset_t);
 
     if(defpreset == NULL)
     {
@@ -685,34 +1628,12 @@ new_fluid_defpreset(void)
     defpreset->bank = 0;
     defpreset->num = 0;
     defpreset->global_zone = NULL;
-    defpreset->zone = NULL;
-    defpreset->pinned = FALSE;
-    return defpreset;
-}
-
-/*
- * delete_fluid_defpreset
- */
-void
-delete_fluid_defpreset(fluid_defpreset_t *defpreset)
-{
-    fluid_preset_zone_t *zone;
-
-    fluid_return_if_fail(defpreset != NULL);
-
-    delete_fluid_preset_zone(defpreset->global_zone);
-    defpreset->global_zone = NULL;
-
-    zone = defpreset->zone;
-
-    while(zone != NULL)
-    {
-        defpreset->zone = zone->next;
-        delete_fluid_preset_zone(zone);
-        zone = defpreset->zone;
-    }
-
-    FLUID_FREE(defpreset);
+    defpreset->zone = NULL;
+    defpreset->defsfont = NULL;
+    defpreset->sfpreset = NULL;
+    defpreset->zone_index = NULL;
+    FLUID_MEMSET(defpreset->zone_index_start, 0, sizeof(defpreset->zone_index_start));
+    return defpreset;
 }
 
 int
@@ -877,6 +1798,136 @@ fluid_defpreset_noteon_add_mod_to_voice(fluid_voice_t *voice,
     }
 }
 
+/*
+ * fluid_defpreset_noteon_voice_zone
+ * Starts a voice for a single instrument zone that matched a noteon event.
+ */
+static int
+fluid_defpreset_noteon_voice_zone(fluid_synth_t *synth, int chan, int key, int vel,
+                                  fluid_preset_zone_t *global_preset_zone,
+                                  fluid_preset_zone_t *preset_zone,
+                                  fluid_voice_zone_t *voice_zone,
+                                  int async_samples)
+{
+    fluid_inst_zone_t *inst_zone, *global_inst_zone;
+    fluid_voice_t *voice;
+    int i;
+
+    global_inst_zone = fluid_inst_get_global_zone(fluid_preset_zone_get_inst(preset_zone));
+    inst_zone = voice_zone->inst_zone;
+
+    /* The sample data might still be loaded in the background, after the preset
+     * has been selected. Skip the zone instead of blocking the synth. */
+    if(async_samples && fluid_atomic_int_get(&inst_zone->sample->loading))
+    {
+        FLUID_LOG(FLUID_DBG, "Sample '%s' is not loaded yet, skipping noteon", inst_zone->sample->name);
+        return FLUID_OK;
+    }
+
+    /* this is a good zone. allocate a new synthesis process and initialize it */
+    voice = fluid_synth_alloc_voice_LOCAL(synth, inst_zone->sample, chan, key, vel, &voice_zone->range);
+
+    if(voice == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+
+    /* Instrument level, generators */
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        /* SF 2.01 section 9.4 'bullet' 4:
+         *
+         * A generator in a local instrument zone supersedes a
+         * global instrument zone generator.  Both cases supersede
+         * the default generator -> voice_gen_set */
+
+        if(inst_zone->gen[i].flags)
+        {
+            fluid_voice_gen_set(voice, i, inst_zone->gen[i].val);
+
+        }
+        else if((global_inst_zone != NULL) && (global_inst_zone->gen[i].flags))
+        {
+            fluid_voice_gen_set(voice, i, global_inst_zone->gen[i].val);
+
+        }
+        else
+        {
+            /* The generator has not been defined in this instrument.
+             * Do nothing, leave it at the default.
+             */
+        }
+    } /* for all generators */
+
+    /* Adds instrument zone modulators (global and local) to the voice.*/
+    fluid_defpreset_noteon_add_mod_to_voice(voice,
+                                            /* global instrument modulators */
+                                            global_inst_zone ? global_inst_zone->mod : NULL,
+                                            inst_zone->mod, /* local instrument modulators */
+                                            FLUID_VOICE_OVERWRITE); /* mode */
+
+    /* Preset level, generators */
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        fluid_real_t awe_val;
+        /* SF 2.01 section 8.5 page 58: If some generators are
+         encountered at preset level, they should be ignored.
+         However this check is not necessary when the soundfont
+         loader has ignored invalid preset generators.
+         Actually load_pgen()has ignored these invalid preset
+         generators:
+           GEN_STARTADDROFS,      GEN_ENDADDROFS,
+           GEN_STARTLOOPADDROFS,  GEN_ENDLOOPADDROFS,
+           GEN_STARTADDRCOARSEOFS,GEN_ENDADDRCOARSEOFS,
+           GEN_STARTLOOPADDRCOARSEOFS,
+           GEN_KEYNUM, GEN_VELOCITY,
+           GEN_ENDLOOPADDRCOARSEOFS,
+           GEN_SAMPLEMODE, GEN_EXCLUSIVECLASS,GEN_OVERRIDEROOTKEY
+        */
+
+        /* SF 2.01 section 9.4 'bullet' 9: A generator in a
+         * local preset zone supersedes a global preset zone
+         * generator.  The effect is -added- to the destination
+         * summing node -> voice_gen_incr */
+
+        if(preset_zone->gen[i].flags)
+        {
+            fluid_voice_gen_incr(voice, i, preset_zone->gen[i].val);
+        }
+        else if((global_preset_zone != NULL) && global_preset_zone->gen[i].flags)
+        {
+            fluid_voice_gen_incr(voice, i, global_preset_zone->gen[i].val);
+        }
+        else
+        {
+            /* The generator has not been defined in this preset
+             * Do nothing, leave it unchanged.
+             */
+        }
+
+        /* ...unless the default value has been overridden by an AWE32 NRPN */
+        if (fluid_channel_get_override_gen_default(synth->channel[chan], i, &awe_val))
+        {
+            fluid_voice_gen_set(voice, i, awe_val);
+        }
+    } /* for all generators */
+
+    /* Adds preset zone modulators (global and local) to the voice.*/
+    fluid_defpreset_noteon_add_mod_to_voice(voice,
+                                            /* global preset modulators */
+                                            global_preset_zone ? global_preset_zone->mod : NULL,
+                                            preset_zone->mod, /* local preset modulators */
+                                            FLUID_VOICE_ADD); /* mode */
+
+    /* add the synthesis process to the synthesis loop. */
+    fluid_synth_start_voice(synth, voice);
+
+    return FLUID_OK;
+}
+
 /*
  * fluid_defpreset_noteon
  */
@@ -884,13 +1935,11 @@ int
 fluid_defpreset_noteon(fluid_defpreset_t *defpreset, fluid_synth_t *synth, int chan, int key, int vel)
 {
     fluid_preset_zone_t *preset_zone, *global_preset_zone;
-    fluid_inst_t *inst;
-    fluid_inst_zone_t *inst_zone, *global_inst_zone;
     fluid_voice_zone_t *voice_zone;
-    fluid_list_t *list;
-    fluid_voice_t *voice;
+    fluid_zone_index_entry_t *entries;
     int tuned_key;
-    int i;
+    int i, count;
+    int async_samples = (defpreset->defsfont != NULL && defpreset->defsfont->async_samples);
 
     /* For detuned channels it might be better to use another key for Soundfont sample selection
      * giving better approximations for the pitch than the original key.
@@ -911,6 +1960,32 @@ fluid_defpreset_noteon(fluid_defpreset_t *defpreset, fluid_synth_t *synth, int c
 
     global_preset_zone = fluid_defpreset_get_global_zone(defpreset);
 
+    /* Fast path: only visit the voice zones whose key range covers the tuned key.
+     * A voice zone range is the intersection of its preset zone and instrument zone
+     * ranges, so testing it alone is sufficient. */
+    entries = fluid_defpreset_get_key_zones(defpreset, tuned_key, &count);
+
+    if(entries != NULL)
+    {
+        for(i = 0; i < count; i++)
+        {
+            /* check if the instrument zone is ignored and the note falls into
+               the velocity range of this instrument zone (see below) */
+            if(fluid_zone_inside_range(&entries[i].voice_zone->range, tuned_key, vel)
+                    && !fluid_synth_legato_ignores_zone(synth, chan, &entries[i].voice_zone->range))
+            {
+                if(fluid_defpreset_noteon_voice_zone(synth, chan, key, vel, global_preset_zone,
+                                                     entries[i].preset_zone,
+                                                     entries[i].voice_zone, async_samples) != FLUID_OK)
+                {
+                    return FLUID_FAILED;
+                }
+            }
+        }
+
+        return FLUID_OK;
+    }
+
     /* run thru all the zones of this preset */
     preset_zone = fluid_defpreset_get_zone(defpreset);
 
@@ -921,141 +1996,130 @@ fluid_defpreset_noteon(fluid_defpreset_t *defpreset, fluid_synth_t *synth, int c
            preset */
         if(fluid_zone_inside_range(&preset_zone->range, tuned_key, vel))
         {
-
-            inst = fluid_preset_zone_get_inst(preset_zone);
-            global_inst_zone = fluid_inst_get_global_zone(inst);
-
             /* run thru all the zones of this instrument that could start a voice */
-            for(list = preset_zone->voice_zone; list != NULL; list = fluid_list_next(list))
+            for(i = 0; i < preset_zone->voice_zone_count; i++)
             {
-                voice_zone = fluid_list_get(list);
+                voice_zone = &preset_zone->voice_zone[i];
 
                 /* check if the instrument zone is ignored and the note falls into
                    the key and velocity range of this  instrument zone.
                    An instrument zone must be ignored when its voice is already running
                    played by a legato passage (see fluid_synth_noteon_monopoly_legato()) */
-                if(fluid_zone_inside_range(&voice_zone->range, tuned_key, vel))
+                if(fluid_zone_inside_range(&voice_zone->range, tuned_key, vel)
+                        && !fluid_synth_legato_ignores_zone(synth, chan, &voice_zone->range))
                 {
-
-                    inst_zone = voice_zone->inst_zone;
-
-                    /* this is a good zone. allocate a new synthesis process and initialize it */
-                    voice = fluid_synth_alloc_voice_LOCAL(synth, inst_zone->sample, chan, key, vel, &voice_zone->range);
-
-                    if(voice == NULL)
+                    if(fluid_defpreset_noteon_voice_zone(synth, chan, key, vel, global_preset_zone,
+                                                         preset_zone, voice_zone, async_samples) != FLUID_OK)
                     {
                         return FLUID_FAILED;
                     }
+                }
+            }
+        }
 
+        preset_zone = fluid_preset_zone_next(preset_zone);
+    }
 
-                    /* Instrument level, generators */
+    return FLUID_OK;
+}
 
-                    for(i = 0; i < GEN_LAST; i++)
-                    {
-                        /* SF 2.01 section 9.4 'bullet' 4:
-                         *
-                         * A generator in a local instrument zone supersedes a
-                         * global instrument zone generator.  Both cases supersede
-                         * the default generator -> voice_gen_set */
+/*
+ * fluid_defpreset_build_zone_index
+ * Builds the key lookup table used by fluid_defpreset_noteon(). Must be called
+ * again whenever the zones of the preset change.
+ */
+int
+fluid_defpreset_build_zone_index(fluid_defpreset_t *defpreset)
+{
+    fluid_preset_zone_t *preset_zone;
+    fluid_voice_zone_t *voice_zone;
+    int fill[FLUID_ZONE_INDEX_KEYS];
+    int i, key, keylo, keyhi, total;
 
-                        if(inst_zone->gen[i].flags)
-                        {
-                            fluid_voice_gen_set(voice, i, inst_zone->gen[i].val);
+    defpreset->zone_index = NULL;
+    FLUID_MEMSET(defpreset->zone_index_start, 0, sizeof(defpreset->zone_index_start));
+    FLUID_MEMSET(fill, 0, sizeof(fill));
 
-                        }
-                        else if((global_inst_zone != NULL) && (global_inst_zone->gen[i].flags))
-                        {
-                            fluid_voice_gen_set(voice, i, global_inst_zone->gen[i].val);
+    /* First pass: count the voice zones per key */
+    for(preset_zone = defpreset->zone; preset_zone != NULL; preset_zone = preset_zone->next)
+    {
+        for(i = 0; i < preset_zone->voice_zone_count; i++)
+        {
+            voice_zone = &preset_zone->voice_zone[i];
+            keylo = (voice_zone->range.keylo < 0) ? 0 : voice_zone->range.keylo;
+            keyhi = (voice_zone->range.keyhi >= FLUID_ZONE_INDEX_KEYS) ? FLUID_ZONE_INDEX_KEYS - 1 : voice_zone->range.keyhi;
 
-                        }
-                        else
-                        {
-                            /* The generator has not been defined in this instrument.
-                             * Do nothing, leave it at the default.
-                             */
-                        }
-                    } /* for all generators */
+            for(key = keylo; key <= keyhi; key++)
+            {
+                fill[key]++;
+            }
+        }
+    }
 
-                    /* Adds instrument zone modulators (global and local) to the voice.*/
-                    fluid_defpreset_noteon_add_mod_to_voice(voice,
-                                                            /* global instrument modulators */
-                                                            global_inst_zone ? global_inst_zone->mod : NULL,
-                                                            inst_zone->mod, /* local instrument modulators */
-                                                            FLUID_VOICE_OVERWRITE); /* mode */
+    total = 0;
 
-                    /* Preset level, generators */
+    for(key = 0; key < FLUID_ZONE_INDEX_KEYS; key++)
+    {
+        defpreset->zone_index_start[key] = total;
+        total += fill[key];
+        fill[key] = defpreset->zone_index_start[key];
+    }
 
-                    for(i = 0; i < GEN_LAST; i++)
-                    {
-                        fluid_real_t awe_val;
-                        /* SF 2.01 section 8.5 page 58: If some generators are
-                         encountered at preset level, they should be ignored.
-                         However this check is not necessary when the soundfont
-                         loader has ignored invalid preset generators.
-                         Actually load_pgen()has ignored these invalid preset
-                         generators:
-                           GEN_STARTADDROFS,      GEN_ENDADDROFS,
-                           GEN_STARTLOOPADDROFS,  GEN_ENDLOOPADDROFS,
-                           GEN_STARTADDRCOARSEOFS,GEN_ENDADDRCOARSEOFS,
-                           GEN_STARTLOOPADDRCOARSEOFS,
-                           GEN_KEYNUM, GEN_VELOCITY,
-                           GEN_ENDLOOPADDRCOARSEOFS,
-                           GEN_SAMPLEMODE, GEN_EXCLUSIVECLASS,GEN_OVERRIDEROOTKEY
-                        */
-
-                        /* SF 2.01 section 9.4 'bullet' 9: A generator in a
-                         * local preset zone supersedes a global preset zone
-                         * generator.  The effect is -added- to the destination
-                         * summing node -> voice_gen_incr */
-
-                        if(preset_zone->gen[i].flags)
-                        {
-                            fluid_voice_gen_incr(voice, i, preset_zone->gen[i].val);
-                        }
-                        else if((global_preset_zone != NULL) && global_preset_zone->gen[i].flags)
-                        {
-                            fluid_voice_gen_incr(voice, i, global_preset_zone->gen[i].val);
-                        }
-                        else
-                        {
-                            /* The generator has not been defined in this preset
-                             * Do nothing, leave it unchanged.
-                             */
-                        }
+    defpreset->zone_index_start[FLUID_ZONE_INDEX_KEYS] = total;
 
-                        /* ...unless the default value has been overridden by an AWE32 NRPN */
-                        if (fluid_channel_get_override_gen_default(synth->channel[chan], i, &awe_val))
-                        {
-                            fluid_voice_gen_set(voice, i, awe_val);
-                        }
-                    } /* for all generators */
-
-                    /* Adds preset zone modulators (global and local) to the voice.*/
-                    fluid_defpreset_noteon_add_mod_to_voice(voice,
-                                                            /* global preset modulators */
-                                                            global_preset_zone ? global_preset_zone->mod : NULL,
-                                                            preset_zone->mod, /* local preset modulators */
-                                                            FLUID_VOICE_ADD); /* mode */
-
-                    /* add the synthesis process to the synthesis loop. */
-                    fluid_synth_start_voice(synth, voice);
-
-                    /* Store the ID of the first voice that was created by this noteon event.
-                     * Exclusive class may only terminate older voices.
-                     * That avoids killing voices, which have just been created.
-                     * (a noteon event can create several voice processes with the same exclusive
-                     * class - for example when using stereo samples)
-                     */
-                }
+    if(total == 0)
+    {
+        return FLUID_OK;
+    }
+
+    defpreset->zone_index = FLUID_ARENA_ARRAY(defpreset->defsfont->arena, fluid_zone_index_entry_t, total);
+
+    if(defpreset->zone_index == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    /* Second pass: fill in the entries, preserving the zone list order */
+    for(preset_zone = defpreset->zone; preset_zone != NULL; preset_zone = preset_zone->next)
+    {
+        for(i = 0; i < preset_zone->voice_zone_count; i++)
+        {
+            voice_zone = &preset_zone->voice_zone[i];
+            keylo = (voice_zone->range.keylo < 0) ? 0 : voice_zone->range.keylo;
+            keyhi = (voice_zone->range.keyhi >= FLUID_ZONE_INDEX_KEYS) ? FLUID_ZONE_INDEX_KEYS - 1 : voice_zone->range.keyhi;
+
+            for(key = keylo; key <= keyhi; key++)
+            {
+                defpreset->zone_index[fill[key]].preset_zone = preset_zone;
+                defpreset->zone_index[fill[key]].voice_zone = voice_zone;
+                fill[key]++;
             }
         }
-
-        preset_zone = fluid_preset_zone_next(preset_zone);
     }
 
     return FLUID_OK;
 }
 
+/*
+ * fluid_defpreset_get_key_zones
+ * Returns the voice zones whose key range covers key, or NULL if the preset
+ * has no zone index or key is outside the indexed range. In the latter case,
+ * the caller has to walk the zone list instead.
+ */
+fluid_zone_index_entry_t *
+fluid_defpreset_get_key_zones(fluid_defpreset_t *defpreset, int key, int *count)
+{
+    if(defpreset->zone_index == NULL || key < 0 || key >= FLUID_ZONE_INDEX_KEYS)
+    {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = defpreset->zone_index_start[key + 1] - defpreset->zone_index_start[key];
+    return &defpreset->zone_index[defpreset->zone_index_start[key]];
+}
+
 /*
  * fluid_defpreset_set_global_zone
  */
@@ -1075,11 +2139,7 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
                              fluid_defsfont_t *defsfont,
                              SFData *sfdata)
 {
-    fluid_list_t *p;
-    SFZone *sfzone;
-    fluid_preset_zone_t *zone;
-    int count;
-    char zone_name[256];
+    defpreset->defsfont = defsfont;
 
     if(FLUID_STRLEN(sfpreset->name) > 0)
     {
@@ -1092,6 +2152,66 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
 
     defpreset->bank = sfpreset->bank;
     defpreset->num = sfpreset->prenum;
+
+    /* Only the preset header is needed until the preset is used */
+    if(defsfont->lazy_presets)
+    {
+        defpreset->sfpreset = sfpreset;
+        return FLUID_OK;
+    }
+
+    return fluid_defpreset_import_zones(defpreset, sfpreset, sfdata);
+}
+
+/*
+ * fluid_defpreset_import_lazy
+ *
+ * Imports the zones of a preset which has been loaded lazily, does nothing if
+ * the preset has been imported already.
+ */
+int
+fluid_defpreset_import_lazy(fluid_defpreset_t *defpreset)
+{
+    SFPreset *sfpreset = defpreset->sfpreset;
+
+    if(sfpreset == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    /* Never try again, a preset that failed to import stays silent */
+    defpreset->sfpreset = NULL;
+
+    if(fluid_defpreset_import_zones(defpreset, sfpreset, defpreset->defsfont->sfdata) == FLUID_OK)
+    {
+        FLUID_LOG(FLUID_DBG, "Imported preset '%s'", defpreset->name);
+        return FLUID_OK;
+    }
+
+    FLUID_LOG(FLUID_ERR, "Unable to import preset '%s'", defpreset->name);
+
+    /* The zones imported so far stay in the arena until the SoundFont is freed */
+    defpreset->zone_index = NULL;
+    FLUID_MEMSET(defpreset->zone_index_start, 0, sizeof(defpreset->zone_index_start));
+    defpreset->global_zone = NULL;
+    defpreset->zone = NULL;
+
+    return FLUID_FAILED;
+}
+
+/*
+ * fluid_defpreset_import_zones
+ */
+static int
+fluid_defpreset_import_zones(fluid_defpreset_t *defpreset, SFPreset *sfpreset, SFData *sfdata)
+{
+    fluid_defsfont_t *defsfont = defpreset->defsfont;
+    fluid_list_t *p;
+    SFZone *sfzone;
+    fluid_preset_zone_t *zone;
+    int count;
+    char zone_name[256];
+
     p = sfpreset->zone;
     count = 0;
 
@@ -1099,7 +2219,7 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
     {
         sfzone = (SFZone *)fluid_list_get(p);
         FLUID_SNPRINTF(zone_name, sizeof(zone_name), "pz:%s/%d", defpreset->name, count);
-        zone = new_fluid_preset_zone(zone_name);
+        zone = new_fluid_preset_zone(defsfont->arena, zone_name);
 
         if(zone == NULL)
         {
@@ -1108,7 +2228,6 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
 
         if(fluid_preset_zone_import_sfont(zone, defpreset->global_zone, sfzone, defsfont, sfdata) != FLUID_OK)
         {
-            delete_fluid_preset_zone(zone);
             return FLUID_FAILED;
         }
 
@@ -1118,7 +2237,6 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
         }
         else if(fluid_defpreset_add_zone(defpreset, zone) != FLUID_OK)
         {
-            delete_fluid_preset_zone(zone);
             return FLUID_FAILED;
         }
 
@@ -1126,7 +2244,7 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
         count++;
     }
 
-    return FLUID_OK;
+    return fluid_defpreset_build_zone_index(defpreset);
 }
 
 /*
@@ -1185,10 +2303,10 @@ fluid_preset_zone_next(fluid_preset_zone_t *zone)
  * new_fluid_preset_zone
  */
 fluid_preset_zone_t *
-new_fluid_preset_zone(char *name)
+new_fluid_preset_zone(fluid_arena_t *arena, char *name)
 {
     fluid_preset_zone_t *zone = NULL;
-    zone = FLUID_NEW(fluid_preset_zone_t);
+    zone = FLUID_ARENA_NEW(arena, fluid_preset_zone_t);
 
     if(zone == NULL)
     {
@@ -1198,12 +2316,12 @@ new_fluid_preset_zone(char *name)
 
     zone->next = NULL;
     zone->voice_zone = NULL;
-    zone->name = FLUID_STRDUP(name);
+    zone->voice_zone_count = 0;
+    zone->name = fluid_arena_strdup(arena, name);
 
     if(zone->name == NULL)
     {
         FLUID_LOG(FLUID_ERR, "Out of memory");
-        FLUID_FREE(zone);
         return NULL;
     }
 
@@ -1212,7 +2330,6 @@ new_fluid_preset_zone(char *name)
     zone->range.keyhi = 128;
     zone->range.vello = 0;
     zone->range.velhi = 128;
-    zone->range.ignore = FALSE;
 
     /* Flag all generators as unused (default, they will be set when they are found
      * in the sound font).
@@ -1223,61 +2340,55 @@ new_fluid_preset_zone(char *name)
 }
 
 /*
- * delete_fluid_preset_zone
+ * fluid_preset_zone_create_voice_zones
  */
-void
-delete_fluid_preset_zone(fluid_preset_zone_t *zone)
-{
-    fluid_list_t *list;
-
-    fluid_return_if_fail(zone != NULL);
-
-    delete_fluid_list_mod(zone->mod);
-
-    for(list = zone->voice_zone; list != NULL; list = fluid_list_next(list))
-    {
-        FLUID_FREE(fluid_list_get(list));
-    }
-
-    delete_fluid_list(zone->voice_zone);
-
-    FLUID_FREE(zone->name);
-    FLUID_FREE(zone);
-}
-
-static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone)
+int
+fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone, fluid_arena_t *arena)
 {
     fluid_inst_zone_t *inst_zone;
     fluid_sample_t *sample;
     fluid_voice_zone_t *voice_zone;
     fluid_zone_range_t *irange;
     fluid_zone_range_t *prange = &preset_zone->range;
+    int count = 0;
 
     fluid_return_val_if_fail(preset_zone->inst != NULL, FLUID_FAILED);
 
-    inst_zone = fluid_inst_get_zone(preset_zone->inst);
-
-    while(inst_zone != NULL)
+    /* We only create voice ranges for zones that could actually start a voice,
+     * i.e. that have a sample and don't point to ROM */
+    for(inst_zone = fluid_inst_get_zone(preset_zone->inst); inst_zone != NULL; inst_zone = fluid_inst_zone_next(inst_zone))
     {
-
-        /* We only create voice ranges for zones that could actually start a voice,
-         * i.e. that have a sample and don't point to ROM */
         sample = fluid_inst_zone_get_sample(inst_zone);
 
-        if((sample == NULL) || fluid_sample_in_rom(sample))
+        if((sample != NULL) && !fluid_sample_in_rom(sample))
         {
-            inst_zone = fluid_inst_zone_next(inst_zone);
-            continue;
+            count++;
         }
+    }
+
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    preset_zone->voice_zone = FLUID_ARENA_ARRAY(arena, fluid_voice_zone_t, count);
+
+    if(preset_zone->voice_zone == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
 
-        voice_zone = FLUID_NEW(fluid_voice_zone_t);
+    for(inst_zone = fluid_inst_get_zone(preset_zone->inst); inst_zone != NULL; inst_zone = fluid_inst_zone_next(inst_zone))
+    {
+        sample = fluid_inst_zone_get_sample(inst_zone);
 
-        if(voice_zone == NULL)
+        if((sample == NULL) || fluid_sample_in_rom(sample))
         {
-            FLUID_LOG(FLUID_ERR, "Out of memory");
-            return FLUID_FAILED;
+            continue;
         }
 
+        voice_zone = &preset_zone->voice_zone[preset_zone->voice_zone_count++];
         voice_zone->inst_zone = inst_zone;
 
         irange = &inst_zone->range;
@@ -1286,11 +2397,6 @@ static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone
         voice_zone->range.keyhi = (prange->keyhi < irange->keyhi) ? prange->keyhi : irange->keyhi;
         voice_zone->range.vello = (prange->vello > irange->vello) ? prange->vello : irange->vello;
         voice_zone->range.velhi = (prange->velhi < irange->velhi) ? prange->velhi : irange->velhi;
-        voice_zone->range.ignore = FALSE;
-
-        preset_zone->voice_zone = fluid_list_append(preset_zone->voice_zone, voice_zone);
-
-        inst_zone = fluid_inst_zone_next(inst_zone);
     }
 
     return FLUID_OK;
@@ -1355,7 +2461,7 @@ static void fluid_limit_mod_list(char *zone_name, fluid_mod_t **list_mod)
                 *list_mod = NULL;
             }
 
-            delete_fluid_list_mod(mod);
+            /* the modulators live in the arena of the SoundFont */
             FLUID_LOG(FLUID_WARN, "%s, modulators count limited to %d", zone_name,
                       FLUID_NUM_MOD);
             break;
@@ -1403,8 +2509,6 @@ fluid_zone_check_mod(char *zone_name, fluid_mod_t **list_mod)
             {
                 *list_mod = next;
             }
-
-            delete_fluid_mod(mod); /* freeing */
         }
         else
         {
@@ -1565,22 +2669,36 @@ fluid_zone_mod_source_import_sfont(unsigned char *src, unsigned char *flags, uns
 /**
  * fluid_zone_mod_import_sfont
  * Imports modulators from sfzone to modulators list mod.
+ * @param arena - if not NULL, the modulators are allocated as one array from
+ *  the arena, otherwise each modulator is allocated separately.
  * @param mod -  address of pointer on modulators list to return.
  * @param sfmod - pointer on the modulator list.
  * @return FLUID_OK if success, FLUID_FAILED otherwise.
  */
 static int
-fluid_mod_import_sfont(fluid_mod_t **mod, fluid_list_t *sfmod)
+fluid_mod_import_sfont(fluid_arena_t *arena, fluid_mod_t **mod, fluid_list_t *sfmod)
 {
     fluid_list_t *r;
+    fluid_mod_t *mod_array = NULL;
     int count;
 
+    if(arena != NULL && sfmod != NULL && fluid_list_get(sfmod) != NULL)
+    {
+        mod_array = FLUID_ARENA_ARRAY(arena, fluid_mod_t, fluid_list_size(sfmod));
+
+        if(mod_array == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+    }
+
     /* Import the modulators (only SF2.1 and higher) */
     for(count = 0, r = sfmod; r != NULL; count++)
     {
 
         SFMod *mod_src = (SFMod*)(r->data);
-        fluid_mod_t *mod_dest = new_fluid_mod();
+        fluid_mod_t *mod_dest;
 
         if (mod_src == NULL)
         {
@@ -1588,6 +2706,8 @@ fluid_mod_import_sfont(fluid_mod_t **mod, fluid_list_t *sfmod)
             return FLUID_OK;
         }
 
+        mod_dest = (mod_array != NULL) ? &mod_array[count] : new_fluid_mod();
+
         if(mod_dest == NULL)
         {
             return FLUID_FAILED;
@@ -1640,6 +2760,10 @@ fluid_mod_import_sfont(fluid_mod_t **mod, fluid_list_t *sfmod)
         {
             *mod = mod_dest;
         }
+        else if(mod_array != NULL)
+        {
+            mod_array[count - 1].next = mod_dest;
+        }
         else
         {
             fluid_mod_t *last_mod = *mod;
@@ -1667,9 +2791,9 @@ fluid_mod_import_sfont(fluid_mod_t **mod, fluid_list_t *sfmod)
  * @return FLUID_OK if success, FLUID_FAILED otherwise.
  */
 static int
-fluid_zone_mod_import_sfont(char *zone_name, fluid_mod_t **mod, SFZone *sfzone)
+fluid_zone_mod_import_sfont(fluid_arena_t *arena, char *zone_name, fluid_mod_t **mod, SFZone *sfzone)
 {
-    if (fluid_mod_import_sfont(mod, sfzone->mod) != FLUID_OK)
+    if (fluid_mod_import_sfont(arena, mod, sfzone->mod) != FLUID_OK)
     {
         return FLUID_FAILED;
     }
@@ -1707,7 +2831,7 @@ fluid_preset_zone_import_sfont(fluid_preset_zone_t *zone, fluid_preset_zone_t *g
             return FLUID_FAILED;
         }
 
-        if(fluid_preset_zone_create_voice_zones(zone) == FLUID_FAILED)
+        if(fluid_preset_zone_create_voice_zones(zone, defsfont->arena) == FLUID_FAILED)
         {
             return FLUID_FAILED;
         }
@@ -1717,7 +2841,7 @@ fluid_preset_zone_import_sfont(fluid_preset_zone_t *zone, fluid_preset_zone_t *g
     }
 
     /* Import the modulators (only SF2.1 and higher) */
-    return fluid_zone_mod_import_sfont(zone->name, &zone->mod, sfzone);
+    return fluid_zone_mod_import_sfont(defsfont->arena, zone->name, &zone->mod, sfzone);
 }
 
 /*
@@ -1739,9 +2863,9 @@ fluid_preset_zone_get_inst(fluid_preset_zone_t *zone)
  * new_fluid_inst
  */
 fluid_inst_t *
-new_fluid_inst(void)
+new_fluid_inst(fluid_arena_t *arena)
 {
-    fluid_inst_t *inst = FLUID_NEW(fluid_inst_t);
+    fluid_inst_t *inst = FLUID_ARENA_NEW(arena, fluid_inst_t);
 
     if(inst == NULL)
     {
@@ -1755,31 +2879,6 @@ new_fluid_inst(void)
     return inst;
 }
 
-/*
- * delete_fluid_inst
- */
-void
-delete_fluid_inst(fluid_inst_t *inst)
-{
-    fluid_inst_zone_t *zone;
-
-    fluid_return_if_fail(inst != NULL);
-
-    delete_fluid_inst_zone(inst->global_zone);
-    inst->global_zone = NULL;
-
-    zone = inst->zone;
-
-    while(zone != NULL)
-    {
-        inst->zone = zone->next;
-        delete_fluid_inst_zone(zone);
-        zone = inst->zone;
-    }
-
-    FLUID_FREE(inst);
-}
-
 /*
  * fluid_inst_set_global_zone
  */
@@ -1797,7 +2896,6 @@ fluid_inst_t *
 fluid_inst_import_sfont(int inst_idx, fluid_defsfont_t *defsfont, SFData *sfdata)
 {
     fluid_list_t *p;
-    fluid_list_t *inst_list;
     fluid_inst_t *inst;
     SFZone *sfzone;
     SFInst *sfinst;
@@ -1805,20 +2903,13 @@ fluid_inst_import_sfont(int inst_idx, fluid_defsfont_t *defsfont, SFData *sfdata
     char zone_name[256];
     int count;
 
-    for (inst_list = sfdata->inst; inst_list; inst_list = fluid_list_next(inst_list))
-    {
-        sfinst = fluid_list_get(inst_list);
-        if (sfinst->idx == inst_idx)
-        {
-            break;
-        }
-    }
-    if (inst_list == NULL)
+    if(inst_idx < 0 || inst_idx >= defsfont->inst_count || defsfont->sfinst[inst_idx] == NULL)
     {
         return NULL;
     }
 
-    inst = (fluid_inst_t *) new_fluid_inst();
+    sfinst = defsfont->sfinst[inst_idx];
+    inst = new_fluid_inst(defsfont->arena);
 
     if(inst == NULL)
     {
@@ -1848,18 +2939,17 @@ fluid_inst_import_sfont(int inst_idx, fluid_defsfont_t *defsfont, SFData *sfdata
         /* instrument zone name */
         FLUID_SNPRINTF(zone_name, sizeof(zone_name), "iz:%s/%d", inst->name, count);
 
-        inst_zone = new_fluid_inst_zone(zone_name);
+        inst_zone = new_fluid_inst_zone(defsfont->arena, zone_name);
         if(inst_zone == NULL)
         {
             FLUID_LOG(FLUID_ERR, "Out of memory");
-            goto error;
+            return NULL;
         }
 
         if(fluid_inst_zone_import_sfont(inst_zone, inst->global_zone, sfzone, defsfont, sfdata) != FLUID_OK)
         {
             FLUID_LOG(FLUID_ERR, "fluid_inst_zone_import_sfont() failed for instrument %s", inst->name);
-            delete_fluid_inst_zone(inst_zone);
-            goto error;
+            return NULL;
         }
 
         if((count == 0) && (fluid_inst_zone_get_sample(inst_zone) == NULL))
@@ -1870,20 +2960,15 @@ fluid_inst_import_sfont(int inst_idx, fluid_defsfont_t *defsfont, SFData *sfdata
         else if(fluid_inst_add_zone(inst, inst_zone) != FLUID_OK)
         {
             FLUID_LOG(FLUID_ERR, "fluid_inst_add_zone() failed for instrument %s", inst->name);
-            delete_fluid_inst_zone(inst_zone);
-            goto error;
+            return NULL;
         }
 
         p = fluid_list_next(p);
         count++;
     }
 
-    defsfont->inst = fluid_list_append(defsfont->inst, inst);
+    defsfont->inst[inst_idx] = inst;
     return inst;
-
-error:
-    delete_fluid_inst(inst);
-    return NULL;
 }
 
 /*
@@ -1933,10 +3018,10 @@ fluid_inst_get_global_zone(fluid_inst_t *inst)
  * new_fluid_inst_zone
  */
 fluid_inst_zone_t *
-new_fluid_inst_zone(char *name)
+new_fluid_inst_zone(fluid_arena_t *arena, char *name)
 {
     fluid_inst_zone_t *zone = NULL;
-    zone = FLUID_NEW(fluid_inst_zone_t);
+    zone = FLUID_ARENA_NEW(arena, fluid_inst_zone_t);
 
     if(zone == NULL)
     {
@@ -1945,12 +3030,11 @@ new_fluid_inst_zone(char *name)
     }
 
     zone->next = NULL;
-    zone->name = FLUID_STRDUP(name);
+    zone->name = fluid_arena_strdup(arena, name);
 
     if(zone->name == NULL)
     {
         FLUID_LOG(FLUID_ERR, "Out of memory");
-        FLUID_FREE(zone);
         return NULL;
     }
 
@@ -1959,26 +3043,11 @@ new_fluid_inst_zone(char *name)
     zone->range.keyhi = 128;
     zone->range.vello = 0;
     zone->range.velhi = 128;
-    zone->range.ignore = FALSE;
     /* Flag the generators as unused.
      * This also sets the generator values to default, but they will be overwritten anyway, if used.*/
     fluid_gen_init(&zone->gen[0], NULL);
-    zone->mod = NULL; /* list of modulators */
-    return zone;
-}
-
-/*
- * delete_fluid_inst_zone
- */
-void
-delete_fluid_inst_zone(fluid_inst_zone_t *zone)
-{
-    fluid_return_if_fail(zone != NULL);
-
-    delete_fluid_list_mod(zone->mod);
-
-    FLUID_FREE(zone->name);
-    FLUID_FREE(zone);
+    zone->mod = NULL; /* list of modulators */
+    return zone;
 }
 
 /*
@@ -2006,20 +3075,16 @@ fluid_inst_zone_import_sfont(fluid_inst_zone_t *inst_zone, fluid_inst_zone_t *gl
 
     if (inst_zone->gen[GEN_SAMPLEID].flags == GEN_SET)
     {
-        fluid_list_t *list;
-        SFSample *sfsample;
+        SFSample *sfsample = NULL;
         int sample_idx = (int) inst_zone->gen[GEN_SAMPLEID].val;
 
         /* find the SFSample by index */
-        for(list = sfdata->sample; list; list = fluid_list_next(list))
+        if(sample_idx >= 0 && sample_idx < defsfont->sfsample_count)
         {
-            sfsample = fluid_list_get(list);
-            if (sfsample->idx == sample_idx)
-            {
-                break;
-            }
+            sfsample = defsfont->sfsample[sample_idx];
         }
-        if (list == NULL)
+
+        if (sfsample == NULL)
         {
             FLUID_LOG(FLUID_ERR, "Instrument zone '%s': Invalid sample reference",
                       inst_zone->name);
@@ -2033,7 +3098,7 @@ fluid_inst_zone_import_sfont(fluid_inst_zone_t *inst_zone, fluid_inst_zone_t *gl
     }
 
     /* Import the modulators (only SF2.1 and higher) */
-    return fluid_zone_mod_import_sfont(inst_zone->name, &inst_zone->mod, sfzone);
+    return fluid_zone_mod_import_sfont(defsfont->arena, inst_zone->name, &inst_zone->mod, sfzone);
 }
 
 /*
@@ -2049,16 +3114,10 @@ fluid_inst_zone_get_sample(fluid_inst_zone_t *zone)
 int
 fluid_zone_inside_range(fluid_zone_range_t *range, int key, int vel)
 {
-    /* ignoreInstrumentZone is set in mono legato playing */
-    int ignore_zone = range->ignore;
-
-    /* Reset the 'ignore' request */
-    range->ignore = FALSE;
-
-    return !ignore_zone && ((range->keylo <= key) &&
-                            (range->keyhi >= key) &&
-                            (range->vello <= vel) &&
-                            (range->velhi >= vel));
+    return ((range->keylo <= key) &&
+            (range->keyhi >= key) &&
+            (range->vello <= vel) &&
+            (range->velhi >= vel));
 }
 
 /***************************************************************
@@ -2101,7 +3160,7 @@ fluid_sample_import_sfont(fluid_sample_t *sample, SFSample *sfsample, fluid_defs
 
     if(defsfont->dynamic_samples)
     {
-        sample->notify = dynamic_samples_sample_notify;
+        sample->notify = defsfont->sharing ? shared_samples_sample_notify : dynamic_samples_sample_notify;
     }
 
     FLUID_LOG(FLUID_DBG, "Discovering sample '%s', src_start %d, loop_start %d, loop_end %d, src_end %d", sample->name, sample->source_start, sample->loopstart, sample->loopend, sample->source_end);
@@ -2119,6 +3178,9 @@ fluid_sample_import_sfont(fluid_sample_t *sample, SFSample *sfsample, fluid_defs
  * be unloaded straight away because it was still in use by a voice. */
 static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason)
 {
+    /* A sample that has been used by a voice isn't being loaded in the background,
+     * and preset_count is only changed by the synth thread (or with the shared
+     * samples mutex held, for shared SoundFonts) */
     if(reason == FLUID_SAMPLE_DONE && sample->preset_count == 0)
     {
         unload_sample(sample);
@@ -2127,60 +3189,141 @@ static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason)
     return FLUID_OK;
 }
 
+/* Called if a preset has been selected for or unselected from a channel or
+ * pinned. Imports lazily loaded presets on first use and forwards to dynamic
+ * sample loading. */
+static int fluid_defpreset_preset_notify(fluid_preset_t *preset, int reason, int chan)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(preset->sfont);
+
+    if((reason == FLUID_PRESET_SELECTED || reason == FLUID_PRESET_PIN)
+            && fluid_defpreset_import_lazy(fluid_preset_get_data(preset)) == FLUID_FAILED)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(defsfont->dynamic_samples)
+    {
+        return dynamic_samples_preset_notify(preset, reason, chan);
+    }
+
+    return FLUID_OK;
+}
+
+/* Called for the samples of shared SoundFonts instead of dynamic_samples_sample_notify(),
+ * the voices and presets using them can belong to several synths */
+static int shared_samples_sample_notify(fluid_sample_t *sample, int reason)
+{
+    int ret;
+
+    fluid_mutex_lock(shared_samples_mutex);
+    ret = dynamic_samples_sample_notify(sample, reason);
+    fluid_mutex_unlock(shared_samples_mutex);
+
+    return ret;
+}
+
 /* Called if a preset has been selected for or unselected from a channel. Used by
  * dynamic sample loading to load and unload samples on demand. */
 static int dynamic_samples_preset_notify(fluid_preset_t *preset, int reason, int chan)
 {
-    fluid_defsfont_t *defsfont;
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(preset->sfont);
+    int ret = FLUID_OK;
+
+    if(defsfont->sharing)
+    {
+        fluid_mutex_lock(shared_samples_mutex);
+    }
 
     if(reason == FLUID_PRESET_SELECTED)
     {
         FLUID_LOG(FLUID_DBG, "Selected preset '%s' on channel %d", fluid_preset_get_name(preset), chan);
-        defsfont = fluid_sfont_get_data(preset->sfont);
-        return load_preset_samples(defsfont, preset);
+        ret = load_preset_samples(sample_owner(defsfont), preset);
     }
-
-    if(reason == FLUID_PRESET_UNSELECTED)
+    else if(reason == FLUID_PRESET_UNSELECTED)
     {
         FLUID_LOG(FLUID_DBG, "Deselected preset '%s' from channel %d", fluid_preset_get_name(preset), chan);
-        defsfont = fluid_sfont_get_data(preset->sfont);
-        return unload_preset_samples(defsfont, preset);
+        ret = unload_preset_samples(sample_owner(defsfont), preset);
     }
-
-    if(reason == FLUID_PRESET_PIN)
+    else if(reason == FLUID_PRESET_PIN)
+    {
+        ret = pin_preset_samples(defsfont, preset);
+    }
+    else if(reason == FLUID_PRESET_UNPIN)
     {
-        defsfont = fluid_sfont_get_data(preset->sfont);
-        return pin_preset_samples(defsfont, preset);
+        ret = unpin_preset_samples(defsfont, preset);
     }
 
-    if(reason == FLUID_PRESET_UNPIN)
+    if(defsfont->sharing)
     {
-        defsfont = fluid_sfont_get_data(preset->sfont);
-        return unpin_preset_samples(defsfont, preset);
+        fluid_mutex_unlock(shared_samples_mutex);
     }
 
-    return FLUID_OK;
+    return ret;
 }
 
+/* Returns the index of preset in the presets of defsfont, -1 if it isn't one of them */
+static int find_preset_index(fluid_defsfont_t *defsfont, fluid_preset_t *preset)
+{
+    int i;
+
+    for(i = 0; i < defsfont->preset_count; i++)
+    {
+        if(defsfont->preset[i] == preset)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
 
+/* Pinning is tracked per SoundFont, not per preset, as the presets of shared
+ * SoundFonts are pinned by every synth on its own */
 static int pin_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset)
 {
-    fluid_defpreset_t *defpreset;
+    int idx = find_preset_index(defsfont, preset);
 
-    defpreset = fluid_preset_get_data(preset);
-    if (defpreset->pinned)
+    if(idx < 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(defsfont->pinned == NULL)
+    {
+        defsfont->pinned = FLUID_ARRAY(unsigned char, defsfont->preset_count);
+
+        if(defsfont->pinned == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMSET(defsfont->pinned, 0, defsfont->preset_count);
+    }
+
+    if(defsfont->pinned[idx])
     {
         return FLUID_OK;
     }
 
     FLUID_LOG(FLUID_DBG, "Pinning preset '%s'", fluid_preset_get_name(preset));
 
-    if(load_preset_samples(defsfont, preset) == FLUID_FAILED)
+    if(load_preset_samples(sample_owner(defsfont), preset) == FLUID_FAILED)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* Pinned samples are expected to be loaded on return */
+    if(defsfont->async_samples && wait_preset_samples(preset) == FLUID_FAILED)
     {
+        FLUID_LOG(FLUID_WARN, "Samples of preset '%s' could not be loaded in time, not pinning it",
+                  fluid_preset_get_name(preset));
+        unload_preset_samples(sample_owner(defsfont), preset);
         return FLUID_FAILED;
     }
 
-    defpreset->pinned = TRUE;
+    defsfont->pinned[idx] = TRUE;
 
     return FLUID_OK;
 }
@@ -2188,22 +3331,21 @@ static int pin_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset
 
 static int unpin_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset)
 {
-    fluid_defpreset_t *defpreset;
+    int idx = find_preset_index(defsfont, preset);
 
-    defpreset = fluid_preset_get_data(preset);
-    if (!defpreset->pinned)
+    if(idx < 0 || defsfont->pinned == NULL || !defsfont->pinned[idx])
     {
         return FLUID_OK;
     }
 
     FLUID_LOG(FLUID_DBG, "Unpinning preset '%s'", fluid_preset_get_name(preset));
 
-    if(unload_preset_samples(defsfont, preset) == FLUID_FAILED)
+    if(unload_preset_samples(sample_owner(defsfont), preset) == FLUID_FAILED)
     {
         return FLUID_FAILED;
     }
 
-    defpreset->pinned = FALSE;
+    defsfont->pinned[idx] = FALSE;
 
     return FLUID_OK;
 }
@@ -2218,7 +3360,14 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
     fluid_inst_t *inst;
     fluid_inst_zone_t *inst_zone;
     fluid_sample_t *sample;
+    fluid_list_t *samples = NULL;
     SFData *sffile = NULL;
+    double start_time = fluid_utime();
+
+    if(defsfont->async_samples)
+    {
+        return queue_preset_samples(defsfont, preset);
+    }
 
     defpreset = fluid_preset_get_data(preset);
     preset_zone = fluid_defpreset_get_zone(defpreset);
@@ -2237,8 +3386,10 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
                 sample->preset_count++;
 
                 /* If this is the first time this sample has been selected,
-                 * load the sampledata */
-                if(sample->preset_count == 1)
+                 * load the sampledata. The data might still be there because
+                 * a voice is using it, possibly one of another synth if the
+                 * SoundFont is shared. */
+                if(sample->preset_count == 1 && sample->data == NULL)
                 {
                     /* Make sure we have an open Soundfont file. Do this here
                      * to avoid having to open the file if no loading is necessary
@@ -2250,20 +3401,106 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
                         if(sffile == NULL)
                         {
                             FLUID_LOG(FLUID_ERR, "Unable to open Soundfont file");
+                            delete_fluid_list(samples);
                             return FLUID_FAILED;
                         }
                     }
 
-                    if(fluid_defsfont_load_sampledata(defsfont, sffile, sample) == FLUID_OK)
-                    {
-                        fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
-                        fluid_voice_optimize_sample(sample);
-                    }
-                    else
-                    {
-                        FLUID_LOG(FLUID_ERR, "Unable to load sample '%s', disabling", sample->name);
-                        sample->start = sample->end = 0;
-                    }
+                    samples = fluid_list_prepend(samples, sample);
+                }
+            }
+
+            inst_zone = fluid_inst_zone_next(inst_zone);
+        }
+
+        preset_zone = fluid_preset_zone_next(preset_zone);
+    }
+
+    if(sffile == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    load_samples(defsfont, sffile, samples);
+
+    FLUID_LOG(FLUID_DBG, "Loaded %d samples of preset '%s' in %.1f ms", fluid_list_size(samples),
+              fluid_preset_get_name(preset), (fluid_utime() - start_time) / 1000.0);
+
+    delete_fluid_list(samples);
+    fluid_sffile_close(sffile);
+
+    return FLUID_OK;
+}
+
+/* Loads the sample data of a list of samples. Failing samples are disabled. */
+static void load_samples(fluid_defsfont_t *defsfont, SFData *sffile, fluid_list_t *samples)
+{
+    fluid_list_t *list;
+    fluid_sample_t *sample;
+
+    /* Compressed SF3 samples are decoded concurrently, like in fluid_defsfont_load_all_sampledata() */
+    #pragma omp parallel if(sffile->version.major == 3)
+    #pragma omp single
+    for(list = samples; list; list = fluid_list_next(list))
+    {
+        sample = fluid_list_get(list);
+
+        #pragma omp task firstprivate(sample, sffile, defsfont) default(none)
+        {
+            if(fluid_defsfont_load_sampledata(defsfont, sffile, sample) == FLUID_OK)
+            {
+                fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
+                fluid_voice_optimize_sample(sample);
+                fluid_defsfont_compress_sample(defsfont, sample);
+            }
+            else
+            {
+                #pragma omp critical
+                {
+                    FLUID_LOG(FLUID_ERR, "Unable to load sample '%s', disabling", sample->name);
+                }
+                sample->start = sample->end = 0;
+            }
+        }
+    }
+}
+
+/* Like load_preset_samples(), but the samples are queued for the loader thread
+ * instead of being loaded right away. A sample is owned by the loader thread
+ * while its loading flag is set. */
+static int queue_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset)
+{
+    fluid_preset_zone_t *preset_zone;
+    fluid_inst_zone_t *inst_zone;
+    fluid_sample_t *sample;
+    fluid_list_t *old_queue, *list;
+    int ret = FLUID_OK;
+
+    fluid_cond_mutex_lock(defsfont->async_mutex);
+
+    old_queue = defsfont->async_queue;
+
+    preset_zone = fluid_defpreset_get_zone(fluid_preset_get_data(preset));
+
+    while(preset_zone != NULL)
+    {
+        inst_zone = fluid_inst_get_zone(fluid_preset_zone_get_inst(preset_zone));
+
+        while(inst_zone != NULL)
+        {
+            sample = fluid_inst_zone_get_sample(inst_zone);
+
+            if((sample != NULL) && (sample->start != sample->end))
+            {
+                sample->preset_count++;
+
+                /* The data might still be there because a voice is using it, or
+                 * because the sample has been queued for an earlier selection */
+                if(sample->preset_count == 1 && sample->data == NULL
+                        && !fluid_atomic_int_get(&sample->loading))
+                {
+                    fluid_atomic_int_set(&sample->loading, TRUE);
+                    defsfont->async_queue = fluid_list_prepend(defsfont->async_queue, sample);
                 }
             }
 
@@ -2273,14 +3510,200 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
         preset_zone = fluid_preset_zone_next(preset_zone);
     }
 
-    if(sffile != NULL)
+    if(defsfont->async_queue != old_queue)
+    {
+        if(defsfont->async_thread == NULL)
+        {
+            defsfont->async_quit = FALSE;
+            defsfont->async_thread = new_fluid_thread("sampleload", dynamic_samples_thread, defsfont, 0, FALSE);
+        }
+
+        if(defsfont->async_thread == NULL)
+        {
+            /* Take the samples queued above back, nobody is going to load them */
+            while(defsfont->async_queue != old_queue)
+            {
+                list = defsfont->async_queue;
+                fluid_atomic_int_set(&((fluid_sample_t *)fluid_list_get(list))->loading, FALSE);
+                defsfont->async_queue = fluid_list_next(list);
+                delete1_fluid_list(list);
+            }
+
+            ret = FLUID_FAILED;
+        }
+
+        fluid_cond_signal(defsfont->async_cond);
+    }
+
+    fluid_cond_mutex_unlock(defsfont->async_mutex);
+
+    return ret;
+}
+
+/* Waits until deadline, as returned by fluid_curtime(), for a sample that is
+ * being loaded in the background. Returns TRUE if the sample can be played. */
+static int wait_sample(fluid_sample_t *sample, unsigned int deadline)
+{
+    while(fluid_atomic_int_get(&sample->loading))
+    {
+        if((int)(fluid_curtime() - deadline) >= 0)
+        {
+            return FALSE;
+        }
+
+        fluid_msleep(1);
+    }
+
+    return TRUE;
+}
+
+/* Waits up to FLUID_DEFSFONT_PIN_TIMEOUT for all samples of a preset to be loaded in
+ * the background. Returns FLUID_FAILED if they don't arrive in time. */
+static int wait_preset_samples(fluid_preset_t *preset)
+{
+    fluid_preset_zone_t *preset_zone;
+    fluid_inst_zone_t *inst_zone;
+    fluid_sample_t *sample;
+    unsigned int deadline = fluid_curtime() + FLUID_DEFSFONT_PIN_TIMEOUT;
+
+    preset_zone = fluid_defpreset_get_zone(fluid_preset_get_data(preset));
+
+    while(preset_zone != NULL)
     {
-        fluid_sffile_close(sffile);
+        inst_zone = fluid_inst_get_zone(fluid_preset_zone_get_inst(preset_zone));
+
+        while(inst_zone != NULL)
+        {
+            sample = fluid_inst_zone_get_sample(inst_zone);
+
+            if(sample != NULL && !wait_sample(sample, deadline))
+            {
+                return FLUID_FAILED;
+            }
+
+            inst_zone = fluid_inst_zone_next(inst_zone);
+        }
+
+        preset_zone = fluid_preset_zone_next(preset_zone);
     }
 
     return FLUID_OK;
 }
 
+/* Loads the samples queued by queue_preset_samples() */
+static fluid_thread_return_t dynamic_samples_thread(void *data)
+{
+    fluid_defsfont_t *defsfont = data;
+    fluid_list_t *list, *samples;
+    fluid_sample_t *sample;
+    SFData *sffile;
+    double start_time;
+
+    fluid_cond_mutex_lock(defsfont->async_mutex);
+
+    while(!defsfont->async_quit)
+    {
+        if(defsfont->async_queue == NULL)
+        {
+            fluid_cond_wait(defsfont->async_cond, defsfont->async_mutex);
+            continue;
+        }
+
+        /* Skip samples whose presets have been unselected before loading started */
+        samples = NULL;
+
+        for(list = defsfont->async_queue; list; list = fluid_list_next(list))
+        {
+            sample = fluid_list_get(list);
+
+            if(sample->preset_count == 0)
+            {
+                fluid_atomic_int_set(&sample->loading, FALSE);
+            }
+            else
+            {
+                samples = fluid_list_prepend(samples, sample);
+            }
+        }
+
+        delete_fluid_list(defsfont->async_queue);
+        defsfont->async_queue = NULL;
+
+        fluid_cond_mutex_unlock(defsfont->async_mutex);
+
+        start_time = fluid_utime();
+        sffile = (samples != NULL) ? fluid_sffile_open(defsfont->filename, &defsfont->fcbs) : NULL;
+
+        if(sffile != NULL)
+        {
+            load_samples(defsfont, sffile, samples);
+            fluid_sffile_close(sffile);
+
+            FLUID_LOG(FLUID_DBG, "Loaded %d samples in the background in %.1f ms", fluid_list_size(samples),
+                      (fluid_utime() - start_time) / 1000.0);
+        }
+        else if(samples != NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Unable to open Soundfont file");
+
+            for(list = samples; list; list = fluid_list_next(list))
+            {
+                sample = fluid_list_get(list);
+                sample->start = sample->end = 0;
+            }
+        }
+
+        fluid_cond_mutex_lock(defsfont->async_mutex);
+
+        for(list = samples; list; list = fluid_list_next(list))
+        {
+            sample = fluid_list_get(list);
+            fluid_atomic_int_set(&sample->loading, FALSE);
+
+            /* No voice can have used the sample yet, so it can be unloaded
+             * right away if its presets have been unselected meanwhile */
+            if(sample->preset_count == 0 && sample->data != NULL)
+            {
+                unload_sample(sample);
+            }
+        }
+
+        delete_fluid_list(samples);
+    }
+
+    fluid_cond_mutex_unlock(defsfont->async_mutex);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/* Stops the loader thread. Samples that are still queued are not loaded. */
+static void stop_dynamic_samples_thread(fluid_defsfont_t *defsfont)
+{
+    fluid_list_t *list;
+
+    if(defsfont->async_thread == NULL)
+    {
+        return;
+    }
+
+    fluid_cond_mutex_lock(defsfont->async_mutex);
+    defsfont->async_quit = TRUE;
+    fluid_cond_signal(defsfont->async_cond);
+    fluid_cond_mutex_unlock(defsfont->async_mutex);
+
+    fluid_thread_join(defsfont->async_thread);
+    delete_fluid_thread(defsfont->async_thread);
+    defsfont->async_thread = NULL;
+
+    for(list = defsfont->async_queue; list; list = fluid_list_next(list))
+    {
+        fluid_atomic_int_set(&((fluid_sample_t *)fluid_list_get(list))->loading, FALSE);
+    }
+
+    delete_fluid_list(defsfont->async_queue);
+    defsfont->async_queue = NULL;
+}
+
 /* Walk through all samples used by the passed in preset and unload the sample data
  * of each sample that is not used by any selected preset anymore. Used by dynamic
  * sample loading. */
@@ -2292,6 +3715,11 @@ static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *pre
     fluid_inst_zone_t *inst_zone;
     fluid_sample_t *sample;
 
+    if(defsfont->async_samples)
+    {
+        fluid_cond_mutex_lock(defsfont->async_mutex);
+    }
+
     defpreset = fluid_preset_get_data(preset);
     preset_zone = fluid_defpreset_get_zone(defpreset);
 
@@ -2312,8 +3740,10 @@ static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *pre
                  * sounding voice, unload it from the sample cache. If it's
                  * still in use by a voice, dynamic_samples_sample_notify will
                  * take care of unloading the sample as soon as the voice is
-                 * finished with it (but only on the next API call). */
-                if(sample->preset_count == 0 && sample->refcount == 0)
+                 * finished with it (but only on the next API call). If it's
+                 * being loaded in the background, the loader thread unloads it. */
+                if(sample->preset_count == 0 && fluid_atomic_int_get(&sample->refcount) == 0
+                        && !fluid_atomic_int_get(&sample->loading))
                 {
                     unload_sample(sample);
                 }
@@ -2325,6 +3755,11 @@ static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *pre
         preset_zone = fluid_preset_zone_next(preset_zone);
     }
 
+    if(defsfont->async_samples)
+    {
+        fluid_cond_mutex_unlock(defsfont->async_mutex);
+    }
+
     return FLUID_OK;
 }
 
@@ -2334,11 +3769,11 @@ static void unload_sample(fluid_sample_t *sample)
     fluid_return_if_fail(sample != NULL);
     fluid_return_if_fail(sample->data != NULL);
     fluid_return_if_fail(sample->preset_count == 0);
-    fluid_return_if_fail(sample->refcount == 0);
+    fluid_return_if_fail(fluid_atomic_int_get(&sample->refcount) == 0);
 
     FLUID_LOG(FLUID_DBG, "Unloading sample '%s'", sample->name);
 
-    if(fluid_samplecache_unload(sample->data) == FLUID_FAILED)
+    if(unload_sample_data(sample) == FLUID_FAILED)
     {
         FLUID_LOG(FLUID_ERR, "Unable to unload sample '%s'", sample->name);
     }
@@ -2349,20 +3784,33 @@ static void unload_sample(fluid_sample_t *sample)
     }
 }
 
-static fluid_inst_t *find_inst_by_idx(fluid_defsfont_t *defsfont, int idx)
+/* Drops the reference to the data of an individually loaded sample. The data
+ * either belongs to the sample cache, is shared by its content with
+ * synth.sample-dedup, or is compressed with synth.sample-compression. */
+static int unload_sample_data(fluid_sample_t *sample)
 {
-    fluid_list_t *list;
-    fluid_inst_t *inst;
+    if(sample->codec != NULL)
+    {
+        fluid_samplecodec_free(sample->codec);
+        sample->codec = NULL;
+        sample->stream_preload = 0;
+        return FLUID_OK;
+    }
 
-    for(list = defsfont->inst; list != NULL; list = fluid_list_next(list))
+    if(fluid_samplededup_release(sample->data) == FLUID_OK)
     {
-        inst = fluid_list_get(list);
+        return FLUID_OK;
+    }
 
-        if(inst->source_idx == idx)
-        {
-            return inst;
-        }
+    return fluid_samplecache_unload(sample->data);
+}
+
+static fluid_inst_t *find_inst_by_idx(fluid_defsfont_t *defsfont, int idx)
+{
+    if(idx < 0 || idx >= defsfont->inst_count)
+    {
+        return NULL;
     }
 
-    return NULL;
+    return defsfont->inst[idx];
 }
@@ -28,6 +28,8 @@
 #include "fluidsynth_priv.h"
 #include "fluid_sffile.h"
 #include "fluid_list.h"
+#include "fluid_arena.h"
+#include "fluid_hash.h"
 #include "fluid_mod.h"
 #include "fluid_gen.h"
 #include "fluid_sfont.h"
@@ -58,6 +60,7 @@ typedef struct _fluid_preset_zone_t fluid_preset_zone_t;
 typedef struct _fluid_inst_t fluid_inst_t;
 typedef struct _fluid_inst_zone_t fluid_inst_zone_t;            /**< Soundfont Instrument Zone */
 typedef struct _fluid_voice_zone_t fluid_voice_zone_t;
+typedef struct _fluid_zone_index_entry_t fluid_zone_index_entry_t;
 
 /* defines the velocity and key range for a zone */
 struct _fluid_zone_range_t
@@ -66,7 +69,6 @@ struct _fluid_zone_range_t
     int keyhi;
     int vello;
     int velhi;
-    unsigned char ignore;	/* set to TRUE for legato playing to ignore this range zone */
 };
 
 /* Stored on a preset zone to keep track of the inst zones that could start a voice
@@ -77,6 +79,18 @@ struct _fluid_voice_zone_t
     fluid_zone_range_t range;
 };
 
+/* Number of keys covered by the per-preset zone index. Notes outside of this range
+ * (e.g. tuned keys beyond 127) fall back to walking the preset zone list. */
+#define FLUID_ZONE_INDEX_KEYS 128
+
+/* An entry of the per-preset zone index: a voice zone together with the preset zone
+ * it belongs to. */
+struct _fluid_zone_index_entry_t
+{
+    fluid_preset_zone_t *preset_zone;
+    fluid_voice_zone_t *voice_zone;
+};
+
 /*
 
   Public interface
@@ -84,6 +98,9 @@ struct _fluid_voice_zone_t
  */
 
 fluid_sfont_t *fluid_defsfloader_load(fluid_sfloader_t *loader, const char *filename);
+int fluid_defsfont_can_reload(fluid_sfont_t *sfont);
+int fluid_defsfont_import_preset(fluid_preset_t *preset);
+fluid_sfont_t *fluid_defsfloader_reload(fluid_sfloader_t *loader, fluid_sfont_t *sfont);
 
 
 int fluid_defsfont_sfont_delete(fluid_sfont_t *sfont);
@@ -118,12 +135,44 @@ struct _fluid_defsfont_t
 
     fluid_sfont_t *sfont;           /* pointer to parent sfont */
     fluid_list_t *sample;           /* the samples in this soundfont */
-    fluid_list_t *preset;           /* the presets of this soundfont */
-    fluid_list_t *inst;             /* the instruments of this soundfont */
+    fluid_preset_t **preset;        /* the presets of this soundfont */
+    int preset_count;               /* number of presets */
+    int preset_size;                /* allocated size of the preset array */
+    fluid_inst_t **inst;            /* the instruments of this soundfont by source index, NULL until imported */
+    int inst_count;                 /* number of instruments in the source Soundfont */
+    fluid_arena_t *arena;           /* holds the presets, instruments and their zones and modulators */
     int mlock;                      /* Should we try memlock (avoid swapping)? */
     int dynamic_samples;            /* Enables dynamic sample loading if set */
-
-    fluid_list_t *preset_iter_cur;       /* the current preset in the iteration */
+    int mmap;                       /* Should we try to map uncompressed sample data from the file? */
+    int shm;                        /* Should we share sample data with other processes in shared memory? */
+    char *sample_cache_dir;         /* Directory to store decoded samples in, NULL if disabled */
+    char *compiled_dir;             /* Directory of compiled SoundFont images, NULL if disabled */
+    int streaming;                  /* Should we stream sample data from disk instead of keeping it resident? */
+    int stream_preload;             /* Count of frames at the start of each streamed sample to keep resident */
+    int lazy_presets;               /* Import the zones of a preset only when it is first used */
+    int dedup;                      /* Share sample data with identical samples of other SoundFonts? */
+    int compression;                /* Keep sample data compressed and decode it while playing? */
+    int sharing;                    /* Share the loaded data with other synths loading the same file? */
+    fluid_defsfont_t *shared;       /* the SoundFont whose data this one uses with synth.sfont-sharing, NULL if it owns its data */
+    int share_count;                /* count of SoundFonts using the data of this one, protected by the share mutex */
+    time_t mtime;                   /* modification time of the file when it was loaded, identifies shared SoundFonts */
+    unsigned char *pinned;          /* per preset: are its samples pinned by this SoundFont? NULL if none has been pinned yet */
+    int incremental;                /* Take over the data of unchanged samples when reloading? */
+    fluid_hashtable_t *reload_samples; /* the samples of the SoundFont being reloaded by their data, NULL if not reloading */
+    SFData *sfdata;                 /* parsed preset data kept for lazy preset import, NULL if not lazy */
+    SFInst **sfinst;                /* the instruments of the parsed data by index, valid as long as the parsed data */
+    SFSample **sfsample;            /* the samples of the parsed data by index, valid as long as the parsed data */
+    int sfsample_count;             /* number of entries in sfsample */
+
+    /* Background loading of the samples of selected presets, see synth.dynamic-sample-loading-async */
+    int async_samples;              /* Should samples of selected presets be loaded by a separate thread? */
+    fluid_cond_mutex_t *async_mutex; /* protects the queue and, if async_samples is set, the preset_count of samples */
+    fluid_cond_t *async_cond;       /* signalled when samples have been queued or the thread should quit */
+    fluid_list_t *async_queue;      /* samples waiting to be loaded */
+    fluid_thread_t *async_thread;   /* loader thread, started on demand */
+    int async_quit;                 /* TRUE if the loader thread should quit */
+
+    int preset_iter_cur;            /* index of the current preset in the iteration */
 };
 
 
@@ -140,6 +189,9 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
 int fluid_defsfont_add_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample);
 int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *defpreset);
 
+/* Only used for tests */
+int fluid_defsfont_count_shared(void);
+
 
 /*
  * fluid_preset_t
@@ -152,13 +204,20 @@ struct _fluid_defpreset_t
     unsigned int num;                     /* the preset number */
     fluid_preset_zone_t *global_zone;        /* the global zone of the preset */
     fluid_preset_zone_t *zone;               /* the chained list of preset zones */
-    int pinned;                           /* preset samples pinned to sample cache? */
+    fluid_defsfont_t *defsfont;           /* the SoundFont this preset belongs to */
+    SFPreset *sfpreset;                   /* preset data still to be imported (lazy import), NULL once imported */
+
+    /* Zone index built at load time: the voice zones whose key range covers key k are
+     * stored in zone_index[zone_index_start[k] .. zone_index_start[k + 1] - 1], in the
+     * same order as they would be found by walking the preset zone list. */
+    fluid_zone_index_entry_t *zone_index;
+    int zone_index_start[FLUID_ZONE_INDEX_KEYS + 1];
 };
 
-fluid_defpreset_t *new_fluid_defpreset(void);
-void delete_fluid_defpreset(fluid_defpreset_t *defpreset);
+fluid_defpreset_t *new_fluid_defpreset(fluid_arena_t *arena);
 fluid_defpreset_t *fluid_defpreset_next(fluid_defpreset_t *defpreset);
 int fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset, SFPreset *sfpreset, fluid_defsfont_t *defsfont, SFData *sfdata);
+int fluid_defpreset_import_lazy(fluid_defpreset_t *defpreset);
 int fluid_defpreset_set_global_zone(fluid_defpreset_t *defpreset, fluid_preset_zone_t *zone);
 int fluid_defpreset_add_zone(fluid_defpreset_t *defpreset, fluid_preset_zone_t *zone);
 fluid_preset_zone_t *fluid_defpreset_get_zone(fluid_defpreset_t *defpreset);
@@ -167,6 +226,8 @@ int fluid_defpreset_get_banknum(fluid_defpreset_t *defpreset);
 int fluid_defpreset_get_num(fluid_defpreset_t *defpreset);
 const char *fluid_defpreset_get_name(fluid_defpreset_t *defpreset);
 int fluid_defpreset_noteon(fluid_defpreset_t *defpreset, fluid_synth_t *synth, int chan, int key, int vel);
+int fluid_defpreset_build_zone_index(fluid_defpreset_t *defpreset);
+fluid_zone_index_entry_t *fluid_defpreset_get_key_zones(fluid_defpreset_t *defpreset, int key, int *count);
 
 /*
  * fluid_preset_zone
@@ -176,17 +237,18 @@ struct _fluid_preset_zone_t
     fluid_preset_zone_t *next;
     char *name;
     fluid_inst_t *inst;
-    fluid_list_t *voice_zone;
+    fluid_voice_zone_t *voice_zone;  /* array of the voice zones */
+    int voice_zone_count;
     fluid_zone_range_t range;
     fluid_gen_t gen[GEN_LAST];
     fluid_mod_t *mod;  /* List of modulators */
 };
 
-fluid_preset_zone_t *new_fluid_preset_zone(char *name);
-void delete_fluid_preset_zone(fluid_preset_zone_t *zone);
+fluid_preset_zone_t *new_fluid_preset_zone(fluid_arena_t *arena, char *name);
 fluid_preset_zone_t *fluid_preset_zone_next(fluid_preset_zone_t *zone);
 int fluid_preset_zone_import_sfont(fluid_preset_zone_t *zone, fluid_preset_zone_t *global_zone, SFZone *sfzone, fluid_defsfont_t *defssfont, SFData *sfdata);
 fluid_inst_t *fluid_preset_zone_get_inst(fluid_preset_zone_t *zone);
+int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone, fluid_arena_t *arena);
 
 /*
  * fluid_inst_t
@@ -199,9 +261,8 @@ struct _fluid_inst_t
     fluid_inst_zone_t *zone;
 };
 
-fluid_inst_t *new_fluid_inst(void);
+fluid_inst_t *new_fluid_inst(fluid_arena_t *arena);
 fluid_inst_t *fluid_inst_import_sfont(int inst_idx, fluid_defsfont_t *defsfont, SFData *sfdata);
-void delete_fluid_inst(fluid_inst_t *inst);
 int fluid_inst_set_global_zone(fluid_inst_t *inst, fluid_inst_zone_t *zone);
 int fluid_inst_add_zone(fluid_inst_t *inst, fluid_inst_zone_t *zone);
 fluid_inst_zone_t *fluid_inst_get_zone(fluid_inst_t *inst);
@@ -221,8 +282,7 @@ struct _fluid_inst_zone_t
 };
 
 
-fluid_inst_zone_t *new_fluid_inst_zone(char *name);
-void delete_fluid_inst_zone(fluid_inst_zone_t *zone);
+fluid_inst_zone_t *new_fluid_inst_zone(fluid_arena_t *arena, char *name);
 fluid_inst_zone_t *fluid_inst_zone_next(fluid_inst_zone_t *zone);
 int fluid_inst_zone_import_sfont(fluid_inst_zone_t *inst_zone, fluid_inst_zone_t *global_inst_zone, SFZone *sfzone, fluid_defsfont_t *defsfont, SFData *sfdata);
 fluid_sample_t *fluid_inst_zone_get_sample(fluid_inst_zone_t *zone);
@@ -15,6 +15,8 @@
 #include "fluid_sfont.h"
 #include "fluidsynth_priv.h"
 #include "fluid_defsfont.h"
+#include "fluid_samplecache.h"
+#include "fluid_samplededup.h"
 #include "fluid_mod.h"
 #include "fluid_synth.h"
 #include "fluid_chan.h"
@@ -143,76 +145,42 @@ public:
     }
 };
 
-// RAII wrapper for mlock
-struct mlock_guard
+// Drops the reference to the sample data of a fluid sample. The data either
+// belongs to the sample cache or, with synth.sample-dedup, is shared by content.
+static void unload_sample_data(fluid_sample_t &sample) noexcept
 {
-    mlock_guard() noexcept : ptr(nullptr), size(0), locked(false)
+    if(fluid_samplededup_release(sample.data) != FLUID_OK)
     {
+        fluid_samplecache_unload(sample.data);
     }
 
-    mlock_guard(void *ptr, fluid_long_long_t size) noexcept : ptr(ptr), size(size), locked(false)
-    {
-    }
+    sample.data = nullptr;
+    sample.data24 = nullptr;
+}
 
-    mlock_guard(const mlock_guard &) = delete;
-    mlock_guard &operator=(const mlock_guard &) = delete;
-    mlock_guard(mlock_guard &&other) noexcept
-        : ptr(std::exchange(other.ptr, nullptr)), size(std::exchange(other.size, 0)),
-          locked(std::exchange(other.locked, false))
+// RAII wrapper that unloads the sample data of fluid samples
+struct sample_data_guard
+{
+    explicit sample_data_guard(std::vector<fluid_sample_t> &samples) noexcept : samples(samples)
     {
     }
 
-    mlock_guard &operator=(mlock_guard &&other) noexcept
-    {
-        if(this == &other)
-        {
-            return *this; // self-assignment
-        }
+    sample_data_guard(const sample_data_guard &) = delete;
+    sample_data_guard &operator=(const sample_data_guard &) = delete;
 
-        unlock();
-        ptr = std::exchange(other.ptr, nullptr);
-        size = std::exchange(other.size, 0);
-        locked = std::exchange(other.locked, false);
-        return *this;
-    }
-
-    int lock() noexcept
+    ~sample_data_guard() noexcept
     {
-        if(ptr == nullptr || locked)
-        {
-            return 0;
-        }
-
-        int result = fluid_mlock(ptr, size);
-
-        if(result == 0)
+        for(auto &sample : samples)
         {
-            locked = true;
-        }
-
-        return result;
-    }
-
-    void unlock() noexcept
-    {
-        if(ptr == nullptr || !locked)
-        {
-            return;
+            if(sample.data != nullptr)
+            {
+                unload_sample_data(sample);
+            }
         }
-
-        fluid_munlock(ptr, size);
-        locked = false;
-    }
-
-    ~mlock_guard() noexcept
-    {
-        unlock();
     }
 
 private:
-    void *ptr;
-    fluid_long_long_t size;
-    bool locked;
+    std::vector<fluid_sample_t> &samples;
 };
 
 // fluid_sfloader_t interface
@@ -232,6 +200,10 @@ static int fluid_dls_preset_get_banknum(fluid_preset_t *preset) noexcept;
 static int fluid_dls_preset_get_num(fluid_preset_t *preset) noexcept;
 static int fluid_dls_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int chan, int key, int vel) noexcept;
 static void fluid_dls_preset_free(fluid_preset_t *preset) noexcept;
+static int fluid_dls_preset_notify(fluid_preset_t *preset, int reason, int chan) noexcept;
+
+// fluid_sample_t interface
+static int fluid_dls_sample_notify(fluid_sample_t *sample, int reason) noexcept;
 
 // internal struct for keeping some nice information of the DLS
 
@@ -310,8 +282,14 @@ struct fluid_dls_sample
 
     std::string name;
     unsigned samplerate;
-    unsigned start;
-    unsigned end; // past the end
+    unsigned frames;
+
+    // The sample data is only read when it is loaded into the sample cache
+    fluid_long_long_t wave_offset; // offset of the LIST[wave] chunk, identifies the sample in the cache
+    fluid_long_long_t data_offset; // offset of the PCM data
+    uint16_t bits_per_sample;
+    bool sndfile;                  // the data has to be decoded by libsndfile instead
+
     std::optional<fluid_dls_wsmp> wsmp;
 };
 
@@ -366,6 +344,7 @@ struct fluid_dls_instrument_fluid_data
 
     fluid_preset_t fluid{};           // its user data is `this` (fluid_dls_instrument_fluid_data*)
     fluid_dls_instrument *instrument; // backing instrument
+    bool pinned{};                    // samples pinned with dynamic sample loading?
 };
 
 struct DLSID;
@@ -398,11 +377,13 @@ struct fluid_dls_font
     fluid_long_long_t pgaloffset{};
     fluid_long_long_t pgalsize{};
 
-    // this MUST NOT be modified after initialization, because of probable mlock
-    std::vector<int16_t> sampledata;
-    mlock_guard sampledata_mlock;
+    bool try_mlock;
+    bool sample_dedup;    // share sample data with identical samples of other fonts
+    bool dynamic_samples; // load the sample data of presets only when they are selected
+
     std::vector<uint32_t> poolcues; // data of ptbl
 
+    // kept after initialization to load the sample data on demand, same indices as samples_fluid
     std::vector<fluid_dls_sample> samples;
     // this MUST NOT be modified after initialization, because of instrument.articulations pointer
     std::vector<fluid_dls_articulation> articulations;
@@ -412,6 +393,7 @@ struct fluid_dls_font
     std::vector<fluid_dls_instrument_fluid_data> instruments_fluid_data;
     // this MUST NOT be modified after initialization, because of instrument.samples_fluid pointer
     std::vector<fluid_sample_t> samples_fluid;
+    sample_data_guard samples_fluid_data{ samples_fluid };
 
     // for 'pgal' chunk in MobileBAE DLS banks
     std::optional<std::array<uint8_t, 128>> drum_note_aliasing;
@@ -428,7 +410,9 @@ struct fluid_dls_font
                           const fluid_file_callbacks_t *fcbs,
                           const char *filename,
                           uint32_t output_sample_rate,
-                          bool try_mlock);
+                          bool try_mlock,
+                          bool sample_dedup,
+                          bool dynamic_samples);
 
     fluid_dls_font(const fluid_dls_font &) = delete;
     fluid_dls_font &operator=(const fluid_dls_font &) = delete;
@@ -474,6 +458,12 @@ struct fluid_dls_font
     // info
     inline std::string read_name_from_info_entries(fluid_long_long_t offset, uint32_t size);
 
+    // sample data
+    int read_sample_data(const fluid_dls_sample &sample, short **data) noexcept;
+    int load_sample_data(size_t index) noexcept;
+    int load_preset_samples(fluid_dls_instrument &instrument) noexcept;
+    int unload_preset_samples(fluid_dls_instrument &instrument) noexcept;
+
     // utilities
     void fseek(fluid_long_long_t pos, int whence)
     {
@@ -1459,8 +1449,11 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
                                const fluid_file_callbacks_t *fcbs_in,
                                const char *filename,
                                uint32_t output_sample_rate,
-                               bool try_mlock)
-    : synth(synth), sfont(sfont), fcbs(*fcbs_in), output_sample_rate(output_sample_rate), filename(filename)
+                               bool try_mlock,
+                               bool sample_dedup,
+                               bool dynamic_samples)
+    : synth(synth), sfont(sfont), fcbs(*fcbs_in), output_sample_rate(output_sample_rate), filename(filename),
+      try_mlock(try_mlock), sample_dedup(sample_dedup), dynamic_samples(dynamic_samples)
 {
     // Get basic file information
 
@@ -1662,23 +1655,7 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
         std::throw_with_nested(std::runtime_error{ "Exception thrown while parsing samples" });
     }
 
-    // reading sample data is now completed
-
-    FLUID_LOG(FLUID_DBG, "DLS %zu samples read, %zu bytes", samples.size(), sampledata.size());
-
-    sampledata_mlock = mlock_guard{ sampledata.data(), static_cast<fluid_long_long_t>(sampledata.size()) };
-
-    if(try_mlock && !sampledata.empty())
-    {
-        if(sampledata_mlock.lock() != 0)
-        {
-            FLUID_LOG(FLUID_WARN, "Failed to pin the sample data to RAM; swapping is possible.");
-        }
-        else
-        {
-            FLUID_LOG(FLUID_DBG, "Sample data pinned to RAM, %zu bytes", sampledata.size());
-        }
-    }
+    FLUID_LOG(FLUID_DBG, "DLS %zu samples found", samples.size());
 
     // Parse LIST[lins]
     try
@@ -1727,9 +1704,10 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
     bool invalid_loops_were_sanitized = false;
     for(auto &sample : samples)
     {
+        // each sample gets its own buffer when its data is loaded
         auto& fluid = samples_fluid.emplace_back();
-        fluid.start = sample.start;
-        fluid.end = sample.end - 1;
+        fluid.start = 0;
+        fluid.end = sample.frames - 1;
         fluid.samplerate = sample.samplerate;
         std::strncpy(fluid.name, sample.name.c_str(), sizeof(fluid.name) - 1);
         fluid.name[sizeof(fluid.name) - 1] = '\0';
@@ -1737,11 +1715,16 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
         if(sample.wsmp.has_value())
         {
             const auto &wsmp = sample.wsmp.value();
-            fluid.loopstart = sample.start + wsmp.loop_start;
-            fluid.loopend = sample.start + wsmp.loop_start + wsmp.loop_length;
+            fluid.loopstart = wsmp.loop_start;
+            fluid.loopend = wsmp.loop_start + wsmp.loop_length;
             fluid.origpitch = wsmp.unity_note;
             fluid.pitchadj = wsmp.fine_tune;
-            invalid_loops_were_sanitized |= fluid_sample_sanitize_loop(&fluid, sampledata.size() * sizeof(decltype(sampledata)::value_type));
+
+            // empty samples are rejected by fluid_sample_validate() below
+            if(sample.frames > 0)
+            {
+                invalid_loops_were_sanitized |= fluid_sample_sanitize_loop(&fluid, sample.frames * sizeof(short));
+            }
         }
         else
         {
@@ -1751,11 +1734,12 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
             fluid.pitchadj = 0;
         }
 
-        fluid.data = sampledata.data();
+        fluid.data = nullptr;
         fluid.sampletype = FLUID_SAMPLETYPE_MONO;
         fluid.default_modulators = this->sfont->default_mod_list;
+        fluid.notify = dynamic_samples ? fluid_dls_sample_notify : nullptr;
 
-        if(fluid_sample_validate(&fluid, sampledata.size() * sizeof(decltype(sampledata)::value_type)) != FLUID_OK)
+        if(fluid_sample_validate(&fluid, sample.frames * sizeof(short)) != FLUID_OK)
         {
             fluid = {};
         }
@@ -1768,6 +1752,18 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
                   "start fluidsynth in verbose mode for detailed information.");
     }
 
+    // without dynamic sample loading, the data of all samples is loaded right away
+    if(!dynamic_samples)
+    {
+        for(size_t i = 0; i < samples_fluid.size(); i++)
+        {
+            if(samples_fluid[i].start != samples_fluid[i].end && load_sample_data(i) != FLUID_OK)
+            {
+                throw std::runtime_error{ string_format("Failed to load sample '%s'", samples_fluid[i].name) };
+            }
+        }
+    }
+
     // put info in dls_sample into region
     for(auto &instrument : instruments)
     {
@@ -1812,9 +1808,6 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
         }
     }
 
-    // now samples list can be cleared
-    samples.clear();
-
     std::sort(instruments.begin(),
               instruments.end(),
               [](const fluid_dls_instrument & lhs, const fluid_dls_instrument & rhs)
@@ -1870,7 +1863,7 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
         self_data.fluid.noteon = fluid_dls_preset_noteon;
         self_data.fluid.free = fluid_dls_preset_free;
         self_data.fluid.data = &self_data;
-        self_data.fluid.notify = nullptr;
+        self_data.fluid.notify = dynamic_samples ? fluid_dls_preset_notify : nullptr;
 
         for(auto &alias : instrument.aliases)
         {
@@ -1887,7 +1880,7 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
             alias_data.fluid.noteon = fluid_dls_preset_noteon;
             alias_data.fluid.free = fluid_dls_preset_free;
             alias_data.fluid.data = &alias_data;
-            alias_data.fluid.notify = nullptr;
+            alias_data.fluid.notify = dynamic_samples ? fluid_dls_preset_notify : nullptr;
         }
 
         // instrument.aliases is not used anymore, free it
@@ -2192,6 +2185,9 @@ inline void fluid_dls_font::parse_wave(fluid_long_long_t offset, fluid_dls_sampl
     uint16_t fmtTag{};
     uint16_t bitsPerSample{};
 
+    sample.wave_offset = offset;
+    sample.sndfile = false;
+
     visit_subchunks(offset, WAVE_FCC, [&](RIFFChunk subchunk, int headersize [[maybe_unused]], fluid_long_long_t pos)
     {
         switch(subchunk.id)
@@ -2274,31 +2270,15 @@ inline void fluid_dls_font::parse_wave(fluid_long_long_t offset, fluid_dls_sampl
                 throw std::runtime_error{ "DLS data chunk not align to bitsPerSample" };
             }
 
-            auto samplelen = subchunk.size / (bitsPerSample / 8);
-            sample.start = sampledata.size();
-            sample.end = sample.start + samplelen;
-            sampledata.resize(sampledata.size() + samplelen);
-
-            char buffer[4096];
-            uint32_t remaining = subchunk.size;
-            int16_t *destination = sampledata.data() + sample.start;
-
-            while(remaining > 0)
+            if(pos + headersize + subchunk.size > filesize)
             {
-                uint32_t c = remaining > sizeof(buffer) ? sizeof(buffer) : remaining;
-
-                if(fcbs.fread(buffer, c, file) != FLUID_OK)
-                {
-                    FLUID_LOG(FLUID_ERR, "fcbs::fread failed when reading DLS data chunk");
-                    throw std::exception{};
-                }
-
-                read_data_lpcm(destination, buffer, c, bitsPerSample);
-
-                destination += c / (bitsPerSample / 8);
-                remaining -= c;
+                throw std::runtime_error{ "DLS data chunk exceeds file size" };
             }
 
+            // the data is read when the sample is loaded
+            sample.frames = subchunk.size / (bitsPerSample / 8);
+            sample.data_offset = pos + headersize;
+            sample.bits_per_sample = bitsPerSample;
             break;
         }
 
@@ -2981,21 +2961,217 @@ inline void fluid_dls_font::parse_wave_sndfile(fluid_long_long_t offset, fluid_d
                                                 sfinfo.channels) };
     }
 
-    sample.start = sampledata.size();
-    sample.end = sample.start + sfinfo.frames;
-    sampledata.resize(sampledata.size() + sfinfo.frames);
-
-    auto count = sf_read_short(sndfile, sampledata.data() + sample.start, sfinfo.frames);
+    sf_close(sndfile);
 
-    if(count != sfinfo.frames)
+    if(sfinfo.frames < 0 || sfinfo.frames > std::numeric_limits<int>::max())
     {
-        FLUID_LOG(FLUID_WARN, "Read 'wave' using libsndfile reached unexpected EOF");
+        throw std::runtime_error{ "Unsupported wave length (libsndfile)" };
     }
 
-    sf_close(sndfile);
+    // the data is decoded when the sample is loaded
+    sample.frames = static_cast<unsigned>(sfinfo.frames);
+    sample.sndfile = true;
 }
 #endif
 
+// Reads and converts the data of a sample to 16 bit, returns the sample count or -1 on error.
+int fluid_dls_font::read_sample_data(const fluid_dls_sample &sample, short **data) noexcept
+{
+    auto *destination = FLUID_ARRAY(short, sample.frames);
+
+    if(destination == nullptr)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return -1;
+    }
+
+    try
+    {
+#if LIBSNDFILE_SUPPORT
+        if(sample.sndfile)
+        {
+            RIFFChunk chunk;
+            fseek(sample.wave_offset, SEEK_SET);
+            READCHUNK(this, chunk);
+
+            sfvio_data vio_data{ this, sample.wave_offset, 0, chunk.size + 12 };
+            sfvio_seek(0, SEEK_SET, &vio_data);
+
+            SF_INFO sfinfo{};
+            auto *sndfile = sf_open_virtual(&sfvio, SFM_READ, &sfinfo, &vio_data);
+
+            if(sndfile == nullptr)
+            {
+                throw std::runtime_error{ string_format("Failed to open 'wave' chunk using libsndfile: %s",
+                                                        sf_strerror(sndfile)) };
+            }
+
+            auto count = sf_read_short(sndfile, destination, sample.frames);
+            sf_close(sndfile);
+
+            if(count != sample.frames)
+            {
+                FLUID_LOG(FLUID_WARN, "Read 'wave' using libsndfile reached unexpected EOF");
+                FLUID_MEMSET(destination + count, 0, (sample.frames - count) * sizeof(short));
+            }
+
+            *data = destination;
+            return sample.frames;
+        }
+#endif
+
+        char buffer[4096];
+        const unsigned bytes_per_sample = sample.bits_per_sample / 8;
+        fluid_long_long_t remaining = static_cast<fluid_long_long_t>(sample.frames) * bytes_per_sample;
+        short *pos = destination;
+
+        fseek(sample.data_offset, SEEK_SET);
+
+        while(remaining > 0)
+        {
+            uint32_t c = remaining > static_cast<fluid_long_long_t>(sizeof(buffer)) ? sizeof(buffer) : static_cast<uint32_t>(remaining);
+
+            if(fcbs.fread(buffer, c, file) != FLUID_OK)
+            {
+                throw std::runtime_error{ "fcbs::fread failed when reading DLS data chunk" };
+            }
+
+            read_data_lpcm(pos, buffer, c, sample.bits_per_sample);
+
+            pos += c / bytes_per_sample;
+            remaining -= c;
+        }
+    }
+    catch(const std::exception &exc)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to read the data of DLS sample '%s'", sample.name.c_str());
+        log_exception(FLUID_ERR, exc);
+        FLUID_FREE(destination);
+        return -1;
+    }
+
+    *data = destination;
+    return sample.frames;
+}
+
+struct fluid_dls_sample_read_data
+{
+    fluid_dls_font *font;
+    const fluid_dls_sample *sample;
+};
+
+// fluid_samplecache_read_func_t
+static int fluid_dls_sample_read(void *data, short **sample_data, char **sample_data24) noexcept
+{
+    auto *read_data = static_cast<fluid_dls_sample_read_data *>(data);
+
+    *sample_data24 = nullptr;
+    return read_data->font->read_sample_data(*read_data->sample, sample_data);
+}
+
+// Loads the data of a sample through the sample cache, so that all synths
+// loading the same file share it.
+int fluid_dls_font::load_sample_data(size_t index) noexcept
+{
+    const auto &sample = samples[index];
+    auto &fluid = samples_fluid[index];
+    fluid_dls_sample_read_data read_data{ this, &sample };
+    short *data{};
+    char *data24{};
+
+    // the wave chunk identifies the sample, DLS files are limited to 4 GB by RIFF
+    int count = fluid_samplecache_load_custom(filename.c_str(),
+                static_cast<unsigned int>(sample.wave_offset), sample.frames,
+                try_mlock && !sample_dedup, fluid_dls_sample_read, &read_data, &data, &data24);
+
+    if(count < 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(static_cast<unsigned>(count) != sample.frames)
+    {
+        FLUID_LOG(FLUID_ERR, "DLS sample '%s' has %d frames instead of %u", sample.name.c_str(), count, sample.frames);
+        fluid_samplecache_unload(data);
+        return FLUID_FAILED;
+    }
+
+    if(sample_dedup)
+    {
+        short *shared{};
+        char *shared24{};
+        int ret = fluid_samplededup_acquire(data, data24, count, fluid.loopstart, fluid.loopend, try_mlock,
+                                            &shared, &shared24);
+
+        // the data read from the file isn't needed anymore, either way
+        fluid_samplecache_unload(data);
+
+        if(ret != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+
+        data = shared;
+        data24 = shared24;
+    }
+
+    fluid.data = data;
+    fluid.data24 = data24;
+    return FLUID_OK;
+}
+
+// Loads the samples of an instrument that isn't used by any selected preset
+// yet. Samples that fail to load are disabled.
+int fluid_dls_font::load_preset_samples(fluid_dls_instrument &instrument) noexcept
+{
+    for(const auto &region : instrument.regions)
+    {
+        auto &fluid = samples_fluid[region.sampleindex];
+
+        if(fluid.start == fluid.end)
+        {
+            continue;
+        }
+
+        fluid.preset_count++;
+
+        // The data is still there if a voice kept it from being unloaded
+        if(fluid.preset_count == 1 && fluid.data == nullptr
+                && load_sample_data(region.sampleindex) != FLUID_OK)
+        {
+            FLUID_LOG(FLUID_ERR, "Unable to load sample '%s', disabling", fluid.name);
+            fluid.start = fluid.end = 0;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+// Unloads the samples of an instrument that aren't used by any selected preset
+// anymore. Samples still in use by a voice are unloaded by fluid_dls_sample_notify().
+int fluid_dls_font::unload_preset_samples(fluid_dls_instrument &instrument) noexcept
+{
+    for(const auto &region : instrument.regions)
+    {
+        auto &fluid = samples_fluid[region.sampleindex];
+
+        if(fluid.start == fluid.end || fluid.preset_count == 0)
+        {
+            continue;
+        }
+
+        fluid.preset_count--;
+
+        if(fluid.preset_count == 0 && fluid.refcount == 0 && fluid.data != nullptr)
+        {
+            FLUID_LOG(FLUID_DBG, "Unloading sample '%s'", fluid.name);
+            unload_sample_data(fluid);
+        }
+    }
+
+    return FLUID_OK;
+}
+
 // fluid sfloader interfaces implementation
 
 struct fluid_dls_loader_data
@@ -3083,6 +3259,8 @@ static fluid_sfont_t *fluid_dls_loader_load(fluid_sfloader_t *loader, const char
 
     uint32_t sample_rate = 44100;
     bool try_mlock = false;
+    bool sample_dedup = false;
+    bool dynamic_samples = false;
     auto *sfloader_data = static_cast<fluid_dls_loader_data *>(fluid_sfloader_get_data(loader));
     auto *settings = sfloader_data->settings;
 
@@ -3101,10 +3279,24 @@ static fluid_sfont_t *fluid_dls_loader_load(fluid_sfloader_t *loader, const char
         {
             try_mlock = mlock != 0;
         }
+
+        int dedup{};
+
+        if(fluid_settings_getint(settings, "synth.sample-dedup", &dedup) == FLUID_OK)
+        {
+            sample_dedup = dedup != 0;
+        }
+
+        int dynamic{};
+
+        if(fluid_settings_getint(settings, "synth.dynamic-sample-loading", &dynamic) == FLUID_OK)
+        {
+            dynamic_samples = dynamic != 0;
+        }
     }
 
     auto *dlsfont =
-        new_fluid_dls_font(sfloader_data->synth, sfont, &loader->file_callbacks, filename, sample_rate, try_mlock);
+        new_fluid_dls_font(sfloader_data->synth, sfont, &loader->file_callbacks, filename, sample_rate, try_mlock, sample_dedup, dynamic_samples);
 
     if(dlsfont == nullptr)
     {
@@ -3290,8 +3482,10 @@ static int fluid_dls_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth,
     for(auto &region : dlspreset->regions)
     {
         auto *sample = dlspreset->samples_fluid + region.sampleindex;
-        // Check for zero-length samples, typically caused by samples that failed fluid_sample_validate()
-        if(!fluid_zone_inside_range(&region.range, tuned_key, vel) || sample->start == sample->end)
+        // Check for zero-length samples, typically caused by samples that failed fluid_sample_validate(),
+        // and for samples not loaded by dynamic sample loading
+        if(!fluid_zone_inside_range(&region.range, tuned_key, vel) || sample->start == sample->end
+                || sample->data == nullptr || fluid_synth_legato_ignores_zone(synth, chan, &region.range))
         {
             continue;
         }
@@ -3387,3 +3581,58 @@ static void fluid_dls_preset_free(fluid_preset_t *preset [[maybe_unused]]) noexc
 {
     // do nothing. presets are under RAII of fluid_dls_font
 }
+
+// Called if a preset has been selected for or unselected from a channel or
+// pinned. Used by dynamic sample loading to load and unload samples on demand.
+static int fluid_dls_preset_notify(fluid_preset_t *preset, int reason, int chan) noexcept
+{
+    auto *data = static_cast<fluid_dls_instrument_fluid_data *>(fluid_preset_get_data(preset));
+    auto *dlsfont = static_cast<fluid_dls_font *>(fluid_sfont_get_data(preset->sfont));
+
+    switch(reason)
+    {
+    case FLUID_PRESET_SELECTED:
+        FLUID_LOG(FLUID_DBG, "Selected preset '%s' on channel %d", fluid_preset_get_name(preset), chan);
+        return dlsfont->load_preset_samples(*data->instrument);
+
+    case FLUID_PRESET_UNSELECTED:
+        FLUID_LOG(FLUID_DBG, "Deselected preset '%s' from channel %d", fluid_preset_get_name(preset), chan);
+        return dlsfont->unload_preset_samples(*data->instrument);
+
+    case FLUID_PRESET_PIN:
+        if(data->pinned)
+        {
+            return FLUID_OK;
+        }
+
+        FLUID_LOG(FLUID_DBG, "Pinning preset '%s'", fluid_preset_get_name(preset));
+        data->pinned = true;
+        return dlsfont->load_preset_samples(*data->instrument);
+
+    case FLUID_PRESET_UNPIN:
+        if(!data->pinned)
+        {
+            return FLUID_OK;
+        }
+
+        FLUID_LOG(FLUID_DBG, "Unpinning preset '%s'", fluid_preset_get_name(preset));
+        data->pinned = false;
+        return dlsfont->unload_preset_samples(*data->instrument);
+
+    default:
+        return FLUID_OK;
+    }
+}
+
+// Called if a sample is no longer used by a voice. Used by dynamic sample loading
+// to unload a sample that couldn't be unloaded when its last preset was unselected.
+static int fluid_dls_sample_notify(fluid_sample_t *sample, int reason) noexcept
+{
+    if(reason == FLUID_SAMPLE_DONE && sample->preset_count == 0 && sample->data != nullptr)
+    {
+        FLUID_LOG(FLUID_DBG, "Unloading sample '%s'", sample->name);
+        unload_sample_data(*sample);
+    }
+
+    return FLUID_OK;
+}
@@ -23,12 +23,19 @@
 /* CACHED SAMPLE DATA LOADER
  *
  * This is a wrapper around fluid_sffile_read_sample_data that attempts to cache the read
- * data across all FluidSynth instances in a global (process-wide) list.
+ * data across all FluidSynth instances in a global (process-wide) table. Loaders of other
+ * file formats can share their sample data the same way, see fluid_samplecache_load_custom().
+ *
+ * Optionally, decoded Ogg Vorbis samples are additionally stored in a cache directory,
+ * so that later processes can map the decoded data instead of decoding it again.
+ * Sample data can also be published in named shared memory segments, which the
+ * other processes on the same host map instead of keeping their own copy.
  */
 
 #include "fluid_samplecache.h"
 #include "fluid_sys.h"
 #include "fluid_list.h"
+#include "fluid_hash.h"
 
 
 typedef struct _fluid_samplecache_entry_t fluid_samplecache_entry_t;
@@ -53,54 +60,263 @@ struct _fluid_samplecache_entry_t
 
     int num_references;
     int mlocked;
+
+    /* If not NULL, sample_data (and sample_data24) point into read-only
+     * mappings of the SoundFont file, a cache file or a shared memory segment
+     * instead of heap memory. A shared memory segment holds both in one mapping. */
+    void *map_base;
+    size_t map_size;
+    void *map24_base;
+    size_t map24_size;
+    int map_shm; /* map_base is a shared memory segment */
+
+    /* Neighbours in the LRU list, if the entry is unreferenced but kept for reuse */
+    fluid_samplecache_entry_t *lru_prev;
+    fluid_samplecache_entry_t *lru_next;
+    int in_lru;
+
+    /* Count of samplecache_evict() calls that took the entry from the LRU list,
+     * but haven't decided yet whether to delete it */
+    int evictors;
 };
 
-static fluid_list_t *samplecache_list = NULL;
-static fluid_mutex_t samplecache_mutex = FLUID_MUTEX_INIT;
+/* Header of a file in the on-disk cache of decoded samples or of a shared
+ * memory segment. It is followed by the SoundFont filename and padding up to
+ * header_size, then sample_count 16-bit samples in native byte order and
+ * data24_count bytes of 24-bit data. Cache files never contain 24-bit data. */
+typedef struct _fluid_samplecache_file_header_t
+{
+    char magic[8];
+    unsigned int version; /* also rejects files written with a different byte order */
+    unsigned int header_size;
+    fluid_long_long_t modification_time;
+    unsigned int sf_samplepos;
+    unsigned int sf_samplesize;
+    unsigned int sf_sample24pos;
+    unsigned int sf_sample24size;
+    unsigned int sample_start;
+    unsigned int sample_end;
+    int sample_type;
+    int sample_count;
+    unsigned int filename_length;
+    unsigned int data24_count; /* either 0 or sample_count */
+} fluid_samplecache_file_header_t;
+
+#define SAMPLECACHE_FILE_MAGIC "FLUIDPCM"
+#define SAMPLECACHE_FILE_VERSION 1
+#define SAMPLECACHE_FILE_ALIGN 16
+
+/* Prefix of the names of shared memory segments */
+#define SAMPLECACHE_SHM_PREFIX "/fluidsynth-"
 
-static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf, unsigned int sample_start,
-        unsigned int sample_end, int sample_type, time_t mtime);
-static fluid_samplecache_entry_t *get_samplecache_entry(SFData *sf, unsigned int sample_start,
-        unsigned int sample_end, int sample_type, time_t mtime);
+/* The entries are indexed by their cache key in a number of hash tables, each
+ * protected by its own mutex, so that different SoundFonts can be loaded in
+ * parallel. The mutexes are statically initialized (zeroed) like FLUID_MUTEX_INIT. */
+#define SAMPLECACHE_SHARDS 16
+
+typedef struct
+{
+    fluid_mutex_t mutex;
+    fluid_hashtable_t *entries; /* entry -> entry, hashed and compared by cache key */
+} fluid_samplecache_shard_t;
+
+static fluid_samplecache_shard_t samplecache_shards[SAMPLECACHE_SHARDS];
+
+/* Maps sample data pointers to their entries, for fluid_samplecache_unload() */
+static fluid_hashtable_t *samplecache_data_index = NULL;
+static fluid_mutex_t samplecache_data_mutex = FLUID_MUTEX_INIT;
+
+/* Unreferenced entries, kept as long as their total size fits into
+ * samplecache_max_unused_size. Least recently used first.
+ * If both are needed, a shard mutex is always locked before samplecache_lru_mutex. */
+static fluid_samplecache_entry_t *samplecache_lru_head = NULL;
+static fluid_samplecache_entry_t *samplecache_lru_tail = NULL;
+static fluid_long_long_t samplecache_lru_size = 0;
+static fluid_long_long_t samplecache_max_unused_size = 0;
+static fluid_mutex_t samplecache_lru_mutex = FLUID_MUTEX_INIT;
+
+/* Fills a new entry with its sample data. Returns FLUID_OK or FLUID_FAILED. */
+typedef int (*samplecache_fill_func_t)(fluid_samplecache_entry_t *entry, void *data);
+
+/* fill data of entries read from SoundFont files */
+typedef struct
+{
+    SFData *sf;
+    int try_mmap;
+    int try_shm;
+    const char *cache_dir;
+} samplecache_sffile_t;
+
+/* fill data of entries read by fluid_samplecache_load_custom() */
+typedef struct
+{
+    fluid_samplecache_read_func_t read;
+    void *data;
+} samplecache_custom_t;
+
+static int samplecache_load(const fluid_samplecache_entry_t *key, int try_mlock,
+                            samplecache_fill_func_t fill, void *fill_data,
+                            short **sample_data, char **sample_data24);
+static int samplecache_fill_sffile(fluid_samplecache_entry_t *entry, void *data);
+static int samplecache_fill_custom(fluid_samplecache_entry_t *entry, void *data);
+
+static fluid_samplecache_entry_t *new_samplecache_entry(const fluid_samplecache_entry_t *key,
+        samplecache_fill_func_t fill, void *fill_data);
+static fluid_samplecache_entry_t *get_samplecache_entry(fluid_samplecache_shard_t *shard,
+        const fluid_samplecache_entry_t *key);
+static int insert_samplecache_entry(fluid_samplecache_shard_t *shard, fluid_samplecache_entry_t *entry);
+static void remove_samplecache_entry(fluid_samplecache_shard_t *shard, fluid_samplecache_entry_t *entry);
+static fluid_samplecache_entry_t *find_samplecache_entry(const short *sample_data);
 static void delete_samplecache_entry(fluid_samplecache_entry_t *entry);
 
-static int fluid_get_file_modification_time(char *filename, time_t *modification_time);
+static unsigned int samplecache_entry_hash(const void *v);
+static int samplecache_entry_equal(const void *a, const void *b);
+static fluid_samplecache_shard_t *samplecache_entry_shard(const fluid_samplecache_entry_t *entry);
+
+static int fluid_get_file_modification_time(const char *filename, time_t *modification_time);
+static int map_samplecache_entry(fluid_samplecache_entry_t *entry, SFData *sf);
+static int load_samplecache_file(fluid_samplecache_entry_t *entry, const char *cache_dir);
+static void save_samplecache_file(const fluid_samplecache_entry_t *entry, const char *cache_dir);
+static char *samplecache_shm_name(const fluid_samplecache_entry_t *entry);
+static int use_samplecache_shm(fluid_samplecache_entry_t *entry, char *base, size_t size);
+static int load_samplecache_shm(fluid_samplecache_entry_t *entry);
+static void save_samplecache_shm(fluid_samplecache_entry_t *entry);
+
+static fluid_long_long_t samplecache_entry_size(const fluid_samplecache_entry_t *entry);
+static void samplecache_lru_remove(fluid_samplecache_entry_t *entry);
+static void samplecache_lru_append(fluid_samplecache_entry_t *entry);
+static void samplecache_evict(void);
 
 
 /* PUBLIC INTERFACE */
 
 int fluid_samplecache_load(SFData *sf,
                            unsigned int sample_start, unsigned int sample_end, int sample_type,
-                           int try_mlock, short **sample_data, char **sample_data24)
+                           int try_mlock, int try_mmap, int try_shm, const char *cache_dir,
+                           short **sample_data, char **sample_data24)
 {
-    fluid_samplecache_entry_t *entry;
+    fluid_samplecache_entry_t key;
+    samplecache_sffile_t fill_data;
+
+    FLUID_MEMSET(&key, 0, sizeof(key));
+    key.filename = sf->fname;
+    key.sf_samplepos = sf->samplepos;
+    key.sf_samplesize = sf->samplesize;
+    key.sf_sample24pos = sf->sample24pos;
+    key.sf_sample24size = sf->sample24size;
+    key.sample_start = sample_start;
+    key.sample_end = sample_end;
+    key.sample_type = sample_type;
+
+    fill_data.sf = sf;
+    fill_data.try_mmap = try_mmap;
+    fill_data.try_shm = try_shm;
+    fill_data.cache_dir = cache_dir;
+
+    return samplecache_load(&key, try_mlock, samplecache_fill_sffile, &fill_data, sample_data, sample_data24);
+}
+
+/* Like fluid_samplecache_load(), for sample data that isn't read from a
+ * SoundFont file. The data is identified by the file it is read from and two
+ * numbers of the caller's choice, usually the position of the sample in the
+ * file. read is only called if the data isn't in the cache yet, it has to
+ * allocate the data with FLUID_ARRAY() and return the sample count, or -1 on
+ * error. */
+int fluid_samplecache_load_custom(const char *filename,
+                                  unsigned int sample_start, unsigned int sample_end,
+                                  int try_mlock, fluid_samplecache_read_func_t read, void *read_data,
+                                  short **sample_data, char **sample_data24)
+{
+    fluid_samplecache_entry_t key;
+    samplecache_custom_t fill_data;
     int ret;
-    time_t mtime;
 
-    fluid_mutex_lock(samplecache_mutex);
+    FLUID_MEMSET(&key, 0, sizeof(key));
+    key.filename = FLUID_STRDUP(filename);
 
-    if(fluid_get_file_modification_time(sf->fname, &mtime) == FLUID_FAILED)
+    if(key.filename == NULL)
     {
-        mtime = 0;
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return -1;
     }
 
-    entry = get_samplecache_entry(sf, sample_start, sample_end, sample_type, mtime);
+    key.sample_start = sample_start;
+    key.sample_end = sample_end;
+
+    fill_data.read = read;
+    fill_data.data = read_data;
+
+    ret = samplecache_load(&key, try_mlock, samplecache_fill_custom, &fill_data, sample_data, sample_data24);
+
+    FLUID_FREE(key.filename);
+    return ret;
+}
+
+/* Looks up the entry with the given key and takes a reference to it. If there
+ * is no such entry, a new one is created and filled. */
+static int samplecache_load(const fluid_samplecache_entry_t *key_in, int try_mlock,
+                            samplecache_fill_func_t fill, void *fill_data,
+                            short **sample_data, char **sample_data24)
+{
+    fluid_samplecache_entry_t key = *key_in;
+    fluid_samplecache_entry_t *entry, *new_entry = NULL;
+    fluid_samplecache_shard_t *shard;
+
+    if(fluid_get_file_modification_time(key.filename, &key.modification_time) == FLUID_FAILED)
+    {
+        key.modification_time = 0;
+    }
+
+    shard = samplecache_entry_shard(&key);
+
+    fluid_mutex_lock(shard->mutex);
+    entry = get_samplecache_entry(shard, &key);
 
     if(entry == NULL)
     {
-        fluid_mutex_unlock(samplecache_mutex);
-        entry = new_samplecache_entry(sf, sample_start, sample_end, sample_type, mtime);
+        /* Don't block loading other samples of this shard while reading the data */
+        fluid_mutex_unlock(shard->mutex);
+        new_entry = new_samplecache_entry(&key, fill, fill_data);
+
+        if(new_entry == NULL)
+        {
+            return -1;
+        }
+
+        fluid_mutex_lock(shard->mutex);
+
+        /* Another thread might have loaded the same sample meanwhile */
+        entry = get_samplecache_entry(shard, &key);
 
         if(entry == NULL)
         {
-            ret = -1;
-            goto unlock_exit;
+            if(insert_samplecache_entry(shard, new_entry) == FLUID_FAILED)
+            {
+                fluid_mutex_unlock(shard->mutex);
+                delete_samplecache_entry(new_entry);
+                return -1;
+            }
+
+            entry = new_entry;
+            new_entry = NULL;
+        }
+    }
+
+    if(entry->num_references == 0)
+    {
+        /* Reuse sample data that has been kept after it was unloaded */
+        fluid_mutex_lock(samplecache_lru_mutex);
+
+        if(entry->in_lru)
+        {
+            samplecache_lru_remove(entry);
         }
 
-        fluid_mutex_lock(samplecache_mutex);
-        samplecache_list = fluid_list_prepend(samplecache_list, entry);
+        fluid_mutex_unlock(samplecache_lru_mutex);
     }
-        fluid_mutex_unlock(samplecache_mutex);
+
+    /* Take the reference while holding the lock, so that the entry cannot be evicted meanwhile */
+    entry->num_references++;
 
     if(try_mlock && !entry->mlocked)
     {
@@ -125,71 +341,125 @@ int fluid_samplecache_load(SFData *sf,
         }
     }
 
-    entry->num_references++;
+    fluid_mutex_unlock(shard->mutex);
+
+    /* lost the race, drop the duplicate */
+    delete_samplecache_entry(new_entry);
+
     *sample_data = entry->sample_data;
     *sample_data24 = entry->sample_data24;
-    ret = entry->sample_count;
-
-unlock_exit:
-    return ret;
+    return entry->sample_count;
 }
 
+/* Drops a reference to sample data. Unreferenced sample data is kept for reuse,
+ * see fluid_samplecache_set_size(). */
 int fluid_samplecache_unload(const short *sample_data)
 {
-    fluid_list_t *entry_list;
     fluid_samplecache_entry_t *entry;
-    int ret;
+    fluid_samplecache_shard_t *shard;
 
-    fluid_mutex_lock(samplecache_mutex);
+    /* The caller's reference keeps the entry alive after it has been found */
+    entry = find_samplecache_entry(sample_data);
 
-    entry_list = samplecache_list;
-
-    while(entry_list)
+    if(entry == NULL)
     {
-        entry = (fluid_samplecache_entry_t *)fluid_list_get(entry_list);
+        FLUID_LOG(FLUID_ERR, "Trying to free sample data not found in cache.");
+        return FLUID_FAILED;
+    }
+
+    shard = samplecache_entry_shard(entry);
+    fluid_mutex_lock(shard->mutex);
+
+    entry->num_references--;
 
-        if(sample_data == entry->sample_data)
+    if(entry->num_references == 0)
+    {
+        if(entry->mlocked)
         {
-            entry->num_references--;
+            fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
 
-            if(entry->num_references == 0)
+            if(entry->sample_data24 != NULL)
             {
-                if(entry->mlocked)
-                {
-                    fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
-
-                    if(entry->sample_data24 != NULL)
-                    {
-                        fluid_munlock(entry->sample_data24, entry->sample_count);
-                    }
-                }
-
-                samplecache_list = fluid_list_remove(samplecache_list, entry);
-                delete_samplecache_entry(entry);
+                fluid_munlock(entry->sample_data24, entry->sample_count);
             }
 
-            ret = FLUID_OK;
-            goto unlock_exit;
+            entry->mlocked = FALSE;
         }
 
-        entry_list = fluid_list_next(entry_list);
+        fluid_mutex_lock(samplecache_lru_mutex);
+        samplecache_lru_append(entry);
+        fluid_mutex_unlock(samplecache_lru_mutex);
     }
 
-    FLUID_LOG(FLUID_ERR, "Trying to free sample data not found in cache.");
-    ret = FLUID_FAILED;
+    fluid_mutex_unlock(shard->mutex);
 
-unlock_exit:
-    fluid_mutex_unlock(samplecache_mutex);
-    return ret;
+    samplecache_evict();
+    return FLUID_OK;
+}
+
+/* Takes another reference to sample data returned by fluid_samplecache_load(),
+ * to be dropped with fluid_samplecache_unload(). */
+int fluid_samplecache_ref(const short *sample_data)
+{
+    fluid_samplecache_entry_t *entry;
+    fluid_samplecache_shard_t *shard;
+
+    /* The caller's reference keeps the entry alive after it has been found */
+    entry = find_samplecache_entry(sample_data);
+
+    if(entry == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    shard = samplecache_entry_shard(entry);
+    fluid_mutex_lock(shard->mutex);
+    entry->num_references++;
+    fluid_mutex_unlock(shard->mutex);
+
+    return FLUID_OK;
+}
+
+/* Sets the maximum total size in bytes of the sample data that is kept in the
+ * cache after it has been unloaded, so that loading it again doesn't have to
+ * touch the disk. Least recently used data is evicted first, 0 disables keeping
+ * unloaded data. The cache is shared by the whole process. */
+void fluid_samplecache_set_size(fluid_long_long_t size)
+{
+    fluid_mutex_lock(samplecache_lru_mutex);
+    samplecache_max_unused_size = size;
+    fluid_mutex_unlock(samplecache_lru_mutex);
+
+    samplecache_evict();
+}
+
+/* Like fluid_samplecache_set_size(), but only ever enlarges the cache, so that
+ * the largest size requested by any SoundFont applies. */
+void fluid_samplecache_grow_size(fluid_long_long_t size)
+{
+    fluid_mutex_lock(samplecache_lru_mutex);
+
+    if(size > samplecache_max_unused_size)
+    {
+        samplecache_max_unused_size = size;
+    }
+
+    fluid_mutex_unlock(samplecache_lru_mutex);
+}
+
+/* Returns TRUE if the sample data is mapped from a file rather than held in memory */
+int fluid_samplecache_is_mapped(const short *sample_data)
+{
+    fluid_samplecache_entry_t *entry = find_samplecache_entry(sample_data);
+
+    /* map_base never changes during the lifetime of an entry */
+    return (entry != NULL && entry->map_base != NULL);
 }
 
 
 /* Private functions */
-static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf,
-        unsigned int sample_start,
-        unsigned int sample_end,
-        int sample_type,
-        time_t mtime)
+static fluid_samplecache_entry_t *new_samplecache_entry(const fluid_samplecache_entry_t *key,
+        samplecache_fill_func_t fill, void *fill_data)
 {
     fluid_samplecache_entry_t *entry;
 
@@ -201,9 +471,18 @@ static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf,
         return NULL;
     }
 
+    /* copy the key members, the rest is zeroed */
     FLUID_MEMSET(entry, 0, sizeof(*entry));
+    entry->modification_time = key->modification_time;
+    entry->sf_samplepos = key->sf_samplepos;
+    entry->sf_samplesize = key->sf_samplesize;
+    entry->sf_sample24pos = key->sf_sample24pos;
+    entry->sf_sample24size = key->sf_sample24size;
+    entry->sample_start = key->sample_start;
+    entry->sample_end = key->sample_end;
+    entry->sample_type = key->sample_type;
 
-    entry->filename = FLUID_STRDUP(sf->fname);
+    entry->filename = FLUID_STRDUP(key->filename);
 
     if(entry->filename == NULL)
     {
@@ -211,19 +490,7 @@ static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf,
         goto error_exit;
     }
 
-    entry->sf_samplepos = sf->samplepos;
-    entry->sf_samplesize = sf->samplesize;
-    entry->sf_sample24pos = sf->sample24pos;
-    entry->sf_sample24size = sf->sample24size;
-    entry->sample_start = sample_start;
-    entry->sample_end = sample_end;
-    entry->sample_type = sample_type;
-    entry->modification_time = mtime;
-
-    entry->sample_count = fluid_sffile_read_sample_data(sf, sample_start, sample_end, sample_type,
-                          &entry->sample_data, &entry->sample_data24);
-
-    if(entry->sample_count < 0)
+    if(fill(entry, fill_data) == FLUID_FAILED)
     {
         goto error_exit;
     }
@@ -235,51 +502,702 @@ error_exit:
     return NULL;
 }
 
+static int samplecache_fill_sffile(fluid_samplecache_entry_t *entry, void *data)
+{
+    samplecache_sffile_t *fill_data = data;
+    SFData *sf = fill_data->sf;
+    const char *cache_dir = fill_data->cache_dir;
+    int sample_type = entry->sample_type;
+
+    /* Uncompressed SF2 sample data is little-endian 16 bit, i.e. it can be
+     * used directly from the file on little-endian machines */
+    if(fill_data->try_mmap && !(sample_type & FLUID_SAMPLETYPE_OGG_VORBIS) && !FLUID_IS_BIG_ENDIAN
+            && fluid_sfont_uses_default_fopen(sf->fcbs)
+            && map_samplecache_entry(entry, sf) == FLUID_OK)
+    {
+        return FLUID_OK;
+    }
+
+    /* Another process on this host might have loaded the data already */
+    if(fill_data->try_shm && load_samplecache_shm(entry) == FLUID_OK)
+    {
+        return FLUID_OK;
+    }
+
+    /* Decoding compressed samples is expensive, try to reuse the result of an earlier run */
+    if(cache_dir != NULL && (sample_type & FLUID_SAMPLETYPE_OGG_VORBIS)
+            && load_samplecache_file(entry, cache_dir) == FLUID_OK)
+    {
+        return FLUID_OK;
+    }
+
+    entry->sample_count = fluid_sffile_read_sample_data(sf, entry->sample_start, entry->sample_end, sample_type,
+                          &entry->sample_data, &entry->sample_data24);
+
+    if(entry->sample_count < 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(cache_dir != NULL && (sample_type & FLUID_SAMPLETYPE_OGG_VORBIS) && entry->sample_count > 0)
+    {
+        save_samplecache_file(entry, cache_dir);
+    }
+
+    if(fill_data->try_shm && entry->sample_count > 0)
+    {
+        save_samplecache_shm(entry);
+    }
+
+    return FLUID_OK;
+}
+
+static int samplecache_fill_custom(fluid_samplecache_entry_t *entry, void *data)
+{
+    samplecache_custom_t *fill_data = data;
+
+    entry->sample_count = fill_data->read(fill_data->data, &entry->sample_data, &entry->sample_data24);
+
+    return (entry->sample_count < 0) ? FLUID_FAILED : FLUID_OK;
+}
+
 static void delete_samplecache_entry(fluid_samplecache_entry_t *entry)
 {
     fluid_return_if_fail(entry != NULL);
 
     FLUID_FREE(entry->filename);
-    FLUID_FREE(entry->sample_data);
-    FLUID_FREE(entry->sample_data24);
+
+    if(entry->map_shm)
+    {
+        fluid_shm_unmap(entry->map_base);
+    }
+    else if(entry->map_base != NULL)
+    {
+        fluid_file_unmap(entry->map_base, entry->map_size);
+    }
+    else
+    {
+        FLUID_FREE(entry->sample_data);
+    }
+
+    if(entry->map24_base != NULL)
+    {
+        fluid_file_unmap(entry->map24_base, entry->map24_size);
+    }
+    else if(entry->map_base == NULL)
+    {
+        FLUID_FREE(entry->sample_data24);
+    }
+
     FLUID_FREE(entry);
 }
 
-static fluid_samplecache_entry_t *get_samplecache_entry(SFData *sf,
-        unsigned int sample_start,
-        unsigned int sample_end,
-        int sample_type,
-        time_t mtime)
+/* Let the entry point directly into a read-only mapping of the SoundFont file
+ * rather than reading the sample data into heap memory. Pages are loaded on
+ * first access and shared by all processes using the same file.
+ * Returns FLUID_OK on success, FLUID_FAILED if the caller should fall back to
+ * reading the data. */
+static int map_samplecache_entry(fluid_samplecache_entry_t *entry, SFData *sf)
 {
-    fluid_list_t *entry_list;
-    fluid_samplecache_entry_t *entry;
+    unsigned int start = entry->sample_start;
+    unsigned int end = entry->sample_end;
+    unsigned int num_samples;
+    short *data;
 
-    entry_list = samplecache_list;
+    if((end + 1) <= start || (sf->samplepos & 1)
+            || (start * sizeof(short) > sf->samplesize) || (end * sizeof(short) > sf->samplesize))
+    {
+        /* let fluid_sffile_read_sample_data() deal with it */
+        return FLUID_FAILED;
+    }
 
-    while(entry_list)
+    num_samples = (end + 1) - start;
+
+    data = fluid_file_map(sf->fname, (fluid_long_long_t)sf->samplepos + start * sizeof(short),
+                          num_samples * sizeof(short), &entry->map_base, &entry->map_size);
+
+    if(data == NULL)
     {
-        entry = (fluid_samplecache_entry_t *)fluid_list_get(entry_list);
+        return FLUID_FAILED;
+    }
+
+    /* 24-bit data is optional, see fluid_sffile_read_wav() */
+    if(sf->sample24pos && start <= sf->sample24size && end <= sf->sample24size)
+    {
+        entry->sample_data24 = fluid_file_map(sf->fname, (fluid_long_long_t)sf->sample24pos + start,
+                                              num_samples, &entry->map24_base, &entry->map24_size);
 
-        if((FLUID_STRCMP(sf->fname, entry->filename) == 0) &&
-                (mtime == entry->modification_time) &&
-                (sf->samplepos == entry->sf_samplepos) &&
-                (sf->samplesize == entry->sf_samplesize) &&
-                (sf->sample24pos == entry->sf_sample24pos) &&
-                (sf->sample24size == entry->sf_sample24size) &&
-                (sample_start == entry->sample_start) &&
-                (sample_end == entry->sample_end) &&
-                (sample_type == entry->sample_type))
+        if(entry->sample_data24 == NULL)
         {
-            return entry;
+            FLUID_LOG(FLUID_WARN, "Failed to map 24-bit sample data, using 16-bit only");
         }
+    }
 
-        entry_list = fluid_list_next(entry_list);
+    /* start reading the data in the background, pages are faulted in on demand anyway */
+    fluid_file_map_prefetch(data, num_samples * sizeof(short));
+
+    entry->sample_data = data;
+    entry->sample_count = num_samples;
+
+    return FLUID_OK;
+}
+
+/* Build the path of the cache file for an entry. The name is derived from a
+ * hash of the cache key, the full key is stored in the file header. */
+static char *samplecache_file_path(const fluid_samplecache_entry_t *entry, const char *cache_dir)
+{
+    unsigned int hash = samplecache_entry_hash(entry);
+    size_t len;
+    char *path;
+
+    len = FLUID_STRLEN(cache_dir) + 40;
+    path = FLUID_ARRAY(char, len);
+
+    if(path == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
     }
 
-    return NULL;
+    FLUID_SNPRINTF(path, len, "%s/%08x-%u-%u.pcm", cache_dir, hash, entry->sample_start, entry->sample_end);
+
+    return path;
+}
+
+static void samplecache_file_header_init(fluid_samplecache_file_header_t *header,
+        const fluid_samplecache_entry_t *entry)
+{
+    FLUID_MEMSET(header, 0, sizeof(*header));
+    FLUID_MEMCPY(header->magic, SAMPLECACHE_FILE_MAGIC, sizeof(header->magic));
+    header->version = SAMPLECACHE_FILE_VERSION;
+    header->filename_length = (unsigned int)FLUID_STRLEN(entry->filename);
+    header->header_size = sizeof(*header) + header->filename_length;
+    header->header_size += (SAMPLECACHE_FILE_ALIGN - header->header_size % SAMPLECACHE_FILE_ALIGN) % SAMPLECACHE_FILE_ALIGN;
+    header->modification_time = (fluid_long_long_t)entry->modification_time;
+    header->sf_samplepos = entry->sf_samplepos;
+    header->sf_samplesize = entry->sf_samplesize;
+    header->sf_sample24pos = entry->sf_sample24pos;
+    header->sf_sample24size = entry->sf_sample24size;
+    header->sample_start = entry->sample_start;
+    header->sample_end = entry->sample_end;
+    header->sample_type = entry->sample_type;
+    header->sample_count = entry->sample_count;
+}
+
+/* Fill the entry with decoded sample data from the cache directory, mapping it
+ * if possible. Returns FLUID_OK on success, FLUID_FAILED if there is no valid
+ * cache file for the entry. */
+static int load_samplecache_file(fluid_samplecache_entry_t *entry, const char *cache_dir)
+{
+    fluid_samplecache_file_header_t expected, header;
+    char *path = samplecache_file_path(entry, cache_dir);
+    char *filename = NULL;
+    short *data = NULL;
+    size_t data_size;
+    FILE *file;
+    int ret = FLUID_FAILED;
+
+    if(path == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    file = FLUID_FOPEN(path, "rb");
+
+    if(file == NULL)
+    {
+        FLUID_FREE(path);
+        return FLUID_FAILED;
+    }
+
+    samplecache_file_header_init(&expected, entry);
+
+    if(FLUID_FREAD(&header, sizeof(header), 1, file) != 1)
+    {
+        goto exit;
+    }
+
+    /* the sample count is the only thing not known upfront */
+    expected.sample_count = header.sample_count;
+
+    if(FLUID_MEMCMP(&header, &expected, sizeof(header)) != 0 || header.sample_count <= 0)
+    {
+        goto exit;
+    }
+
+    filename = FLUID_ARRAY(char, header.filename_length);
+
+    if(filename == NULL
+            || FLUID_FREAD(filename, 1, header.filename_length, file) != header.filename_length
+            || FLUID_MEMCMP(filename, entry->filename, header.filename_length) != 0)
+    {
+        goto exit;
+    }
+
+    data_size = (size_t)header.sample_count * sizeof(short);
+    data = fluid_file_map(path, header.header_size, data_size, &entry->map_base, &entry->map_size);
+
+    if(data == NULL)
+    {
+        /* no memory mapped files on this platform, read the data instead */
+        data = FLUID_ARRAY(short, header.sample_count);
+
+        if(data == NULL
+                || fluid_file_seek(file, header.header_size, SEEK_SET) != FLUID_OK
+                || FLUID_FREAD(data, sizeof(short), header.sample_count, file) != (size_t)header.sample_count)
+        {
+            FLUID_FREE(data);
+            goto exit;
+        }
+    }
+
+    FLUID_LOG(FLUID_DBG, "Using decoded sample data from '%s'", path);
+
+    entry->sample_data = data;
+    entry->sample_count = header.sample_count;
+    ret = FLUID_OK;
+
+exit:
+    FLUID_FCLOSE(file);
+    FLUID_FREE(filename);
+    FLUID_FREE(path);
+    return ret;
+}
+
+/* Store the decoded sample data of an entry in the cache directory. The file is
+ * written under a temporary name first, so that concurrent processes never see
+ * a partially written file. Failures are not fatal, the cache is best effort. */
+static void save_samplecache_file(const fluid_samplecache_entry_t *entry, const char *cache_dir)
+{
+    static const char padding[SAMPLECACHE_FILE_ALIGN] = { 0 };
+    fluid_samplecache_file_header_t header;
+    fluid_data_part_t parts[4];
+    char *path = samplecache_file_path(entry, cache_dir);
+
+    if(path == NULL)
+    {
+        return;
+    }
+
+    samplecache_file_header_init(&header, entry);
+
+    parts[0].data = &header;
+    parts[0].size = sizeof(header);
+    parts[1].data = entry->filename;
+    parts[1].size = header.filename_length;
+    parts[2].data = padding;
+    parts[2].size = header.header_size - sizeof(header) - header.filename_length;
+    parts[3].data = entry->sample_data;
+    parts[3].size = (size_t)entry->sample_count * sizeof(short);
+
+    if(fluid_file_write_parts(path, parts, (int)FLUID_N_ELEMENTS(parts)) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_DBG, "Unable to write sample cache file '%s'", path);
+    }
+
+    FLUID_FREE(path);
+}
+
+/* Build the name of the shared memory segment of an entry. Like the path of a
+ * cache file, the name is derived from a hash of the cache key. */
+static char *samplecache_shm_name(const fluid_samplecache_entry_t *entry)
+{
+    unsigned int hash = samplecache_entry_hash(entry);
+    size_t len = sizeof(SAMPLECACHE_SHM_PREFIX) + 40;
+    char *name = FLUID_ARRAY(char, len);
+
+    if(name == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_SNPRINTF(name, len, SAMPLECACHE_SHM_PREFIX "%08x-%u-%u", hash, entry->sample_start, entry->sample_end);
+
+    return name;
+}
+
+/* Let the entry use the sample data of a mapped shared memory segment, taking
+ * over the mapping. Returns FLUID_OK on success, FLUID_FAILED if the segment
+ * isn't valid for the entry. */
+static int use_samplecache_shm(fluid_samplecache_entry_t *entry, char *base, size_t size)
+{
+    fluid_samplecache_file_header_t expected;
+    const fluid_samplecache_file_header_t *header = (const fluid_samplecache_file_header_t *)base;
+    size_t data_size;
+
+    if(size < sizeof(*header))
+    {
+        return FLUID_FAILED;
+    }
+
+    samplecache_file_header_init(&expected, entry);
+
+    /* the sample count and whether there is 24-bit data are not known upfront */
+    expected.sample_count = header->sample_count;
+    expected.data24_count = header->data24_count;
+
+    if(FLUID_MEMCMP(header, &expected, sizeof(expected)) != 0 || header->sample_count <= 0
+            || (header->data24_count != 0 && header->data24_count != (unsigned int)header->sample_count))
+    {
+        return FLUID_FAILED;
+    }
+
+    data_size = (size_t)header->sample_count * sizeof(short);
+
+    if(size < header->header_size + data_size + header->data24_count
+            || FLUID_MEMCMP(base + sizeof(*header), entry->filename, header->filename_length) != 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    entry->sample_data = (short *)(base + header->header_size);
+    entry->sample_data24 = (header->data24_count > 0) ? base + header->header_size + data_size : NULL;
+    entry->sample_count = header->sample_count;
+    entry->map_base = base;
+    entry->map_size = size;
+    entry->map_shm = TRUE;
+
+    return FLUID_OK;
+}
+
+/* Fill the entry with a read-only mapping of the shared memory segment of
+ * another process. Returns FLUID_OK on success, FLUID_FAILED if there is no
+ * valid segment for the entry. */
+static int load_samplecache_shm(fluid_samplecache_entry_t *entry)
+{
+    char *name = samplecache_shm_name(entry);
+    char *base;
+    size_t size = 0;
+    int ret = FLUID_FAILED;
+
+    if(name == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    base = fluid_shm_map(name, &size);
+
+    if(base != NULL)
+    {
+        ret = use_samplecache_shm(entry, base, size);
+
+        if(ret == FLUID_OK)
+        {
+            FLUID_LOG(FLUID_DBG, "Using sample data of shared memory segment '%s'", name);
+        }
+        else
+        {
+            fluid_shm_unmap(base);
+        }
+    }
+
+    FLUID_FREE(name);
+    return ret;
+}
+
+/* Publish the sample data of an entry in a shared memory segment, and let the
+ * entry use a read-only mapping of the segment instead of its heap memory like
+ * the other processes do. Failures are not fatal, the entry keeps its heap
+ * memory then. */
+static void save_samplecache_shm(fluid_samplecache_entry_t *entry)
+{
+    static const char padding[SAMPLECACHE_FILE_ALIGN] = { 0 };
+    fluid_samplecache_file_header_t header;
+    fluid_data_part_t parts[5];
+    short *data = entry->sample_data;
+    char *data24 = entry->sample_data24;
+    char *name = samplecache_shm_name(entry);
+    char *base;
+    size_t size = 0;
+
+    if(name == NULL)
+    {
+        return;
+    }
+
+    samplecache_file_header_init(&header, entry);
+    header.data24_count = (data24 != NULL) ? (unsigned int)entry->sample_count : 0;
+
+    parts[0].data = &header;
+    parts[0].size = sizeof(header);
+    parts[1].data = entry->filename;
+    parts[1].size = header.filename_length;
+    parts[2].data = padding;
+    parts[2].size = header.header_size - sizeof(header) - header.filename_length;
+    parts[3].data = data;
+    parts[3].size = (size_t)entry->sample_count * sizeof(short);
+    parts[4].data = data24;
+    parts[4].size = header.data24_count;
+
+    base = fluid_shm_create(name, parts, (int)FLUID_N_ELEMENTS(parts), &size);
+
+    /* If another process was faster, use its segment. A segment that isn't
+     * valid for the entry, e.g. because its creator was killed while filling
+     * it, is replaced. */
+    if(base == NULL && load_samplecache_shm(entry) != FLUID_OK)
+    {
+        fluid_shm_unlink(name);
+        base = fluid_shm_create(name, parts, (int)FLUID_N_ELEMENTS(parts), &size);
+    }
+
+    if(base != NULL && use_samplecache_shm(entry, base, size) != FLUID_OK)
+    {
+        fluid_shm_unmap(base);
+    }
+
+    if(entry->map_shm)
+    {
+        FLUID_FREE(data);
+        FLUID_FREE(data24);
+    }
+
+    FLUID_FREE(name);
+}
+
+/* Hash of the cache key of an entry (FNV-1a) */
+static unsigned int samplecache_entry_hash(const void *v)
+{
+    const fluid_samplecache_entry_t *entry = v;
+    unsigned int key[8];
+
+    key[0] = (unsigned int)entry->modification_time;
+    key[1] = entry->sf_samplepos;
+    key[2] = entry->sf_samplesize;
+    key[3] = entry->sf_sample24pos;
+    key[4] = entry->sf_sample24size;
+    key[5] = entry->sample_start;
+    key[6] = entry->sample_end;
+    key[7] = (unsigned int)entry->sample_type;
+
+    return fluid_fnv1a(fluid_fnv1a_str(FLUID_FNV1A_INIT, entry->filename), key, sizeof(key));
+}
+
+static int samplecache_entry_equal(const void *a, const void *b)
+{
+    const fluid_samplecache_entry_t *entry_a = a;
+    const fluid_samplecache_entry_t *entry_b = b;
+
+    return (FLUID_STRCMP(entry_a->filename, entry_b->filename) == 0) &&
+           (entry_a->modification_time == entry_b->modification_time) &&
+           (entry_a->sf_samplepos == entry_b->sf_samplepos) &&
+           (entry_a->sf_samplesize == entry_b->sf_samplesize) &&
+           (entry_a->sf_sample24pos == entry_b->sf_sample24pos) &&
+           (entry_a->sf_sample24size == entry_b->sf_sample24size) &&
+           (entry_a->sample_start == entry_b->sample_start) &&
+           (entry_a->sample_end == entry_b->sample_end) &&
+           (entry_a->sample_type == entry_b->sample_type);
+}
+
+static fluid_samplecache_shard_t *samplecache_entry_shard(const fluid_samplecache_entry_t *entry)
+{
+    /* the low bits are used by the hash tables already */
+    return &samplecache_shards[(samplecache_entry_hash(entry) >> 24) % SAMPLECACHE_SHARDS];
+}
+
+/* Must be called with the shard mutex locked */
+static fluid_samplecache_entry_t *get_samplecache_entry(fluid_samplecache_shard_t *shard,
+        const fluid_samplecache_entry_t *key)
+{
+    if(shard->entries == NULL)
+    {
+        return NULL;
+    }
+
+    return fluid_hashtable_lookup(shard->entries, key);
+}
+
+/* Adds a new entry to its shard and the data index. Must be called with the shard mutex locked. */
+static int insert_samplecache_entry(fluid_samplecache_shard_t *shard, fluid_samplecache_entry_t *entry)
+{
+    if(shard->entries == NULL)
+    {
+        shard->entries = new_fluid_hashtable(samplecache_entry_hash, samplecache_entry_equal);
+
+        if(shard->entries == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+    }
+
+    fluid_mutex_lock(samplecache_data_mutex);
+
+    if(samplecache_data_index == NULL)
+    {
+        samplecache_data_index = new_fluid_hashtable(fluid_direct_hash, NULL);
+
+        if(samplecache_data_index == NULL)
+        {
+            fluid_mutex_unlock(samplecache_data_mutex);
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+    }
+
+    /* empty samples might not have any data */
+    if(entry->sample_data != NULL)
+    {
+        fluid_hashtable_insert(samplecache_data_index, entry->sample_data, entry);
+    }
+
+    fluid_mutex_unlock(samplecache_data_mutex);
+
+    fluid_hashtable_insert(shard->entries, entry, entry);
+    return FLUID_OK;
 }
 
-static int fluid_get_file_modification_time(char *filename, time_t *modification_time)
+/* Removes an entry from its shard and the data index, the tables are freed
+ * once they are empty. Must be called with the shard mutex locked. */
+static void remove_samplecache_entry(fluid_samplecache_shard_t *shard, fluid_samplecache_entry_t *entry)
+{
+    fluid_hashtable_remove(shard->entries, entry);
+
+    if(fluid_hashtable_size(shard->entries) == 0)
+    {
+        delete_fluid_hashtable(shard->entries);
+        shard->entries = NULL;
+    }
+
+    fluid_mutex_lock(samplecache_data_mutex);
+
+    if(entry->sample_data != NULL)
+    {
+        fluid_hashtable_remove(samplecache_data_index, entry->sample_data);
+    }
+
+    if(fluid_hashtable_size(samplecache_data_index) == 0)
+    {
+        delete_fluid_hashtable(samplecache_data_index);
+        samplecache_data_index = NULL;
+    }
+
+    fluid_mutex_unlock(samplecache_data_mutex);
+}
+
+static fluid_samplecache_entry_t *find_samplecache_entry(const short *sample_data)
+{
+    fluid_samplecache_entry_t *entry = NULL;
+
+    fluid_mutex_lock(samplecache_data_mutex);
+
+    if(samplecache_data_index != NULL)
+    {
+        entry = fluid_hashtable_lookup(samplecache_data_index, sample_data);
+    }
+
+    fluid_mutex_unlock(samplecache_data_mutex);
+    return entry;
+}
+static fluid_long_long_t samplecache_entry_size(const fluid_samplecache_entry_t *entry)
+{
+    fluid_long_long_t size = (fluid_long_long_t)entry->sample_count * sizeof(short);
+
+    if(entry->sample_data24 != NULL)
+    {
+        size += entry->sample_count;
+    }
+
+    return size;
+}
+
+static void samplecache_lru_append(fluid_samplecache_entry_t *entry)
+{
+    entry->lru_prev = samplecache_lru_tail;
+    entry->lru_next = NULL;
+
+    if(samplecache_lru_tail != NULL)
+    {
+        samplecache_lru_tail->lru_next = entry;
+    }
+    else
+    {
+        samplecache_lru_head = entry;
+    }
+
+    samplecache_lru_tail = entry;
+    samplecache_lru_size += samplecache_entry_size(entry);
+    entry->in_lru = TRUE;
+}
+
+static void samplecache_lru_remove(fluid_samplecache_entry_t *entry)
+{
+    if(entry->lru_prev != NULL)
+    {
+        entry->lru_prev->lru_next = entry->lru_next;
+    }
+    else
+    {
+        samplecache_lru_head = entry->lru_next;
+    }
+
+    if(entry->lru_next != NULL)
+    {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    }
+    else
+    {
+        samplecache_lru_tail = entry->lru_prev;
+    }
+
+    entry->lru_prev = entry->lru_next = NULL;
+    samplecache_lru_size -= samplecache_entry_size(entry);
+    entry->in_lru = FALSE;
+}
+
+/* Deletes the least recently used unreferenced entries until their total size
+ * fits into samplecache_max_unused_size.
+ *
+ * The shard mutex has to be locked before samplecache_lru_mutex, so the victim
+ * is taken from the LRU list first and only deleted after locking its shard,
+ * if it hasn't been loaded again or taken by another eviction meanwhile. */
+static void samplecache_evict(void)
+{
+    fluid_samplecache_entry_t *entry;
+    fluid_samplecache_shard_t *shard;
+    int delete_entry;
+
+    while(TRUE)
+    {
+        fluid_mutex_lock(samplecache_lru_mutex);
+
+        if(samplecache_lru_size <= samplecache_max_unused_size)
+        {
+            fluid_mutex_unlock(samplecache_lru_mutex);
+            break;
+        }
+
+        entry = samplecache_lru_head;
+        samplecache_lru_remove(entry);
+        entry->evictors++;
+
+        fluid_mutex_unlock(samplecache_lru_mutex);
+
+        /* The entry can't be deleted by anyone else as long as evictors is non-zero */
+        shard = samplecache_entry_shard(entry);
+        fluid_mutex_lock(shard->mutex);
+        fluid_mutex_lock(samplecache_lru_mutex);
+
+        entry->evictors--;
+        delete_entry = (entry->num_references == 0 && !entry->in_lru && entry->evictors == 0);
+
+        fluid_mutex_unlock(samplecache_lru_mutex);
+
+        if(delete_entry)
+        {
+            remove_samplecache_entry(shard, entry);
+        }
+
+        fluid_mutex_unlock(shard->mutex);
+
+        if(delete_entry)
+        {
+            delete_samplecache_entry(entry);
+        }
+    }
+}
+
+static int fluid_get_file_modification_time(const char *filename, time_t *modification_time)
 {
     fluid_stat_buf_t buf;
 
@@ -293,20 +1211,33 @@ static int fluid_get_file_modification_time(char *filename, time_t *modification
 }
 
 
+/* Only used for tests: returns the name of the shared memory segment that
+ * would hold the given sample data, to be freed with FLUID_FREE() */
+char *fluid_samplecache_get_shm_name(const short *sample_data)
+{
+    fluid_samplecache_entry_t *entry = find_samplecache_entry(sample_data);
+
+    fluid_return_val_if_fail(entry != NULL, NULL);
+
+    return samplecache_shm_name(entry);
+}
+
 /* Only used for tests */
 int fluid_samplecache_count_entries(void)
 {
-    fluid_list_t *entry;
-    int count = 0;
+    int i, count = 0;
 
-    fluid_mutex_lock(samplecache_mutex);
-
-    for(entry = samplecache_list; entry != NULL; entry = fluid_list_next(entry))
+    for(i = 0; i < SAMPLECACHE_SHARDS; i++)
     {
-        count++;
-    }
+        fluid_mutex_lock(samplecache_shards[i].mutex);
+
+        if(samplecache_shards[i].entries != NULL)
+        {
+            count += fluid_hashtable_size(samplecache_shards[i].entries);
+        }
 
-    fluid_mutex_unlock(samplecache_mutex);
+        fluid_mutex_unlock(samplecache_shards[i].mutex);
+    }
 
     return count;
 }
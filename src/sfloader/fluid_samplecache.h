@@ -24,13 +24,36 @@
 #include "fluid_sfont.h"
 #include "fluid_sffile.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 int fluid_samplecache_load(SFData *sf,
                            unsigned int sample_start, unsigned int sample_end, int sample_type,
-                           int try_mlock, short **data, char **data24);
+                           int try_mlock, int try_mmap, int try_shm, const char *cache_dir,
+                           short **data, char **data24);
+
+/* Reads sample data for fluid_samplecache_load_custom(), returns the sample count or -1 */
+typedef int (*fluid_samplecache_read_func_t)(void *data, short **sample_data, char **sample_data24);
+
+int fluid_samplecache_load_custom(const char *filename,
+                                  unsigned int sample_start, unsigned int sample_end,
+                                  int try_mlock, fluid_samplecache_read_func_t read, void *read_data,
+                                  short **sample_data, char **sample_data24);
 
+int fluid_samplecache_ref(const short *sample_data);
 int fluid_samplecache_unload(const short *sample_data);
+void fluid_samplecache_set_size(fluid_long_long_t size);
+void fluid_samplecache_grow_size(fluid_long_long_t size);
+
+int fluid_samplecache_is_mapped(const short *sample_data);
 
 /* Only used for tests */
 int fluid_samplecache_count_entries(void);
+char *fluid_samplecache_get_shm_name(const short *sample_data);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* _FLUID_SAMPLECACHE_H */
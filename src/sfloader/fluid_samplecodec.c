@@ -0,0 +1,686 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/* COMPRESSED SAMPLE DATA
+ *
+ * With synth.sample-compression, sample data is kept in memory losslessly
+ * compressed and decoded while the sample is playing. The data is split into
+ * blocks, which are compressed independently: every block is predicted by a
+ * fixed polynomial predictor of order 0 to 2, and the prediction residuals are
+ * stored Rice coded, with a Rice parameter per partition of the block.
+ *
+ * The decoded sample data lives in a memory region of the full sample size, of
+ * which only the decoded part is backed by physical memory. This way the
+ * interpolation reads the sample data like any other. The head of the sample
+ * is decoded when it is loaded and stays decoded. The rest is decoded block by
+ * block ahead of the playing voices by the synth's sample streaming thread, see
+ * fluid_rvoice_stream.c, so that rendering never waits for the decoder. Once a
+ * sample isn't played anymore, its decoded rest is kept for reuse until the
+ * decoded data of all samples exceeds synth.sample-compression-cache-size, the
+ * least recently decoded samples are discarded first.
+ */
+
+#include "fluid_samplecodec.h"
+#include "fluid_sys.h"
+
+/* Count of frames of a block */
+#define FLUID_SAMPLECODEC_BLOCK 4096
+
+/* Count of residuals sharing a Rice parameter */
+#define FLUID_SAMPLECODEC_PARTITION 256
+
+/* Largest Rice parameter, residuals of 16 bit data are below 2^19 */
+#define FLUID_SAMPLECODEC_MAX_RICE 19
+#define FLUID_SAMPLECODEC_RICE_BITS 5
+
+/* Size of the buffer a single block is compressed into. A block never takes
+ * more than a header and 20 bits per frame. */
+#define FLUID_SAMPLECODEC_BLOCK_BYTES (16 + FLUID_SAMPLECODEC_BLOCK * 3)
+
+struct _fluid_samplecodec_t
+{
+    unsigned char *packed;          /* compressed blocks */
+    unsigned int *block_offset;     /* offset of each block in packed, and the size of packed at the end */
+    unsigned int count;             /* count of frames */
+    unsigned int head;              /* count of frames at the start, that always stay decoded */
+
+    short *data;                    /* decoded sample data, reserved with fluid_mem_reserve() */
+    size_t data_size;
+    int mlocked;                    /* TRUE if the head is pinned to RAM */
+
+    fluid_atomic_int_t users;       /* count of playing voices reading the decoded data */
+    fluid_atomic_int_t references;  /* count of samples using the codec, see fluid_samplecodec_ref() */
+
+    /* Protected by samplecodec_mutex */
+    unsigned int decoded_end;       /* all frames before this are decoded */
+    fluid_samplecodec_t *lru_prev;  /* neighbours in the LRU list, if more than the head is decoded */
+    fluid_samplecodec_t *lru_next;
+    int in_lru;
+};
+
+typedef struct
+{
+    unsigned char *out;
+    unsigned int pos;
+    unsigned int acc;
+    int bits;
+} fluid_samplecodec_writer_t;
+
+typedef struct
+{
+    const unsigned char *in;
+    unsigned int pos;
+    unsigned int acc;
+    int bits;
+} fluid_samplecodec_reader_t;
+
+/* Samples whose data is decoded beyond their head, least recently decoded first */
+static fluid_samplecodec_t *samplecodec_lru_head = NULL;
+static fluid_samplecodec_t *samplecodec_lru_tail = NULL;
+/* Size in bytes of the data decoded beyond the heads */
+static fluid_long_long_t samplecodec_cached_size = 0;
+static fluid_long_long_t samplecodec_max_cached_size = 32 * 1024 * 1024;
+static fluid_mutex_t samplecodec_mutex = FLUID_MUTEX_INIT;
+
+static unsigned int samplecodec_encode_block(const short *data, unsigned int len, unsigned char *out);
+static void samplecodec_decode_block(const fluid_samplecodec_t *codec, unsigned int block, short *out);
+static void samplecodec_trim(const fluid_samplecodec_t *keep);
+static void samplecodec_lru_append(fluid_samplecodec_t *codec);
+static void samplecodec_lru_remove(fluid_samplecodec_t *codec);
+
+
+/* PUBLIC INTERFACE */
+
+/* Compresses count frames of sample data. The first head frames are decoded
+ * right away, the rest is decoded on demand by fluid_samplecodec_decode().
+ * The caller keeps ownership of data, the decoded data is returned in decoded.
+ * Returns NULL if out of memory or if the platform can't reserve memory for
+ * the decoded data, the sample data should be kept uncompressed then. */
+fluid_samplecodec_t *fluid_samplecodec_compress(const short *data, unsigned int count,
+        unsigned int head, int try_mlock, short **decoded)
+{
+    fluid_samplecodec_t *codec;
+    unsigned char *block_buf = NULL;
+    unsigned char *packed;
+    unsigned int block, block_count, len, size, capacity;
+
+    fluid_return_val_if_fail(data != NULL, NULL);
+    fluid_return_val_if_fail(count > 0, NULL);
+
+    codec = FLUID_NEW(fluid_samplecodec_t);
+
+    if(codec == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(codec, 0, sizeof(*codec));
+    fluid_atomic_int_set(&codec->references, 1);
+    codec->count = count;
+    codec->data_size = count * sizeof(short);
+    codec->data = fluid_mem_reserve(codec->data_size);
+
+    if(codec->data == NULL)
+    {
+        FLUID_FREE(codec);
+        return NULL;
+    }
+
+    block_count = (count + FLUID_SAMPLECODEC_BLOCK - 1) / FLUID_SAMPLECODEC_BLOCK;
+    codec->block_offset = FLUID_ARRAY(unsigned int, block_count + 1);
+    block_buf = FLUID_ARRAY(unsigned char, FLUID_SAMPLECODEC_BLOCK_BYTES);
+
+    /* Most samples compress to less than two thirds */
+    capacity = (unsigned int)(codec->data_size * 2 / 3) + FLUID_SAMPLECODEC_BLOCK_BYTES;
+    codec->packed = FLUID_ARRAY(unsigned char, capacity);
+
+    if(codec->block_offset == NULL || block_buf == NULL || codec->packed == NULL)
+    {
+        goto error_exit;
+    }
+
+    size = 0;
+
+    for(block = 0; block < block_count; block++)
+    {
+        len = count - block * FLUID_SAMPLECODEC_BLOCK;
+
+        if(len > FLUID_SAMPLECODEC_BLOCK)
+        {
+            len = FLUID_SAMPLECODEC_BLOCK;
+        }
+
+        len = samplecodec_encode_block(data + block * FLUID_SAMPLECODEC_BLOCK, len, block_buf);
+
+        if(size + len > capacity)
+        {
+            capacity = capacity * 3 / 2 + len;
+            packed = FLUID_REALLOC(codec->packed, capacity);
+
+            if(packed == NULL)
+            {
+                goto error_exit;
+            }
+
+            codec->packed = packed;
+        }
+
+        codec->block_offset[block] = size;
+        FLUID_MEMCPY(codec->packed + size, block_buf, len);
+        size += len;
+    }
+
+    codec->block_offset[block_count] = size;
+    FLUID_FREE(block_buf);
+
+    /* Give back the unused part of the buffer, failing to do so is harmless */
+    packed = FLUID_REALLOC(codec->packed, size);
+
+    if(packed != NULL)
+    {
+        codec->packed = packed;
+    }
+
+    /* The head is taken over from the uncompressed data, in whole blocks */
+    codec->head = (head + FLUID_SAMPLECODEC_BLOCK - 1) / FLUID_SAMPLECODEC_BLOCK * FLUID_SAMPLECODEC_BLOCK;
+
+    if(codec->head > count)
+    {
+        codec->head = count;
+    }
+
+    FLUID_MEMCPY(codec->data, data, codec->head * sizeof(short));
+    codec->decoded_end = codec->head;
+
+    if(try_mlock && codec->head > 0)
+    {
+        /* It's okay if this fails, the head may be paged out then */
+        codec->mlocked = (fluid_mlock(codec->data, codec->head * sizeof(short)) == 0);
+    }
+
+    *decoded = codec->data;
+    return codec;
+
+error_exit:
+    FLUID_LOG(FLUID_ERR, "Out of memory");
+    FLUID_FREE(block_buf);
+    fluid_samplecodec_free(codec);
+    return NULL;
+}
+
+/* Takes another reference to compressed sample data, for another sample with
+ * the same data. The data is freed by the last fluid_samplecodec_free(). */
+void fluid_samplecodec_ref(fluid_samplecodec_t *codec)
+{
+    fluid_return_if_fail(codec != NULL);
+
+    fluid_atomic_int_inc(&codec->references);
+}
+
+/* Drops a reference to compressed sample data and frees it along with its
+ * decoded data if it was the last one. No voice may use the sample anymore. */
+void fluid_samplecodec_free(fluid_samplecodec_t *codec)
+{
+    fluid_return_if_fail(codec != NULL);
+
+    if(!fluid_atomic_int_dec_and_test(&codec->references))
+    {
+        return;
+    }
+
+    fluid_mutex_lock(samplecodec_mutex);
+
+    if(codec->in_lru)
+    {
+        samplecodec_lru_remove(codec);
+    }
+
+    fluid_mutex_unlock(samplecodec_mutex);
+
+    if(codec->mlocked)
+    {
+        fluid_munlock(codec->data, codec->head * sizeof(short));
+    }
+
+    fluid_mem_unreserve(codec->data, codec->data_size);
+    FLUID_FREE(codec->packed);
+    FLUID_FREE(codec->block_offset);
+    FLUID_FREE(codec);
+}
+
+/* Decodes the sample data up to the frame before end, if it isn't decoded yet.
+ * The data stays decoded as long as the sample is used by a voice, see
+ * fluid_samplecodec_use(). May take a while, must not be called by the
+ * renderer. Returns the end of the decoded data, which may be beyond end. */
+unsigned int fluid_samplecodec_decode(fluid_samplecodec_t *codec, unsigned int end)
+{
+    unsigned int decoded_end;
+
+    if(end > codec->count)
+    {
+        end = codec->count;
+    }
+
+    fluid_mutex_lock(samplecodec_mutex);
+
+    if(codec->decoded_end < end)
+    {
+        if(codec->in_lru)
+        {
+            samplecodec_lru_remove(codec);
+        }
+
+        while(codec->decoded_end < end)
+        {
+            samplecodec_decode_block(codec, codec->decoded_end / FLUID_SAMPLECODEC_BLOCK,
+                                     codec->data + codec->decoded_end);
+            codec->decoded_end += FLUID_SAMPLECODEC_BLOCK;
+
+            if(codec->decoded_end > codec->count)
+            {
+                codec->decoded_end = codec->count;
+            }
+        }
+
+        samplecodec_lru_append(codec);
+        samplecodec_trim(codec);
+    }
+
+    decoded_end = codec->decoded_end;
+    fluid_mutex_unlock(samplecodec_mutex);
+
+    return decoded_end;
+}
+
+/* Marks the decoded data as being read by a voice, it is not discarded until
+ * fluid_samplecodec_unuse() is called. Never blocks. */
+void fluid_samplecodec_use(fluid_samplecodec_t *codec)
+{
+    fluid_atomic_int_inc(&codec->users);
+}
+
+void fluid_samplecodec_unuse(fluid_samplecodec_t *codec)
+{
+    fluid_atomic_int_add(&codec->users, -1);
+}
+
+/* Sets the size in bytes of the decoded sample data, that is kept after the
+ * samples have stopped playing. */
+void fluid_samplecodec_set_cache_size(fluid_long_long_t size)
+{
+    fluid_mutex_lock(samplecodec_mutex);
+    samplecodec_max_cached_size = size;
+    samplecodec_trim(NULL);
+    fluid_mutex_unlock(samplecodec_mutex);
+}
+
+
+/* Private functions */
+
+static FLUID_INLINE void samplecodec_put_bits(fluid_samplecodec_writer_t *writer, unsigned int value, int count)
+{
+    /* count is at most 24, only the lowest bits of the accumulator matter */
+    writer->acc = (writer->acc << count) | value;
+    writer->bits += count;
+
+    while(writer->bits >= 8)
+    {
+        writer->bits -= 8;
+        writer->out[writer->pos++] = (unsigned char)(writer->acc >> writer->bits);
+    }
+}
+
+static FLUID_INLINE void samplecodec_put_rice(fluid_samplecodec_writer_t *writer, unsigned int value, int k)
+{
+    unsigned int q = value >> k;
+
+    while(q > 16)
+    {
+        samplecodec_put_bits(writer, 0, 16);
+        q -= 16;
+    }
+
+    samplecodec_put_bits(writer, 1, q + 1);
+
+    if(k > 0)
+    {
+        samplecodec_put_bits(writer, value & ((1u << k) - 1), k);
+    }
+}
+
+static FLUID_INLINE unsigned int samplecodec_get_bits(fluid_samplecodec_reader_t *reader, int count)
+{
+    while(reader->bits < count)
+    {
+        reader->acc = (reader->acc << 8) | reader->in[reader->pos++];
+        reader->bits += 8;
+    }
+
+    reader->bits -= count;
+    return (reader->acc >> reader->bits) & ((1u << count) - 1);
+}
+
+static FLUID_INLINE unsigned int samplecodec_get_rice(fluid_samplecodec_reader_t *reader, int k)
+{
+    unsigned int q = 0;
+
+    for(;;)
+    {
+        if(reader->bits == 0)
+        {
+            reader->acc = reader->in[reader->pos++];
+            reader->bits = 8;
+        }
+
+        if((reader->acc & ((1u << reader->bits) - 1)) != 0)
+        {
+            break;
+        }
+
+        q += reader->bits;
+        reader->bits = 0;
+    }
+
+    while(((reader->acc >> (reader->bits - 1)) & 1) == 0)
+    {
+        q++;
+        reader->bits--;
+    }
+
+    reader->bits--;
+
+    return (q << k) | samplecodec_get_bits(reader, k);
+}
+
+/* Prediction residual of frame i, zigzag encoded to be unsigned */
+static FLUID_INLINE unsigned int samplecodec_residual(const short *data, unsigned int i, int order)
+{
+    int residual;
+
+    switch(order)
+    {
+    case 0:
+        residual = data[i];
+        break;
+
+    case 1:
+        residual = data[i] - data[i - 1];
+        break;
+
+    default:
+        residual = data[i] - 2 * data[i - 1] + data[i - 2];
+        break;
+    }
+
+    return (residual >= 0) ? ((unsigned int)residual << 1) : (((unsigned int)(-residual) << 1) - 1);
+}
+
+/* Count of bits of the Rice coded residuals of a partition */
+static unsigned int samplecodec_rice_cost(const unsigned int *residuals, unsigned int count, int k)
+{
+    unsigned int i, cost = count * (k + 1);
+
+    for(i = 0; i < count; i++)
+    {
+        cost += residuals[i] >> k;
+    }
+
+    return cost;
+}
+
+/* Compresses a block of len frames into out, returns the count of bytes written */
+static unsigned int samplecodec_encode_block(const short *data, unsigned int len, unsigned char *out)
+{
+    unsigned int residuals[FLUID_SAMPLECODEC_BLOCK];
+    unsigned int sums[3] = { 0, 0, 0 };
+    fluid_samplecodec_writer_t writer;
+    unsigned int i, j, n, sum, cost, next_cost;
+    int order, k;
+
+    /* Use the predictor that leaves the smallest residuals */
+    for(i = 2; i < len; i++)
+    {
+        for(order = 0; order < 3; order++)
+        {
+            sums[order] += samplecodec_residual(data, i, order);
+        }
+    }
+
+    order = (sums[1] < sums[0]) ? 1 : 0;
+
+    if(sums[2] < sums[order])
+    {
+        order = 2;
+    }
+
+    writer.out = out;
+    writer.pos = 0;
+    writer.acc = 0;
+    writer.bits = 0;
+
+    samplecodec_put_bits(&writer, order, 8);
+
+    for(i = 0; i < (unsigned int)order; i++)
+    {
+        samplecodec_put_bits(&writer, (unsigned short)data[i], 16);
+    }
+
+    for(i = order; i < len; i++)
+    {
+        residuals[i] = samplecodec_residual(data, i, order);
+    }
+
+    for(i = order; i < len; i += n)
+    {
+        n = len - i;
+
+        if(n > FLUID_SAMPLECODEC_PARTITION)
+        {
+            n = FLUID_SAMPLECODEC_PARTITION;
+        }
+
+        /* Start with the parameter matching the mean residual, then walk to the cheapest one */
+        sum = 0;
+
+        for(j = 0; j < n; j++)
+        {
+            sum += residuals[i + j];
+        }
+
+        for(k = 0, sum /= n; sum > 1 && k < FLUID_SAMPLECODEC_MAX_RICE; sum >>= 1)
+        {
+            k++;
+        }
+
+        cost = samplecodec_rice_cost(residuals + i, n, k);
+
+        while(k > 0 && (next_cost = samplecodec_rice_cost(residuals + i, n, k - 1)) <= cost)
+        {
+            k--;
+            cost = next_cost;
+        }
+
+        while(k < FLUID_SAMPLECODEC_MAX_RICE && (next_cost = samplecodec_rice_cost(residuals + i, n, k + 1)) < cost)
+        {
+            k++;
+            cost = next_cost;
+        }
+
+        samplecodec_put_bits(&writer, k, FLUID_SAMPLECODEC_RICE_BITS);
+
+        for(j = 0; j < n; j++)
+        {
+            samplecodec_put_rice(&writer, residuals[i + j], k);
+        }
+    }
+
+    if(writer.bits > 0)
+    {
+        samplecodec_put_bits(&writer, 0, 8 - writer.bits);
+    }
+
+    return writer.pos;
+}
+
+static void samplecodec_decode_block(const fluid_samplecodec_t *codec, unsigned int block, short *out)
+{
+    fluid_samplecodec_reader_t reader;
+    unsigned int i, n, end, len;
+    unsigned int value;
+    int order, k, residual;
+
+    len = codec->count - block * FLUID_SAMPLECODEC_BLOCK;
+
+    if(len > FLUID_SAMPLECODEC_BLOCK)
+    {
+        len = FLUID_SAMPLECODEC_BLOCK;
+    }
+
+    reader.in = codec->packed + codec->block_offset[block];
+    reader.pos = 0;
+    reader.acc = 0;
+    reader.bits = 0;
+
+    order = samplecodec_get_bits(&reader, 8);
+
+    for(i = 0; i < (unsigned int)order; i++)
+    {
+        out[i] = (short)samplecodec_get_bits(&reader, 16);
+    }
+
+    while(i < len)
+    {
+        n = len - i;
+
+        if(n > FLUID_SAMPLECODEC_PARTITION)
+        {
+            n = FLUID_SAMPLECODEC_PARTITION;
+        }
+
+        k = samplecodec_get_bits(&reader, FLUID_SAMPLECODEC_RICE_BITS);
+
+        for(end = i + n; i < end; i++)
+        {
+            value = samplecodec_get_rice(&reader, k);
+            residual = (value & 1) ? -(int)((value + 1) >> 1) : (int)(value >> 1);
+
+            switch(order)
+            {
+            case 0:
+                out[i] = (short)residual;
+                break;
+
+            case 1:
+                out[i] = (short)(out[i - 1] + residual);
+                break;
+
+            default:
+                out[i] = (short)(2 * out[i - 1] - out[i - 2] + residual);
+                break;
+            }
+        }
+    }
+}
+
+/* Discards the decoded data of samples that are not playing, until the decoded
+ * data fits the cache size. Must be called with samplecodec_mutex locked. */
+static void samplecodec_trim(const fluid_samplecodec_t *keep)
+{
+    fluid_samplecodec_t *codec, *next;
+
+    for(codec = samplecodec_lru_head; codec != NULL && samplecodec_cached_size > samplecodec_max_cached_size;
+            codec = next)
+    {
+        next = codec->lru_next;
+
+        /* Voices only read data that the stream thread has decoded while the
+         * mutex was held, so it's safe to discard it if there are no users */
+        if(codec == keep || fluid_atomic_int_get(&codec->users) != 0)
+        {
+            continue;
+        }
+
+        samplecodec_lru_remove(codec);
+        fluid_mem_discard(codec->data + codec->head, (codec->decoded_end - codec->head) * sizeof(short));
+        codec->decoded_end = codec->head;
+    }
+}
+
+static void samplecodec_lru_append(fluid_samplecodec_t *codec)
+{
+    codec->lru_prev = samplecodec_lru_tail;
+    codec->lru_next = NULL;
+
+    if(samplecodec_lru_tail != NULL)
+    {
+        samplecodec_lru_tail->lru_next = codec;
+    }
+    else
+    {
+        samplecodec_lru_head = codec;
+    }
+
+    samplecodec_lru_tail = codec;
+    samplecodec_cached_size += (codec->decoded_end - codec->head) * sizeof(short);
+    codec->in_lru = TRUE;
+}
+
+static void samplecodec_lru_remove(fluid_samplecodec_t *codec)
+{
+    if(codec->lru_prev != NULL)
+    {
+        codec->lru_prev->lru_next = codec->lru_next;
+    }
+    else
+    {
+        samplecodec_lru_head = codec->lru_next;
+    }
+
+    if(codec->lru_next != NULL)
+    {
+        codec->lru_next->lru_prev = codec->lru_prev;
+    }
+    else
+    {
+        samplecodec_lru_tail = codec->lru_prev;
+    }
+
+    samplecodec_cached_size -= (codec->decoded_end - codec->head) * sizeof(short);
+    codec->lru_prev = codec->lru_next = NULL;
+    codec->in_lru = FALSE;
+}
+
+
+/* Only used for tests */
+size_t fluid_samplecodec_get_size(const fluid_samplecodec_t *codec)
+{
+    return codec->block_offset[(codec->count + FLUID_SAMPLECODEC_BLOCK - 1) / FLUID_SAMPLECODEC_BLOCK];
+}
+
+fluid_long_long_t fluid_samplecodec_get_cached_size(void)
+{
+    fluid_long_long_t size;
+
+    fluid_mutex_lock(samplecodec_mutex);
+    size = samplecodec_cached_size;
+    fluid_mutex_unlock(samplecodec_mutex);
+
+    return size;
+}
@@ -0,0 +1,50 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FLUID_SAMPLECODEC_H
+#define _FLUID_SAMPLECODEC_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_sfont.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+fluid_samplecodec_t *fluid_samplecodec_compress(const short *data, unsigned int count,
+        unsigned int head, int try_mlock, short **decoded);
+void fluid_samplecodec_ref(fluid_samplecodec_t *codec);
+void fluid_samplecodec_free(fluid_samplecodec_t *codec);
+
+unsigned int fluid_samplecodec_decode(fluid_samplecodec_t *codec, unsigned int end);
+void fluid_samplecodec_use(fluid_samplecodec_t *codec);
+void fluid_samplecodec_unuse(fluid_samplecodec_t *codec);
+
+void fluid_samplecodec_set_cache_size(fluid_long_long_t size);
+
+/* Only used for tests */
+size_t fluid_samplecodec_get_size(const fluid_samplecodec_t *codec);
+fluid_long_long_t fluid_samplecodec_get_cached_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_SAMPLECODEC_H */
@@ -0,0 +1,358 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/* CONTENT ADDRESSED SAMPLE STORE
+ *
+ * The sample cache only shares sample data loaded from the same file at the
+ * same offsets. This store shares sample data by its content instead: the PCM
+ * data of a sample is hashed together with its loop points, and a sample that
+ * is identical to one already in the store uses the stored copy. This way
+ * samples that several SoundFonts (or DLS files) have in common are kept in
+ * memory only once, see synth.sample-dedup. The store is shared by the whole
+ * process.
+ */
+
+#include "fluid_samplededup.h"
+#include "fluid_sys.h"
+#include "fluid_hash.h"
+
+
+/* Identifies the content of a sample */
+typedef struct
+{
+    unsigned int hash;
+    const short *data;
+    const char *data24;
+    unsigned int count;
+    unsigned int loopstart;
+    unsigned int loopend;
+} fluid_samplededup_key_t;
+
+typedef struct
+{
+    fluid_samplededup_key_t key; /* must be first, the content table hashes entries by it */
+
+    short *sample_data;
+    char *sample_data24;
+    int num_references;
+    int mlocked;
+} fluid_samplededup_entry_t;
+
+/* Maps the key of an entry to the entry */
+static fluid_hashtable_t *samplededup_entries = NULL;
+/* Maps sample data pointers to their entries, for fluid_samplededup_release() */
+static fluid_hashtable_t *samplededup_data_index = NULL;
+static fluid_mutex_t samplededup_mutex = FLUID_MUTEX_INIT;
+
+static unsigned int samplededup_content_hash(const short *data, const char *data24, unsigned int count,
+        unsigned int loopstart, unsigned int loopend);
+static unsigned int samplededup_key_hash(const void *v);
+static int samplededup_key_equal(const void *a, const void *b);
+static fluid_samplededup_entry_t *new_samplededup_entry(const fluid_samplededup_key_t *key);
+static void delete_samplededup_entry(fluid_samplededup_entry_t *entry);
+
+
+/* PUBLIC INTERFACE */
+
+/* Looks up sample data with the given content in the store. If there is none
+ * yet, the data is copied into the store. The caller keeps ownership of the
+ * passed data and receives a reference to the stored data, to be dropped with
+ * fluid_samplededup_release(). data24 may be NULL.
+ * Returns FLUID_OK on success, FLUID_FAILED if out of memory. */
+int fluid_samplededup_acquire(const short *data, const char *data24, unsigned int count,
+                              unsigned int loopstart, unsigned int loopend, int try_mlock,
+                              short **shared_data, char **shared_data24)
+{
+    fluid_samplededup_key_t key;
+    fluid_samplededup_entry_t *entry;
+
+    fluid_return_val_if_fail(data != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(count > 0, FLUID_FAILED);
+
+    /* Hashing touches all the data, don't block other loaders meanwhile */
+    key.hash = samplededup_content_hash(data, data24, count, loopstart, loopend);
+    key.data = data;
+    key.data24 = data24;
+    key.count = count;
+    key.loopstart = loopstart;
+    key.loopend = loopend;
+
+    fluid_mutex_lock(samplededup_mutex);
+
+    if(samplededup_entries == NULL)
+    {
+        samplededup_entries = new_fluid_hashtable(samplededup_key_hash, samplededup_key_equal);
+        samplededup_data_index = new_fluid_hashtable(fluid_direct_hash, NULL);
+
+        if(samplededup_entries == NULL || samplededup_data_index == NULL)
+        {
+            delete_fluid_hashtable(samplededup_entries);
+            delete_fluid_hashtable(samplededup_data_index);
+            samplededup_entries = samplededup_data_index = NULL;
+            fluid_mutex_unlock(samplededup_mutex);
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+    }
+
+    entry = fluid_hashtable_lookup(samplededup_entries, &key);
+
+    if(entry == NULL)
+    {
+        entry = new_samplededup_entry(&key);
+
+        if(entry == NULL)
+        {
+            fluid_mutex_unlock(samplededup_mutex);
+            return FLUID_FAILED;
+        }
+
+        fluid_hashtable_insert(samplededup_entries, entry, entry);
+        fluid_hashtable_insert(samplededup_data_index, entry->sample_data, entry);
+    }
+    else
+    {
+        FLUID_LOG(FLUID_DBG, "Sharing %u frames of identical sample data", count);
+    }
+
+    entry->num_references++;
+
+    if(try_mlock && !entry->mlocked)
+    {
+        /* It's okay if this fails, see fluid_samplecache_load() */
+        if(fluid_mlock(entry->sample_data, count * sizeof(short)) == 0)
+        {
+            if(entry->sample_data24 != NULL && fluid_mlock(entry->sample_data24, count) != 0)
+            {
+                fluid_munlock(entry->sample_data, count * sizeof(short));
+            }
+            else
+            {
+                entry->mlocked = TRUE;
+            }
+        }
+
+        if(!entry->mlocked)
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to pin the sample data to RAM; swapping is possible.");
+        }
+    }
+
+    fluid_mutex_unlock(samplededup_mutex);
+
+    *shared_data = entry->sample_data;
+    *shared_data24 = entry->sample_data24;
+    return FLUID_OK;
+}
+
+/* Takes another reference to sample data returned by fluid_samplededup_acquire().
+ * Returns FLUID_FAILED if the data doesn't belong to the store. */
+int fluid_samplededup_ref(const short *shared_data)
+{
+    fluid_samplededup_entry_t *entry = NULL;
+
+    fluid_mutex_lock(samplededup_mutex);
+
+    if(samplededup_data_index != NULL)
+    {
+        entry = fluid_hashtable_lookup(samplededup_data_index, shared_data);
+    }
+
+    if(entry != NULL)
+    {
+        entry->num_references++;
+    }
+
+    fluid_mutex_unlock(samplededup_mutex);
+
+    return (entry != NULL) ? FLUID_OK : FLUID_FAILED;
+}
+
+/* Drops a reference to sample data returned by fluid_samplededup_acquire(),
+ * the data is freed when it isn't referenced anymore.
+ * Returns FLUID_FAILED if the data doesn't belong to the store. */
+int fluid_samplededup_release(const short *shared_data)
+{
+    fluid_samplededup_entry_t *entry = NULL;
+
+    fluid_mutex_lock(samplededup_mutex);
+
+    if(samplededup_data_index != NULL)
+    {
+        entry = fluid_hashtable_lookup(samplededup_data_index, shared_data);
+    }
+
+    if(entry == NULL)
+    {
+        fluid_mutex_unlock(samplededup_mutex);
+        return FLUID_FAILED;
+    }
+
+    entry->num_references--;
+
+    if(entry->num_references > 0)
+    {
+        fluid_mutex_unlock(samplededup_mutex);
+        return FLUID_OK;
+    }
+
+    fluid_hashtable_remove(samplededup_entries, entry);
+    fluid_hashtable_remove(samplededup_data_index, entry->sample_data);
+
+    if(fluid_hashtable_size(samplededup_entries) == 0)
+    {
+        delete_fluid_hashtable(samplededup_entries);
+        delete_fluid_hashtable(samplededup_data_index);
+        samplededup_entries = samplededup_data_index = NULL;
+    }
+
+    fluid_mutex_unlock(samplededup_mutex);
+
+    delete_samplededup_entry(entry);
+    return FLUID_OK;
+}
+
+
+/* Private functions */
+
+static fluid_samplededup_entry_t *new_samplededup_entry(const fluid_samplededup_key_t *key)
+{
+    fluid_samplededup_entry_t *entry = FLUID_NEW(fluid_samplededup_entry_t);
+
+    if(entry == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(entry, 0, sizeof(*entry));
+
+    entry->sample_data = FLUID_ARRAY(short, key->count);
+
+    if(entry->sample_data == NULL)
+    {
+        goto error_exit;
+    }
+
+    FLUID_MEMCPY(entry->sample_data, key->data, key->count * sizeof(short));
+
+    if(key->data24 != NULL)
+    {
+        entry->sample_data24 = FLUID_ARRAY(char, key->count);
+
+        if(entry->sample_data24 == NULL)
+        {
+            goto error_exit;
+        }
+
+        FLUID_MEMCPY(entry->sample_data24, key->data24, key->count);
+    }
+
+    /* From now on the key refers to the stored copy */
+    entry->key = *key;
+    entry->key.data = entry->sample_data;
+    entry->key.data24 = entry->sample_data24;
+
+    return entry;
+
+error_exit:
+    FLUID_LOG(FLUID_ERR, "Out of memory");
+    delete_samplededup_entry(entry);
+    return NULL;
+}
+
+static void delete_samplededup_entry(fluid_samplededup_entry_t *entry)
+{
+    fluid_return_if_fail(entry != NULL);
+
+    if(entry->mlocked)
+    {
+        fluid_munlock(entry->sample_data, entry->key.count * sizeof(short));
+
+        if(entry->sample_data24 != NULL)
+        {
+            fluid_munlock(entry->sample_data24, entry->key.count);
+        }
+    }
+
+    FLUID_FREE(entry->sample_data);
+    FLUID_FREE(entry->sample_data24);
+    FLUID_FREE(entry);
+}
+
+/* Hash of the sample content */
+static unsigned int samplededup_content_hash(const short *data, const char *data24, unsigned int count,
+        unsigned int loopstart, unsigned int loopend)
+{
+    unsigned int key[3];
+    unsigned int hash;
+
+    key[0] = count;
+    key[1] = loopstart;
+    key[2] = loopend;
+
+    hash = fluid_fnv1a(FLUID_FNV1A_INIT, key, sizeof(key));
+    hash = fluid_fnv1a(hash, data, count * sizeof(short));
+
+    if(data24 != NULL)
+    {
+        hash = fluid_fnv1a(hash, data24, count);
+    }
+
+    return hash;
+}
+
+static unsigned int samplededup_key_hash(const void *v)
+{
+    return ((const fluid_samplededup_key_t *)v)->hash;
+}
+
+/* Equal hashes are not enough, samples are only shared if their data is identical */
+static int samplededup_key_equal(const void *a, const void *b)
+{
+    const fluid_samplededup_key_t *key_a = a;
+    const fluid_samplededup_key_t *key_b = b;
+
+    if(key_a->hash != key_b->hash || key_a->count != key_b->count
+            || key_a->loopstart != key_b->loopstart || key_a->loopend != key_b->loopend
+            || (key_a->data24 == NULL) != (key_b->data24 == NULL))
+    {
+        return FALSE;
+    }
+
+    return FLUID_MEMCMP(key_a->data, key_b->data, key_a->count * sizeof(short)) == 0
+           && (key_a->data24 == NULL || FLUID_MEMCMP(key_a->data24, key_b->data24, key_a->count) == 0);
+}
+
+
+/* Only used for tests */
+int fluid_samplededup_count_entries(void)
+{
+    int count = 0;
+
+    fluid_mutex_lock(samplededup_mutex);
+
+    if(samplededup_entries != NULL)
+    {
+        count = fluid_hashtable_size(samplededup_entries);
+    }
+
+    fluid_mutex_unlock(samplededup_mutex);
+    return count;
+}
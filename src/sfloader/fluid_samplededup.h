@@ -0,0 +1,44 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FLUID_SAMPLEDEDUP_H
+#define _FLUID_SAMPLEDEDUP_H
+
+#include "fluidsynth_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fluid_samplededup_acquire(const short *data, const char *data24, unsigned int count,
+                              unsigned int loopstart, unsigned int loopend, int try_mlock,
+                              short **shared_data, char **shared_data24);
+
+int fluid_samplededup_ref(const short *shared_data);
+int fluid_samplededup_release(const short *shared_data);
+
+/* Only used for tests */
+int fluid_samplededup_count_entries(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_SAMPLEDEDUP_H */
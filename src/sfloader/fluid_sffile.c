@@ -24,6 +24,7 @@
 #include "fluid_sffile.h"
 #include "fluid_sfont.h"
 #include "fluid_sys.h"
+#include "fluid_hash.h"
 
 #if LIBSNDFILE_SUPPORT
 #include <sndfile.h>
@@ -151,68 +152,105 @@ static const unsigned short invalid_preset_gen[] =
 #define SF_SHDR_SIZE (46)
 
 
-#define READCHUNK(sf, var)                                                  \
-    do                                                                      \
-    {                                                                       \
-        if (sf->fcbs->fread(&(var)->id, 4, sf->sffd) == FLUID_FAILED)       \
-            return FALSE;                                                   \
-        if (sf->fcbs->fread(&(var)->size, 4, sf->sffd) == FLUID_FAILED)     \
-            return FALSE;                                                   \
-        (var)->size = FLUID_LE32TOH((var)->size); \
-    } while (0)
+/* Reads count bytes from the pdta chunk in memory while it is being parsed,
+ * otherwise from the file through the file callbacks. */
+static FLUID_INLINE int sffile_read(SFData *sf, void *buf, unsigned int count)
+{
+    if(sf->pdta != NULL)
+    {
+        if(count > sf->pdta_size - sf->pdta_pos)
+        {
+            sf->pdta_pos = sf->pdta_size;
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMCPY(buf, sf->pdta + sf->pdta_pos, count);
+        sf->pdta_pos += count;
+        return FLUID_OK;
+    }
+
+    return sf->fcbs->fread(buf, count, sf->sffd);
+}
+
+static FLUID_INLINE int sffile_skip(SFData *sf, fluid_long_long_t count)
+{
+    if(sf->pdta != NULL)
+    {
+        if(count < 0 || count > sf->pdta_size - sf->pdta_pos)
+        {
+            sf->pdta_pos = sf->pdta_size;
+            return FLUID_FAILED;
+        }
+
+        sf->pdta_pos += count;
+        return FLUID_OK;
+    }
+
+    return sf->fcbs->fseek(sf->sffd, count, SEEK_CUR);
+}
 
-#define READD(sf, var)                                            \
+#define READCHUNK(sf, var)                                        \
     do                                                            \
     {                                                             \
-        uint32_t _temp;                                           \
-        if (sf->fcbs->fread(&_temp, 4, sf->sffd) == FLUID_FAILED) \
+        if (sffile_read(sf, &(var)->id, 4) == FLUID_FAILED)       \
+            return FALSE;                                         \
+        if (sffile_read(sf, &(var)->size, 4) == FLUID_FAILED)     \
             return FALSE;                                         \
-        var = FLUID_LE32TOH(_temp);                               \
+        (var)->size = FLUID_LE32TOH((var)->size);                 \
     } while (0)
 
-#define READW(sf, var)                                            \
-    do                                                            \
-    {                                                             \
-        uint16_t _temp;                                           \
-        if (sf->fcbs->fread(&_temp, 2, sf->sffd) == FLUID_FAILED) \
-            return FALSE;                                         \
-        var = FLUID_LE16TOH(_temp);                               \
+#define READD(sf, var)                                  \
+    do                                                  \
+    {                                                   \
+        uint32_t _temp;                                 \
+        if (sffile_read(sf, &_temp, 4) == FLUID_FAILED) \
+            return FALSE;                               \
+        var = FLUID_LE32TOH(_temp);                     \
     } while (0)
 
-#define READID(sf, var)                                        \
-    do                                                         \
-    {                                                          \
-        if (sf->fcbs->fread(var, 4, sf->sffd) == FLUID_FAILED) \
-            return FALSE;                                      \
+#define READW(sf, var)                                  \
+    do                                                  \
+    {                                                   \
+        uint16_t _temp;                                 \
+        if (sffile_read(sf, &_temp, 2) == FLUID_FAILED) \
+            return FALSE;                               \
+        var = FLUID_LE16TOH(_temp);                     \
     } while (0)
 
-#define READSTR(sf, var)                                        \
-    do                                                          \
-    {                                                           \
-        if (sf->fcbs->fread(var, 20, sf->sffd) == FLUID_FAILED) \
-            return FALSE;                                       \
-        (*var)[20] = '\0';                                      \
+#define READID(sf, var)                              \
+    do                                               \
+    {                                                \
+        if (sffile_read(sf, var, 4) == FLUID_FAILED) \
+            return FALSE;                            \
     } while (0)
 
-#define READB(sf, var)                                          \
-    do                                                          \
-    {                                                           \
-        if (sf->fcbs->fread(&var, 1, sf->sffd) == FLUID_FAILED) \
-            return FALSE;                                       \
+#define READSTR(sf, var)                              \
+    do                                                \
+    {                                                 \
+        if (sffile_read(sf, var, 20) == FLUID_FAILED) \
+            return FALSE;                             \
+        (*var)[20] = '\0';                            \
     } while (0)
 
-#define FSKIP(sf, size)                                                \
-    do                                                                 \
-    {                                                                  \
-        if (sf->fcbs->fseek(sf->sffd, size, SEEK_CUR) == FLUID_FAILED) \
-            return FALSE;                                              \
+#define READB(sf, var)                                \
+    do                                                \
+    {                                                 \
+        if (sffile_read(sf, &var, 1) == FLUID_FAILED) \
+            return FALSE;                             \
     } while (0)
 
-#define FSKIPW(sf)                                                  \
-    do                                                              \
-    {                                                               \
-        if (sf->fcbs->fseek(sf->sffd, 2, SEEK_CUR) == FLUID_FAILED) \
-            return FALSE;                                           \
+#define FSKIP(sf, size)                                  \
+    do                                                   \
+    {                                                    \
+        if (sffile_skip(sf, size) == FLUID_FAILED)       \
+            return FALSE;                                \
+    } while (0)
+
+#define FSKIPW(sf)                                    \
+    do                                                \
+    {                                                 \
+        if (sffile_skip(sf, 2) == FLUID_FAILED)       \
+            return FALSE;                             \
     } while (0)
 
 /* removes and advances a fluid_list_t pointer */
@@ -450,6 +488,114 @@ int fluid_sffile_read_sample_data(SFData *sf, unsigned int sample_start, unsigne
     return num_samples;
 }
 
+/* Continues a 64-bit FNV-1a hash with count bytes of the file at pos */
+static int sffile_hash_range(SFData *sf, unsigned int pos, unsigned int count, uint64_t *hash)
+{
+    unsigned char buf[4096];
+    unsigned int size;
+
+    while(count > 0)
+    {
+        size = (count < sizeof(buf)) ? count : sizeof(buf);
+
+        /* Other threads might read other samples of the file meanwhile */
+        fluid_rec_mutex_lock(sf->mtx);
+
+        if(sf->fcbs->fseek(sf->sffd, pos, SEEK_SET) == FLUID_FAILED
+                || sf->fcbs->fread(buf, size, sf->sffd) == FLUID_FAILED)
+        {
+            fluid_rec_mutex_unlock(sf->mtx);
+            FLUID_LOG(FLUID_ERR, "Failed to read SoundFont data for hashing");
+            return FLUID_FAILED;
+        }
+
+        fluid_rec_mutex_unlock(sf->mtx);
+
+        *hash = fluid_fnv1a64(*hash, buf, size);
+
+        pos += size;
+        count -= size;
+    }
+
+    return FLUID_OK;
+}
+
+/* Hash the data of a sample as it is stored in the Soundfont file
+ *
+ * The data isn't decoded, so this is much faster than loading Ogg Vorbis
+ * compressed samples. Samples whose data hashes to the same value can be
+ * considered identical.
+ *
+ * @param sf SFData instance
+ * @param sample_start index of first sample point in Soundfont sample chunk
+ * @param sample_end index of last sample point in Soundfont sample chunk
+ * @param sample_type type of the sample in Soundfont
+ * @param hash pointer to the hash value, set on success
+ *
+ * @return FLUID_OK on success, otherwise FLUID_FAILED
+ */
+int fluid_sffile_hash_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
+                                  int sample_type, uint64_t *hash)
+{
+    /* Sample offsets of Ogg Vorbis samples are byte offsets */
+    unsigned int size = (sample_type & FLUID_SAMPLETYPE_OGG_VORBIS) ? 1 : sizeof(short);
+
+    *hash = FLUID_FNV1A64_INIT;
+
+    if((sample_end < sample_start) || (sample_end >= sf->samplesize / size))
+    {
+        FLUID_LOG(FLUID_ERR, "Sample offsets exceed sample data chunk");
+        return FLUID_FAILED;
+    }
+
+    if(sffile_hash_range(sf, sf->samplepos + sample_start * size,
+                         (sample_end + 1 - sample_start) * size, hash) == FLUID_FAILED)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* The 24-bit data is hashed as well, if present */
+    if(sf->sample24pos && size != 1 && sample_end < sf->sample24size)
+    {
+        return sffile_hash_range(sf, sf->sample24pos + sample_start, sample_end + 1 - sample_start, hash);
+    }
+
+    return FLUID_OK;
+}
+
+/* Hash the preset data of a Soundfont file
+ *
+ * Covers the HYDRA chunk and the layout of the sample chunks, i.e. everything
+ * the presets, instruments and sample headers are parsed from. The header of
+ * the file must have been read already.
+ *
+ * @param sf SFData instance
+ * @param hash pointer to the hash value, set on success
+ *
+ * @return FLUID_OK on success, otherwise FLUID_FAILED
+ */
+int fluid_sffile_hash_hydra(SFData *sf, uint64_t *hash)
+{
+    unsigned int key[6];
+
+    key[0] = ((unsigned int)sf->version.major << 16) | sf->version.minor;
+    key[1] = sf->samplepos;
+    key[2] = sf->samplesize;
+    key[3] = sf->sample24pos;
+    key[4] = sf->sample24size;
+    key[5] = sf->hydrasize;
+
+    *hash = fluid_fnv1a64(FLUID_FNV1A64_INIT, key, sizeof(key));
+
+    if(sf->hydrasize > sf->filesize || sf->hydrapos > sf->filesize - sf->hydrasize)
+    {
+        FLUID_LOG(FLUID_ERR, "HYDRA chunk exceeds the file size");
+        return FLUID_FAILED;
+    }
+
+    return sffile_hash_range(sf, sf->hydrapos, sf->hydrasize, hash);
+}
+
 /*
  * Close a SoundFont file and free the SFData structure.
  *
@@ -631,13 +777,48 @@ static int load_header(SFData *sf)
 
 static int load_body(SFData *sf)
 {
+    unsigned char *pdta;
+    int ok;
+
+    if(sf->hydrasize > sf->filesize || sf->hydrapos > sf->filesize - sf->hydrasize)
+    {
+        FLUID_LOG(FLUID_ERR, "HYDRA chunk exceeds the file size");
+        return FALSE;
+    }
+
     if(sf->fcbs->fseek(sf->sffd, sf->hydrapos, SEEK_SET) == FLUID_FAILED)
     {
         FLUID_LOG(FLUID_ERR, "Failed to seek to HYDRA position");
         return FALSE;
     }
 
-    if(!process_pdta(sf, sf->hydrasize))
+    /* Read the whole chunk at once and parse the records from memory,
+     * instead of going through the file callbacks for every field */
+    pdta = FLUID_ARRAY(unsigned char, sf->hydrasize + 1);
+
+    if(pdta == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FALSE;
+    }
+
+    if(sf->hydrasize > 0 && sf->fcbs->fread(pdta, sf->hydrasize, sf->sffd) == FLUID_FAILED)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to read HYDRA chunk");
+        FLUID_FREE(pdta);
+        return FALSE;
+    }
+
+    sf->pdta = pdta;
+    sf->pdta_pos = 0;
+    sf->pdta_size = sf->hydrasize;
+
+    ok = process_pdta(sf, sf->hydrasize);
+
+    sf->pdta = NULL;
+    FLUID_FREE(pdta);
+
+    if(!ok)
     {
         return FALSE;
     }
@@ -2519,15 +2700,15 @@ error_exit:
 /* Ogg Vorbis loading and decompression */
 #if LIBSNDFILE_SUPPORT
 
-/* Virtual file access routines to allow loading individually compressed
- * samples from the Soundfont sample data chunk using the file callbacks
- * passing in during opening of the file */
+/* Virtual file access routines to allow decoding individually compressed
+ * samples from a copy of their data. The compressed data is read from the
+ * Soundfont sample data chunk at once, so that decoding doesn't need to hold
+ * the file mutex and several samples can be decoded concurrently. */
 typedef struct _sfvio_data_t
 {
-    SFData *sffile;
-    sf_count_t start;  /* start byte offset of compressed data */
-    sf_count_t end;    /* end byte offset of compressed data */
-    sf_count_t offset; /* current virtual file offset from start byte offset */
+    const char *buffer; /* compressed data */
+    sf_count_t length;  /* length of compressed data in bytes */
+    sf_count_t offset;  /* current virtual file offset */
 
 } sfvio_data_t;
 
@@ -2535,13 +2716,12 @@ static sf_count_t sfvio_get_filelen(void *user_data)
 {
     sfvio_data_t *data = user_data;
 
-    return (data->end + 1) - data->start;
+    return data->length;
 }
 
 static sf_count_t sfvio_seek(sf_count_t offset, int whence, void *user_data)
 {
     sfvio_data_t *data = user_data;
-    SFData *sf = data->sffile;
     sf_count_t new_offset;
 
     switch(whence)
@@ -2562,17 +2742,11 @@ static sf_count_t sfvio_seek(sf_count_t offset, int whence, void *user_data)
         goto fail; /* proper error handling not possible?? */
     }
 
-    new_offset += data->start;
-    fluid_rec_mutex_lock(sf->mtx);
-
-    if(data->start <= new_offset && new_offset <= data->end &&
-            sf->fcbs->fseek(sf->sffd, new_offset, SEEK_SET) != FLUID_FAILED)
+    if(0 <= new_offset && new_offset < data->length)
     {
-        data->offset = new_offset - data->start;
+        data->offset = new_offset;
     }
 
-    fluid_rec_mutex_unlock(sf->mtx);
-
 fail:
     return data->offset;
 }
@@ -2580,7 +2754,6 @@ fail:
 static sf_count_t sfvio_read(void *ptr, sf_count_t count, void *user_data)
 {
     sfvio_data_t *data = user_data;
-    SFData *sf = data->sffile;
     sf_count_t remain;
 
     remain = sfvio_get_filelen(user_data) - data->offset;
@@ -2590,29 +2763,12 @@ static sf_count_t sfvio_read(void *ptr, sf_count_t count, void *user_data)
         count = remain;
     }
 
-    if(count == 0)
+    if(count <= 0)
     {
-        return count;
-    }
-
-    fluid_rec_mutex_lock(sf->mtx);
-
-    if(sf->fcbs->fseek(sf->sffd, data->start + data->offset, SEEK_SET) == FLUID_FAILED)
-    {
-        FLUID_LOG(FLUID_ERR, "This should never happen: fseek failed in sfvoid_read()");
-        count = 0;
-    }
-    else
-    {
-        if(sf->fcbs->fread(ptr, count, sf->sffd) == FLUID_FAILED)
-        {
-            FLUID_LOG(FLUID_ERR, "Failed to read compressed sample data");
-            count = 0;
-        }
+        return 0;
     }
 
-    fluid_rec_mutex_unlock(sf->mtx);
-
+    FLUID_MEMCPY(ptr, data->buffer + data->offset, count);
     data->offset += count;
 
     return count;
@@ -2648,29 +2804,47 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
         sfvio_tell
     };
     sfvio_data_t sfdata;
+    char *compressed_data;
     short *wav_data = NULL;
 
-    if((start_byte > sf->samplesize) || (end_byte > sf->samplesize))
+    if((start_byte > sf->samplesize) || (end_byte > sf->samplesize) || (end_byte < start_byte))
     {
         FLUID_LOG(FLUID_ERR, "Ogg Vorbis data offsets exceed sample data chunk");
         return -1;
     }
 
-    // Initialize file position indicator and SF_INFO structure
-    sfdata.sffile = sf;
-    sfdata.start = sf->samplepos + start_byte;
-    sfdata.end = sf->samplepos + end_byte;
-    sfdata.offset = -1;
+    sfdata.length = (sf_count_t)(end_byte - start_byte) + 1;
+    sfdata.offset = 0;
+    compressed_data = FLUID_ARRAY(char, sfdata.length);
+
+    if(compressed_data == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return -1;
+    }
 
-    /* Seek to sfdata.start, the beginning of Ogg Vorbis data in Soundfont */
-    sfvio_seek(0, SEEK_SET, &sfdata);
+    fluid_rec_mutex_lock(sf->mtx);
 
-    if(sfdata.offset != 0)
+    if(sf->fcbs->fseek(sf->sffd, sf->samplepos + start_byte, SEEK_SET) == FLUID_FAILED)
     {
+        fluid_rec_mutex_unlock(sf->mtx);
         FLUID_LOG(FLUID_ERR, "Failed to seek to compressed sample position");
+        FLUID_FREE(compressed_data);
         return -1;
     }
 
+    if(sf->fcbs->fread(compressed_data, sfdata.length, sf->sffd) == FLUID_FAILED)
+    {
+        fluid_rec_mutex_unlock(sf->mtx);
+        FLUID_LOG(FLUID_ERR, "Failed to read compressed sample data");
+        FLUID_FREE(compressed_data);
+        return -1;
+    }
+
+    fluid_rec_mutex_unlock(sf->mtx);
+
+    sfdata.buffer = compressed_data;
+
     FLUID_MEMSET(&sfinfo, 0, sizeof(sfinfo));
 
     // Open sample as a virtual file
@@ -2679,6 +2853,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
     if(!sndfile)
     {
         FLUID_LOG(FLUID_ERR, "sf_open_virtual(): %s", sf_strerror(sndfile));
+        FLUID_FREE(compressed_data);
         return -1;
     }
 
@@ -2688,6 +2863,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
         FLUID_LOG(FLUID_DBG, "Empty decompressed sample");
         *data = NULL;
         sf_close(sndfile);
+        FLUID_FREE(compressed_data);
         return 0;
     }
 
@@ -2726,6 +2902,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
     }
 
     sf_close(sndfile);
+    FLUID_FREE(compressed_data);
 
     *data = wav_data;
 
@@ -2734,6 +2911,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
 error_exit:
     FLUID_FREE(wav_data);
     sf_close(sndfile);
+    FLUID_FREE(compressed_data);
     return -1;
 }
 #else
@@ -150,6 +150,10 @@ struct _SFData
     unsigned int hydrapos;
     unsigned int hydrasize;
 
+    const unsigned char *pdta; /* the HYDRA chunk in memory while it is being parsed, NULL otherwise */
+    unsigned int pdta_pos;     /* read position within pdta */
+    unsigned int pdta_size;    /* size of pdta */
+
     char *fname; /* file name */
     FILE *sffd; /* loaded sfont file descriptor */
     const fluid_file_callbacks_t *fcbs; /* file callbacks used to read this file */
@@ -185,6 +189,9 @@ void fluid_sffile_close(SFData *sf);
 int fluid_sffile_parse_presets(SFData *sf);
 int fluid_sffile_read_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
                                   int sample_type, short **data, char **data24);
+int fluid_sffile_hash_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
+                                  int sample_type, uint64_t *hash);
+int fluid_sffile_hash_hydra(SFData *sf, uint64_t *hash);
 
 
 /* extern only for unit test purposes */
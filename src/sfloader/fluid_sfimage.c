@@ -0,0 +1,1048 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_sfimage.h"
+#include "fluid_sys.h"
+#include "fluid_hash.h"
+
+/* The tables of an image, in the order they are stored in the file */
+enum
+{
+    SFIMAGE_SAMPLES,
+    SFIMAGE_DEFAULT_MODS,
+    SFIMAGE_MODS,
+    SFIMAGE_GENS,
+    SFIMAGE_ZONES,
+    SFIMAGE_INSTS,
+    SFIMAGE_PRESETS,
+    SFIMAGE_TABLE_COUNT
+};
+
+typedef struct _fluid_sfimage_table_t
+{
+    unsigned int offset; /* from the start of the file */
+    unsigned int count;  /* number of records */
+} fluid_sfimage_table_t;
+
+/* Header of a compiled image. It is followed by padding up to header_size,
+ * then the tables. */
+typedef struct _fluid_sfimage_header_t
+{
+    char magic[8];
+    unsigned int version; /* also rejects files written with a different byte order */
+    unsigned int header_size;
+    uint64_t source_hash; /* of the preset data the image was compiled from */
+    unsigned int image_size;
+    unsigned int inst_table_size; /* highest instrument source index + 1 */
+    fluid_sfimage_table_t table[SFIMAGE_TABLE_COUNT];
+} fluid_sfimage_header_t;
+
+typedef struct _fluid_sfimage_sample_t
+{
+    char name[24];
+    int idx;
+    unsigned int start;
+    unsigned int end;
+    unsigned int loopstart;
+    unsigned int loopend;
+    unsigned int samplerate;
+    unsigned char origpitch;
+    signed char pitchadj;
+    unsigned short sampletype;
+} fluid_sfimage_sample_t;
+
+typedef struct _fluid_sfimage_mod_t
+{
+    double amount;
+    unsigned char dest;
+    unsigned char src1;
+    unsigned char flags1;
+    unsigned char src2;
+    unsigned char flags2;
+    unsigned char trans;
+    unsigned char pad[2];
+} fluid_sfimage_mod_t;
+
+typedef struct _fluid_sfimage_gen_t
+{
+    double val;
+    unsigned int id;
+    unsigned int flags;
+} fluid_sfimage_gen_t;
+
+/* Zones of a preset or instrument are stored global zone first, followed by
+ * the other zones in the order of the runtime zone list. */
+typedef struct _fluid_sfimage_zone_t
+{
+    int keylo;
+    int keyhi;
+    int vello;
+    int velhi;
+    int ref; /* instrument source index (preset zones) or sample index (instrument zones), -1 if none */
+    unsigned int gen_start;
+    unsigned int gen_count;
+    unsigned int mod_start;
+    unsigned int mod_count;
+} fluid_sfimage_zone_t;
+
+typedef struct _fluid_sfimage_inst_t
+{
+    char name[24];
+    int source_idx;
+    unsigned int zone_start;
+    unsigned int zone_count;
+    int has_global;
+} fluid_sfimage_inst_t;
+
+typedef struct _fluid_sfimage_preset_t
+{
+    char name[24];
+    unsigned int bank;
+    unsigned int num;
+    unsigned int zone_start;
+    unsigned int zone_count;
+    int has_global;
+} fluid_sfimage_preset_t;
+
+#define SFIMAGE_FILE_MAGIC "FLSFIMG"
+#define SFIMAGE_FILE_VERSION 2
+#define SFIMAGE_FILE_ALIGN 16
+
+static const size_t sfimage_record_size[SFIMAGE_TABLE_COUNT] =
+{
+    sizeof(fluid_sfimage_sample_t),
+    sizeof(fluid_sfimage_mod_t),
+    sizeof(fluid_sfimage_mod_t),
+    sizeof(fluid_sfimage_gen_t),
+    sizeof(fluid_sfimage_zone_t),
+    sizeof(fluid_sfimage_inst_t),
+    sizeof(fluid_sfimage_preset_t)
+};
+
+struct _fluid_sfimage_t
+{
+    char *path;
+    fluid_sfimage_header_t header;
+    char *data;          /* the whole image file */
+    void *map_base;      /* if not NULL, data is mapped from the file */
+    size_t map_size;
+};
+
+/* Table being built while saving an image */
+typedef struct _fluid_sfimage_buffer_t
+{
+    char *data;
+    unsigned int count;
+    unsigned int size;
+} fluid_sfimage_buffer_t;
+
+#define SFIMAGE_TABLE(_image, _type, _table) \
+    ((const _type *)((_image)->data + (_image)->header.table[_table].offset))
+
+
+/* Builds the path of the image of a SoundFont from the hash of its preset
+ * data, so that copies of a SoundFont share their image. */
+static char *sfimage_file_path(const char *dir, uint64_t source_hash)
+{
+    size_t len = FLUID_STRLEN(dir) + 24;
+    char *path = FLUID_ARRAY(char, len);
+
+    if(path == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_SNPRINTF(path, len, "%s/%08x%08x.sfc", dir,
+                   (unsigned int)(source_hash >> 32), (unsigned int)source_hash);
+
+    return path;
+}
+
+static int sfimage_header_init(fluid_sfimage_header_t *header, SFData *sfdata)
+{
+    FLUID_MEMSET(header, 0, sizeof(*header));
+
+    if(fluid_sffile_hash_hydra(sfdata, &header->source_hash) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(header->magic, SFIMAGE_FILE_MAGIC, sizeof(header->magic));
+    header->version = SFIMAGE_FILE_VERSION;
+    header->header_size = sizeof(*header);
+    header->header_size += (SFIMAGE_FILE_ALIGN - header->header_size % SFIMAGE_FILE_ALIGN) % SFIMAGE_FILE_ALIGN;
+
+    return FLUID_OK;
+}
+
+/* Checks that the tables lie within the image */
+static int sfimage_check_tables(const fluid_sfimage_header_t *header)
+{
+    const fluid_sfimage_table_t *table;
+    int i;
+
+    for(i = 0; i < SFIMAGE_TABLE_COUNT; i++)
+    {
+        table = &header->table[i];
+
+        if(table->offset < header->header_size
+                || table->offset % SFIMAGE_FILE_ALIGN != 0
+                || table->offset > header->image_size
+                || table->count > (header->image_size - table->offset) / sfimage_record_size[i])
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * fluid_sfimage_open
+ *
+ * Opens the compiled image of a SoundFont, the header of the SoundFont must
+ * have been read already. Returns NULL if there is no valid image.
+ */
+fluid_sfimage_t *fluid_sfimage_open(SFData *sfdata, const char *dir)
+{
+    fluid_sfimage_header_t expected;
+    fluid_sfimage_t *image;
+    char *data;
+    FILE *file;
+
+    if(sfimage_header_init(&expected, sfdata) != FLUID_OK)
+    {
+        return NULL;
+    }
+
+    image = FLUID_NEW(fluid_sfimage_t);
+
+    if(image == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(image, 0, sizeof(*image));
+    image->path = sfimage_file_path(dir, expected.source_hash);
+
+    if(image->path == NULL)
+    {
+        goto error_rec;
+    }
+
+    file = FLUID_FOPEN(image->path, "rb");
+
+    if(file == NULL)
+    {
+        goto error_rec;
+    }
+
+    if(FLUID_FREAD(&image->header, sizeof(image->header), 1, file) != 1)
+    {
+        FLUID_FCLOSE(file);
+        goto error_rec;
+    }
+
+    /* the tables are the only thing not known upfront */
+    expected.image_size = image->header.image_size;
+    expected.inst_table_size = image->header.inst_table_size;
+    FLUID_MEMCPY(expected.table, image->header.table, sizeof(expected.table));
+
+    if(FLUID_MEMCMP(&image->header, &expected, sizeof(expected)) != 0
+            || sfimage_check_tables(&image->header) != FLUID_OK)
+    {
+        FLUID_FCLOSE(file);
+        goto error_rec;
+    }
+
+    data = fluid_file_map(image->path, 0, image->header.image_size, &image->map_base, &image->map_size);
+
+    if(data == NULL)
+    {
+        /* no memory mapped files on this platform, read the image instead */
+        data = FLUID_ARRAY(char, image->header.image_size);
+
+        if(data == NULL
+                || fluid_file_seek(file, 0, SEEK_SET) != FLUID_OK
+                || FLUID_FREAD(data, 1, image->header.image_size, file) != image->header.image_size)
+        {
+            FLUID_FREE(data);
+            FLUID_FCLOSE(file);
+            goto error_rec;
+        }
+    }
+
+    FLUID_FCLOSE(file);
+    image->data = data;
+
+    FLUID_LOG(FLUID_DBG, "Using compiled SoundFont image '%s'", image->path);
+    return image;
+
+error_rec:
+    fluid_sfimage_close(image);
+    return NULL;
+}
+
+/*
+ * fluid_sfimage_close
+ */
+void fluid_sfimage_close(fluid_sfimage_t *image)
+{
+    fluid_return_if_fail(image != NULL);
+
+    if(image->map_base != NULL)
+    {
+        fluid_file_unmap(image->map_base, image->map_size);
+    }
+    else
+    {
+        FLUID_FREE(image->data);
+    }
+
+    FLUID_FREE(image->path);
+    FLUID_FREE(image);
+}
+
+/*
+ * fluid_sfimage_invalidate
+ *
+ * Removes an image whose contents turned out to be invalid, so that the
+ * SoundFont is parsed and compiled again the next time it is loaded.
+ */
+void fluid_sfimage_invalidate(fluid_sfimage_t *image)
+{
+    FLUID_LOG(FLUID_ERR, "Invalid compiled SoundFont image '%s', removing it", image->path);
+    remove(image->path);
+}
+
+/*
+ * fluid_sfimage_get_samples
+ *
+ * Fills the sample list of the SoundFont data with the sample headers of the
+ * image, in place of parsing the pdta chunk.
+ */
+int fluid_sfimage_get_samples(fluid_sfimage_t *image, SFData *sfdata)
+{
+    const fluid_sfimage_sample_t *rec = SFIMAGE_TABLE(image, fluid_sfimage_sample_t, SFIMAGE_SAMPLES);
+    int i = image->header.table[SFIMAGE_SAMPLES].count;
+    SFSample *sfsample;
+
+    /* Prepend backwards to keep the order of the samples */
+    while(--i >= 0)
+    {
+        if(rec[i].idx < 0)
+        {
+            return FLUID_FAILED;
+        }
+
+        sfsample = FLUID_NEW(SFSample);
+
+        if(sfsample == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMSET(sfsample, 0, sizeof(*sfsample));
+        FLUID_MEMCPY(sfsample->name, rec[i].name, sizeof(sfsample->name) - 1);
+        sfsample->idx = rec[i].idx;
+        sfsample->start = rec[i].start;
+        sfsample->end = rec[i].end;
+        sfsample->loopstart = rec[i].loopstart;
+        sfsample->loopend = rec[i].loopend;
+        sfsample->samplerate = rec[i].samplerate;
+        sfsample->origpitch = rec[i].origpitch;
+        sfsample->pitchadj = rec[i].pitchadj;
+        sfsample->sampletype = rec[i].sampletype;
+
+        sfdata->sample = fluid_list_prepend(sfdata->sample, sfsample);
+    }
+
+    return FLUID_OK;
+}
+
+/* Number of the i-th stored zone in the file, used for the zone name only */
+static unsigned int sfimage_zone_number(int has_global, unsigned int zone_count, unsigned int i)
+{
+    if(has_global)
+    {
+        return (i == 0) ? 0 : zone_count - i;
+    }
+
+    return zone_count - 1 - i;
+}
+
+static int sfimage_mod_import(fluid_mod_t *mod, const fluid_sfimage_mod_t *rec)
+{
+    if(rec->dest >= GEN_LAST)
+    {
+        return FLUID_FAILED;
+    }
+
+    mod->amount = rec->amount;
+    mod->dest = rec->dest;
+    mod->src1 = rec->src1;
+    mod->flags1 = rec->flags1;
+    mod->src2 = rec->src2;
+    mod->flags2 = rec->flags2;
+    mod->trans = rec->trans;
+    mod->next = NULL;
+    return FLUID_OK;
+}
+
+/*
+ * fluid_sfimage_get_default_mods
+ *
+ * Creates the default modulator list of the SoundFont, if it has one.
+ */
+int fluid_sfimage_get_default_mods(fluid_sfimage_t *image, fluid_mod_t **mod)
+{
+    const fluid_sfimage_mod_t *rec = SFIMAGE_TABLE(image, fluid_sfimage_mod_t, SFIMAGE_DEFAULT_MODS);
+    unsigned int i, count = image->header.table[SFIMAGE_DEFAULT_MODS].count;
+    fluid_mod_t *last = NULL, *mod_dest;
+
+    for(i = 0; i < count; i++)
+    {
+        mod_dest = new_fluid_mod();
+
+        if(mod_dest == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        if(last == NULL)
+        {
+            *mod = mod_dest;
+        }
+        else
+        {
+            last->next = mod_dest;
+        }
+
+        last = mod_dest;
+
+        if(sfimage_mod_import(mod_dest, &rec[i]) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/* Creates the generators, range and modulators of a zone. The arrays of the
+ * zone are stored in gen, range and mod. */
+static int sfimage_zone_import(fluid_sfimage_t *image, fluid_arena_t *arena,
+                               const fluid_sfimage_zone_t *zone,
+                               fluid_gen_t *gen, fluid_zone_range_t *range, fluid_mod_t **mod)
+{
+    const fluid_sfimage_gen_t *gen_rec = SFIMAGE_TABLE(image, fluid_sfimage_gen_t, SFIMAGE_GENS);
+    const fluid_sfimage_mod_t *mod_rec = SFIMAGE_TABLE(image, fluid_sfimage_mod_t, SFIMAGE_MODS);
+    fluid_mod_t *mod_array;
+    unsigned int i;
+
+    if(zone->gen_start > image->header.table[SFIMAGE_GENS].count
+            || zone->gen_count > image->header.table[SFIMAGE_GENS].count - zone->gen_start
+            || zone->mod_start > image->header.table[SFIMAGE_MODS].count
+            || zone->mod_count > image->header.table[SFIMAGE_MODS].count - zone->mod_start)
+    {
+        return FLUID_FAILED;
+    }
+
+    range->keylo = zone->keylo;
+    range->keyhi = zone->keyhi;
+    range->vello = zone->vello;
+    range->velhi = zone->velhi;
+
+    for(i = zone->gen_start; i < zone->gen_start + zone->gen_count; i++)
+    {
+        if(gen_rec[i].id >= GEN_LAST)
+        {
+            return FLUID_FAILED;
+        }
+
+        gen[gen_rec[i].id].val = gen_rec[i].val;
+        gen[gen_rec[i].id].flags = (unsigned char)gen_rec[i].flags;
+    }
+
+    if(zone->mod_count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    mod_array = FLUID_ARENA_ARRAY(arena, fluid_mod_t, zone->mod_count);
+
+    if(mod_array == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < zone->mod_count; i++)
+    {
+        if(sfimage_mod_import(&mod_array[i], &mod_rec[zone->mod_start + i]) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+
+        if(i > 0)
+        {
+            mod_array[i - 1].next = &mod_array[i];
+        }
+    }
+
+    *mod = mod_array;
+    return FLUID_OK;
+}
+
+static fluid_inst_t *sfimage_inst_import(fluid_sfimage_t *image, fluid_defsfont_t *defsfont,
+        const fluid_sfimage_inst_t *rec)
+{
+    const fluid_sfimage_zone_t *zone_rec = SFIMAGE_TABLE(image, fluid_sfimage_zone_t, SFIMAGE_ZONES);
+    fluid_inst_t *inst;
+    fluid_inst_zone_t *inst_zone, *last = NULL;
+    char zone_name[256];
+    unsigned int i;
+    int ref;
+
+    if(rec->zone_start > image->header.table[SFIMAGE_ZONES].count
+            || rec->zone_count > image->header.table[SFIMAGE_ZONES].count - rec->zone_start
+            || (rec->has_global && rec->zone_count == 0))
+    {
+        return NULL;
+    }
+
+    inst = new_fluid_inst(defsfont->arena);
+
+    if(inst == NULL)
+    {
+        return NULL;
+    }
+
+    FLUID_MEMCPY(inst->name, rec->name, sizeof(inst->name) - 1);
+    inst->source_idx = rec->source_idx;
+
+    for(i = 0; i < rec->zone_count; i++)
+    {
+        FLUID_SNPRINTF(zone_name, sizeof(zone_name), "iz:%s/%u", inst->name,
+                       sfimage_zone_number(rec->has_global, rec->zone_count, i));
+        inst_zone = new_fluid_inst_zone(defsfont->arena, zone_name);
+
+        if(inst_zone == NULL
+                || sfimage_zone_import(image, defsfont->arena, &zone_rec[rec->zone_start + i],
+                                       inst_zone->gen, &inst_zone->range, &inst_zone->mod) != FLUID_OK)
+        {
+            return NULL;
+        }
+
+        ref = zone_rec[rec->zone_start + i].ref;
+
+        if(ref >= 0)
+        {
+            if(ref >= defsfont->sfsample_count || defsfont->sfsample[ref] == NULL)
+            {
+                return NULL;
+            }
+
+            inst_zone->sample = defsfont->sfsample[ref]->fluid_sample;
+        }
+
+        if(rec->has_global && i == 0)
+        {
+            inst->global_zone = inst_zone;
+        }
+        else
+        {
+            if(last == NULL)
+            {
+                inst->zone = inst_zone;
+            }
+            else
+            {
+                last->next = inst_zone;
+            }
+
+            last = inst_zone;
+        }
+    }
+
+    return inst;
+}
+
+static fluid_defpreset_t *sfimage_preset_import(fluid_sfimage_t *image, fluid_defsfont_t *defsfont,
+        const fluid_sfimage_preset_t *rec)
+{
+    const fluid_sfimage_zone_t *zone_rec = SFIMAGE_TABLE(image, fluid_sfimage_zone_t, SFIMAGE_ZONES);
+    fluid_defpreset_t *defpreset;
+    fluid_preset_zone_t *zone, *last = NULL;
+    char zone_name[256];
+    unsigned int i;
+    int ref;
+
+    if(rec->zone_start > image->header.table[SFIMAGE_ZONES].count
+            || rec->zone_count > image->header.table[SFIMAGE_ZONES].count - rec->zone_start
+            || (rec->has_global && rec->zone_count == 0))
+    {
+        return NULL;
+    }
+
+    defpreset = new_fluid_defpreset(defsfont->arena);
+
+    if(defpreset == NULL)
+    {
+        return NULL;
+    }
+
+    defpreset->defsfont = defsfont;
+    FLUID_MEMCPY(defpreset->name, rec->name, sizeof(defpreset->name) - 1);
+    defpreset->bank = rec->bank;
+    defpreset->num = rec->num;
+
+    for(i = 0; i < rec->zone_count; i++)
+    {
+        FLUID_SNPRINTF(zone_name, sizeof(zone_name), "pz:%s/%u", defpreset->name,
+                       sfimage_zone_number(rec->has_global, rec->zone_count, i));
+        zone = new_fluid_preset_zone(defsfont->arena, zone_name);
+
+        if(zone == NULL
+                || sfimage_zone_import(image, defsfont->arena, &zone_rec[rec->zone_start + i],
+                                       zone->gen, &zone->range, &zone->mod) != FLUID_OK)
+        {
+            return NULL;
+        }
+
+        ref = zone_rec[rec->zone_start + i].ref;
+
+        if(ref >= 0)
+        {
+            if(ref >= defsfont->inst_count || defsfont->inst[ref] == NULL)
+            {
+                return NULL;
+            }
+
+            zone->inst = defsfont->inst[ref];
+
+            if(fluid_preset_zone_create_voice_zones(zone, defsfont->arena) != FLUID_OK)
+            {
+                return NULL;
+            }
+        }
+
+        if(rec->has_global && i == 0)
+        {
+            defpreset->global_zone = zone;
+        }
+        else
+        {
+            if(last == NULL)
+            {
+                defpreset->zone = zone;
+            }
+            else
+            {
+                last->next = zone;
+            }
+
+            last = zone;
+        }
+    }
+
+    if(fluid_defpreset_build_zone_index(defpreset) != FLUID_OK)
+    {
+        return NULL;
+    }
+
+    return defpreset;
+}
+
+/*
+ * fluid_sfimage_import
+ *
+ * Creates the instruments and presets of the image. The samples of the
+ * SoundFont must have been created from the sample headers of the image.
+ */
+int fluid_sfimage_import(fluid_sfimage_t *image, fluid_defsfont_t *defsfont)
+{
+    const fluid_sfimage_inst_t *inst_rec = SFIMAGE_TABLE(image, fluid_sfimage_inst_t, SFIMAGE_INSTS);
+    const fluid_sfimage_preset_t *preset_rec = SFIMAGE_TABLE(image, fluid_sfimage_preset_t, SFIMAGE_PRESETS);
+    fluid_defpreset_t *defpreset;
+    fluid_inst_t *inst;
+    unsigned int i;
+
+    defsfont->inst = FLUID_ARENA_ARRAY(defsfont->arena, fluid_inst_t *, image->header.inst_table_size);
+
+    if(defsfont->inst == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    defsfont->inst_count = image->header.inst_table_size;
+
+    for(i = 0; i < image->header.table[SFIMAGE_INSTS].count; i++)
+    {
+        if(inst_rec[i].source_idx < 0 || inst_rec[i].source_idx >= defsfont->inst_count)
+        {
+            return FLUID_FAILED;
+        }
+
+        inst = sfimage_inst_import(image, defsfont, &inst_rec[i]);
+
+        if(inst == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        defsfont->inst[inst->source_idx] = inst;
+    }
+
+    for(i = 0; i < image->header.table[SFIMAGE_PRESETS].count; i++)
+    {
+        defpreset = sfimage_preset_import(image, defsfont, &preset_rec[i]);
+
+        if(defpreset == NULL || fluid_defsfont_add_preset(defsfont, defpreset) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/* Appends a zero initialized record to a table being built */
+static void *sfimage_buffer_add(fluid_sfimage_buffer_t *buffer, size_t record_size)
+{
+    char *data;
+    unsigned int size;
+
+    if(buffer->count == buffer->size)
+    {
+        size = (buffer->size > 0) ? 2 * buffer->size : 64;
+        data = FLUID_REALLOC(buffer->data, size * record_size);
+
+        if(data == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return NULL;
+        }
+
+        buffer->data = data;
+        buffer->size = size;
+    }
+
+    data = buffer->data + buffer->count++ * record_size;
+    FLUID_MEMSET(data, 0, record_size);
+    return data;
+}
+
+static int sfimage_mods_save(fluid_sfimage_buffer_t *buffer, fluid_mod_t *mod, unsigned int *count)
+{
+    fluid_sfimage_mod_t *rec;
+
+    for(*count = 0; mod != NULL; mod = mod->next, (*count)++)
+    {
+        rec = sfimage_buffer_add(buffer, sizeof(*rec));
+
+        if(rec == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        rec->amount = mod->amount;
+        rec->dest = mod->dest;
+        rec->src1 = mod->src1;
+        rec->flags1 = mod->flags1;
+        rec->src2 = mod->src2;
+        rec->flags2 = mod->flags2;
+        rec->trans = mod->trans;
+    }
+
+    return FLUID_OK;
+}
+
+static int sfimage_zone_save(fluid_sfimage_buffer_t *tables, const fluid_gen_t *gen,
+                             const fluid_zone_range_t *range, fluid_mod_t *mod, int ref)
+{
+    fluid_sfimage_zone_t *zone = sfimage_buffer_add(&tables[SFIMAGE_ZONES], sizeof(*zone));
+    fluid_sfimage_gen_t *gen_rec;
+    int i;
+
+    if(zone == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    zone->keylo = range->keylo;
+    zone->keyhi = range->keyhi;
+    zone->vello = range->vello;
+    zone->velhi = range->velhi;
+    zone->ref = ref;
+    zone->gen_start = tables[SFIMAGE_GENS].count;
+    zone->mod_start = tables[SFIMAGE_MODS].count;
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        if(gen[i].flags == GEN_UNUSED)
+        {
+            continue;
+        }
+
+        gen_rec = sfimage_buffer_add(&tables[SFIMAGE_GENS], sizeof(*gen_rec));
+
+        if(gen_rec == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        gen_rec->val = gen[i].val;
+        gen_rec->id = i;
+        gen_rec->flags = gen[i].flags;
+        zone->gen_count++;
+    }
+
+    return sfimage_mods_save(&tables[SFIMAGE_MODS], mod, &zone->mod_count);
+}
+
+static int sfimage_inst_save(fluid_sfimage_buffer_t *tables, fluid_inst_t *inst, fluid_hashtable_t *sample_idx)
+{
+    fluid_sfimage_inst_t *rec = sfimage_buffer_add(&tables[SFIMAGE_INSTS], sizeof(*rec));
+    fluid_inst_zone_t *zone;
+    void *idx;
+    int ref;
+
+    if(rec == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(rec->name, inst->name, sizeof(inst->name));
+    rec->source_idx = inst->source_idx;
+    rec->zone_start = tables[SFIMAGE_ZONES].count;
+    rec->has_global = (inst->global_zone != NULL);
+
+    zone = (inst->global_zone != NULL) ? inst->global_zone : inst->zone;
+
+    while(zone != NULL)
+    {
+        /* the sample index table holds the index + 1, 0 means no sample */
+        idx = (zone->sample != NULL) ? fluid_hashtable_lookup(sample_idx, zone->sample) : NULL;
+        ref = FLUID_POINTER_TO_INT(idx) - 1;
+
+        if(sfimage_zone_save(tables, zone->gen, &zone->range, zone->mod, ref) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+
+        zone = (zone == inst->global_zone) ? inst->zone : zone->next;
+    }
+
+    /* the table may have moved */
+    rec = (fluid_sfimage_inst_t *)tables[SFIMAGE_INSTS].data + tables[SFIMAGE_INSTS].count - 1;
+    rec->zone_count = tables[SFIMAGE_ZONES].count - rec->zone_start;
+    return FLUID_OK;
+}
+
+static int sfimage_preset_save(fluid_sfimage_buffer_t *tables, fluid_defpreset_t *defpreset)
+{
+    fluid_sfimage_preset_t *rec = sfimage_buffer_add(&tables[SFIMAGE_PRESETS], sizeof(*rec));
+    fluid_preset_zone_t *zone;
+
+    if(rec == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(rec->name, defpreset->name, sizeof(defpreset->name));
+    rec->bank = defpreset->bank;
+    rec->num = defpreset->num;
+    rec->zone_start = tables[SFIMAGE_ZONES].count;
+    rec->has_global = (defpreset->global_zone != NULL);
+
+    zone = (defpreset->global_zone != NULL) ? defpreset->global_zone : defpreset->zone;
+
+    while(zone != NULL)
+    {
+        if(sfimage_zone_save(tables, zone->gen, &zone->range, zone->mod,
+                             (zone->inst != NULL) ? zone->inst->source_idx : -1) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+
+        zone = (zone == defpreset->global_zone) ? defpreset->zone : zone->next;
+    }
+
+    rec = (fluid_sfimage_preset_t *)tables[SFIMAGE_PRESETS].data + tables[SFIMAGE_PRESETS].count - 1;
+    rec->zone_count = tables[SFIMAGE_ZONES].count - rec->zone_start;
+    return FLUID_OK;
+}
+
+static int sfimage_tables_build(fluid_sfimage_buffer_t *tables, fluid_defsfont_t *defsfont, SFData *sfdata)
+{
+    fluid_hashtable_t *sample_idx;
+    fluid_sfimage_sample_t *sample_rec;
+    fluid_list_t *p;
+    SFSample *sfsample;
+    unsigned int count;
+    int i, ret = FLUID_FAILED;
+
+    sample_idx = new_fluid_hashtable(fluid_direct_hash, fluid_direct_equal);
+
+    if(sample_idx == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    for(p = sfdata->sample; p != NULL; p = fluid_list_next(p))
+    {
+        sfsample = fluid_list_get(p);
+        sample_rec = sfimage_buffer_add(&tables[SFIMAGE_SAMPLES], sizeof(*sample_rec));
+
+        if(sample_rec == NULL)
+        {
+            goto exit;
+        }
+
+        FLUID_MEMCPY(sample_rec->name, sfsample->name, sizeof(sfsample->name));
+        sample_rec->idx = sfsample->idx;
+        sample_rec->start = sfsample->start;
+        sample_rec->end = sfsample->end;
+        sample_rec->loopstart = sfsample->loopstart;
+        sample_rec->loopend = sfsample->loopend;
+        sample_rec->samplerate = sfsample->samplerate;
+        sample_rec->origpitch = sfsample->origpitch;
+        sample_rec->pitchadj = sfsample->pitchadj;
+        sample_rec->sampletype = sfsample->sampletype;
+
+        if(sfsample->fluid_sample != NULL)
+        {
+            fluid_hashtable_insert(sample_idx, sfsample->fluid_sample, FLUID_INT_TO_POINTER(sfsample->idx + 1));
+        }
+    }
+
+    if(sfimage_mods_save(&tables[SFIMAGE_DEFAULT_MODS], defsfont->sfont->default_mod_list, &count) != FLUID_OK)
+    {
+        goto exit;
+    }
+
+    for(i = 0; i < defsfont->inst_count; i++)
+    {
+        if(defsfont->inst[i] != NULL && sfimage_inst_save(tables, defsfont->inst[i], sample_idx) != FLUID_OK)
+        {
+            goto exit;
+        }
+    }
+
+    for(i = 0; i < defsfont->preset_count; i++)
+    {
+        if(sfimage_preset_save(tables, fluid_preset_get_data(defsfont->preset[i])) != FLUID_OK)
+        {
+            goto exit;
+        }
+    }
+
+    ret = FLUID_OK;
+
+exit:
+    delete_fluid_hashtable(sample_idx);
+    return ret;
+}
+
+/*
+ * fluid_sfimage_save
+ *
+ * Stores the imported presets of a SoundFont as compiled image in dir. The
+ * file is written under a temporary name first, so that concurrent processes
+ * never see a partially written image. Failures are not fatal, the images are
+ * best effort.
+ */
+int fluid_sfimage_save(fluid_defsfont_t *defsfont, SFData *sfdata, const char *dir)
+{
+    static const char padding[SFIMAGE_FILE_ALIGN] = { 0 };
+    fluid_sfimage_buffer_t tables[SFIMAGE_TABLE_COUNT];
+    fluid_data_part_t parts[2 + 2 * SFIMAGE_TABLE_COUNT];
+    fluid_sfimage_header_t header;
+    char *path = NULL;
+    size_t size, offset;
+    int i, ret = FLUID_FAILED;
+
+    FLUID_MEMSET(tables, 0, sizeof(tables));
+
+    if(sfimage_header_init(&header, sfdata) != FLUID_OK
+            || sfimage_tables_build(tables, defsfont, sfdata) != FLUID_OK)
+    {
+        goto exit;
+    }
+
+    header.inst_table_size = defsfont->inst_count;
+    offset = header.header_size;
+
+    for(i = 0; i < SFIMAGE_TABLE_COUNT; i++)
+    {
+        size = tables[i].count * sfimage_record_size[i];
+        header.table[i].offset = (unsigned int)offset;
+        header.table[i].count = tables[i].count;
+
+        parts[2 + 2 * i].data = tables[i].data;
+        parts[2 + 2 * i].size = size;
+        parts[3 + 2 * i].data = padding;
+        parts[3 + 2 * i].size = (SFIMAGE_FILE_ALIGN - size % SFIMAGE_FILE_ALIGN) % SFIMAGE_FILE_ALIGN;
+
+        offset += size + parts[3 + 2 * i].size;
+
+        if(offset > 0xffffffffu)
+        {
+            goto exit;
+        }
+    }
+
+    header.image_size = (unsigned int)offset;
+
+    parts[0].data = &header;
+    parts[0].size = sizeof(header);
+    parts[1].data = padding;
+    parts[1].size = header.header_size - sizeof(header);
+
+    path = sfimage_file_path(dir, header.source_hash);
+
+    if(path == NULL)
+    {
+        goto exit;
+    }
+
+    if(fluid_file_write_parts(path, parts, (int)FLUID_N_ELEMENTS(parts)) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_DBG, "Unable to write compiled SoundFont image '%s'", path);
+        goto exit;
+    }
+
+    FLUID_LOG(FLUID_DBG, "Compiled '%s' to '%s'", sfdata->fname, path);
+    ret = FLUID_OK;
+
+exit:
+    for(i = 0; i < SFIMAGE_TABLE_COUNT; i++)
+    {
+        FLUID_FREE(tables[i].data);
+    }
+
+    FLUID_FREE(path);
+    return ret;
+}
@@ -0,0 +1,48 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FLUID_SFIMAGE_H
+#define _FLUID_SFIMAGE_H
+
+#include "fluid_defsfont.h"
+
+/* COMPILED SOUNDFONT IMAGES
+ *
+ * A compiled image holds the imported and validated presets, instruments,
+ * zones, generators and modulators of a SoundFont together with its sample
+ * headers. All references are table indexes, so the image can be mapped and
+ * used in place. Loading a SoundFont from its image skips parsing and
+ * validating the pdta chunk. Images are stored in synth.compiled-sfont-dir
+ * and are only used for the exact file (name, size and modification time)
+ * they were compiled from.
+ */
+
+typedef struct _fluid_sfimage_t fluid_sfimage_t;
+
+fluid_sfimage_t *fluid_sfimage_open(SFData *sfdata, const char *dir);
+void fluid_sfimage_close(fluid_sfimage_t *image);
+void fluid_sfimage_invalidate(fluid_sfimage_t *image);
+int fluid_sfimage_get_samples(fluid_sfimage_t *image, SFData *sfdata);
+int fluid_sfimage_get_default_mods(fluid_sfimage_t *image, fluid_mod_t **mod);
+int fluid_sfimage_import(fluid_sfimage_t *image, fluid_defsfont_t *defsfont);
+
+int fluid_sfimage_save(fluid_defsfont_t *defsfont, SFData *sfdata, const char *dir);
+
+#endif /* _FLUID_SFIMAGE_H */
@@ -21,8 +21,10 @@
 #include "fluid_sys.h"
 #include "fluid_mod.h"
 
+/* The asynchronous load running in the current thread, if any */
+static fluid_private_t sfload_current;
 
-void *default_fopen(const char *path)
+static void *default_fopen(const char *path)
 {
     const char* msg;
     FILE* handle = fluid_file_open(path, &msg);
@@ -55,6 +57,13 @@ int safe_fseek(void *handle, fluid_long_long_t ofs, int whence)
     return fluid_file_seek(handle, ofs, whence);
 }
 
+/* Returns TRUE if files are opened by the default file callbacks, i.e. they are
+ * regular files of the filesystem */
+int fluid_sfont_uses_default_fopen(const fluid_file_callbacks_t *fcbs)
+{
+    return fcbs->fopen == default_fopen;
+}
+
 /**
  * Creates a new SoundFont loader.
  *
@@ -915,3 +924,47 @@ int fluid_sample_sanitize_loop(fluid_sample_t *sample, unsigned int buffer_size)
 
     return modified;
 }
+
+/*
+ * Asynchronous loading
+ *
+ * SoundFont loaders don't know whether they are called by fluid_synth_sfload()
+ * or by the thread of fluid_synth_sfload_async(). The latter registers its load
+ * as thread private data, so that internal loaders can report their progress
+ * and check for cancellation without changing the loader interface.
+ */
+
+void fluid_sfload_init(void)
+{
+    fluid_private_init(sfload_current);
+}
+
+void fluid_sfload_set_current(fluid_sfload_t *load)
+{
+    fluid_private_set(sfload_current, load);
+}
+
+/* Returns the asynchronous load running in the calling thread or NULL */
+fluid_sfload_t *fluid_sfload_get_current(void)
+{
+    return fluid_private_get(sfload_current);
+}
+
+/**
+ * Report the progress of an asynchronous load.
+ * @param load the load as returned by fluid_sfload_get_current(), may be NULL
+ * @param progress fraction of the work that is done, 0.0 to 1.0
+ */
+void fluid_sfload_set_progress(fluid_sfload_t *load, float progress)
+{
+    if(load != NULL)
+    {
+        fluid_atomic_float_set(&load->progress, progress);
+    }
+}
+
+/* Returns TRUE if the loader should stop because the load has been cancelled */
+int fluid_sfload_is_cancelled(fluid_sfload_t *load)
+{
+    return (load != NULL) && fluid_atomic_int_get(&load->cancel);
+}
@@ -22,10 +22,14 @@
 #define _PRIV_FLUID_SFONT_H
 
 #include "fluidsynth.h"
+#include "fluid_sys.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
+
+typedef struct _fluid_samplecodec_t fluid_samplecodec_t;
+
 int fluid_sample_validate(fluid_sample_t *sample, unsigned int max_end);
 int fluid_sample_sanitize_loop(fluid_sample_t *sample, unsigned int max_end);
 
@@ -56,11 +60,10 @@ fluid_sfont_t *new_fluid_sfont_local(fluid_sfont_get_name_t get_name,
   ( ((_preset) && (_preset)->notify) ? (*(_preset)->notify)(_preset,_reason,_chan) : FLUID_OK )
 
 
-#define fluid_sample_incr_ref(_sample) { (_sample)->refcount++; }
+#define fluid_sample_incr_ref(_sample) { fluid_atomic_int_inc(&(_sample)->refcount); }
 
 #define fluid_sample_decr_ref(_sample) \
-  (_sample)->refcount--; \
-  if (((_sample)->refcount == 0) && ((_sample)->notify)) \
+  if (fluid_atomic_int_dec_and_test(&(_sample)->refcount) && ((_sample)->notify)) \
     (*(_sample)->notify)(_sample, FLUID_SAMPLE_DONE);
 
 
@@ -77,6 +80,8 @@ struct _fluid_file_callbacks_t
     fluid_sfloader_callback_tell_t  ftell;
 };
 
+int fluid_sfont_uses_default_fopen(const fluid_file_callbacks_t *fcbs);
+
 /**
  * SoundFont loader structure.
  */
@@ -166,6 +171,7 @@ struct _fluid_sample_t
     unsigned int source_end;
     unsigned int source_loopstart;
     unsigned int source_loopend;
+    uint64_t source_hash;         /* Hash of the data in the file, only set with synth.incremental-reload */
 
     unsigned int start;           /**< Start index */
     unsigned int end;	        /**< End index, index of last valid sample point (contrary to SF spec) */
@@ -183,8 +189,11 @@ struct _fluid_sample_t
     int amplitude_that_reaches_noise_floor_is_valid;      /**< Indicates if \a amplitude_that_reaches_noise_floor is valid (TRUE), set to FALSE initially to calculate. */
     double amplitude_that_reaches_noise_floor;            /**< The amplitude at which the sample's loop will be below the noise floor.  For voice off optimization, calculated automatically. */
 
-    unsigned int refcount;             /**< Count of voices using this sample */
+    fluid_atomic_int_t refcount;       /**< Atomic: count of voices using this sample, of all synths sharing it */
     int preset_count;                  /**< Count of selected presets using this sample (used for dynamic sample loading) */
+    unsigned int stream_preload;       /**< Count of frames at the sample start kept resident when streaming from disk, 0 if the sample isn't streamed */
+    fluid_samplecodec_t *codec;        /**< Compressed sample data that \a data is decoded from while playing, NULL if \a data is fully resident */
+    fluid_atomic_int_t loading;        /**< Atomic: TRUE while the sample data is being loaded in the background (dynamic sample loading) */
     fluid_mod_t *default_modulators;   /**< Default soundfont modulators for this sample to allocate the voice for it. NULL will use the synth's defaults. */
 
     /**
@@ -197,6 +206,29 @@ struct _fluid_sample_t
 };
 
 
+/**
+ * State of an asynchronous SoundFont load, see fluid_synth_sfload_async().
+ */
+struct _fluid_sfload_t
+{
+    fluid_synth_t *synth;           /**< Synth to add the SoundFont to, NULL once the synth has been deleted */
+    char *filename;
+    int reset_presets;
+    fluid_thread_t *thread;         /**< Loader thread, NULL once it has been joined */
+    int sfont_id;                   /**< ID of the SoundFont, once status is #FLUID_SFLOAD_DONE */
+
+    fluid_atomic_int_t status;      /**< Atomic: #fluid_sfload_status */
+    fluid_atomic_int_t cancel;      /**< Atomic: TRUE if the load should be cancelled */
+    fluid_atomic_float_t progress;  /**< Atomic: 0.0 to 1.0, reported by the SoundFont loader */
+};
+
+void fluid_sfload_init(void);
+void fluid_sfload_set_current(fluid_sfload_t *load);
+fluid_sfload_t *fluid_sfload_get_current(void);
+void fluid_sfload_set_progress(fluid_sfload_t *load, float progress);
+int fluid_sfload_is_cancelled(fluid_sfload_t *load);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -58,8 +58,6 @@ extern int feenableexcept(int excepts);
   } \
 
 static void fluid_synth_init(void);
-static void fluid_synth_api_enter(fluid_synth_t *synth);
-static void fluid_synth_api_exit(fluid_synth_t *synth);
 
 static int fluid_synth_noteon_LOCAL(fluid_synth_t *synth, int chan, int key,
                                     int vel);
@@ -105,11 +103,18 @@ fluid_synth_get_preset_by_sfont_name(fluid_synth_t *synth, const char *sfontname
 static void fluid_synth_update_presets(fluid_synth_t *synth);
 static void fluid_synth_update_gain_LOCAL(fluid_synth_t *synth);
 static int fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony);
+static int fluid_synth_alloc_voices_LOCAL(fluid_synth_t *synth, int from, int to);
+static fluid_voice_chunk_t *new_fluid_voice_chunk(fluid_synth_t *synth, int count, fluid_real_t sample_rate);
+static void delete_fluid_voice_chunk(fluid_voice_chunk_t *chunk, int delete_voices);
+static fluid_voice_t *fluid_synth_grow_voice_pool_LOCAL(fluid_synth_t *synth);
+static int fluid_synth_voice_allocator_callback(void *data, unsigned int msec);
+
 
 static fluid_voice_t *fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth);
 static void fluid_synth_kill_by_exclusive_class_LOCAL(fluid_synth_t *synth,
         fluid_voice_t *new_voice);
 static int fluid_synth_sfunload_callback(void *data, unsigned int msec);
+static void fluid_synth_push_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont, int sfont_id, int reset_presets);
 static fluid_tuning_t *fluid_synth_get_tuning(fluid_synth_t *synth,
         int bank, int prog);
 static int fluid_synth_replace_tuning_LOCK(fluid_synth_t *synth,
@@ -158,6 +163,11 @@ static void fluid_synth_set_basic_channel_LOCAL(fluid_synth_t *synth, int basicc
 /* fluid_atomic_int_t may be anything, so init with {0} to catch most cases */
 static fluid_atomic_int_t fluid_synth_initialized = {0};
 
+/* set in a thread while it runs the sample timers of a synth it renders, or
+ * handles timestamped events from its audio callback, see
+ * fluid_synth_in_render_context() */
+static fluid_private_t render_context;
+
 /* default modulators
  * SF2.01 page 52 ff:
  *
@@ -249,6 +259,7 @@ void fluid_synth_settings(fluid_settings_t *settings)
 #endif
 
     fluid_settings_register_int(settings, "synth.polyphony", 256, 1, 65535, 0);
+    fluid_settings_register_int(settings, "synth.polyphony-max", 0, 0, 65535, 0);
     fluid_settings_register_int(settings, "synth.midi-channels", 16, 16, 256, 0);
     fluid_settings_register_num(settings, "synth.gain", 0.2, 0.0, 10.0, 0);
     fluid_settings_register_int(settings, "synth.audio-channels", 1, 1, 128, 0);
@@ -283,6 +294,20 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_add_option(settings, "synth.midi-bank-select", "mma");
 
     fluid_settings_register_int(settings, "synth.dynamic-sample-loading", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.dynamic-sample-loading-async", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.lazy-preset-loading", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-mmap", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-shm", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_str(settings, "synth.sample-cache-dir", "", 0);
+    fluid_settings_register_str(settings, "synth.compiled-sfont-dir", "", 0);
+    fluid_settings_register_int(settings, "synth.sample-cache-size", 0, 0, 65536, 0);
+    fluid_settings_register_int(settings, "synth.sample-dedup", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-compression", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-compression-cache-size", 32, 0, 65536, 0);
+    fluid_settings_register_int(settings, "synth.sample-streaming", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-streaming-preload", 32768, 1024, 16777216, 0);
+    fluid_settings_register_int(settings, "synth.sfont-sharing", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.incremental-reload", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_int(settings, "synth.note-cut", 0, 0, 2, 0);
 
     fluid_settings_register_str(settings, "synth.portamento-time", "auto", 0);
@@ -349,6 +374,9 @@ fluid_synth_init(void)
 
     init_dither();
 
+    fluid_sfload_init();
+    fluid_private_init(render_context);
+
     /* custom_breath2att_mod is not a default modulator specified in SF2.01.
      it is intended to replace default_vel2att_mod on demand using
      API fluid_set_breath_mode() or command shell setbreathmode.
@@ -718,6 +746,7 @@ new_fluid_synth(fluid_settings_t *settings)
     int i, prio_level = 0;
     int with_ladspa = 0;
     int with_limiter = 0;
+    int with_compression = 0;
     double sample_rate_min, sample_rate_max;
 #ifdef SIGNALSMITH_SUPPORT
     fluid_limiter_settings_t limiter_settings;
@@ -791,6 +820,7 @@ new_fluid_synth(fluid_settings_t *settings)
     fluid_settings_getint(settings, "synth.verbose", &synth->verbose);
 
     fluid_settings_getint(settings, "synth.polyphony", &synth->polyphony);
+    fluid_settings_getint(settings, "synth.polyphony-max", &synth->polyphony_max);
     fluid_settings_getnum(settings, "synth.sample-rate", &synth->sample_rate);
     fluid_settings_getnum_range(settings, "synth.sample-rate", &sample_rate_min, &sample_rate_max);
     fluid_settings_getint(settings, "synth.midi-channels", &synth->midi_channels);
@@ -893,6 +923,16 @@ new_fluid_synth(fluid_settings_t *settings)
         synth->audio_groups = 128;
     }
 
+    if(synth->polyphony_max > 0 && synth->polyphony_max <= synth->polyphony)
+    {
+        /* nothing to grow */
+        synth->polyphony_max = 0;
+    }
+
+    /* If the voice pool may grow, all arrays that hold voices are allocated for
+     * the ceiling up front, so that adopting new voices never needs to allocate. */
+    synth->voice_capacity = (synth->polyphony_max > 0) ? synth->polyphony_max : synth->polyphony;
+
     if(synth->effects_channels < 2)
     {
         FLUID_LOG(FLUID_WARN, "Invalid number of effects channels (%d)."
@@ -973,7 +1013,7 @@ new_fluid_synth(fluid_settings_t *settings)
     /* Allocate event queue for rvoice mixer */
     /* In an overflow situation, a new voice takes about 50 spaces in the queue! */
     synth->eventhandler = new_fluid_rvoice_eventhandler(synth->polyphony * 64,
-                          synth->polyphony, synth->audio_groups,
+                          synth->voice_capacity, synth->audio_groups,
                           synth->effects_channels, synth->effects_groups,
                           (fluid_real_t)sample_rate_max, synth->sample_rate,
                           synth->reverb_type,
@@ -1098,24 +1138,36 @@ new_fluid_synth(fluid_settings_t *settings)
         }
     }
 
+    fluid_settings_getint(settings, "synth.sample-streaming", &i);
+    fluid_settings_getint(settings, "synth.sample-compression", &with_compression);
+
+    /* Compressed samples are decoded by the same thread */
+    if(i || with_compression)
+    {
+        /* The I/O thread keeps as much data ahead of each voice as is preloaded */
+        fluid_settings_getint(settings, "synth.sample-streaming-preload", &i);
+        synth->streamer = new_fluid_rvoice_streamer(i);
+
+        if(synth->streamer == NULL)
+        {
+            goto error_recovery;
+        }
+    }
+
     /* allocate all synthesis processes */
     synth->nvoice = synth->polyphony;
-    synth->voice = FLUID_ARRAY(fluid_voice_t *, synth->nvoice);
+    synth->voice = FLUID_ARRAY(fluid_voice_t *, synth->voice_capacity);
 
     if(synth->voice == NULL)
     {
         goto error_recovery;
     }
 
-    FLUID_MEMSET(synth->voice, 0, synth->nvoice * sizeof(*synth->voice));
-    for(i = 0; i < synth->nvoice; i++)
-    {
-        synth->voice[i] = new_fluid_voice(synth->eventhandler, synth->sample_rate, synth->iir_sincos_table);
+    FLUID_MEMSET(synth->voice, 0, synth->voice_capacity * sizeof(*synth->voice));
 
-        if(synth->voice[i] == NULL)
-        {
-            goto error_recovery;
-        }
+    if(fluid_synth_alloc_voices_LOCAL(synth, 0, synth->nvoice) != FLUID_OK)
+    {
+        goto error_recovery;
     }
 
     /* sets a default basic channel */
@@ -1129,7 +1181,7 @@ new_fluid_synth(fluid_settings_t *settings)
 
 
     fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_polyphony,
-                             synth->polyphony, 0.0f);
+                             synth->voice_capacity, 0.0f);
     fluid_synth_reverb_on(synth, -1, synth->with_reverb);
     fluid_synth_chorus_on(synth, -1, synth->with_chorus);
 
@@ -1194,6 +1246,19 @@ new_fluid_synth(fluid_settings_t *settings)
     fluid_iir_filter_init_table(synth->iir_sincos_table, synth->sample_rate);
     fluid_synth_process_event_queue(synth);
 
+    if(synth->polyphony_max > 0)
+    {
+        /* prepares voice chunks in the background, so that the voice pool can grow without allocating in the synthesis thread */
+        synth->voice_allocator = new_fluid_timer(FLUID_VOICE_ALLOCATOR_INTERVAL, fluid_synth_voice_allocator_callback,
+                                 synth, TRUE, FALSE, FALSE);
+
+        if(synth->voice_allocator == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to create the voice allocator thread");
+            goto error_recovery;
+        }
+    }
+
     /* FIXME */
     synth->start = fluid_curtime();
 
@@ -1224,6 +1289,22 @@ delete_fluid_synth(fluid_synth_t *synth)
 
     fluid_profiling_print();
 
+    /* cancel background loads, the loaders and the SoundFont list must stay intact until they are done */
+    for(list = synth->sfloads; list; list = fluid_list_next(list))
+    {
+        fluid_sfload_t *load = fluid_list_get(list);
+
+        fluid_sfload_cancel(load);
+        fluid_sfload_join(load);
+        load->synth = NULL;
+    }
+
+    delete_fluid_list(synth->sfloads);
+    synth->sfloads = NULL;
+
+    /* stop preparing voice chunks before the voices are torn down */
+    delete_fluid_timer(synth->voice_allocator);
+
     /* unregister all realtime settings callback, to avoid a use-after-free when changing those settings after
      * this synth has been deleted*/
 
@@ -1305,6 +1386,10 @@ delete_fluid_synth(fluid_synth_t *synth)
         }
     }
 
+    /* drop the sample references held by streams of finished voices */
+    delete_fluid_rvoice_streamer(synth->streamer);
+    synth->streamer = NULL;
+
     /* also unset all presets for clean SoundFont unload */
     if(synth->channel != NULL)
     {
@@ -1371,6 +1456,16 @@ delete_fluid_synth(fluid_synth_t *synth)
         FLUID_FREE(synth->voice);
     }
 
+    /* the voices of adopted chunks have been deleted above */
+    while(synth->voice_chunks != NULL)
+    {
+        fluid_voice_chunk_t *chunk = synth->voice_chunks;
+        synth->voice_chunks = chunk->next;
+        delete_fluid_voice_chunk(chunk, FALSE);
+    }
+
+    delete_fluid_voice_chunk(synth->voice_chunk_spare, TRUE);
+
     /* free the tunings, if any */
     if(synth->tuning != NULL)
     {
@@ -3948,35 +4043,259 @@ fluid_synth_set_polyphony(fluid_synth_t *synth, int polyphony)
     FLUID_API_RETURN(result);
 }
 
-/* Called by synthesis thread to update the polyphony value */
+/*
+ * Creates a chunk of count voices. Their rvoices are taken from a single arena:
+ * the primary rvoices are packed at the front so that the ones rendered by the
+ * mixer are adjacent, the overflow rvoices follow behind.
+ *
+ * Only touches members of synth that stay constant during its lifetime, hence
+ * it may be called from the voice allocator thread without holding the API
+ * lock as well.
+ */
+static fluid_voice_chunk_t *
+new_fluid_voice_chunk(fluid_synth_t *synth, int count, fluid_real_t sample_rate)
+{
+    fluid_voice_chunk_t *chunk;
+    fluid_rvoice_stream_t *streams;
+    int i;
+
+    chunk = FLUID_NEW(fluid_voice_chunk_t);
+
+    if(chunk == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(chunk, 0, sizeof(*chunk));
+    chunk->sample_rate = sample_rate;
+    chunk->arena = new_fluid_rvoice_arena(2 * count);
+    chunk->voice = FLUID_ARRAY(fluid_voice_t *, count);
+
+    if(chunk->arena == NULL || chunk->voice == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_voice_chunk(chunk, TRUE);
+        return NULL;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        chunk->voice[i] = new_fluid_voice(synth->eventhandler, sample_rate, synth->iir_sincos_table,
+                                          fluid_rvoice_arena_get(chunk->arena, i),
+                                          fluid_rvoice_arena_get(chunk->arena, count + i));
+
+        if(chunk->voice[i] == NULL)
+        {
+            delete_fluid_voice_chunk(chunk, TRUE);
+            return NULL;
+        }
+
+        chunk->count++;
+    }
+
+    if(synth->streamer != NULL)
+    {
+        streams = fluid_rvoice_streamer_new_streams(synth->streamer, 2 * count);
+
+        if(streams == NULL)
+        {
+            delete_fluid_voice_chunk(chunk, TRUE);
+            return NULL;
+        }
+
+        for(i = 0; i < 2 * count; i++)
+        {
+            fluid_rvoice_arena_get(chunk->arena, i)->stream = &streams[i];
+        }
+    }
+
+    return chunk;
+}
+
+/*
+ * Frees a chunk and its rvoices. The voices themselves are only deleted if
+ * delete_voices is TRUE, i.e. if they have not been adopted by synth->voice.
+ */
+static void
+delete_fluid_voice_chunk(fluid_voice_chunk_t *chunk, int delete_voices)
+{
+    int i;
+
+    fluid_return_if_fail(chunk != NULL);
+
+    if(delete_voices && chunk->voice != NULL)
+    {
+        for(i = 0; i < chunk->count; i++)
+        {
+            delete_fluid_voice(chunk->voice[i]);
+        }
+    }
+
+    FLUID_FREE(chunk->voice);
+    delete_fluid_rvoice_arena(chunk->arena);
+    FLUID_FREE(chunk);
+}
+
+/*
+ * Creates the voices synth->voice[from] to synth->voice[to - 1] as one chunk.
+ */
 static int
-fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
+fluid_synth_alloc_voices_LOCAL(fluid_synth_t *synth, int from, int to)
 {
+    fluid_voice_chunk_t *chunk;
+
+    chunk = new_fluid_voice_chunk(synth, to - from, synth->sample_rate);
+
+    if(chunk == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(&synth->voice[from], chunk->voice, chunk->count * sizeof(*chunk->voice));
+    chunk->next = synth->voice_chunks;
+    synth->voice_chunks = chunk;
+
+    return FLUID_OK;
+}
+
+/*
+ * Called by the synthesis thread when all voices are busy. Rather than killing a
+ * voice, the voice pool is grown towards synth.polyphony-max, either by reusing
+ * voices that have already been created or by adopting the chunk the voice
+ * allocator prepared in the background. This never allocates memory.
+ *
+ * Returns the first of the new voices, or NULL if the pool cannot grow right now.
+ */
+static fluid_voice_t *
+fluid_synth_grow_voice_pool_LOCAL(fluid_synth_t *synth)
+{
+    fluid_voice_chunk_t *chunk;
     fluid_voice_t *voice;
     int i;
 
-    if(new_polyphony > synth->nvoice)
+    if(synth->polyphony_max <= 0 || synth->polyphony >= synth->polyphony_max)
+    {
+        return NULL;
+    }
+
+    if(synth->polyphony < synth->nvoice)
     {
-        /* Create more voices */
-        fluid_voice_t **new_voices = FLUID_REALLOC(synth->voice,
-                                     sizeof(fluid_voice_t *) * new_polyphony);
+        int count = synth->nvoice - synth->polyphony;
+
+        voice = synth->voice[synth->polyphony];
+        synth->polyphony += (count < FLUID_VOICE_CHUNK_SIZE) ? count : FLUID_VOICE_CHUNK_SIZE;
+        FLUID_LOG(FLUID_DBG, "Polyphony exceeded, growing voice pool to %d voices", synth->polyphony);
+        return voice;
+    }
+
+    chunk = fluid_atomic_pointer_get(&synth->voice_chunk_spare);
 
-        if(new_voices == NULL)
+    if(chunk == NULL
+            || synth->nvoice + chunk->count > synth->voice_capacity
+            || !fluid_atomic_pointer_compare_and_exchange(&synth->voice_chunk_spare, chunk, NULL))
+    {
+        return NULL;
+    }
+
+    for(i = 0; i < chunk->count; i++)
+    {
+        voice = chunk->voice[i];
+
+        if(chunk->sample_rate != synth->sample_rate)
         {
-            return FLUID_FAILED;
+            fluid_voice_set_output_rate(voice, synth->sample_rate);
         }
 
-        synth->voice = new_voices;
+        fluid_voice_set_custom_filter(voice, synth->custom_filter_type, synth->custom_filter_flags);
+        synth->voice[synth->nvoice + i] = voice;
+    }
 
-        for(i = synth->nvoice; i < new_polyphony; i++)
+    chunk->next = synth->voice_chunks;
+    synth->voice_chunks = chunk;
+
+    voice = synth->voice[synth->nvoice];
+    synth->nvoice += chunk->count;
+    synth->polyphony = synth->nvoice;
+
+    FLUID_LOG(FLUID_DBG, "Polyphony exceeded, growing voice pool to %d voices", synth->polyphony);
+
+    return voice;
+}
+
+/*
+ * Voice allocator thread: keeps one chunk of voices ready for
+ * fluid_synth_grow_voice_pool_LOCAL() until the pool reached synth.polyphony-max.
+ */
+static int
+fluid_synth_voice_allocator_callback(void *data, unsigned int msec)
+{
+    fluid_synth_t *synth = data;
+    fluid_voice_chunk_t *chunk;
+    fluid_real_t sample_rate;
+    int avail;
+
+    if(fluid_atomic_pointer_get(&synth->voice_chunk_spare) != NULL)
+    {
+        /* not adopted yet */
+        return 1;
+    }
+
+    fluid_synth_api_enter(synth);
+    avail = synth->polyphony_max - synth->nvoice;
+    sample_rate = synth->sample_rate;
+    fluid_synth_api_exit(synth);
+
+    if(avail <= 0)
+    {
+        /* pool is full, stop the thread */
+        return 0;
+    }
+
+    /* allocated without holding the lock, a chunk created for an outdated
+     * sample rate is adjusted when it is adopted */
+    chunk = new_fluid_voice_chunk(synth, (avail < FLUID_VOICE_CHUNK_SIZE) ? avail : FLUID_VOICE_CHUNK_SIZE,
+                                  sample_rate);
+
+    if(chunk != NULL)
+    {
+        fluid_atomic_pointer_set(&synth->voice_chunk_spare, chunk);
+    }
+
+    return 1;
+}
+
+/* Called by synthesis thread to update the polyphony value */
+static int
+fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
+{
+    fluid_voice_t *voice;
+    int i;
+
+    if(new_polyphony > synth->nvoice)
+    {
+        if(new_polyphony > synth->voice_capacity)
         {
-            synth->voice[i] = new_fluid_voice(synth->eventhandler, synth->sample_rate, synth->iir_sincos_table);
+            /* Create more voices */
+            fluid_voice_t **new_voices = FLUID_REALLOC(synth->voice,
+                                         sizeof(fluid_voice_t *) * new_polyphony);
 
-            if(synth->voice[i] == NULL)
+            if(new_voices == NULL)
             {
                 return FLUID_FAILED;
             }
 
+            synth->voice = new_voices;
+            synth->voice_capacity = new_polyphony;
+        }
+
+        if(fluid_synth_alloc_voices_LOCAL(synth, synth->nvoice, new_polyphony) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+
+        for(i = synth->nvoice; i < new_polyphony; i++)
+        {
             fluid_voice_set_custom_filter(synth->voice[i], synth->custom_filter_type, synth->custom_filter_flags);
         }
 
@@ -3997,7 +4316,7 @@ fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
     }
 
     fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_polyphony,
-                             synth->polyphony, 0.0f);
+                             synth->voice_capacity, 0.0f);
 
     return FLUID_OK;
 }
@@ -5110,6 +5429,11 @@ fluid_synth_check_finished_voices(fluid_synth_t *synth)
             }
         }
     }
+
+    if(synth->streamer != NULL)
+    {
+        fluid_rvoice_streamer_reclaim(synth->streamer);
+    }
 }
 
 /**
@@ -5123,6 +5447,17 @@ void fluid_synth_process_event_queue(fluid_synth_t *synth)
 }
 
 
+/*
+ * Returns TRUE if the calling thread is rendering a synth, i.e. it runs sample
+ * timers like those of the sequencer or the MIDI player, or handles timestamped
+ * events from the audio callback. Code called from there must never wait or
+ * allocate memory.
+ */
+int fluid_synth_in_render_context(void)
+{
+    return fluid_private_get(render_context) != NULL;
+}
+
 /**
  * Process blocks (FLUID_BUFSIZE) of audio.
  * Must be called from renderer thread only!
@@ -5132,6 +5467,7 @@ int
 fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
 {
     int i, maxblocks;
+    void *outer_context = fluid_private_get(render_context);
     fluid_profile_ref_var(prof_ref);
 
     /* Assign ID of synthesis thread */
@@ -5139,7 +5475,11 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
 
     fluid_check_fpe("??? Just starting up ???");
 
-    fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+    /* events applied from here on must not wait for anything */
+    fluid_private_set(render_context, synth);
+
+    /* events held back by timestamped events stay queued until their block */
+    fluid_rvoice_eventhandler_dispatch_until(synth->eventhandler, fluid_synth_get_ticks(synth) + FLUID_BUFSIZE);
 
     /* do not render more blocks than we can store internally */
     maxblocks = fluid_rvoice_mixer_get_bufcount(synth->eventhandler->mixer);
@@ -5154,10 +5494,12 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
         fluid_sample_timer_process(synth);
         fluid_synth_add_ticks(synth, FLUID_BUFSIZE);
 
-        /* If events have been queued waiting for fluid_rvoice_eventhandler_dispatch_all()
-         * (should only happen with parallel render) stop processing and go for rendering
+        /* If events have been queued waiting for fluid_rvoice_eventhandler_dispatch_until()
+         * (should only happen with parallel render or timestamped events due in the next
+         * block) stop processing and go for rendering
          */
-        if(fluid_rvoice_eventhandler_dispatch_count(synth->eventhandler))
+        if(fluid_rvoice_eventhandler_dispatch_count_until(synth->eventhandler,
+                fluid_synth_get_ticks(synth) + FLUID_BUFSIZE))
         {
             // Something has happened, we can't process more
             blockcount = i + 1;
@@ -5165,6 +5507,8 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
         }
     }
 
+    fluid_private_set(render_context, outer_context);
+
     fluid_check_fpe("fluid_sample_timer_process");
 
     blockcount = fluid_rvoice_mixer_render(synth->eventhandler->mixer, blockcount);
@@ -5317,6 +5661,14 @@ fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth)
         }
     }
 
+    /* all voices busy: grow the voice pool if possible, before killing one */
+    voice = fluid_synth_grow_voice_pool_LOCAL(synth);
+
+    if(voice != NULL)
+    {
+        return voice;
+    }
+
     if(best_voice_index < 0)
     {
         FLUID_LOG(FLUID_DBG, "Polyphony exceeded, failed to find a suitable voice to kill");
@@ -5512,6 +5864,13 @@ fluid_synth_start_voice(fluid_synth_t *synth, fluid_voice_t *voice)
     fluid_synth_kill_by_exclusive_class_LOCAL(synth, voice);
 
     fluid_voice_start(voice);     /* Start the new voice */
+
+    if(synth->start_delay > 0)
+    {
+        /* started by a timestamped event, see fluid_synth_handle_midi_event_at() */
+        fluid_voice_set_start_delay(voice, synth->start_delay);
+    }
+
     fluid_voice_lock_rvoice(voice);
     fluid_rvoice_eventhandler_add_rvoice(synth->eventhandler, voice->rvoice);
     fluid_synth_api_exit(synth);
@@ -5592,17 +5951,7 @@ fluid_synth_sfload(fluid_synth_t *synth, const char *filename, int reset_presets
 
             if(sfont != NULL)
             {
-                sfont->refcount++;
-                synth->sfont_id = sfont->id = sfont_id;
-
-                synth->sfont = fluid_list_prepend(synth->sfont, sfont);   /* prepend to list */
-
-                /* reset the presets for all channels if requested */
-                if(reset_presets)
-                {
-                    fluid_synth_program_reset(synth);
-                }
-
+                fluid_synth_push_sfont(synth, sfont, sfont_id, reset_presets);
                 FLUID_API_RETURN(sfont_id);
             }
         }
@@ -5612,6 +5961,258 @@ fluid_synth_sfload(fluid_synth_t *synth, const char *filename, int reset_presets
     FLUID_API_RETURN(FLUID_FAILED);
 }
 
+/* Puts a loaded SoundFont on top of the SoundFont stack. Must be called within the synth API. */
+static void
+fluid_synth_push_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont, int sfont_id, int reset_presets)
+{
+    sfont->refcount++;
+    synth->sfont_id = sfont->id = sfont_id;
+
+    synth->sfont = fluid_list_prepend(synth->sfont, sfont);   /* prepend to list */
+
+    /* reset the presets for all channels if requested */
+    if(reset_presets)
+    {
+        fluid_synth_program_reset(synth);
+    }
+}
+
+static fluid_thread_return_t
+fluid_synth_sfload_thread(void *data)
+{
+    fluid_sfload_t *load = data;
+    fluid_synth_t *synth = load->synth;
+    fluid_sfont_t *sfont = NULL;
+    fluid_list_t *list;
+    int sfont_id;
+
+    /* Parse the file and load the sample data without holding the synth API lock,
+     * so that the synth stays responsive. MT NOTE: Loaders list should not change. */
+    fluid_sfload_set_current(load);
+
+    for(list = synth->loaders; list != NULL && sfont == NULL; list = fluid_list_next(list))
+    {
+        if(fluid_atomic_int_get(&load->cancel))
+        {
+            break;
+        }
+
+        sfont = fluid_sfloader_load((fluid_sfloader_t *) fluid_list_get(list), load->filename);
+    }
+
+    fluid_sfload_set_current(NULL);
+
+    if(sfont == NULL)
+    {
+        if(fluid_atomic_int_get(&load->cancel))
+        {
+            fluid_atomic_int_set(&load->status, FLUID_SFLOAD_CANCELLED);
+        }
+        else
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to load SoundFont \"%s\"", load->filename);
+            fluid_atomic_int_set(&load->status, FLUID_SFLOAD_FAILED);
+        }
+
+        return FLUID_THREAD_RETURN_VALUE;
+    }
+
+    /* Publish the SoundFont within a single API call, other threads see it
+     * either completely loaded or not at all. */
+    fluid_synth_api_enter(synth);
+
+    sfont_id = synth->sfont_id + 1;
+
+    if(fluid_atomic_int_get(&load->cancel) || sfont_id == FLUID_FAILED)
+    {
+        fluid_synth_api_exit(synth);
+        fluid_sfont_delete_internal(sfont);
+
+        fluid_atomic_int_set(&load->status, (sfont_id == FLUID_FAILED) ? FLUID_SFLOAD_FAILED : FLUID_SFLOAD_CANCELLED);
+        return FLUID_THREAD_RETURN_VALUE;
+    }
+
+    fluid_synth_push_sfont(synth, sfont, sfont_id, load->reset_presets);
+    load->sfont_id = sfont_id;
+
+    fluid_atomic_float_set(&load->progress, 1.0f);
+    fluid_atomic_int_set(&load->status, FLUID_SFLOAD_DONE);
+
+    fluid_synth_api_exit(synth);
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/**
+ * Load a SoundFont file in the background.
+ *
+ * Like fluid_synth_sfload(), but the SoundFont is parsed and its sample data
+ * is loaded by a separate thread, without blocking the caller or other calls
+ * to the synth. Once loading is complete, the SoundFont is put on top of the
+ * SoundFont stack within a single synth API call.
+ *
+ * The returned object can be used to wait for the load, to query its status
+ * and progress or to cancel it. It must be freed with delete_fluid_sfload(),
+ * which cancels the load if it is still in progress. Deleting the synth
+ * cancels all of its loads that haven't finished yet.
+ *
+ * @param synth FluidSynth instance
+ * @param filename File to load
+ * @param reset_presets TRUE to re-assign presets for all MIDI channels once the SoundFont has been added
+ * @return The new load or NULL on error
+ *
+ * @note Progress is only reported and cancellation only takes effect while
+ * loading, if the SoundFont is loaded by the built-in SoundFont 2 loader. For
+ * other loaders, the progress jumps from 0.0 to 1.0 and cancellation only
+ * prevents the SoundFont from being added.
+ *
+ * @since 2.6.0
+ */
+fluid_sfload_t *
+fluid_synth_sfload_async(fluid_synth_t *synth, const char *filename, int reset_presets)
+{
+    fluid_sfload_t *load;
+
+    fluid_return_val_if_fail(synth != NULL, NULL);
+    fluid_return_val_if_fail(filename != NULL, NULL);
+
+    load = FLUID_NEW(fluid_sfload_t);
+
+    if(load == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(load, 0, sizeof(*load));
+    load->synth = synth;
+    load->reset_presets = reset_presets;
+    load->sfont_id = FLUID_FAILED;
+    fluid_atomic_int_set(&load->status, FLUID_SFLOAD_LOADING);
+    fluid_atomic_int_set(&load->cancel, FALSE);
+    fluid_atomic_float_set(&load->progress, 0.0f);
+
+    load->filename = FLUID_STRDUP(filename);
+
+    if(load->filename == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(load);
+        return NULL;
+    }
+
+    fluid_synth_api_enter(synth);
+    synth->sfloads = fluid_list_prepend(synth->sfloads, load);
+    fluid_synth_api_exit(synth);
+
+    load->thread = new_fluid_thread("sfload", fluid_synth_sfload_thread, load, 0, FALSE);
+
+    if(load->thread == NULL)
+    {
+        delete_fluid_sfload(load);
+        return NULL;
+    }
+
+    return load;
+}
+
+/**
+ * Get the status of an asynchronous SoundFont load.
+ * @param load Load as returned by fluid_synth_sfload_async()
+ * @return One of #fluid_sfload_status or #FLUID_FAILED if @p load is NULL
+ * @since 2.6.0
+ */
+int
+fluid_sfload_get_status(fluid_sfload_t *load)
+{
+    fluid_return_val_if_fail(load != NULL, FLUID_FAILED);
+
+    return fluid_atomic_int_get(&load->status);
+}
+
+/**
+ * Get the progress of an asynchronous SoundFont load.
+ * @param load Load as returned by fluid_synth_sfload_async()
+ * @return Fraction of the SoundFont that has been loaded, from 0.0 to 1.0
+ * @since 2.6.0
+ */
+double
+fluid_sfload_get_progress(fluid_sfload_t *load)
+{
+    fluid_return_val_if_fail(load != NULL, 0.0);
+
+    return fluid_atomic_float_get(&load->progress);
+}
+
+/**
+ * Cancel an asynchronous SoundFont load.
+ *
+ * Returns immediately, the load stops at the next opportunity. A SoundFont
+ * that has already been added to the synth is not removed.
+ *
+ * @param load Load as returned by fluid_synth_sfload_async()
+ * @since 2.6.0
+ */
+void
+fluid_sfload_cancel(fluid_sfload_t *load)
+{
+    fluid_return_if_fail(load != NULL);
+
+    fluid_atomic_int_set(&load->cancel, TRUE);
+}
+
+/**
+ * Wait for an asynchronous SoundFont load to finish.
+ * @param load Load as returned by fluid_synth_sfload_async()
+ * @return SoundFont ID if the SoundFont has been added to the synth, #FLUID_FAILED
+ *   if loading failed or has been cancelled
+ *
+ * @note Must not be called concurrently with delete_fluid_sfload() or
+ * delete_fluid_synth().
+ * @since 2.6.0
+ */
+int
+fluid_sfload_join(fluid_sfload_t *load)
+{
+    fluid_return_val_if_fail(load != NULL, FLUID_FAILED);
+
+    if(load->thread != NULL)
+    {
+        fluid_thread_join(load->thread);
+        delete_fluid_thread(load->thread);
+        load->thread = NULL;
+    }
+
+    return (fluid_atomic_int_get(&load->status) == FLUID_SFLOAD_DONE) ? load->sfont_id : FLUID_FAILED;
+}
+
+/**
+ * Delete an asynchronous SoundFont load, cancelling it if it is still in progress.
+ *
+ * A SoundFont that has already been added to the synth is not affected.
+ * May be called before or after the synth has been deleted.
+ *
+ * @param load Load as returned by fluid_synth_sfload_async()
+ * @since 2.6.0
+ */
+void
+delete_fluid_sfload(fluid_sfload_t *load)
+{
+    fluid_return_if_fail(load != NULL);
+
+    fluid_sfload_cancel(load);
+    fluid_sfload_join(load);
+
+    if(load->synth != NULL)
+    {
+        fluid_synth_api_enter(load->synth);
+        load->synth->sfloads = fluid_list_remove(load->synth->sfloads, load);
+        fluid_synth_api_exit(load->synth);
+    }
+
+    FLUID_FREE(load->filename);
+    FLUID_FREE(load);
+}
+
 /**
  * Schedule a SoundFont for unloading.
  *
@@ -5716,8 +6317,89 @@ fluid_synth_sfunload_callback(void *data, unsigned int msec)
     }
 }
 
+/* Returns the index of a SoundFont on the SoundFont stack, or -1 if it isn't on it */
+static int
+fluid_synth_get_sfont_index(fluid_synth_t *synth, fluid_sfont_t *sfont)
+{
+    fluid_list_t *list;
+    int index;
+
+    for(list = synth->sfont, index = 0; list; list = fluid_list_next(list), index++)
+    {
+        if(fluid_list_get(list) == sfont)
+        {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Reloads a SoundFont loaded with synth.incremental-reload by the loader that
+ * loaded it. The file is read without holding the synth API lock, the loaded
+ * SoundFont is only replaced afterwards. Must be called within the synth API,
+ * which is left while loading.
+ */
+static int
+fluid_synth_sfreload_incremental(fluid_synth_t *synth, fluid_sfont_t *sfont)
+{
+    fluid_sfont_t *reloaded = NULL;
+    fluid_list_t *list;
+    int index;
+
+    /* keep the SoundFont while the synth may unload it */
+    sfont->refcount++;
+    fluid_synth_api_exit(synth);
+
+    /* MT NOTE: Loaders list should not change. */
+    for(list = synth->loaders; list != NULL && reloaded == NULL; list = fluid_list_next(list))
+    {
+        reloaded = fluid_defsfloader_reload((fluid_sfloader_t *) fluid_list_get(list), sfont);
+    }
+
+    fluid_synth_api_enter(synth);
+
+    index = fluid_synth_get_sfont_index(synth, sfont);
+
+    if(reloaded != NULL && index >= 0)
+    {
+        reloaded->id = sfont->id;
+        reloaded->bankofs = sfont->bankofs;
+        reloaded->refcount++;
+
+        /* replace the SoundFont at the same index, playing voices keep using the old one */
+        synth->sfont = fluid_list_remove(synth->sfont, sfont);
+        synth->sfont = fluid_list_insert_at(synth->sfont, index, reloaded);
+
+        fluid_synth_update_presets(synth);
+        fluid_synth_sfont_unref(synth, sfont);
+    }
+    else if(reloaded != NULL)
+    {
+        /* unloaded in the meantime */
+        fluid_sfont_delete_internal(reloaded);
+        reloaded = NULL;
+    }
+
+    if(reloaded == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to reload SoundFont \"%s\"", fluid_sfont_get_name(sfont));
+    }
+
+    fluid_synth_sfont_unref(synth, sfont);
+
+    return (reloaded != NULL) ? FLUID_OK : FLUID_FAILED;
+}
+
 /**
  * Reload a SoundFont.  The SoundFont retains its ID and index on the SoundFont stack.
+ *
+ * If the SoundFont has been loaded with \setting{synth_incremental-reload}, only the
+ * data of samples that have been added or modified is loaded again. The SoundFont
+ * also retains its bank offset then, and it stays loaded if reloading it fails. The
+ * file is read without blocking other calls to the synth.
+ *
  * @param synth FluidSynth instance
  * @param id ID of SoundFont to reload
  * @return SoundFont ID on success, #FLUID_FAILED on error
@@ -5751,6 +6433,16 @@ fluid_synth_sfreload(fluid_synth_t *synth, int id)
         goto exit;
     }
 
+    if(fluid_defsfont_can_reload(sfont))
+    {
+        if(fluid_synth_sfreload_incremental(synth, sfont) == FLUID_OK)
+        {
+            ret = id;
+        }
+
+        goto exit;
+    }
+
     /* keep a copy of the SoundFont's filename */
     filename = FLUID_STRDUP(fluid_sfont_get_name(sfont));
 
@@ -7231,6 +7923,32 @@ fluid_synth_get_cpu_load(fluid_synth_t *synth)
     return fluid_atomic_float_get(&synth->cpu_load);
 }
 
+/**
+ * Get usage statistics of the queue passing voice updates to the rendering thread.
+ *
+ * The queue grows on demand when it runs full. Events are only dropped if it
+ * cannot grow any further, if it runs full again before the rendering thread
+ * had a chance to switch over to the grown queue, or if it runs full with events
+ * sent by the rendering thread itself, e.g. by the sequencer or the MIDI player.
+ *
+ * @param synth FluidSynth instance
+ * @param size Location to store the current capacity of the queue in events or NULL
+ * @param high_water Location to store the maximum number of events queued at once or NULL
+ * @param dropped Location to store the number of events dropped so far or NULL
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 2.6.0
+ */
+int
+fluid_synth_get_event_queue_stats(fluid_synth_t *synth, int *size, int *high_water, int *dropped)
+{
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    fluid_rvoice_eventhandler_get_queue_stats(synth->eventhandler, size, high_water, dropped);
+
+    FLUID_API_RETURN(FLUID_OK);
+}
+
 /* Get tuning for a given bank:program */
 static fluid_tuning_t *
 fluid_synth_get_tuning(fluid_synth_t *synth, int bank, int prog)
@@ -8078,6 +8796,201 @@ fluid_synth_handle_midi_event(void *data, fluid_midi_event_t *event)
     return FLUID_FAILED;
 }
 
+/*
+ * Returns the sample tick of the first sample the next call to fluid_synth_process()
+ * (or any fluid_synth_write_*() function) will output, i.e. the current tick minus the
+ * samples that have been rendered but not yet been returned.
+ */
+static unsigned int
+fluid_synth_get_output_ticks(fluid_synth_t *synth)
+{
+    return fluid_synth_get_ticks(synth) - (FLUID_BUFSIZE - synth->cur % FLUID_BUFSIZE) % FLUID_BUFSIZE;
+}
+
+/**
+ * Handle a MIDI event at a given sample position.
+ *
+ * The event is handled right away, but its effect on the audio is held back until
+ * the block that contains sample @p frame is rendered. Voices started by a note-on
+ * event start exactly at @p frame. All other events take effect at the beginning of
+ * that block, i.e. up to fluid_synth_get_internal_bufsize() - 1 samples early.
+ * The state of the synth, like controller values, changes immediately.
+ *
+ * @param synth FluidSynth instance
+ * @param event MIDI event to handle. It is not modified, the caller keeps ownership.
+ * @param frame Offset in samples, relative to the first sample returned by the next call
+ *   to fluid_synth_process() or any of the fluid_synth_write_*() functions. May exceed
+ *   the length of the next call.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise. SYSEX and meta events are not
+ *   supported.
+ *
+ * @note The frame offset is only well defined when this function is called by the thread
+ * that renders the audio, before rendering (e.g. from a JACK process callback), or while
+ * no audio is being rendered.
+ * @note The effects of all events submitted later, timestamped or not, are held back as
+ * well, so timestamped events should be submitted in chronological order. An event whose
+ * frame lies before the frame of an event submitted earlier takes effect in the block of
+ * that event.
+ * @note If previous rendering calls requested a number of samples that is not a multiple of
+ * fluid_synth_get_internal_bufsize(), the first samples returned by the next call have been
+ * rendered already. Events falling into them are applied as soon as possible instead.
+ * @since 2.6.0
+ */
+int
+fluid_synth_handle_midi_event_at(fluid_synth_t *synth, fluid_midi_event_t *event, int frame)
+{
+    int result, type, chan, delay;
+    unsigned int tick;
+    void *outer_context;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(event != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(frame >= 0, FLUID_FAILED);
+
+    type = fluid_midi_event_get_type(event);
+    chan = fluid_midi_event_get_channel(event);
+
+    switch(type)
+    {
+    case NOTE_ON:
+    case NOTE_OFF:
+    case CONTROL_CHANGE:
+    case PROGRAM_CHANGE:
+    case CHANNEL_PRESSURE:
+    case KEY_PRESSURE:
+    case PITCH_BEND:
+        break;
+
+    case MIDI_SYSTEM_RESET:
+        chan = 0;
+        break;
+
+    default:
+        return FLUID_FAILED;
+    }
+
+    FLUID_API_ENTRY_CHAN(FLUID_FAILED);
+
+    tick = fluid_synth_get_output_ticks(synth) + frame;
+    delay = (int)(tick - fluid_synth_get_ticks(synth));
+
+    /* timestamped events are submitted from the audio callback, which must not
+     * allocate memory, e.g. to grow the rvoice event queue */
+    outer_context = fluid_private_get(render_context);
+    fluid_private_set(render_context, synth);
+
+    /* events falling into the next block to be rendered don't need to be held back */
+    if(delay >= FLUID_BUFSIZE
+            && fluid_rvoice_eventhandler_push_wait(synth->eventhandler, tick) != FLUID_OK)
+    {
+        result = FLUID_FAILED;
+    }
+    else
+    {
+        synth->start_delay = (delay > 0) ? delay % FLUID_BUFSIZE : 0;
+        result = fluid_synth_handle_midi_event(synth, event);
+        synth->start_delay = 0;
+    }
+
+    fluid_private_set(render_context, outer_context);
+
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Send a note-on event at a given sample position.
+ *
+ * The note starts exactly at sample @p frame, see fluid_synth_handle_midi_event_at()
+ * for details.
+ * @param synth FluidSynth instance
+ * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @param key MIDI note number (0-127)
+ * @param vel MIDI velocity (0-127, 0=noteoff)
+ * @param frame Offset in samples relative to the first sample returned by the next rendering call
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 2.6.0
+ */
+int
+fluid_synth_noteon_at(fluid_synth_t *synth, int chan, int key, int vel, int frame)
+{
+    fluid_midi_event_t event;
+
+    fluid_return_val_if_fail(key >= 0 && key <= 127, FLUID_FAILED);
+    fluid_return_val_if_fail(vel >= 0 && vel <= 127, FLUID_FAILED);
+
+    FLUID_MEMSET(&event, 0, sizeof(event));
+    fluid_midi_event_set_type(&event, NOTE_ON);
+    fluid_midi_event_set_channel(&event, chan);
+    fluid_midi_event_set_key(&event, key);
+    fluid_midi_event_set_velocity(&event, vel);
+
+    return fluid_synth_handle_midi_event_at(synth, &event, frame);
+}
+
+/**
+ * Send a note-off event at a given sample position.
+ *
+ * The note-off takes effect at the beginning of the block containing sample @p frame,
+ * see fluid_synth_handle_midi_event_at() for details.
+ * @param synth FluidSynth instance
+ * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @param key MIDI note number (0-127)
+ * @param frame Offset in samples relative to the first sample returned by the next rendering call
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 2.6.0
+ */
+int
+fluid_synth_noteoff_at(fluid_synth_t *synth, int chan, int key, int frame)
+{
+    fluid_midi_event_t event;
+
+    fluid_return_val_if_fail(key >= 0 && key <= 127, FLUID_FAILED);
+
+    FLUID_MEMSET(&event, 0, sizeof(event));
+    fluid_midi_event_set_type(&event, NOTE_OFF);
+    fluid_midi_event_set_channel(&event, chan);
+    fluid_midi_event_set_key(&event, key);
+
+    return fluid_synth_handle_midi_event_at(synth, &event, frame);
+}
+
+/**
+ * Handle a batch of MIDI events.
+ *
+ * Equivalent to calling fluid_synth_handle_midi_event() for every event, but the
+ * synth's API is entered only once for the whole batch. Pending voice updates are
+ * handed over to the rendering thread once, after the last event.
+ *
+ * @param synth FluidSynth instance
+ * @param events Array of MIDI events to handle in order
+ * @param count Number of events in @p events
+ * @return #FLUID_OK if all events have been handled successfully, #FLUID_FAILED if at
+ *   least one of them failed. A failing event does not prevent the remaining ones from
+ *   being handled.
+ * @since 2.6.0
+ */
+int
+fluid_synth_handle_midi_events(fluid_synth_t *synth, fluid_midi_event_t **events, int count)
+{
+    int i, result = FLUID_OK;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(events != NULL || count == 0, FLUID_FAILED);
+    fluid_return_val_if_fail(count >= 0, FLUID_FAILED);
+
+    fluid_synth_api_enter(synth);
+
+    for(i = 0; i < count; i++)
+    {
+        if(events[i] == NULL || fluid_synth_handle_midi_event(synth, events[i]) != FLUID_OK)
+        {
+            result = FLUID_FAILED;
+        }
+    }
+
+    FLUID_API_RETURN(result);
+}
+
 /**
  * Create and start voices using an arbitrary preset and a MIDI note on event.
  *
@@ -8118,6 +9031,11 @@ fluid_synth_start(fluid_synth_t *synth, unsigned int id, fluid_preset_t *preset,
         // the preset here. Thus failure is our only option.
         result = FLUID_FAILED;
     }
+    else if(fluid_defsfont_import_preset(preset) == FLUID_FAILED)
+    {
+        /* Presets are imported when selected on a channel, which this one may never have been */
+        result = FLUID_FAILED;
+    }
     else
     {
         synth->storeid = id;
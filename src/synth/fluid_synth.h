@@ -46,6 +46,9 @@
 
 #define FLUID_UNSET_PROGRAM 128  /* Program number used to unset a preset */
 
+#define FLUID_VOICE_CHUNK_SIZE 64        /* Number of voices added at once when the voice pool grows */
+#define FLUID_VOICE_ALLOCATOR_INTERVAL 10 /* Interval of the voice pool allocator thread in ms */
+
 #define FLUID_REVERB_DEFAULT_DAMP 0.2f      /**< Default reverb damping */
 #define FLUID_REVERB_DEFAULT_LEVEL 0.7f     /**< Default reverb level */
 #define FLUID_REVERB_DEFAULT_ROOMSIZE 0.5f  /**< Default reverb room size */
@@ -120,6 +123,20 @@ enum fluid_msgs_note_cut
  *
  */
 
+/*
+ * A block of voices allocated at once, together with the arena backing their rvoices
+ */
+typedef struct _fluid_voice_chunk_t fluid_voice_chunk_t;
+
+struct _fluid_voice_chunk_t
+{
+    fluid_voice_chunk_t *next;
+    fluid_rvoice_arena_t *arena;
+    fluid_voice_t **voice;
+    int count;
+    fluid_real_t sample_rate;          /**< output rate the voices have been created with */
+};
+
 struct _fluid_synth_t
 {
     fluid_rec_mutex_t mutex;           /**< Lock for public API */
@@ -148,16 +165,25 @@ struct _fluid_synth_t
     fluid_list_t *loaders;              /**< the SoundFont loaders */
     fluid_list_t *sfont;                /**< List of fluid_sfont_info_t for each loaded SoundFont (remains until SoundFont is unloaded) */
     int sfont_id;                       /**< Incrementing ID assigned to each loaded SoundFont */
+    fluid_list_t *sfloads;              /**< List of fluid_sfload_t, loads started by fluid_synth_sfload_async() */
     fluid_list_t *fonts_to_be_unloaded; /**< list of timers that try to unload a soundfont */
 
     float gain;                        /**< master gain */
     fluid_channel_t **channel;         /**< the channels */
     int nvoice;                        /**< the length of the synthesis process array (max polyphony allowed) */
     fluid_voice_t **voice;             /**< the synthesis voices */
+    int voice_capacity;                /**< allocated length of the voice array (>= nvoice) */
+    fluid_voice_chunk_t *voice_chunks; /**< chunks owning the voices and their rvoices */
+
+    int polyphony_max;                 /**< soft ceiling for the voice pool to grow to on demand, 0 if disabled */
+    fluid_voice_chunk_t *voice_chunk_spare; /**< Atomic: chunk prepared by the voice allocator, waiting to be adopted */
+    fluid_timer_t *voice_allocator;         /**< background thread preparing voice chunks */
+    fluid_rvoice_streamer_t *streamer;      /**< background thread reading streamed sample data ahead of the voices, NULL if disabled */
     int active_voice_count;            /**< count of active voices */
     unsigned int noteid;               /**< the id is incremented for every new note. it's used for noteoff's  */
     unsigned int storeid;
     int fromkey_portamento;            /**< fromkey portamento */
+    int legato_ignore_count;           /**< count of voices marked with legato_ignore */
     fluid_rvoice_eventhandler_t *eventhandler;
 
     /**< Shadow of reverb parameter: roomsize, damping, width, level */
@@ -166,6 +192,8 @@ struct _fluid_synth_t
     /**< Shadow of chorus parameter: chorus number, level, speed, depth, type */
     double chorus_param[FLUID_CHORUS_PARAM_LAST];
 
+    int start_delay;                         /**< offset in samples within the current block for voices started now */
+
     int cur;                           /**< the current sample in the audio buffers to be output */
     int curmax;                        /**< current amount of samples present in the audio buffers */
     int dither_index;                  /**< current index in random dither value buffer: fluid_synth_(write_s16|dither_s16) */
@@ -297,6 +325,13 @@ void fluid_sample_timer_reset(fluid_synth_t *synth, fluid_sample_timer_t *timer)
 
 void fluid_synth_process_event_queue(fluid_synth_t *synth);
 
+/* Enter and leave the public API, e.g. to handle a batch of events at once.
+ * Calls may be nested, only the outermost exit hands the voice updates over to the rendering thread. */
+void fluid_synth_api_enter(fluid_synth_t *synth);
+void fluid_synth_api_exit(fluid_synth_t *synth);
+
+int fluid_synth_in_render_context(void);
+
 int
 fluid_synth_process_LOCAL(fluid_synth_t *synth, int len, int nfx, float *fx[],
                           int nout, float *out[], int (*block_render_func)(fluid_synth_t *, int));
@@ -320,6 +355,7 @@ int fluid_synth_noteon_mono_LOCAL(fluid_synth_t *synth, int chan, int key, int v
 int fluid_synth_noteoff_mono_LOCAL(fluid_synth_t *synth, int chan, int key);
 int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan, int fromkey, int tokey, int vel);
 int fluid_synth_noteoff_monopoly(fluid_synth_t *synth, int chan, int key, char Mono);
+int fluid_synth_legato_ignores_zone(fluid_synth_t *synth, int chan, const fluid_zone_range_t *zone_range);
 
 fluid_voice_t *
 fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int chan, int key, int vel, fluid_zone_range_t *zone_range);
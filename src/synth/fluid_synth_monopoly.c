@@ -653,7 +653,7 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan,
     fluid_channel_t *channel = synth->channel[chan];
     enum fluid_channel_legato_mode legatomode = channel->legatomode;
     fluid_voice_t *voice;
-    int i ;
+    int i, status;
     /* Gets possible 'fromkey portamento' and possible 'fromkey legato' note  */
     fromkey = fluid_synth_get_fromkey_portamento_legato(channel, fromkey);
 
@@ -695,8 +695,11 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan,
 
                         /* The voice is now used to play tokey in legato manner */
                         /* Marks this Instrument Zone to be ignored during next
-                        fluid_preset_noteon() */
-                        zone_range->ignore = TRUE;
+                        fluid_preset_noteon(). The mark is kept on the voice
+                        rather than on the zone, which may be shared by other
+                        synths (synth.sfont-sharing). */
+                        voice->legato_ignore = TRUE;
+                        synth->legato_ignore_count++;
                         break;
 
                     default: /* Invalid mode: this should never happen */
@@ -716,5 +719,53 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan,
 
     /* May be,tokey will enter in new others Insrument Zone(s),Preset Zone(s), in
        this case it needs to be played by voices allocation  */
-    return fluid_preset_noteon(channel->preset, synth, chan, tokey, vel);
+    status = fluid_preset_noteon(channel->preset, synth, chan, tokey, vel);
+
+    /* Resets the 'ignore' marks */
+    if(synth->legato_ignore_count > 0)
+    {
+        for(i = 0; i < synth->polyphony; i++)
+        {
+            synth->voice[i]->legato_ignore = FALSE;
+        }
+
+        synth->legato_ignore_count = 0;
+    }
+
+    return status;
+}
+
+/**
+ * Checks if an instrument zone is to be ignored by fluid_preset_noteon(), as
+ * its voice is already playing the note in a legato passage (see
+ * fluid_synth_noteon_monopoly_legato()).
+ *
+ * @param synth instance.
+ * @param chan MIDI channel number (0 to MIDI channel count - 1).
+ * @param zone_range the range of the instrument zone.
+ * @return TRUE if the zone is to be ignored, FALSE otherwise.
+ */
+int fluid_synth_legato_ignores_zone(fluid_synth_t *synth, int chan,
+                                    const fluid_zone_range_t *zone_range)
+{
+    fluid_voice_t *voice;
+    int i;
+
+    if(synth->legato_ignore_count == 0)
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        voice = synth->voice[i];
+
+        if(voice->legato_ignore && voice->zone_range == zone_range
+                && fluid_voice_get_channel(voice) == chan)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
 }
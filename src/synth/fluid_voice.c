@@ -153,11 +153,16 @@ fluid_voice_update_modenv(fluid_voice_t *voice,
     }
 }
 
-static FLUID_INLINE void fluid_voice_sample_unref(fluid_sample_t **sample)
+static FLUID_INLINE void fluid_voice_sample_unref(fluid_sample_t **sample, fluid_rvoice_t *rvoice)
 {
     if(*sample != NULL)
     {
-        fluid_sample_decr_ref(*sample);
+        /* If the sample is still being read from disk or locked in memory, the stream keeps the reference for a while */
+        if(rvoice->stream == NULL || fluid_rvoice_stream_stop(rvoice->stream))
+        {
+            fluid_sample_decr_ref(*sample);
+        }
+
         *sample = NULL;
     }
 }
@@ -211,11 +216,19 @@ static void fluid_voice_initialize_rvoice(fluid_voice_t *voice, fluid_real_t out
 
 /*
  * new_fluid_voice
+ *
+ * The rvoice and overflow_rvoice are owned by the caller (usually taken from a
+ * fluid_rvoice_arena_t) and must outlive the voice.
  */
 fluid_voice_t *
-new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate, fluid_iir_sincos_t *sincos_table)
+new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate, fluid_iir_sincos_t *sincos_table,
+                fluid_rvoice_t *rvoice, fluid_rvoice_t *overflow_rvoice)
 {
     fluid_voice_t *voice;
+
+    fluid_return_val_if_fail(rvoice != NULL, NULL);
+    fluid_return_val_if_fail(overflow_rvoice != NULL, NULL);
+
     voice = FLUID_NEW(fluid_voice_t);
 
     if(voice == NULL)
@@ -227,15 +240,8 @@ new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate,
     voice->can_access_rvoice = TRUE;
     voice->can_access_overflow_rvoice = TRUE;
 
-    voice->rvoice = FLUID_NEW(fluid_rvoice_t);
-    voice->overflow_rvoice = FLUID_NEW(fluid_rvoice_t);
-
-    if(voice->rvoice == NULL || voice->overflow_rvoice == NULL)
-    {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        delete_fluid_voice(voice);
-        return NULL;
-    }
+    voice->rvoice = rvoice;
+    voice->overflow_rvoice = overflow_rvoice;
 
     voice->status = FLUID_VOICE_CLEAN;
     voice->chan = NO_CHANNEL;
@@ -268,8 +274,7 @@ delete_fluid_voice(fluid_voice_t *voice)
         FLUID_LOG(FLUID_WARN, "Deleting voice %u which has locked rvoices!", voice->id);
     }
 
-    FLUID_FREE(voice->overflow_rvoice);
-    FLUID_FREE(voice->rvoice);
+    /* rvoices are owned by the arena they were taken from */
     FLUID_FREE(voice);
 }
 
@@ -291,6 +296,7 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
      * generators have been retrieved from the sound font. Here, only
      * the 'working memory' of the voice (position in envelopes, history
      * of IIR filters, position in sample etc) is initialized. */
+    fluid_rvoice_stream_t *stream;
     int i;
 
     if(!voice->can_access_rvoice)
@@ -314,6 +320,7 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
     }
 
     voice->zone_range = inst_zone_range; /* Instrument zone range for legato */
+    voice->legato_ignore = FALSE;
     voice->id = id;
     voice->chan = fluid_channel_get_num(channel);
     voice->key = (unsigned char) key;
@@ -326,6 +333,19 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
     voice->callback_data = NULL;
     UPDATE_RVOICE0(fluid_rvoice_reset);
 
+    if(voice->rvoice->stream != NULL)
+    {
+        /* The rvoice isn't used by the renderer yet, its stream may still be exchanged */
+        stream = fluid_rvoice_stream_start(voice->rvoice->stream, sample);
+
+        if(stream == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        voice->rvoice->stream = stream;
+    }
+
     /*
        We increment the reference count of the sample to indicate that this
        sample is about to be owned by the rvoice. This will prevent the
@@ -1425,7 +1445,7 @@ void fluid_voice_overflow_rvoice_finished(fluid_voice_t *voice)
 
     /* Decrement the reference count of the sample to indicate
        that this sample isn't owned by the rvoice anymore */
-    fluid_voice_sample_unref(&voice->overflow_sample);
+    fluid_voice_sample_unref(&voice->overflow_sample, voice->overflow_rvoice);
 }
 
 /*
@@ -1456,7 +1476,7 @@ fluid_voice_stop(fluid_voice_t *voice)
     /* Decrement the reference count of the sample, to indicate
        that this sample isn't owned by the rvoice anymore.
     */
-    fluid_voice_sample_unref(&voice->sample);
+    fluid_voice_sample_unref(&voice->sample, voice->rvoice);
 
     voice->status = FLUID_VOICE_OFF;
     voice->has_noteoff = 1;
@@ -2081,3 +2101,9 @@ void fluid_voice_set_custom_filter(fluid_voice_t *voice, enum fluid_iir_filter_t
     UPDATE_RVOICE_GENERIC_I2(fluid_iir_filter_init, &voice->rvoice->resonant_custom_filter, type, flags);
 }
 
+
+/* Delays the start of the voice by delay samples within the first block it is rendered in */
+void fluid_voice_set_start_delay(fluid_voice_t *voice, int delay)
+{
+    UPDATE_RVOICE_I1(fluid_rvoice_set_start_delay, delay);
+}
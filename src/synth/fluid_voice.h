@@ -106,6 +106,7 @@ struct _fluid_voice_t
 
     fluid_rvoice_eventhandler_t *eventhandler;
     fluid_zone_range_t *zone_range;  /* instrument zone range*/
+    char legato_ignore;              /* zone_range is played by this voice in a legato passage */
     fluid_sample_t *sample;          /* Pointer to sample (dupe in rvoice) */
     fluid_sample_t *overflow_sample; /* Pointer to sample (dupe in overflow_rvoice) */
 
@@ -124,7 +125,8 @@ struct _fluid_voice_t
 };
 
 
-fluid_voice_t *new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate, fluid_iir_sincos_t *sincos_table);
+fluid_voice_t *new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate, fluid_iir_sincos_t *sincos_table,
+                               fluid_rvoice_t *rvoice, fluid_rvoice_t *overflow_rvoice);
 void delete_fluid_voice(fluid_voice_t *voice);
 
 void fluid_voice_start(fluid_voice_t *voice);
@@ -200,6 +202,7 @@ fluid_voice_unlock_rvoice(fluid_voice_t *voice)
 
 fluid_real_t fluid_voice_gen_value(const fluid_voice_t *voice, int num);
 void fluid_voice_set_custom_filter(fluid_voice_t *voice, enum fluid_iir_filter_type type, enum fluid_iir_filter_flags flags);
+void fluid_voice_set_start_delay(fluid_voice_t *voice, int delay);
 
 #ifdef __cplusplus
 }
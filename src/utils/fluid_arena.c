@@ -0,0 +1,187 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_arena.h"
+
+/* Alignment of the blocks, sufficient for any of the types stored in an arena */
+#define FLUID_ARENA_ALIGN 16
+#define FLUID_ARENA_ROUND(_size) (((_size) + FLUID_ARENA_ALIGN - 1) & ~((size_t)FLUID_ARENA_ALIGN - 1))
+
+typedef struct _fluid_arena_chunk_t fluid_arena_chunk_t;
+
+struct _fluid_arena_chunk_t
+{
+    fluid_arena_chunk_t *next;
+    size_t size;                /* usable bytes following the header */
+    size_t used;                /* bytes handed out */
+};
+
+struct _fluid_arena_t
+{
+    fluid_arena_chunk_t *chunks; /* the chunk blocks are taken from comes first */
+    size_t chunk_size;
+    size_t total;               /* bytes handed out from all chunks */
+};
+
+#define FLUID_ARENA_CHUNK_DATA(_chunk) ((char *)(_chunk) + FLUID_ARENA_ROUND(sizeof(fluid_arena_chunk_t)))
+
+/*
+ * new_fluid_arena
+ */
+fluid_arena_t *
+new_fluid_arena(size_t chunk_size)
+{
+    fluid_arena_t *arena = FLUID_NEW(fluid_arena_t);
+
+    if(arena == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    arena->chunks = NULL;
+    arena->chunk_size = FLUID_ARENA_ROUND(chunk_size);
+    arena->total = 0;
+
+    return arena;
+}
+
+/*
+ * delete_fluid_arena
+ */
+void
+delete_fluid_arena(fluid_arena_t *arena)
+{
+    fluid_arena_chunk_t *chunk;
+
+    fluid_return_if_fail(arena != NULL);
+
+    while((chunk = arena->chunks) != NULL)
+    {
+        arena->chunks = chunk->next;
+        FLUID_FREE(chunk);
+    }
+
+    FLUID_FREE(arena);
+}
+
+static fluid_arena_chunk_t *
+new_fluid_arena_chunk(size_t size)
+{
+    fluid_arena_chunk_t *chunk = FLUID_MALLOC(FLUID_ARENA_ROUND(sizeof(fluid_arena_chunk_t)) + size);
+
+    if(chunk == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+
+    return chunk;
+}
+
+/*
+ * fluid_arena_alloc
+ * Returns a zero initialized block of size bytes that lives as long as the arena.
+ */
+void *
+fluid_arena_alloc(fluid_arena_t *arena, size_t size)
+{
+    fluid_arena_chunk_t *chunk;
+    void *block;
+
+    fluid_return_val_if_fail(arena != NULL, NULL);
+
+    size = FLUID_ARENA_ROUND(size > 0 ? size : 1);
+    chunk = arena->chunks;
+
+    if(chunk == NULL || chunk->size - chunk->used < size)
+    {
+        if(size > arena->chunk_size / 4)
+        {
+            /* Large blocks get a chunk of their own, which is put behind the
+             * current chunk so that its free space isn't lost */
+            chunk = new_fluid_arena_chunk(size);
+
+            if(chunk == NULL)
+            {
+                return NULL;
+            }
+
+            if(arena->chunks != NULL)
+            {
+                chunk->next = arena->chunks->next;
+                arena->chunks->next = chunk;
+            }
+            else
+            {
+                arena->chunks = chunk;
+            }
+        }
+        else
+        {
+            chunk = new_fluid_arena_chunk(arena->chunk_size);
+
+            if(chunk == NULL)
+            {
+                return NULL;
+            }
+
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+    }
+
+    block = FLUID_ARENA_CHUNK_DATA(chunk) + chunk->used;
+    chunk->used += size;
+    arena->total += size;
+
+    FLUID_MEMSET(block, 0, size);
+    return block;
+}
+
+/*
+ * fluid_arena_strdup
+ */
+char *
+fluid_arena_strdup(fluid_arena_t *arena, const char *str)
+{
+    size_t len = FLUID_STRLEN(str) + 1;
+    char *dup = fluid_arena_alloc(arena, len);
+
+    if(dup != NULL)
+    {
+        FLUID_MEMCPY(dup, str, len);
+    }
+
+    return dup;
+}
+
+/*
+ * fluid_arena_get_size
+ * Returns the count of bytes handed out by the arena.
+ */
+size_t
+fluid_arena_get_size(fluid_arena_t *arena)
+{
+    return arena->total;
+}
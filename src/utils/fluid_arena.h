@@ -0,0 +1,50 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLUID_ARENA_H
+#define _FLUID_ARENA_H
+
+#include "fluidsynth_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Memory arena: hands out zero initialized blocks from large chunks. The
+ * blocks cannot be freed individually, all of them are freed at once when the
+ * arena is deleted. Not thread safe.
+ */
+typedef struct _fluid_arena_t fluid_arena_t;
+
+fluid_arena_t *new_fluid_arena(size_t chunk_size);
+void delete_fluid_arena(fluid_arena_t *arena);
+void *fluid_arena_alloc(fluid_arena_t *arena, size_t size);
+char *fluid_arena_strdup(fluid_arena_t *arena, const char *str);
+size_t fluid_arena_get_size(fluid_arena_t *arena);
+
+/* Allocates a zero initialized array of n elements of type t */
+#define FLUID_ARENA_ARRAY(_arena, _t, _n) ((_t *)fluid_arena_alloc((_arena), (_n) * sizeof(_t)))
+#define FLUID_ARENA_NEW(_arena, _t) FLUID_ARENA_ARRAY(_arena, _t, 1)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_ARENA_H */
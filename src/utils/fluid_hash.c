@@ -1404,3 +1404,69 @@ fluid_int_hash(const void *v)
 {
     return *(const int *) v;
 }
+
+/**
+ * fluid_fnv1a:
+ * hash: FLUID_FNV1A_INIT, or the hash of the preceding data
+ * data: the data to hash
+ * size: size of data in bytes
+ *
+ * Continues a 32-bit FNV-1a hash with a block of data. Unlike the hash
+ * functions above, the result only depends on the bytes hashed, which makes it
+ * suitable for keys stored in files.
+ *
+ * Returns: the hash of the preceding data followed by data.
+ */
+unsigned int
+fluid_fnv1a(unsigned int hash, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    size_t i;
+
+    for(i = 0; i < size; i++)
+    {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * fluid_fnv1a_str:
+ * hash: FLUID_FNV1A_INIT, or the hash of the preceding data
+ * str: a NULL-terminated string
+ *
+ * Like fluid_fnv1a(), for the characters of a string.
+ *
+ * Returns: the hash of the preceding data followed by str.
+ */
+unsigned int
+fluid_fnv1a_str(unsigned int hash, const char *str)
+{
+    return fluid_fnv1a(hash, str, FLUID_STRLEN(str));
+}
+
+/**
+ * fluid_fnv1a64:
+ * hash: FLUID_FNV1A64_INIT, or the hash of the preceding data
+ * data: the data to hash
+ * size: size of data in bytes
+ *
+ * Like fluid_fnv1a(), but computes a 64-bit hash, for keys of content that
+ * must not collide.
+ *
+ * Returns: the hash of the preceding data followed by data.
+ */
+uint64_t
+fluid_fnv1a64(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    size_t i;
+
+    for(i = 0; i < size; i++)
+    {
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
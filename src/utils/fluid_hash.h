@@ -126,5 +126,13 @@ unsigned int fluid_direct_hash(const void *v);
 int fluid_int_equal(const void *v1, const void *v2);
 unsigned int fluid_int_hash(const void *v);
 
+/* FNV-1a hashes of byte sequences */
+#define FLUID_FNV1A_INIT 2166136261u
+#define FLUID_FNV1A64_INIT 14695981039346656037ull
+
+unsigned int fluid_fnv1a(unsigned int hash, const void *data, size_t size);
+unsigned int fluid_fnv1a_str(unsigned int hash, const char *str);
+uint64_t fluid_fnv1a64(uint64_t hash, const void *data, size_t size);
+
 #endif /* _FLUID_HASH_H */
 
@@ -1753,6 +1753,656 @@ int fluid_file_seek(FILE *fd, fluid_long_long_t ofs, int whence)
 
 #undef FLUID_PRIi64
 
+/**
+ * Map a region of a file read-only into memory.
+ *
+ * The mapping is shared, so that all processes mapping the same file use the
+ * same physical pages.
+ *
+ * @param filename UTF-8 encoded path of the file to map
+ * @param offset Offset of the region in bytes
+ * @param length Length of the region in bytes
+ * @param map_base Location to store the start of the mapping, to be passed to fluid_file_unmap()
+ * @param map_size Location to store the size of the mapping, to be passed to fluid_file_unmap()
+ * @return Pointer to the region at \a offset, or NULL if the region could not be mapped
+ *   (including platforms without memory mapped files)
+ */
+void *fluid_file_map(const char *filename, fluid_long_long_t offset, size_t length,
+                     void **map_base, size_t *map_size)
+{
+    void *base = NULL;
+    size_t size = 0;
+    fluid_long_long_t aligned_offset = offset;
+    FILE *file;
+
+    fluid_return_val_if_fail(filename != NULL, NULL);
+    fluid_return_val_if_fail(offset >= 0, NULL);
+    fluid_return_val_if_fail(length > 0, NULL);
+
+    file = fluid_file_open(filename, NULL);
+
+    if(file == NULL)
+    {
+        return NULL;
+    }
+
+#if defined(_WIN32)
+    {
+        HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+        HANDLE mapping;
+        LARGE_INTEGER file_size;
+        SYSTEM_INFO info;
+
+        GetSystemInfo(&info);
+        aligned_offset -= offset % info.dwAllocationGranularity;
+        size = (size_t)(offset - aligned_offset) + length;
+
+        if(handle != INVALID_HANDLE_VALUE
+                && GetFileSizeEx(handle, &file_size)
+                && offset + (fluid_long_long_t)length <= file_size.QuadPart
+                && (mapping = CreateFileMapping(handle, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL)
+        {
+            base = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(aligned_offset >> 32),
+                                 (DWORD)(aligned_offset & 0xFFFFFFFF), size);
+            /* the view keeps a reference to the mapping object */
+            CloseHandle(mapping);
+        }
+    }
+#elif defined(HAVE_SYS_MMAN_H) && !defined(__OS2__)
+    {
+        struct stat buf;
+        int fd = fileno(file);
+
+        aligned_offset -= offset % sysconf(_SC_PAGESIZE);
+        size = (size_t)(offset - aligned_offset) + length;
+
+        /* accessing pages beyond the end of the file would raise SIGBUS */
+        if(fstat(fd, &buf) == 0 && offset + (fluid_long_long_t)length <= (fluid_long_long_t)buf.st_size)
+        {
+            base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, (off_t)aligned_offset);
+
+            if(base == MAP_FAILED)
+            {
+                base = NULL;
+            }
+        }
+    }
+#endif
+
+    /* the mapping stays valid after closing the file */
+    FLUID_FCLOSE(file);
+
+    if(base == NULL)
+    {
+        FLUID_LOG(FLUID_DBG, "Failed to map %u bytes of file '%s'", (unsigned int)length, filename);
+        return NULL;
+    }
+
+    *map_base = base;
+    *map_size = size;
+
+    return (char *)base + (offset - aligned_offset);
+}
+
+/**
+ * Unmap a region mapped with fluid_file_map().
+ * @param map_base Start of the mapping, as returned by fluid_file_map()
+ * @param map_size Size of the mapping, as returned by fluid_file_map()
+ */
+void fluid_file_unmap(void *map_base, size_t map_size)
+{
+    fluid_return_if_fail(map_base != NULL);
+
+#if defined(_WIN32)
+    UnmapViewOfFile(map_base);
+#elif defined(HAVE_SYS_MMAN_H) && !defined(__OS2__)
+    munmap(map_base, map_size);
+#endif
+}
+
+/**
+ * Hint the OS that a mapped region will be needed soon, so that it can be read
+ * ahead asynchronously.
+ * @param addr Start of the region, needs not to be page aligned
+ * @param length Length of the region in bytes
+ */
+void fluid_file_map_prefetch(void *addr, size_t length)
+{
+#if defined(HAVE_SYS_MMAN_H) && !defined(__OS2__) && defined(MADV_WILLNEED)
+    uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(page_size - 1);
+
+    madvise((void *)start, length + ((uintptr_t)addr - start), MADV_WILLNEED);
+#endif
+}
+
+/**
+ * Unlock the whole pages within a part of a region locked with fluid_mlock().
+ * Pages the part only covers partially stay locked, as they may hold data
+ * locked for another purpose.
+ * @param addr Start of the part, needs not to be page aligned
+ * @param length Length of the part in bytes
+ */
+void fluid_file_map_unlock(void *addr, size_t length)
+{
+#if defined(HAVE_SYS_MMAN_H) && !defined(__OS2__)
+    uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)addr + page_size - 1) & ~(page_size - 1);
+    uintptr_t end = ((uintptr_t)addr + length) & ~(page_size - 1);
+
+    if(start < end)
+    {
+        fluid_munlock((void *)start, end - start);
+    }
+#endif
+}
+
+/**
+ * Write a file made of the given parts as a whole.
+ *
+ * The parts are written to a temporary file next to path first, which is then
+ * renamed to path, so that concurrent readers never see a partially written
+ * file. The temporary file is removed on failure.
+ *
+ * @param path Path of the file, an existing file is replaced
+ * @param parts The content of the file
+ * @param count Count of parts
+ * @return FLUID_OK on success, FLUID_FAILED otherwise
+ */
+int fluid_file_write_parts(const char *path, const fluid_data_part_t *parts, int count)
+{
+    char *tmp_path;
+    size_t len;
+    FILE *file;
+    unsigned long pid;
+    int i, ok;
+
+    fluid_return_val_if_fail(path != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(parts != NULL, FLUID_FAILED);
+
+#ifdef _WIN32
+    pid = (unsigned long)GetCurrentProcessId();
+#else
+    pid = (unsigned long)getpid();
+#endif
+
+    len = FLUID_STRLEN(path) + 64;
+    tmp_path = FLUID_ARRAY(char, len);
+
+    if(tmp_path == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    /* unique among the threads and processes writing the same file */
+    FLUID_SNPRINTF(tmp_path, len, "%s.%lu.%p.%u", path, pid, (const void *)parts, fluid_curtime());
+
+    file = FLUID_FOPEN(tmp_path, "wb");
+
+    if(file == NULL)
+    {
+        FLUID_FREE(tmp_path);
+        return FLUID_FAILED;
+    }
+
+    ok = TRUE;
+
+    for(i = 0; ok && i < count; i++)
+    {
+        ok = (parts[i].size == 0 || FLUID_FWRITE(parts[i].data, 1, parts[i].size, file) == parts[i].size);
+    }
+
+    ok = (FLUID_FCLOSE(file) == 0) && ok;
+
+    if(!ok || rename(tmp_path, path) != 0)
+    {
+        remove(tmp_path);
+        ok = FALSE;
+    }
+
+    FLUID_FREE(tmp_path);
+
+    return ok ? FLUID_OK : FLUID_FAILED;
+}
+
+#if HAVE_SHM_OPEN
+/* A shared memory segment mapped by this process. The read lock on fd tells
+ * other processes that the segment is in use, it is held as long as the
+ * segment is mapped. As record locks belong to the process and closing any
+ * descriptor of a segment releases them, each segment is mapped only once and
+ * the mapping is shared by all its users within the process. */
+typedef struct _fluid_shm_mapping_t fluid_shm_mapping_t;
+
+struct _fluid_shm_mapping_t
+{
+    char *name;
+    int fd;
+    void *base;
+    size_t length;
+    int refs;
+    fluid_shm_mapping_t *next;
+};
+
+/* Serializes creating, mapping and unmapping shared memory segments within this
+ * process, as the record locks used between processes don't apply within a
+ * process. Also protects shm_mappings. */
+static fluid_mutex_t shm_mutex = FLUID_MUTEX_INIT;
+static fluid_shm_mapping_t *shm_mappings = NULL;
+
+/* Locks the whole segment. If wait is TRUE, waits for conflicting locks of
+ * other processes, otherwise fails if there are any. */
+static int fluid_shm_lock(int fd, short type, int wait)
+{
+    struct flock lock;
+
+    FLUID_MEMSET(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+
+    while(fcntl(fd, wait ? F_SETLKW : F_SETLK, &lock) != 0)
+    {
+        if(errno != EINTR)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
+/* Registers a read-only mapping of a segment whose descriptor holds a read
+ * lock. Takes ownership of fd. Returns NULL on failure. */
+static fluid_shm_mapping_t *fluid_shm_add_mapping(const char *name, int fd, void *base, size_t length)
+{
+    fluid_shm_mapping_t *mapping = FLUID_NEW(fluid_shm_mapping_t);
+
+    if(mapping == NULL || (mapping->name = FLUID_STRDUP(name)) == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(mapping);
+        munmap(base, length);
+        close(fd);
+        return NULL;
+    }
+
+    mapping->fd = fd;
+    mapping->base = base;
+    mapping->length = length;
+    mapping->refs = 1;
+    mapping->next = shm_mappings;
+    shm_mappings = mapping;
+
+    return mapping;
+}
+
+/* Checks whether the name of a segment still refers to the segment of fd, it
+ * might have been replaced meanwhile */
+static int fluid_shm_is_named(int fd, const char *name)
+{
+    struct stat buf, named_buf;
+    fluid_shm_mapping_t *mapping;
+    int named_fd, ret;
+
+    /* Another segment of that name mapped by this process replaced this one,
+     * and opening it would release the read lock on it when closed */
+    for(mapping = shm_mappings; mapping != NULL; mapping = mapping->next)
+    {
+        if(FLUID_STRCMP(mapping->name, name) == 0)
+        {
+            return FALSE;
+        }
+    }
+
+    named_fd = shm_open(name, O_RDONLY, 0);
+
+    if(named_fd < 0)
+    {
+        return FALSE;
+    }
+
+    ret = (fstat(fd, &buf) == 0 && fstat(named_fd, &named_buf) == 0
+           && buf.st_dev == named_buf.st_dev && buf.st_ino == named_buf.st_ino);
+
+    /* this also releases the read lock on fd */
+    close(named_fd);
+
+    return ret;
+}
+#endif
+
+/**
+ * Create a named shared memory segment, filled with the given parts, and map it
+ * read-only into memory like fluid_shm_map().
+ *
+ * The segment is only accessible by its owner, other processes map it
+ * read-only with fluid_shm_map(). It is locked while being filled,
+ * fluid_shm_map() waits for it to be complete. The parts
+ * are copied last to first, so that a segment whose creator was killed while
+ * filling it can be recognized by an incomplete first part.
+ *
+ * @param name Name of the segment, starting with a slash
+ * @param parts The content of the segment
+ * @param count Count of parts
+ * @param length Location to store the size of the segment
+ * @return Start of the mapping, to be passed to fluid_shm_unmap(), or NULL if
+ *   the segment already exists or could not be created (including platforms
+ *   without POSIX shared memory)
+ */
+void *fluid_shm_create(const char *name, const fluid_data_part_t *parts, int count, size_t *length)
+{
+    void *ret = NULL;
+
+    fluid_return_val_if_fail(name != NULL, NULL);
+    fluid_return_val_if_fail(parts != NULL, NULL);
+    fluid_return_val_if_fail(length != NULL, NULL);
+
+#if HAVE_SHM_OPEN
+    {
+        fluid_shm_mapping_t *mapping;
+        size_t size = 0, offset;
+        char *base;
+        int i, fd;
+
+        for(i = 0; i < count; i++)
+        {
+            size += parts[i].size;
+        }
+
+        fluid_return_val_if_fail(size > 0, NULL);
+
+        fluid_mutex_lock(shm_mutex);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+
+        if(fd >= 0)
+        {
+            if(fluid_shm_lock(fd, F_WRLCK, TRUE) == FLUID_OK && ftruncate(fd, (off_t)size) == 0
+                    && (base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) != MAP_FAILED)
+            {
+                for(i = count - 1, offset = size; i >= 0; i--)
+                {
+                    offset -= parts[i].size;
+                    FLUID_MEMCPY(base + offset, parts[i].data, parts[i].size);
+                }
+
+                /* turning the write lock into a read lock is atomic, the
+                 * segment can't be removed by another process in between */
+                if(mprotect(base, size, PROT_READ) == 0 && fluid_shm_lock(fd, F_RDLCK, TRUE) == FLUID_OK)
+                {
+                    mapping = fluid_shm_add_mapping(name, fd, base, size);
+                    fd = -1;
+
+                    if(mapping != NULL)
+                    {
+                        ret = base;
+                        *length = size;
+                    }
+                }
+                else
+                {
+                    munmap(base, size);
+                }
+            }
+
+            if(ret == NULL)
+            {
+                shm_unlink(name);
+            }
+
+            if(fd >= 0)
+            {
+                close(fd);
+            }
+        }
+
+        fluid_mutex_unlock(shm_mutex);
+    }
+#endif
+
+    if(ret == NULL)
+    {
+        FLUID_LOG(FLUID_DBG, "Failed to create shared memory segment '%s'", name);
+    }
+
+    return ret;
+}
+
+/**
+ * Map an existing named shared memory segment read-only into memory.
+ *
+ * Only segments owned by the effective user of this process are mapped, so that
+ * other users can't make this process use data of their choice. The segment
+ * is kept as long as any process maps it.
+ *
+ * @param name Name of the segment, starting with a slash
+ * @param length Location to store the size of the segment
+ * @return Start of the mapping, to be passed to fluid_shm_unmap(), or NULL if
+ *   the segment could not be mapped
+ */
+void *fluid_shm_map(const char *name, size_t *length)
+{
+    void *base = NULL;
+
+    fluid_return_val_if_fail(name != NULL, NULL);
+    fluid_return_val_if_fail(length != NULL, NULL);
+
+#if HAVE_SHM_OPEN
+    {
+        fluid_shm_mapping_t *mapping;
+        struct stat buf;
+        int fd;
+
+        fluid_mutex_lock(shm_mutex);
+
+        for(mapping = shm_mappings; mapping != NULL; mapping = mapping->next)
+        {
+            if(FLUID_STRCMP(mapping->name, name) == 0)
+            {
+                mapping->refs++;
+                *length = mapping->length;
+                base = mapping->base;
+                break;
+            }
+        }
+
+        /* opened for writing only to be able to take a write lock on the
+         * last unmap, the mapping itself is read-only */
+        fd = (base == NULL) ? shm_open(name, O_RDWR, 0) : -1;
+
+        if(fd >= 0)
+        {
+            /* A segment that is still empty once the lock is taken is being
+             * created right now, its creator hasn't locked it yet */
+            if(fluid_shm_lock(fd, F_RDLCK, TRUE) == FLUID_OK
+                    && fstat(fd, &buf) == 0 && buf.st_uid == geteuid() && buf.st_size > 0)
+            {
+                base = mmap(NULL, (size_t)buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+                if(base == MAP_FAILED)
+                {
+                    base = NULL;
+                }
+                else if(fluid_shm_add_mapping(name, fd, base, (size_t)buf.st_size) == NULL)
+                {
+                    base = NULL;
+                    fd = -1;
+                }
+                else
+                {
+                    *length = (size_t)buf.st_size;
+                    fd = -1;
+                }
+            }
+
+            if(fd >= 0)
+            {
+                close(fd);
+            }
+        }
+
+        fluid_mutex_unlock(shm_mutex);
+    }
+#endif
+
+    return base;
+}
+
+/**
+ * Unmap a segment mapped with fluid_shm_create() or fluid_shm_map().
+ *
+ * Once no process maps the segment any more, its name is removed, so that
+ * the memory is freed.
+ *
+ * @param base Start of the mapping
+ */
+void fluid_shm_unmap(void *base)
+{
+    fluid_return_if_fail(base != NULL);
+
+#if HAVE_SHM_OPEN
+    {
+        fluid_shm_mapping_t *mapping, **prev;
+
+        fluid_mutex_lock(shm_mutex);
+
+        for(prev = &shm_mappings; *prev != NULL; prev = &(*prev)->next)
+        {
+            if((*prev)->base == base)
+            {
+                break;
+            }
+        }
+
+        mapping = *prev;
+
+        if(mapping != NULL && --mapping->refs == 0)
+        {
+            *prev = mapping->next;
+            munmap(mapping->base, mapping->length);
+
+            /* Other processes using the segment hold a read lock on it */
+            if(fluid_shm_is_named(mapping->fd, mapping->name)
+                    && fluid_shm_lock(mapping->fd, F_WRLCK, FALSE) == FLUID_OK)
+            {
+                FLUID_LOG(FLUID_DBG, "Removing unused shared memory segment '%s'", mapping->name);
+                shm_unlink(mapping->name);
+            }
+
+            close(mapping->fd);
+            FLUID_FREE(mapping->name);
+            FLUID_FREE(mapping);
+        }
+
+        fluid_mutex_unlock(shm_mutex);
+    }
+#endif
+}
+
+/**
+ * Remove the name of a shared memory segment created with fluid_shm_create().
+ * Existing mappings of the segment stay valid.
+ * @param name Name of the segment
+ */
+void fluid_shm_unlink(const char *name)
+{
+    fluid_return_if_fail(name != NULL);
+
+#if HAVE_SHM_OPEN
+    shm_unlink(name);
+#endif
+}
+
+/**
+ * Reserve a zero-filled memory region, whose pages are only backed by physical
+ * memory once they are written to.
+ * @param length Length of the region in bytes
+ * @return Start of the region, or NULL if it could not be reserved (including
+ *   platforms without virtual memory management)
+ */
+void *fluid_mem_reserve(size_t length)
+{
+    void *addr = NULL;
+
+    fluid_return_val_if_fail(length > 0, NULL);
+
+#if defined(_WIN32)
+    /* committed pages are only assigned physical memory on first access */
+    addr = VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif defined(HAVE_SYS_MMAN_H) && !defined(__OS2__) && defined(MAP_ANONYMOUS)
+#ifdef MAP_NORESERVE
+    addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+#else
+    addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#endif
+
+    if(addr == MAP_FAILED)
+    {
+        addr = NULL;
+    }
+#endif
+
+    if(addr == NULL)
+    {
+        FLUID_LOG(FLUID_DBG, "Failed to reserve %u bytes of memory", (unsigned int)length);
+    }
+
+    return addr;
+}
+
+/**
+ * Free a region reserved with fluid_mem_reserve().
+ * @param addr Start of the region, as returned by fluid_mem_reserve()
+ * @param length Length of the region, as passed to fluid_mem_reserve()
+ */
+void fluid_mem_unreserve(void *addr, size_t length)
+{
+    fluid_return_if_fail(addr != NULL);
+
+#if defined(_WIN32)
+    VirtualFree(addr, 0, MEM_RELEASE);
+#elif defined(HAVE_SYS_MMAN_H) && !defined(__OS2__) && defined(MAP_ANONYMOUS)
+    munmap(addr, length);
+#endif
+}
+
+/**
+ * Give the physical memory backing a part of a region reserved with
+ * fluid_mem_reserve() back to the operating system. Only whole pages within the
+ * part are affected, their content is undefined afterwards. The region stays
+ * accessible.
+ * @param addr Start of the part, needs not to be page aligned
+ * @param length Length of the part in bytes
+ */
+void fluid_mem_discard(void *addr, size_t length)
+{
+    uintptr_t page_size, start, end;
+
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    page_size = info.dwPageSize;
+#elif defined(HAVE_SYS_MMAN_H) && !defined(__OS2__) && defined(MAP_ANONYMOUS)
+    page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+#else
+    return;
+#endif
+
+    start = ((uintptr_t)addr + page_size - 1) & ~(page_size - 1);
+    end = ((uintptr_t)addr + length) & ~(page_size - 1);
+
+    if(start >= end)
+    {
+        return;
+    }
+
+#if defined(_WIN32)
+    VirtualAlloc((void *)start, end - start, MEM_RESET, PAGE_READWRITE);
+#elif defined(HAVE_SYS_MMAN_H) && !defined(__OS2__) && defined(MAP_ANONYMOUS)
+    madvise((void *)start, end - start, MADV_DONTNEED);
+#endif
+}
+
 #if defined(_WIN32) || defined(__CYGWIN__)
 // not thread-safe!
 #define FLUID_WINDOWS_MEX_ERROR_LEN    1024
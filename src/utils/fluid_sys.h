@@ -309,10 +309,33 @@ fluid_istream_t fluid_socket_get_istream(fluid_socket_t sock);
 fluid_ostream_t fluid_socket_get_ostream(fluid_socket_t sock);
 
 /* File access */
+typedef struct
+{
+    const void *data;
+    size_t size;
+} fluid_data_part_t;
+
 FILE* fluid_file_open(const char* filename, const char** errMsg);
 fluid_long_long_t fluid_file_tell(FILE* f);
 int fluid_file_read(void *buf, fluid_long_long_t count, FILE *fd);
 int fluid_file_seek(FILE *fd, fluid_long_long_t ofs, int whence);
+void *fluid_file_map(const char *filename, fluid_long_long_t offset, size_t length,
+                     void **map_base, size_t *map_size);
+void fluid_file_unmap(void *map_base, size_t map_size);
+void fluid_file_map_prefetch(void *addr, size_t length);
+void fluid_file_map_unlock(void *addr, size_t length);
+int fluid_file_write_parts(const char *path, const fluid_data_part_t *parts, int count);
+
+/* Named shared memory */
+void *fluid_shm_create(const char *name, const fluid_data_part_t *parts, int count, size_t *length);
+void *fluid_shm_map(const char *name, size_t *length);
+void fluid_shm_unmap(void *base);
+void fluid_shm_unlink(const char *name);
+
+/* Lazily committed memory */
+void *fluid_mem_reserve(size_t length);
+void fluid_mem_unreserve(void *addr, size_t length);
+void fluid_mem_discard(void *addr, size_t length);
 
 
 /* Profiling */
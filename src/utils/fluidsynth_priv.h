@@ -200,6 +200,7 @@ void* fluid_alloc(size_t len);
 #define FLUID_FOPEN(_f,_m)           fluid_fopen(_f,_m)
 #define FLUID_FCLOSE(_f)             fclose(_f)
 #define FLUID_FREAD(_p,_s,_n,_f)     fread(_p,_s,_n,_f)
+#define FLUID_FWRITE(_p,_s,_n,_f)    fwrite(_p,_s,_n,_f)
 
 FILE *fluid_fopen(const char *filename, const char *mode);
 
@@ -207,6 +208,8 @@ FILE *fluid_fopen(const char *filename, const char *mode);
 
 /* Memory functions */
 #define FLUID_MEMCPY(_dst,_src,_n)   memcpy(_dst,_src,_n)
+#define FLUID_MEMMOVE(_dst,_src,_n)  memmove(_dst,_src,_n)
+#define FLUID_MEMCMP(_s1,_s2,_n)     memcmp(_s1,_s2,_n)
 #define FLUID_MEMSET(_s,_c,_n)       memset(_s,_c,_n)
 
 /* String functions */
@@ -338,9 +338,9 @@ static void dump_defsfont(fluid_defsfont_t *defsfont)
     fmt("sample24size: %u", defsfont->sample24size);
 
     fmt("presets:");
-    for (i = 0, list = defsfont->preset; list; list = fluid_list_next(list), i++)
+    for (i = 0; i < defsfont->preset_count; i++)
     {
-        preset = (fluid_preset_t *)fluid_list_get(list);
+        preset = defsfont->preset[i];
         fmt("- preset: %d", i);
         if (preset == NULL)
         {
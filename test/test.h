@@ -27,3 +27,55 @@
 
 /* macro to test whether a fluidsynth function succeeded or not */
 #define TEST_SUCCESS(FLUID_FUNCT) TEST_ASSERT((FLUID_FUNCT) != FLUID_FAILED)
+
+#include "fluidsynth.h"
+
+/* Stereo frames rendered by test_render() */
+#define TEST_RENDER_FRAMES 4096
+
+/* A note played by test_render(). Unless prog is -1, the program of the
+ * channel is changed before the note is played. */
+typedef struct
+{
+    int chan;
+    int prog;
+    int key;
+    int vel;
+} test_note_t;
+
+/* Plays the notes and renders TEST_RENDER_FRAMES interleaved stereo frames
+ * into buf, which must hold 2 * TEST_RENDER_FRAMES floats */
+static inline void test_render(fluid_synth_t *synth, const test_note_t *notes, int count, float *buf)
+{
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        if(notes[i].prog != -1)
+        {
+            TEST_SUCCESS(fluid_synth_program_change(synth, notes[i].chan, notes[i].prog));
+        }
+
+        TEST_SUCCESS(fluid_synth_noteon(synth, notes[i].chan, notes[i].key, notes[i].vel));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, TEST_RENDER_FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+/* test_render() with an array of notes */
+#define TEST_RENDER(SYNTH, NOTES, BUF) test_render(SYNTH, NOTES, (int)(sizeof(NOTES) / sizeof((NOTES)[0])), BUF)
+
+/* Asserts that a render of test_render() is identical to the reference render,
+ * which must not be silent */
+static inline void test_compare_render(const float *ref, const float *buf)
+{
+    int i, silent = 1;
+
+    for(i = 0; i < 2 * TEST_RENDER_FRAMES; i++)
+    {
+        TEST_ASSERT(ref[i] == buf[i]);
+        silent = silent && (ref[i] == 0);
+    }
+
+    TEST_ASSERT(!silent);
+}
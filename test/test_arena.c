@@ -0,0 +1,47 @@
+#include "test.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_arena.h"
+
+/* Test the allocation of blocks from a memory arena */
+int main(void)
+{
+    int i;
+    char *str;
+    double *small[1000];
+    char *large;
+    fluid_arena_t *arena = new_fluid_arena(1024);
+
+    TEST_ASSERT(arena != NULL);
+    TEST_ASSERT(fluid_arena_get_size(arena) == 0);
+
+    /* blocks are aligned, zeroed and don't overlap */
+    for(i = 0; i < 1000; i++)
+    {
+        small[i] = FLUID_ARENA_ARRAY(arena, double, 3);
+        TEST_ASSERT(small[i] != NULL);
+        TEST_ASSERT(((uintptr_t)small[i] % sizeof(double)) == 0);
+        TEST_ASSERT(small[i][0] == 0.0 && small[i][1] == 0.0 && small[i][2] == 0.0);
+        small[i][0] = small[i][1] = small[i][2] = i;
+    }
+
+    /* blocks larger than a chunk get one of their own */
+    large = fluid_arena_alloc(arena, 100000);
+    TEST_ASSERT(large != NULL);
+    FLUID_MEMSET(large, 0xff, 100000);
+
+    for(i = 0; i < 1000; i++)
+    {
+        TEST_ASSERT(small[i][0] == i && small[i][2] == i);
+    }
+
+    str = fluid_arena_strdup(arena, "fluidsynth");
+    TEST_ASSERT(str != NULL);
+    TEST_ASSERT(FLUID_STRCMP(str, "fluidsynth") == 0);
+
+    TEST_ASSERT(fluid_arena_get_size(arena) >= 1000 * 3 * sizeof(double) + 100000 + 11);
+
+    delete_fluid_arena(arena);
+    delete_fluid_arena(NULL);
+
+    return EXIT_SUCCESS;
+}
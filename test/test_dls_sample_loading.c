@@ -0,0 +1,79 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+
+static const test_note_t notes[] =
+{
+    { 0, -1, 60, 127 },
+    { 0, -1, 67, 100 }
+};
+
+static fluid_synth_t *load(fluid_settings_t *settings, int reset_presets, int *id)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(*id = fluid_synth_sfload(synth, TEST_DLS, reset_presets));
+
+    return synth;
+}
+
+// this test makes sure that the DLS loader shares the sample data of a file
+// through the sample cache, and that it loads the samples of presets on demand
+// with synth.dynamic-sample-loading
+int main(void)
+{
+#ifdef ENABLE_NATIVE_DLS
+    static float buf[TEST_RENDER_FRAMES * 2], dynamic_buf[TEST_RENDER_FRAMES * 2];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_settings_t *dynamic_settings = new_fluid_settings();
+    fluid_synth_t *synth1, *synth2, *dynamic_synth;
+    int id, dynamic_id, count;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(dynamic_settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(dynamic_settings, "synth.dynamic-sample-loading", 1));
+
+    // nothing is loaded until a preset is selected
+    dynamic_synth = load(dynamic_settings, 0, &dynamic_id);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    TEST_SUCCESS(fluid_synth_program_select(dynamic_synth, 0, dynamic_id, 0, 0));
+    count = fluid_samplecache_count_entries();
+    TEST_ASSERT(count > 0);
+
+    // unselecting the preset unloads its samples
+    TEST_SUCCESS(fluid_synth_unset_program(dynamic_synth, 0));
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    TEST_SUCCESS(fluid_synth_program_select(dynamic_synth, 0, dynamic_id, 0, 0));
+    TEST_ASSERT(fluid_samplecache_count_entries() == count);
+
+    // without dynamic sample loading all samples are loaded, but only once per process
+    synth1 = load(settings, 1, &id);
+    count = fluid_samplecache_count_entries();
+    TEST_ASSERT(count > 0);
+
+    synth2 = load(settings, 1, &id);
+    TEST_ASSERT(fluid_samplecache_count_entries() == count);
+
+    TEST_SUCCESS(fluid_synth_program_select(synth1, 0, id, 0, 0));
+    TEST_RENDER(synth1, notes, buf);
+    TEST_RENDER(dynamic_synth, notes, dynamic_buf);
+    test_compare_render(buf, dynamic_buf);
+
+    // the data stays as long as one of the synths uses it
+    delete_fluid_synth(synth1);
+    TEST_ASSERT(fluid_samplecache_count_entries() == count);
+
+    delete_fluid_synth(synth2);
+    delete_fluid_synth(dynamic_synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    delete_fluid_settings(settings);
+    delete_fluid_settings(dynamic_settings);
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+
+static int count_zones(fluid_defpreset_t *defpreset)
+{
+    int count = 0;
+    fluid_preset_zone_t *zone;
+
+    for(zone = fluid_defpreset_get_zone(defpreset); zone != NULL; zone = fluid_preset_zone_next(zone))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+/* Test that presets are only imported when they are used with synth.lazy-preset-loading */
+int main(void)
+{
+    int id, eager_id, key, count, eager_count;
+    fluid_synth_t *synth, *eager_synth;
+    fluid_sfont_t *sfont;
+    fluid_preset_t *preset, *eager_preset;
+    fluid_defpreset_t *defpreset, *eager_defpreset;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_settings_t *eager_settings = new_fluid_settings();
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(eager_settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lazy-preset-loading", 1));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    eager_synth = new_fluid_synth(eager_settings);
+    TEST_ASSERT(eager_synth != NULL);
+
+    /* Don't select any presets when loading */
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0));
+    TEST_SUCCESS(eager_id = fluid_synth_sfload(eager_synth, TEST_SOUNDFONT, 0));
+
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+    TEST_ASSERT(sfont != NULL);
+
+    /* The preset headers are available right away */
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        defpreset = fluid_preset_get_data(preset);
+        TEST_ASSERT(defpreset->sfpreset != NULL);
+        TEST_ASSERT(fluid_defpreset_get_zone(defpreset) == NULL);
+        TEST_ASSERT(fluid_defpreset_get_global_zone(defpreset) == NULL);
+        TEST_ASSERT(fluid_preset_get_name(preset) != NULL);
+    }
+
+    preset = fluid_sfont_get_preset(sfont, 0, 0);
+    TEST_ASSERT(preset != NULL);
+    defpreset = fluid_preset_get_data(preset);
+
+    eager_preset = fluid_sfont_get_preset(fluid_synth_get_sfont_by_id(eager_synth, eager_id), 0, 0);
+    TEST_ASSERT(eager_preset != NULL);
+    eager_defpreset = fluid_preset_get_data(eager_preset);
+
+    /* Selecting the preset imports it */
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 0));
+    TEST_SUCCESS(fluid_synth_program_select(eager_synth, 0, eager_id, 0, 0));
+    TEST_ASSERT(defpreset->sfpreset == NULL);
+    TEST_ASSERT(count_zones(defpreset) > 0);
+    TEST_ASSERT(count_zones(defpreset) == count_zones(eager_defpreset));
+
+    /* The zone index matches the one of an eagerly imported preset */
+    for(key = 0; key < FLUID_ZONE_INDEX_KEYS; key++)
+    {
+        fluid_defpreset_get_key_zones(defpreset, key, &count);
+        fluid_defpreset_get_key_zones(eager_defpreset, key, &eager_count);
+        TEST_ASSERT(count == eager_count);
+    }
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(eager_synth, 0, 60, 100));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == fluid_synth_get_active_voice_count(eager_synth));
+
+    /* Presets that have never been selected are imported by fluid_synth_start(),
+     * the noteon itself never imports */
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        defpreset = fluid_preset_get_data(preset);
+
+        if(defpreset->sfpreset != NULL)
+        {
+            TEST_SUCCESS(fluid_preset_noteon(preset, synth, 1, 60, 100));
+            TEST_ASSERT(defpreset->sfpreset != NULL);
+
+            TEST_SUCCESS(fluid_synth_start(synth, 0, preset, 0, 1, 60, 100));
+            TEST_ASSERT(defpreset->sfpreset == NULL);
+            break;
+        }
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_synth(eager_synth);
+    delete_fluid_settings(settings);
+    delete_fluid_settings(eager_settings);
+
+    return EXIT_SUCCESS;
+}
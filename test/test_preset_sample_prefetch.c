@@ -0,0 +1,148 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_list.h"
+
+/* Returns the count of samples with data, or -1 if any sample is still being loaded */
+static int count_loaded_samples(fluid_synth_t *synth, int sfont_id)
+{
+    fluid_list_t *list;
+    fluid_sfont_t *sfont;
+    fluid_defsfont_t *defsfont;
+    int count = 0;
+
+    sfont = fluid_synth_get_sfont_by_id(synth, sfont_id);
+    TEST_ASSERT(sfont != NULL);
+    defsfont = fluid_sfont_get_data(sfont);
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+
+        if(fluid_atomic_int_get(&sample->loading))
+        {
+            return -1;
+        }
+
+        if(sample->data != NULL)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* Waits for the loader thread to settle with the expected count of loaded samples */
+static void wait_loaded_samples(fluid_synth_t *synth, int sfont_id, int expected)
+{
+    int i;
+
+    for(i = 0; i < 5000; i++)
+    {
+        if(count_loaded_samples(synth, sfont_id) == expected && fluid_samplecache_count_entries() == expected)
+        {
+            return;
+        }
+
+        fluid_msleep(1);
+    }
+
+    TEST_ASSERT(0);
+}
+
+/* Pretends that the loaded samples are still being loaded, or reverts that */
+static void set_loading(fluid_synth_t *synth, int sfont_id, int loading)
+{
+    fluid_list_t *list;
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont_by_id(synth, sfont_id));
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+
+        if(sample->data != NULL)
+        {
+            fluid_atomic_int_set(&sample->loading, loading);
+        }
+    }
+}
+
+/* Plays a note on channel 1, returns the count of voices started */
+static int noteon(fluid_synth_t *synth)
+{
+    int voices = fluid_synth_get_active_voice_count(synth);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 60, 127));
+
+    return fluid_synth_get_active_voice_count(synth) - voices;
+}
+
+// this test makes sure that with synth.dynamic-sample-loading-async the samples of selected
+// presets are loaded in the background, and unloaded once the presets aren't used anymore
+int main(void)
+{
+    int id;
+    fluid_synth_t *synth;
+    fluid_settings_t *settings = new_fluid_settings();
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading-async", 1));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0));
+    TEST_ASSERT(count_loaded_samples(synth, id) == 0);
+
+    /* preset 42 (Lead Synth 2) consists of 4 samples, preset 40 (Aluminum Plate) of 1 sample */
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 42));
+    wait_loaded_samples(synth, id, 4);
+
+    TEST_SUCCESS(fluid_synth_program_select(synth, 1, id, 0, 40));
+    wait_loaded_samples(synth, id, 5);
+
+    TEST_SUCCESS(fluid_synth_unset_program(synth, 0));
+    wait_loaded_samples(synth, id, 1);
+
+    /* unselecting a preset while its samples are being loaded */
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 42));
+    TEST_SUCCESS(fluid_synth_unset_program(synth, 0));
+    wait_loaded_samples(synth, id, 1);
+
+    TEST_SUCCESS(fluid_synth_unset_program(synth, 1));
+    wait_loaded_samples(synth, id, 0);
+
+    /* pinned presets are loaded on return */
+    TEST_SUCCESS(fluid_synth_pin_preset(synth, id, 0, 42));
+    TEST_ASSERT(count_loaded_samples(synth, id) == 4);
+    TEST_SUCCESS(fluid_synth_unpin_preset(synth, id, 0, 42));
+    TEST_ASSERT(count_loaded_samples(synth, id) == 0);
+
+    /* deleting the synth while samples are being loaded */
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 42));
+    delete_fluid_synth(synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    /* noteons skip the samples that are still being loaded instead of waiting */
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0));
+
+    TEST_SUCCESS(fluid_synth_program_select(synth, 1, id, 0, 42));
+    wait_loaded_samples(synth, id, 4);
+    set_loading(synth, id, TRUE);
+    TEST_ASSERT(noteon(synth) == 0);
+    set_loading(synth, id, FALSE);
+    TEST_ASSERT(noteon(synth) > 1);
+
+    delete_fluid_synth(synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
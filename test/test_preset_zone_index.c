@@ -0,0 +1,82 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+
+/* Compares the zone index of a preset against a full walk of its zones */
+static void check_zone_index(fluid_defpreset_t *defpreset)
+{
+    int key, count, n;
+    fluid_zone_index_entry_t *entries;
+    fluid_preset_zone_t *preset_zone;
+    fluid_voice_zone_t *voice_zone;
+    int i;
+
+    for(key = 0; key < FLUID_ZONE_INDEX_KEYS; key++)
+    {
+        entries = fluid_defpreset_get_key_zones(defpreset, key, &count);
+        n = 0;
+
+        for(preset_zone = fluid_defpreset_get_zone(defpreset); preset_zone != NULL; preset_zone = fluid_preset_zone_next(preset_zone))
+        {
+            for(i = 0; i < preset_zone->voice_zone_count; i++)
+            {
+                voice_zone = &preset_zone->voice_zone[i];
+
+                if(voice_zone->range.keylo <= key && voice_zone->range.keyhi >= key)
+                {
+                    TEST_ASSERT(entries != NULL);
+                    TEST_ASSERT(n < count);
+                    TEST_ASSERT(entries[n].preset_zone == preset_zone);
+                    TEST_ASSERT(entries[n].voice_zone == voice_zone);
+                    n++;
+                }
+            }
+        }
+
+        TEST_ASSERT(n == count);
+    }
+
+    /* keys outside of the index must fall back to the zone list */
+    TEST_ASSERT(fluid_defpreset_get_key_zones(defpreset, -1, &count) == NULL && count == 0);
+    TEST_ASSERT(fluid_defpreset_get_key_zones(defpreset, FLUID_ZONE_INDEX_KEYS, &count) == NULL && count == 0);
+}
+
+/* Test that the per-preset zone index matches the zone lists */
+int main(void)
+{
+    int id, presets = 0;
+    fluid_synth_t *synth;
+    fluid_sfont_t *sfont;
+    fluid_preset_t *preset;
+    fluid_settings_t *settings = new_fluid_settings();
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+    TEST_ASSERT(sfont != NULL);
+
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        check_zone_index(fluid_preset_get_data(preset));
+        presets++;
+    }
+
+    TEST_ASSERT(presets > 0);
+
+    /* Playing a note goes through the zone index */
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 0));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "rvoice/fluid_rvoice.h"
+#include "rvoice/fluid_rvoice_event.h"
+
+static int push_real(fluid_rvoice_eventhandler_t *handler, fluid_rvoice_function_t method, void *obj, fluid_real_t value)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+
+    param[0].real = value;
+    return fluid_rvoice_eventhandler_push(handler, method, obj, param);
+}
+
+/* Test that repeated setter events pushed within one batch reach the renderer only once */
+int main(void)
+{
+    int i;
+    fluid_rvoice_t *rvoice;
+    fluid_rvoice_eventhandler_t *handler;
+    fluid_synth_t *synth;
+    fluid_settings_t *settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    handler = synth->eventhandler;
+
+    rvoice = FLUID_NEW(fluid_rvoice_t);
+    TEST_ASSERT(rvoice != NULL);
+    FLUID_MEMSET(rvoice, 0, sizeof(*rvoice));
+
+    /* a sweep of the same parameter collapses into one event carrying the last value */
+    for(i = 0; i < 1000; i++)
+    {
+        TEST_SUCCESS(push_real(handler, fluid_rvoice_set_pitch, rvoice, (fluid_real_t)i));
+        TEST_SUCCESS(push_real(handler, fluid_rvoice_set_min_attenuation_cB, rvoice, (fluid_real_t)(2 * i)));
+    }
+
+    fluid_rvoice_eventhandler_flush(handler);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) == 2);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_all(handler) == 2);
+    TEST_ASSERT(rvoice->dsp.pitch == 999);
+    TEST_ASSERT(rvoice->dsp.min_attenuation_cB == 1998);
+
+    /* the attenuation ramps from its previous value, so every change is kept */
+    for(i = 0; i < 3; i++)
+    {
+        TEST_SUCCESS(push_real(handler, fluid_rvoice_set_attenuation, rvoice, (fluid_real_t)i));
+    }
+
+    fluid_rvoice_eventhandler_flush(handler);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_all(handler) == 3);
+    TEST_ASSERT(rvoice->dsp.attenuation == 2);
+    TEST_ASSERT(rvoice->dsp.prev_attenuation == 1);
+
+    /* amplitudes of different buffers are independent */
+    for(i = 0; i < 10; i++)
+    {
+        TEST_SUCCESS(fluid_rvoice_eventhandler_push_int_real(handler, fluid_rvoice_buffers_set_amp, &rvoice->buffers, 0, 0.5f));
+        TEST_SUCCESS(fluid_rvoice_eventhandler_push_int_real(handler, fluid_rvoice_buffers_set_amp, &rvoice->buffers, 1, 0.25f));
+    }
+
+    fluid_rvoice_eventhandler_flush(handler);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) == 2);
+    fluid_rvoice_eventhandler_dispatch_all(handler);
+
+    /* any other event is a barrier: setters are never moved across it */
+    TEST_SUCCESS(push_real(handler, fluid_rvoice_set_pitch, rvoice, 1.0f));
+    TEST_SUCCESS(fluid_rvoice_eventhandler_push_int_real(handler, fluid_rvoice_set_interp_method, rvoice, FLUID_INTERP_LINEAR, 0.0f));
+    TEST_SUCCESS(push_real(handler, fluid_rvoice_set_pitch, rvoice, 2.0f));
+    fluid_rvoice_eventhandler_flush(handler);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) == 3);
+    fluid_rvoice_eventhandler_dispatch_all(handler);
+    TEST_ASSERT(rvoice->dsp.pitch == 2);
+
+    /* events already handed to the renderer are never modified */
+    TEST_SUCCESS(push_real(handler, fluid_rvoice_set_pitch, rvoice, 3.0f));
+    fluid_rvoice_eventhandler_flush(handler);
+    TEST_SUCCESS(push_real(handler, fluid_rvoice_set_pitch, rvoice, 4.0f));
+    fluid_rvoice_eventhandler_flush(handler);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) == 2);
+    fluid_rvoice_eventhandler_dispatch_all(handler);
+    TEST_ASSERT(rvoice->dsp.pitch == 4);
+
+    FLUID_FREE(rvoice);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "rvoice/fluid_rvoice.h"
+#include "rvoice/fluid_rvoice_event.h"
+
+static int push_root_pitch(fluid_rvoice_eventhandler_t *handler, fluid_rvoice_t *rvoice, int value)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+
+    param[0].real = (fluid_real_t)value;
+    return fluid_rvoice_eventhandler_push(handler, fluid_rvoice_set_root_pitch_hz, rvoice, param);
+}
+
+typedef struct
+{
+    fluid_rvoice_eventhandler_t *handler;
+    fluid_rvoice_t *rvoice;
+    int count;
+} timer_data_t;
+
+/* pushes events from the render thread, like the sequencer does */
+static int push_from_timer(void *data, unsigned int msec)
+{
+    timer_data_t *timer_data = data;
+    int i;
+
+    for(i = 0; i < timer_data->count; i++)
+    {
+        push_root_pitch(timer_data->handler, timer_data->rvoice, i);
+    }
+
+    fluid_rvoice_eventhandler_flush(timer_data->handler);
+    timer_data->count = 0;
+
+    return 1;
+}
+
+/* Test that the rvoice event queue grows instead of dropping events, and that its statistics are reported */
+int main(void)
+{
+    int i, size, high_water, dropped, initial_size;
+    float buf[FLUID_BUFSIZE * 2];
+    timer_data_t timer_data;
+    fluid_sample_timer_t *timer;
+    fluid_rvoice_t *rvoice;
+    fluid_rvoice_eventhandler_t *handler;
+    fluid_synth_t *synth;
+    fluid_settings_t *settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    handler = synth->eventhandler;
+
+    rvoice = FLUID_NEW(fluid_rvoice_t);
+    TEST_ASSERT(rvoice != NULL);
+    FLUID_MEMSET(rvoice, 0, sizeof(*rvoice));
+
+    /* drop whatever the synth queued during its initialization */
+    fluid_rvoice_eventhandler_dispatch_all(handler);
+
+    TEST_SUCCESS(fluid_synth_get_event_queue_stats(synth, &initial_size, &high_water, &dropped));
+    TEST_ASSERT(initial_size == 64);
+    TEST_ASSERT(high_water < 60);
+    TEST_ASSERT(dropped == 0);
+
+    /* leave some events in the initial segment, then overflow it within one batch */
+    for(i = 0; i < 40; i++)
+    {
+        TEST_SUCCESS(push_root_pitch(handler, rvoice, i));
+    }
+
+    fluid_rvoice_eventhandler_flush(handler);
+
+    for(; i < 100; i++)
+    {
+        TEST_SUCCESS(push_root_pitch(handler, rvoice, i));
+    }
+
+    fluid_rvoice_eventhandler_flush(handler);
+
+    TEST_SUCCESS(fluid_synth_get_event_queue_stats(synth, &size, &high_water, &dropped));
+    TEST_ASSERT(size == 2 * initial_size);
+    TEST_ASSERT(high_water == 60);
+    TEST_ASSERT(dropped == 0);
+
+    /* the renderer drains the old segment, then switches over to the grown one */
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) == 40);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_all(handler) == 100);
+    TEST_ASSERT(rvoice->dsp.root_pitch_hz == 99);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_count(handler) == 0);
+
+    /* grow again, which releases the retired segment */
+    for(i = 0; i < 200; i++)
+    {
+        TEST_SUCCESS(push_root_pitch(handler, rvoice, i));
+    }
+
+    fluid_rvoice_eventhandler_flush(handler);
+    TEST_SUCCESS(fluid_synth_get_event_queue_stats(synth, &size, &high_water, NULL));
+    TEST_ASSERT(size == 4 * initial_size);
+    TEST_ASSERT(high_water == 200);
+
+    /* without the renderer adopting the grown segment, the next overflow drops events */
+    for(i = 0; i < 300; i++)
+    {
+        push_root_pitch(handler, rvoice, i);
+    }
+
+    fluid_rvoice_eventhandler_flush(handler);
+    TEST_SUCCESS(fluid_synth_get_event_queue_stats(synth, &size, &high_water, &dropped));
+    TEST_ASSERT(size == 4 * initial_size);
+    TEST_ASSERT(high_water == size);
+    TEST_ASSERT(dropped == 500 - size);
+    TEST_ASSERT(fluid_rvoice_eventhandler_dispatch_all(handler) == size);
+
+    /* the render thread must not allocate memory, so the queue doesn't grow for its events */
+    timer_data.handler = handler;
+    timer_data.rvoice = rvoice;
+    timer_data.count = size + 10;
+    timer = new_fluid_sample_timer(synth, push_from_timer, &timer_data);
+    TEST_ASSERT(timer != NULL);
+    TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 2, buf, 1, 2));
+    TEST_ASSERT(timer_data.count == 0);
+
+    TEST_SUCCESS(fluid_synth_get_event_queue_stats(synth, &size, NULL, &dropped));
+    TEST_ASSERT(size == 4 * initial_size);
+    TEST_ASSERT(dropped == 500 - size + 10);
+    delete_fluid_sample_timer(synth, timer);
+
+    FLUID_FREE(rvoice);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
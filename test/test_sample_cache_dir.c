@@ -0,0 +1,50 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+
+static const test_note_t notes[] =
+{
+    { 0, -1, 60, 127 },
+    { 0, -1, 72, 100 }
+};
+
+static void render(const char *cache_dir, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.sample-cache-dir", cache_dir));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT_SF3, 1));
+
+    TEST_RENDER(synth, notes, buf);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    /* make sure the next synth doesn't reuse the data cached in memory */
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+}
+
+// this test makes sure that decoded samples stored in synth.sample-cache-dir
+// render exactly like freshly decoded ones
+int main(void)
+{
+    static float decoded_buf[TEST_RENDER_FRAMES * 2], stored_buf[TEST_RENDER_FRAMES * 2];
+    static float cached_buf[TEST_RENDER_FRAMES * 2];
+
+    render("", decoded_buf);
+    // the working directory of the test is the build directory
+    render(".", stored_buf);
+    render(".", cached_buf);
+
+    test_compare_render(decoded_buf, stored_buf);
+    test_compare_render(decoded_buf, cached_buf);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+
+static short *load_font(fluid_synth_t *synth)
+{
+    fluid_sfont_t *sfont;
+    int id;
+
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+    TEST_ASSERT(sfont != NULL);
+
+    return ((fluid_defsfont_t *)fluid_sfont_get_data(sfont))->sampledata;
+}
+
+// this test makes sure that unloaded sample data is kept for reuse as long as it
+// fits into synth.sample-cache-size
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_settings_t *default_settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    short *data;
+
+    TEST_ASSERT(settings != NULL && default_settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+    TEST_SUCCESS(fluid_settings_setint(default_settings, "synth.lock-memory", 0));
+
+    // by default, sample data is freed as soon as it isn't used anymore
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    load_font(synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+    delete_fluid_synth(synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    // with a cache size, it is kept after the synth has been deleted ...
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-cache-size", 16));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    data = load_font(synth);
+    delete_fluid_synth(synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+
+    // ... reused by a synth without a cache size, which doesn't shrink the cache ...
+    synth = new_fluid_synth(default_settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(load_font(synth) == data);
+    delete_fluid_synth(synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+
+    // ... and by the next one with a cache size
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(load_font(synth) == data);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+
+    // sample data in use is never evicted
+    fluid_samplecache_set_size(0);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+    fluid_samplecache_set_size(16 * 1024 * 1024);
+    delete_fluid_synth(synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+
+    // unused sample data exceeding the cache size is evicted
+    fluid_samplecache_set_size(1024);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    delete_fluid_settings(settings);
+    delete_fluid_settings(default_settings);
+
+    return EXIT_SUCCESS;
+}
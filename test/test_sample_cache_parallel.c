@@ -0,0 +1,82 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+
+enum { THREAD_COUNT = 4 };
+
+struct load_data
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    short *sampledata;
+};
+
+static fluid_thread_return_t load_font(void *user_data)
+{
+    struct load_data *data = user_data;
+    fluid_sfont_t *sfont;
+    int id;
+
+    data->synth = new_fluid_synth(data->settings);
+    TEST_ASSERT(data->synth != NULL);
+
+    TEST_SUCCESS(id = fluid_synth_sfload(data->synth, TEST_SOUNDFONT, 1));
+    sfont = fluid_synth_get_sfont_by_id(data->synth, id);
+    TEST_ASSERT(sfont != NULL);
+
+    data->sampledata = ((fluid_defsfont_t *)fluid_sfont_get_data(sfont))->sampledata;
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+// this test makes sure that synths loading the same SoundFont in parallel share
+// a single copy of the sample data, and that all of it is freed afterwards
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_thread_t *threads[THREAD_COUNT];
+    struct load_data data[THREAD_COUNT];
+    int i, count;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+    /* the count of cache entries of the font when loaded alone */
+    data[0].settings = settings;
+    load_font(&data[0]);
+    count = fluid_samplecache_count_entries();
+    TEST_ASSERT(count > 0);
+    delete_fluid_synth(data[0].synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        data[i].settings = settings;
+        threads[i] = new_fluid_thread("load", load_font, &data[i], 0, FALSE);
+        TEST_ASSERT(threads[i] != NULL);
+    }
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        fluid_thread_join(threads[i]);
+        delete_fluid_thread(threads[i]);
+    }
+
+    TEST_ASSERT(fluid_samplecache_count_entries() == count);
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        TEST_ASSERT(data[i].sampledata == data[0].sampledata);
+    }
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        delete_fluid_synth(data[i].synth);
+        TEST_ASSERT(fluid_samplecache_count_entries() == (i == THREAD_COUNT - 1 ? 0 : count));
+    }
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecodec.h"
+#include "utils/fluid_sys.h"
+
+enum { SAMPLE_FRAMES = 3 * 4096 + 1000, HEAD = 1024 };
+
+static fluid_samplecodec_t *compress(const short *data, unsigned int count, short **decoded)
+{
+    fluid_samplecodec_t *codec = fluid_samplecodec_compress(data, count, HEAD, FALSE, decoded);
+
+    TEST_ASSERT(codec != NULL);
+    TEST_ASSERT(*decoded != NULL);
+
+    /* the head is decoded right away */
+    TEST_ASSERT(FLUID_MEMCMP(*decoded, data, HEAD * sizeof(short)) == 0);
+
+    return codec;
+}
+
+// tests that the codec is lossless, also for data that doesn't compress well
+static void test_codec(void)
+{
+    static short smooth[SAMPLE_FRAMES], rough[SAMPLE_FRAMES];
+    fluid_samplecodec_t *smooth_codec, *rough_codec;
+    short *smooth_data, *rough_data;
+    unsigned int i, seed = 1;
+
+    for(i = 0; i < SAMPLE_FRAMES; i++)
+    {
+        smooth[i] = (short)(20000 * FLUID_SIN(i * 0.01) + 100 * FLUID_SIN(i * 0.37));
+
+        /* noise and the largest possible steps */
+        seed = seed * 1103515245 + 12345;
+        rough[i] = (i % 7 == 0) ? ((i & 8) ? -32768 : 32767) : (short)(seed >> 16);
+    }
+
+    smooth_codec = compress(smooth, SAMPLE_FRAMES, &smooth_data);
+    rough_codec = compress(rough, SAMPLE_FRAMES, &rough_data);
+
+    TEST_ASSERT(fluid_samplecodec_get_size(smooth_codec) < SAMPLE_FRAMES * sizeof(short) / 2);
+
+    /* data isn't decoded beyond the requested end, except for the rest of a block */
+    TEST_ASSERT(fluid_samplecodec_decode(smooth_codec, 5000) == 2 * 4096);
+    TEST_ASSERT(fluid_samplecodec_decode(smooth_codec, 2 * SAMPLE_FRAMES) == SAMPLE_FRAMES);
+    TEST_ASSERT(FLUID_MEMCMP(smooth_data, smooth, sizeof(smooth)) == 0);
+
+    TEST_ASSERT(fluid_samplecodec_decode(rough_codec, SAMPLE_FRAMES) == SAMPLE_FRAMES);
+    TEST_ASSERT(FLUID_MEMCMP(rough_data, rough, sizeof(rough)) == 0);
+
+    /* without a cache, only the data of samples in use stays decoded */
+    fluid_samplecodec_set_cache_size(0);
+    TEST_ASSERT(fluid_samplecodec_get_cached_size() == 0);
+
+    fluid_samplecodec_use(rough_codec);
+    TEST_ASSERT(fluid_samplecodec_decode(rough_codec, SAMPLE_FRAMES) == SAMPLE_FRAMES);
+    TEST_ASSERT(fluid_samplecodec_decode(smooth_codec, SAMPLE_FRAMES) == SAMPLE_FRAMES);
+    TEST_ASSERT(fluid_samplecodec_get_cached_size() == 2 * (SAMPLE_FRAMES - 4096) * sizeof(short));
+    fluid_samplecodec_unuse(rough_codec);
+
+    fluid_samplecodec_set_cache_size(0);
+    TEST_ASSERT(fluid_samplecodec_get_cached_size() == 0);
+
+    /* decoding the discarded data again gives the same result */
+    TEST_ASSERT(fluid_samplecodec_decode(smooth_codec, SAMPLE_FRAMES) == SAMPLE_FRAMES);
+    TEST_ASSERT(fluid_samplecodec_get_cached_size() == (SAMPLE_FRAMES - 4096) * sizeof(short));
+    TEST_ASSERT(FLUID_MEMCMP(smooth_data, smooth, sizeof(smooth)) == 0);
+
+    fluid_samplecodec_free(smooth_codec);
+    fluid_samplecodec_free(rough_codec);
+    TEST_ASSERT(fluid_samplecodec_get_cached_size() == 0);
+}
+
+static fluid_synth_t *load(fluid_settings_t *settings, fluid_defsfont_t **defsfont)
+{
+    fluid_synth_t *synth;
+    int id;
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont_by_id(synth, id));
+    TEST_ASSERT(*defsfont != NULL);
+
+    return synth;
+}
+
+static const test_note_t notes[] =
+{
+    { 0, -1, 60, 127 },
+    { 0, -1, 72, 100 },
+    { 1, 25, 48, 90 }
+};
+
+// this test makes sure that samples loaded with synth.sample-compression
+// decode to their original data and render exactly like uncompressed samples,
+// as long as the voices don't read beyond the decoded head
+int main(void)
+{
+    static float buf[TEST_RENDER_FRAMES * 2], compressed_buf[TEST_RENDER_FRAMES * 2];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_settings_t *compressed_settings = new_fluid_settings();
+    fluid_synth_t *synth, *compressed_synth;
+    fluid_defsfont_t *defsfont, *compressed_defsfont;
+    fluid_list_t *list, *compressed_list;
+    fluid_sample_t *sample, *compressed_sample;
+    int compressed = 0;
+
+    test_codec();
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(compressed_settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(compressed_settings, "synth.sample-compression", 1));
+    TEST_SUCCESS(fluid_settings_setint(compressed_settings, "synth.lock-memory", 0));
+
+    synth = load(settings, &defsfont);
+    compressed_synth = load(compressed_settings, &compressed_defsfont);
+
+    for(list = defsfont->sample, compressed_list = compressed_defsfont->sample; list && compressed_list;
+            list = fluid_list_next(list), compressed_list = fluid_list_next(compressed_list))
+    {
+        sample = fluid_list_get(list);
+        compressed_sample = fluid_list_get(compressed_list);
+
+        TEST_ASSERT(sample->codec == NULL);
+
+        if(sample->start == sample->end)
+        {
+            continue;
+        }
+
+        TEST_ASSERT(compressed_sample->codec != NULL);
+        TEST_ASSERT(compressed_sample->stream_preload > 0);
+        TEST_ASSERT(compressed_sample->end - compressed_sample->start == sample->end - sample->start);
+        TEST_ASSERT(compressed_sample->loopstart - compressed_sample->start == sample->loopstart - sample->start);
+        TEST_ASSERT(compressed_sample->amplitude_that_reaches_noise_floor == sample->amplitude_that_reaches_noise_floor);
+
+        TEST_ASSERT(fluid_samplecodec_decode(compressed_sample->codec, compressed_sample->end + 1)
+                    == compressed_sample->end + 1);
+        TEST_ASSERT(FLUID_MEMCMP(compressed_sample->data + compressed_sample->start, sample->data + sample->start,
+                                 (sample->end + 1 - sample->start) * sizeof(short)) == 0);
+        compressed++;
+    }
+
+    TEST_ASSERT(list == NULL && compressed_list == NULL);
+    TEST_ASSERT(compressed > 0);
+
+    TEST_RENDER(synth, notes, buf);
+    TEST_RENDER(compressed_synth, notes, compressed_buf);
+    test_compare_render(buf, compressed_buf);
+
+    delete_fluid_synth(synth);
+    delete_fluid_synth(compressed_synth);
+    TEST_ASSERT(fluid_samplecodec_get_cached_size() == 0);
+
+    delete_fluid_settings(settings);
+    delete_fluid_settings(compressed_settings);
+
+    return EXIT_SUCCESS;
+}
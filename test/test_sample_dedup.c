@@ -0,0 +1,93 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplededup.h"
+#include "utils/fluid_sys.h"
+
+static const test_note_t notes[] =
+{
+    { 0, -1, 60, 127 },
+    { 1, 25, 48, 90 },
+    { 9, -1, 36, 110 }
+};
+
+static fluid_synth_t *load(fluid_settings_t *settings, const char *filename, fluid_defsfont_t **defsfont)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    int id;
+
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, filename, 1));
+
+    *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont_by_id(synth, id));
+    TEST_ASSERT(*defsfont != NULL);
+
+    return synth;
+}
+
+// this test makes sure that with synth.sample-dedup identical samples of
+// different SoundFont files are kept in memory only once, and that they
+// render exactly like samples that aren't shared
+int main(void)
+{
+    static float buf[TEST_RENDER_FRAMES * 2], dedup_buf[TEST_RENDER_FRAMES * 2];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_settings_t *dedup_settings = new_fluid_settings();
+    fluid_synth_t *synth, *synth1, *synth2;
+    fluid_defsfont_t *defsfont, *defsfont1, *defsfont2;
+    fluid_list_t *list1, *list2;
+    fluid_sample_t *sample1, *sample2;
+    int count, shared = 0;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(dedup_settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(dedup_settings, "synth.sample-dedup", 1));
+
+    synth = load(settings, TEST_SOUNDFONT, &defsfont);
+    TEST_ASSERT(fluid_samplededup_count_entries() == 0);
+
+    synth1 = load(dedup_settings, TEST_SOUNDFONT, &defsfont1);
+    count = fluid_samplededup_count_entries();
+    TEST_ASSERT(count > 0);
+
+    // a copy of the same file, the sample cache doesn't know it's the same
+    synth2 = load(dedup_settings, TEST_SOUNDFONT_UTF8_1, &defsfont2);
+    TEST_ASSERT(fluid_samplededup_count_entries() == count);
+
+    for(list1 = defsfont1->sample, list2 = defsfont2->sample; list1 && list2;
+            list1 = fluid_list_next(list1), list2 = fluid_list_next(list2))
+    {
+        sample1 = fluid_list_get(list1);
+        sample2 = fluid_list_get(list2);
+
+        TEST_ASSERT(sample1->data == sample2->data);
+
+        if(sample1->data != NULL)
+        {
+            TEST_ASSERT(sample1->data != defsfont->sampledata);
+            TEST_ASSERT(sample1->start == 0);
+            shared++;
+        }
+    }
+
+    TEST_ASSERT(list1 == NULL && list2 == NULL);
+    TEST_ASSERT(shared > 0);
+
+    TEST_RENDER(synth, notes, buf);
+    TEST_RENDER(synth2, notes, dedup_buf);
+    test_compare_render(buf, dedup_buf);
+
+    // the shared data stays as long as one of the fonts uses it
+    delete_fluid_synth(synth1);
+    TEST_ASSERT(fluid_samplededup_count_entries() == count);
+
+    delete_fluid_synth(synth2);
+    TEST_ASSERT(fluid_samplededup_count_entries() == 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+    delete_fluid_settings(dedup_settings);
+
+    return EXIT_SUCCESS;
+}
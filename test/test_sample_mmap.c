@@ -0,0 +1,57 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+
+static const test_note_t notes[] =
+{
+    { 0, -1, 60, 127 },
+    { 0, -1, 72, 100 }
+};
+
+static void render(int mmap, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_defsfont_t *defsfont;
+    int id;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-mmap", mmap));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+
+    /* the sample data must point into the mapping of the file, not into a copy */
+    defsfont = fluid_sfont_get_data(fluid_synth_get_sfont_by_id(synth, id));
+    TEST_ASSERT(defsfont->sampledata != NULL);
+    TEST_ASSERT(fluid_samplecache_is_mapped(defsfont->sampledata) == mmap);
+
+    TEST_RENDER(synth, notes, buf);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    /* make sure the next synth doesn't reuse the cached data */
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+}
+
+// this test makes sure that sample data mapped from the soundfont file renders
+// exactly like sample data read into memory
+int main(void)
+{
+    static float read_buf[TEST_RENDER_FRAMES * 2], mapped_buf[TEST_RENDER_FRAMES * 2];
+
+    render(FALSE, read_buf);
+    render(TRUE, mapped_buf);
+
+    test_compare_render(read_buf, mapped_buf);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,242 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_list.h"
+
+#if HAVE_SHM_OPEN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+enum { MAX_SEGMENTS = 1024 };
+
+static fluid_synth_t *load(fluid_settings_t *settings, fluid_defsfont_t **defsfont)
+{
+    fluid_synth_t *synth;
+    int id;
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont_by_id(synth, id));
+    TEST_ASSERT(*defsfont != NULL);
+
+    return synth;
+}
+
+static const test_note_t notes[] =
+{
+    { 0, -1, 60, 127 },
+    { 0, -1, 72, 100 }
+};
+
+#if HAVE_SHM_OPEN
+// checks that the loaded sample data is mapped from shared memory segments,
+// and returns the names of the segments
+static int get_segments(fluid_defsfont_t *defsfont, char **names)
+{
+    fluid_list_t *list;
+    fluid_sample_t *sample;
+    int count = 0;
+
+    if(defsfont->sampledata != NULL)
+    {
+        TEST_ASSERT(fluid_samplecache_is_mapped(defsfont->sampledata));
+        TEST_ASSERT((names[0] = fluid_samplecache_get_shm_name(defsfont->sampledata)) != NULL);
+        return 1;
+    }
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        sample = fluid_list_get(list);
+
+        if(sample->data != NULL)
+        {
+            TEST_ASSERT(fluid_samplecache_is_mapped(sample->data));
+            TEST_ASSERT(count < MAX_SEGMENTS);
+            TEST_ASSERT((names[count++] = fluid_samplecache_get_shm_name(sample->data)) != NULL);
+        }
+    }
+
+    TEST_ASSERT(count > 0);
+    return count;
+}
+
+// only used while this process doesn't map the segment, closing the
+// descriptor would release its lock on the segment otherwise
+static int segment_exists(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if(fd < 0)
+    {
+        return FALSE;
+    }
+
+    close(fd);
+    return TRUE;
+}
+
+static void send_byte(int fd)
+{
+    char c = 0;
+
+    TEST_ASSERT(write(fd, &c, 1) == 1);
+}
+
+static void receive_byte(int fd)
+{
+    char c;
+
+    TEST_ASSERT(read(fd, &c, 1) == 1);
+}
+
+// the second process: maps the segments published by the first one, and
+// unloads them after the first process has unloaded them
+static void run_child(fluid_settings_t *settings, const float *buf, int from_parent, int to_parent)
+{
+    static float child_buf[TEST_RENDER_FRAMES * 2];
+    static char *names[MAX_SEGMENTS];
+    fluid_synth_t *synth;
+    fluid_defsfont_t *defsfont;
+    int i, count;
+
+    receive_byte(from_parent);
+
+    synth = load(settings, &defsfont);
+    TEST_RENDER(synth, notes, child_buf);
+    test_compare_render(buf, child_buf);
+    count = get_segments(defsfont, names);
+
+    for(i = 0; i < count; i++)
+    {
+        FLUID_FREE(names[i]);
+    }
+
+    send_byte(to_parent);
+    receive_byte(from_parent);
+
+    delete_fluid_synth(synth);
+    exit(EXIT_SUCCESS);
+}
+
+// runs two processes on the same host, both using the sample data published
+// by the first one in shared memory
+static void test_shm(fluid_settings_t *settings, const float *buf)
+{
+    static float shm_buf[TEST_RENDER_FRAMES * 2];
+    static char *names[MAX_SEGMENTS], *replaced[MAX_SEGMENTS];
+    fluid_synth_t *synth;
+    fluid_defsfont_t *defsfont;
+    int to_child[2], to_parent[2];
+    int i, fd, count, status;
+    pid_t pid;
+
+    TEST_ASSERT(pipe(to_child) == 0 && pipe(to_parent) == 0);
+    pid = fork();
+    TEST_ASSERT(pid >= 0);
+
+    if(pid == 0)
+    {
+        close(to_child[1]);
+        close(to_parent[0]);
+        run_child(settings, buf, to_child[0], to_parent[1]);
+    }
+
+    close(to_child[0]);
+    close(to_parent[1]);
+
+    synth = load(settings, &defsfont);
+    TEST_RENDER(synth, notes, shm_buf);
+    test_compare_render(buf, shm_buf);
+    count = get_segments(defsfont, names);
+
+    /* let the other process map the segments */
+    send_byte(to_child[1]);
+    receive_byte(to_parent[0]);
+
+    delete_fluid_synth(synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    /* the segments are kept as long as the other process uses them */
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT(segment_exists(names[i]));
+    }
+
+    send_byte(to_child[1]);
+    TEST_ASSERT(waitpid(pid, &status, 0) == pid);
+    TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    close(to_child[1]);
+    close(to_parent[0]);
+
+    /* and removed by the last process unloading them */
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT(!segment_exists(names[i]));
+    }
+
+    /* invalid segments, e.g. left by a process killed while creating them,
+     * get replaced */
+    for(i = 0; i < count; i++)
+    {
+        fd = shm_open(names[i], O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+        TEST_ASSERT(fd >= 0);
+        TEST_ASSERT(ftruncate(fd, 4096) == 0);
+        close(fd);
+    }
+
+    synth = load(settings, &defsfont);
+    TEST_RENDER(synth, notes, shm_buf);
+    test_compare_render(buf, shm_buf);
+    TEST_ASSERT(get_segments(defsfont, replaced) == count);
+    delete_fluid_synth(synth);
+
+    /* make sure the next synth doesn't reuse the data cached in memory */
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT(FLUID_STRCMP(names[i], replaced[i]) == 0);
+        TEST_ASSERT(!segment_exists(names[i]));
+        FLUID_FREE(names[i]);
+        FLUID_FREE(replaced[i]);
+    }
+}
+#endif
+
+// this test makes sure that sample data shared with synth.sample-shm renders
+// exactly like sample data loaded by this process, and that the segments are
+// removed once no process uses them any more
+int main(void)
+{
+    static float buf[TEST_RENDER_FRAMES * 2];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_defsfont_t *defsfont;
+
+    TEST_ASSERT(settings != NULL);
+
+    synth = load(settings, &defsfont);
+    TEST_RENDER(synth, notes, buf);
+    delete_fluid_synth(synth);
+
+#if HAVE_SHM_OPEN
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-shm", 1));
+    test_shm(settings, buf);
+
+    /* with dynamic sample loading, each sample gets its own segment */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    test_shm(settings, buf);
+#endif
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
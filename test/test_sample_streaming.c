@@ -0,0 +1,179 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_defsfont.h"
+#include "rvoice/fluid_rvoice_stream.h"
+#include "utils/fluid_sys.h"
+
+enum { SAMPLE_FRAMES = 100000, PRELOAD = 1024, LOOKAHEAD = 4096 };
+
+static int wait_ready(fluid_rvoice_stream_t *stream, int need)
+{
+    int i;
+
+    for(i = 0; i < 1000; i++)
+    {
+        if(fluid_rvoice_stream_request(stream, 0, need))
+        {
+            return TRUE;
+        }
+
+        fluid_msleep(2);
+    }
+
+    return FALSE;
+}
+
+// tests the handshake between the renderer and the I/O thread on a single stream
+static void test_stream(void)
+{
+    static short data[SAMPLE_FRAMES];
+    fluid_sample_t sample;
+    fluid_rvoice_streamer_t *streamer;
+    fluid_rvoice_stream_t *stream, *spare;
+
+    FLUID_MEMSET(&sample, 0, sizeof(sample));
+    sample.data = data;
+    sample.start = 0;
+    sample.end = SAMPLE_FRAMES - 1;
+    sample.stream_preload = PRELOAD;
+
+    streamer = new_fluid_rvoice_streamer(LOOKAHEAD);
+    TEST_ASSERT(streamer != NULL);
+
+    stream = fluid_rvoice_streamer_new_streams(streamer, 2);
+    TEST_ASSERT(stream != NULL);
+
+    /* an idle stream never underruns */
+    TEST_ASSERT(fluid_rvoice_stream_request(stream, 0, SAMPLE_FRAMES));
+
+    /* the voice's reference */
+    sample.refcount = 1;
+    TEST_ASSERT(fluid_rvoice_stream_start(stream, &sample) == stream);
+
+    /* the head is resident right away */
+    TEST_ASSERT(fluid_rvoice_stream_request(stream, 0, PRELOAD));
+    TEST_ASSERT(fluid_rvoice_streamer_get_underruns(streamer) == 0);
+
+    /* data far ahead isn't, but is paged in by the I/O thread */
+    if(!fluid_rvoice_stream_request(stream, 0, PRELOAD + 3 * LOOKAHEAD))
+    {
+        TEST_ASSERT(fluid_rvoice_streamer_get_underruns(streamer) == 1);
+        TEST_ASSERT(wait_ready(stream, PRELOAD + 3 * LOOKAHEAD));
+    }
+
+    /* requests are clipped to the end of the sample */
+    TEST_ASSERT(wait_ready(stream, 2 * SAMPLE_FRAMES));
+
+    /* the reference is either dropped by the voice or by the synth after the I/O thread finished */
+    if(fluid_rvoice_stream_stop(stream))
+    {
+        sample.refcount--;
+    }
+
+    while(sample.refcount != 0)
+    {
+        fluid_msleep(2);
+        fluid_rvoice_streamer_reclaim(streamer);
+    }
+
+    /* and the data locked ahead of the voice has been unlocked */
+    TEST_ASSERT(stream->locked_start == stream->locked_end);
+
+    /* a sample that isn't streamed leaves the stream idle */
+    sample.stream_preload = 0;
+    TEST_ASSERT(fluid_rvoice_stream_start(&stream[1], &sample) == &stream[1]);
+    TEST_ASSERT(fluid_rvoice_stream_request(&stream[1], 0, 2 * SAMPLE_FRAMES));
+    TEST_ASSERT(fluid_rvoice_stream_stop(&stream[1]));
+
+    /* a voice starting on a stream the I/O thread is still busy with gets a
+     * spare stream, instead of playing without streaming */
+    sample.stream_preload = PRELOAD;
+    sample.refcount = 2;
+    TEST_ASSERT(fluid_rvoice_stream_start(&stream[1], &sample) == &stream[1]);
+
+    while(!fluid_atomic_int_compare_and_exchange(&stream[1].state, FLUID_RVOICE_STREAM_ACTIVE,
+            FLUID_RVOICE_STREAM_BUSY))
+    {
+        fluid_msleep(1);
+    }
+
+    spare = fluid_rvoice_stream_start(&stream[1], &sample);
+    TEST_ASSERT(spare != NULL && spare != &stream[1]);
+    TEST_ASSERT(spare->owned && !stream[1].owned);
+    TEST_ASSERT(fluid_rvoice_stream_request(spare, 0, PRELOAD));
+
+    if(fluid_rvoice_stream_stop(spare))
+    {
+        sample.refcount--;
+    }
+
+    /* the busy stream keeps its reference until the I/O thread is done */
+    TEST_ASSERT(!fluid_rvoice_stream_stop(&stream[1]));
+
+    while(sample.refcount != 0)
+    {
+        fluid_msleep(2);
+        fluid_rvoice_streamer_reclaim(streamer);
+    }
+
+    delete_fluid_rvoice_streamer(streamer);
+}
+
+static const test_note_t notes[] =
+{
+    { 0, -1, 60, 127 },
+    { 0, -1, 72, 100 }
+};
+
+static void render(int streaming, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sfont_t *sfont;
+    fluid_list_t *list;
+    int id;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-streaming", streaming));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.lock-memory", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+    TEST_ASSERT(sfont != NULL);
+
+    for(list = ((fluid_defsfont_t *)fluid_sfont_get_data(sfont))->sample; list; list = fluid_list_next(list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+        TEST_ASSERT((sample->stream_preload != 0) == streaming);
+    }
+
+    TEST_RENDER(synth, notes, buf);
+
+    /* the sample references of streamed voices are released like any other */
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+    test_render(synth, NULL, 0, buf + 2 * TEST_RENDER_FRAMES);
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id, 0));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+// this test makes sure that streamed sample data renders exactly like resident
+// sample data, as long as the voices don't read beyond the preloaded head
+int main(void)
+{
+    static float resident_buf[TEST_RENDER_FRAMES * 4], streamed_buf[TEST_RENDER_FRAMES * 4];
+
+    test_stream();
+
+    render(FALSE, resident_buf);
+    render(TRUE, streamed_buf);
+
+    test_compare_render(resident_buf, streamed_buf);
+
+    return EXIT_SUCCESS;
+}
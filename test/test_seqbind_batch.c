@@ -0,0 +1,111 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+enum { FRAMES = 4096 };
+
+static fluid_synth_t *synth1, *synth2;
+static int user_events;
+static unsigned int ticks;
+
+/* uses the synths from another thread, which would deadlock if the sequencer
+ * called this client while holding the API lock of a synth */
+static fluid_thread_return_t use_synths(void *data)
+{
+    int val;
+
+    TEST_SUCCESS(fluid_synth_get_cc(synth1, 0, 7, &val));
+    TEST_SUCCESS(fluid_synth_get_cc(synth2, 0, 7, &val));
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+static void user_callback(unsigned int time, fluid_event_t *event, fluid_sequencer_t *seq, void *data)
+{
+    fluid_thread_t *thread = new_fluid_thread("use_synths", use_synths, NULL, 0, FALSE);
+
+    TEST_ASSERT(thread != NULL);
+    TEST_SUCCESS(fluid_thread_join(thread));
+    delete_fluid_thread(thread);
+
+    user_events++;
+}
+
+/* advances the sequencer through the sample timer of a synth, like an audio driver would */
+static void render(fluid_synth_t *synth)
+{
+    static float buf[FRAMES * 2];
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+/* events at the same time aren't necessarily sent in order, give each one its own tick */
+static void send_volume(fluid_sequencer_t *seq, fluid_event_t *evt, fluid_seq_id_t dest, int value)
+{
+    fluid_event_set_dest(evt, dest);
+    fluid_event_volume(evt, 0, value);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, ++ticks, 1));
+}
+
+// tests that runs of events to the synths bound to a sequencer are handled in
+// batches, which end before any other client gets an event
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_sequencer_t *seq = new_fluid_sequencer2(0);
+    fluid_event_t *evt = new_fluid_event();
+    fluid_seq_id_t id1, id2, user_id;
+    int val;
+
+    TEST_ASSERT(settings != NULL && seq != NULL && evt != NULL);
+
+    synth1 = new_fluid_synth(settings);
+    synth2 = new_fluid_synth(settings);
+    TEST_ASSERT(synth1 != NULL && synth2 != NULL);
+
+    TEST_SUCCESS(id1 = fluid_sequencer_register_fluidsynth(seq, synth1));
+    TEST_SUCCESS(id2 = fluid_sequencer_register_fluidsynth(seq, synth2));
+    TEST_SUCCESS(user_id = fluid_sequencer_register_client(seq, "user", user_callback, NULL));
+
+    fluid_event_set_source(evt, -1);
+
+    /* all events are due at once */
+    send_volume(seq, evt, id1, 10);
+    send_volume(seq, evt, id1, 11);
+    send_volume(seq, evt, user_id, 0);
+    send_volume(seq, evt, id2, 20);
+    send_volume(seq, evt, id1, 12);
+    send_volume(seq, evt, id2, 21);
+    send_volume(seq, evt, user_id, 0);
+
+    render(synth1);
+
+    TEST_ASSERT(user_events == 2);
+    TEST_SUCCESS(fluid_synth_get_cc(synth1, 0, 7, &val));
+    TEST_ASSERT(val == 12);
+    TEST_SUCCESS(fluid_synth_get_cc(synth2, 0, 7, &val));
+    TEST_ASSERT(val == 21);
+
+    /* a batch ends when its client is unregistered, the sample timer of a
+     * synth must not be deleted by its own callback though */
+    send_volume(seq, evt, id1, 13);
+    fluid_event_set_dest(evt, id1);
+    fluid_event_unregistering(evt);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, ++ticks, 1));
+    send_volume(seq, evt, user_id, 0);
+
+    render(synth2);
+
+    TEST_ASSERT(user_events == 3);
+    TEST_ASSERT(fluid_sequencer_count_clients(seq) == 2);
+    TEST_SUCCESS(fluid_synth_get_cc(synth1, 0, 7, &val));
+    TEST_ASSERT(val == 13);
+
+    delete_fluid_event(evt);
+    delete_fluid_sequencer(seq);
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
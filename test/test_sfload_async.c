@@ -0,0 +1,72 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that SoundFonts loaded in the background are added to the synth
+// once loading is complete, and that cancelled or failed loads leave the synth untouched
+int main(void)
+{
+    enum { FRAMES = 1024 };
+    float buf[FRAMES * 2];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sfload_t *load;
+    int id, status;
+
+    TEST_ASSERT(settings != NULL);
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    // a successful load
+    load = fluid_synth_sfload_async(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(load != NULL);
+
+    TEST_SUCCESS(id = fluid_sfload_join(load));
+    TEST_ASSERT(fluid_sfload_get_status(load) == FLUID_SFLOAD_DONE);
+    TEST_ASSERT(fluid_sfload_get_progress(load) == 1.0);
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 1);
+    TEST_ASSERT(fluid_synth_get_sfont_by_id(synth, id) != NULL);
+
+    // joining again returns the same result, cancelling a finished load has no effect
+    fluid_sfload_cancel(load);
+    TEST_ASSERT(fluid_sfload_join(load) == id);
+    delete_fluid_sfload(load);
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 1);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    // a failing load
+    load = fluid_synth_sfload_async(synth, "nonexistent.sf2", 1);
+    TEST_ASSERT(load != NULL);
+    TEST_ASSERT(fluid_sfload_join(load) == FLUID_FAILED);
+    TEST_ASSERT(fluid_sfload_get_status(load) == FLUID_SFLOAD_FAILED);
+    delete_fluid_sfload(load);
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 1);
+
+    // a cancelled load, unless it was quicker than the cancellation
+    load = fluid_synth_sfload_async(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(load != NULL);
+    fluid_sfload_cancel(load);
+    id = fluid_sfload_join(load);
+    status = fluid_sfload_get_status(load);
+    TEST_ASSERT(status == FLUID_SFLOAD_CANCELLED || status == FLUID_SFLOAD_DONE);
+    TEST_ASSERT((status == FLUID_SFLOAD_DONE) == (id != FLUID_FAILED));
+    TEST_ASSERT(fluid_synth_sfcount(synth) == (status == FLUID_SFLOAD_DONE ? 2 : 1));
+    delete_fluid_sfload(load);
+
+    // a load that is still running when the synth is deleted
+    load = fluid_synth_sfload_async(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(load != NULL);
+    delete_fluid_synth(synth);
+
+    status = fluid_sfload_get_status(load);
+    TEST_ASSERT(status != FLUID_SFLOAD_LOADING);
+    delete_fluid_sfload(load);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
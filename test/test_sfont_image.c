@@ -0,0 +1,119 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+
+static const test_note_t notes[] =
+{
+    { 0, -1, 60, 127 },
+    { 0, -1, 72, 100 },
+    { 1, 25, 48, 90 },
+    { 9, -1, 36, 110 }
+};
+
+static int count_zones(fluid_defpreset_t *defpreset)
+{
+    int count = 0;
+    fluid_preset_zone_t *zone;
+
+    for(zone = fluid_defpreset_get_zone(defpreset); zone != NULL; zone = fluid_preset_zone_next(zone))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+static fluid_synth_t *load(fluid_settings_t *settings, const char *image_dir, int *id)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.compiled-sfont-dir", image_dir));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(*id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    return synth;
+}
+
+/* Compares the presets of a SoundFont loaded from its compiled image with
+ * the ones of the parsed SoundFont */
+static void compare_presets(fluid_sfont_t *sfont, fluid_sfont_t *image_sfont)
+{
+    fluid_preset_t *preset, *image_preset;
+    fluid_defpreset_t *defpreset, *image_defpreset;
+    int key, count, image_count, presets = 0;
+
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        image_preset = fluid_sfont_get_preset(image_sfont, fluid_preset_get_banknum(preset), fluid_preset_get_num(preset));
+        TEST_ASSERT(image_preset != NULL);
+        TEST_ASSERT(FLUID_STRCMP(fluid_preset_get_name(preset), fluid_preset_get_name(image_preset)) == 0);
+
+        defpreset = fluid_preset_get_data(preset);
+        image_defpreset = fluid_preset_get_data(image_preset);
+        TEST_ASSERT(count_zones(defpreset) == count_zones(image_defpreset));
+        TEST_ASSERT((fluid_defpreset_get_global_zone(defpreset) == NULL)
+                    == (fluid_defpreset_get_global_zone(image_defpreset) == NULL));
+
+        for(key = 0; key < FLUID_ZONE_INDEX_KEYS; key++)
+        {
+            fluid_defpreset_get_key_zones(defpreset, key, &count);
+            fluid_defpreset_get_key_zones(image_defpreset, key, &image_count);
+            TEST_ASSERT(count == image_count);
+        }
+
+        presets++;
+    }
+
+    TEST_ASSERT(presets > 0);
+
+    fluid_sfont_iteration_start(image_sfont);
+
+    while(fluid_sfont_iteration_next(image_sfont) != NULL)
+    {
+        presets--;
+    }
+
+    TEST_ASSERT(presets == 0);
+}
+
+// this test makes sure that a SoundFont loaded from its compiled image in
+// synth.compiled-sfont-dir has the same presets and renders exactly like the
+// parsed SoundFont
+int main(void)
+{
+    static float parsed_buf[TEST_RENDER_FRAMES * 2], compiled_buf[TEST_RENDER_FRAMES * 2];
+    static float image_buf[TEST_RENDER_FRAMES * 2];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *parsed_synth, *compiled_synth, *image_synth;
+    int parsed_id, compiled_id, image_id;
+
+    TEST_ASSERT(settings != NULL);
+
+    parsed_synth = load(settings, "", &parsed_id);
+    // the working directory of the test is the build directory
+    compiled_synth = load(settings, ".", &compiled_id);
+    image_synth = load(settings, ".", &image_id);
+
+    compare_presets(fluid_synth_get_sfont_by_id(parsed_synth, parsed_id),
+                    fluid_synth_get_sfont_by_id(image_synth, image_id));
+
+    TEST_RENDER(parsed_synth, notes, parsed_buf);
+    TEST_RENDER(compiled_synth, notes, compiled_buf);
+    TEST_RENDER(image_synth, notes, image_buf);
+
+    test_compare_render(parsed_buf, compiled_buf);
+    test_compare_render(parsed_buf, image_buf);
+
+    delete_fluid_synth(parsed_synth);
+    delete_fluid_synth(compiled_synth);
+    delete_fluid_synth(image_synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_list.h"
+
+// the working directory of the test is the build directory
+#define RELOAD_SOUNDFONT "test_sfont_reload.sf2"
+
+enum { MAX_SAMPLES = 1024 };
+
+static void copy_file(const char *from, const char *to)
+{
+    static char buf[65536];
+    FILE *in = fopen(from, "rb");
+    FILE *out = fopen(to, "wb");
+    size_t count;
+
+    TEST_ASSERT(in != NULL && out != NULL);
+
+    while((count = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        TEST_ASSERT(fwrite(buf, 1, count, out) == count);
+    }
+
+    fclose(in);
+    fclose(out);
+}
+
+// changes the data of a sample in the file, like a sample editor would
+static void modify_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    FILE *file = fopen(RELOAD_SOUNDFONT, "r+b");
+    unsigned int i, count = (sample->source_end + 1 - sample->source_start) * sizeof(short);
+    unsigned char *data = FLUID_ARRAY(unsigned char, count);
+
+    TEST_ASSERT(file != NULL && data != NULL);
+    TEST_ASSERT(fseek(file, defsfont->samplepos + sample->source_start * sizeof(short), SEEK_SET) == 0);
+    TEST_ASSERT(fread(data, 1, count, file) == count);
+
+    for(i = 0; i < count; i++)
+    {
+        data[i] ^= 0x55;
+    }
+
+    TEST_ASSERT(fseek(file, defsfont->samplepos + sample->source_start * sizeof(short), SEEK_SET) == 0);
+    TEST_ASSERT(fwrite(data, 1, count, file) == count);
+
+    fclose(file);
+    FLUID_FREE(data);
+}
+
+static fluid_defsfont_t *get_defsfont(fluid_synth_t *synth, int id)
+{
+    fluid_sfont_t *sfont = fluid_synth_get_sfont_by_id(synth, id);
+
+    TEST_ASSERT(sfont != NULL);
+    return fluid_sfont_get_data(sfont);
+}
+
+static int get_sample_data(fluid_defsfont_t *defsfont, short **data)
+{
+    fluid_list_t *list;
+    int count = 0;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        TEST_ASSERT(count < MAX_SAMPLES);
+        data[count++] = ((fluid_sample_t *)fluid_list_get(list))->data;
+    }
+
+    return count;
+}
+
+// returns the count of samples whose data has been hashed
+static int count_hashed_samples(fluid_defsfont_t *defsfont)
+{
+    fluid_list_t *list;
+    int count = 0;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        if(((fluid_sample_t *)fluid_list_get(list))->source_hash != 0)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static void render(fluid_synth_t *synth, float *buf)
+{
+    static const test_note_t notes[] =
+    {
+        { 1, -1, 60, 127 },
+        { 1, -1, 72, 100 }
+    };
+
+    TEST_RENDER(synth, notes, buf);
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, 1));
+}
+
+// this test makes sure that a SoundFont loaded with synth.incremental-reload
+// only loads the data of modified samples again when it is reloaded, and that
+// it renders like a freshly loaded SoundFont
+int main(void)
+{
+    static float buf[TEST_RENDER_FRAMES * 2], reloaded_buf[TEST_RENDER_FRAMES * 2];
+    static short *data[MAX_SAMPLES], *reloaded_data[MAX_SAMPLES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth, *fresh_synth;
+    fluid_defsfont_t *defsfont;
+    fluid_list_t *list;
+    fluid_sample_t *sample, *modified = NULL;
+    int id, i, count, modified_idx = 0;
+    unsigned int modified_length;
+    short modified_value;
+
+    TEST_ASSERT(settings != NULL);
+
+    /* a freshly loaded SoundFont for comparison */
+    fresh_synth = new_fluid_synth(settings);
+    TEST_ASSERT(fresh_synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(fresh_synth, TEST_SOUNDFONT, 1));
+    render(fresh_synth, buf);
+    delete_fluid_synth(fresh_synth);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.incremental-reload", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    copy_file(TEST_SOUNDFONT, RELOAD_SOUNDFONT);
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, RELOAD_SOUNDFONT, 1));
+    defsfont = get_defsfont(synth, id);
+    count = get_sample_data(defsfont, data);
+    TEST_SUCCESS(fluid_synth_set_bank_offset(synth, id, 5));
+
+    /* loading doesn't hash the sample data, nor does it load the samples individually */
+    TEST_ASSERT(defsfont->sampledata != NULL);
+    TEST_ASSERT(count_hashed_samples(defsfont) == 0);
+
+    /* reloading the unchanged file takes over all sample data, while a voice keeps playing */
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    TEST_ASSERT(fluid_synth_sfreload(synth, id) == id);
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 1);
+    TEST_ASSERT(get_defsfont(synth, id) != defsfont);
+    TEST_ASSERT(fluid_synth_get_bank_offset(synth, id) == 5);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    defsfont = get_defsfont(synth, id);
+    TEST_ASSERT(get_sample_data(defsfont, reloaded_data) == count);
+    TEST_ASSERT(count_hashed_samples(defsfont) == count);
+
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT(reloaded_data[i] == data[i]);
+    }
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, 0));
+    TEST_SUCCESS(fluid_synth_set_bank_offset(synth, id, 0));
+    TEST_SUCCESS(fluid_synth_program_reset(synth));
+    render(synth, reloaded_buf);
+    test_compare_render(buf, reloaded_buf);
+
+    /* modify a sample, the sample data cache identifies files by their modification time */
+    for(list = defsfont->sample, i = 0; list; list = fluid_list_next(list), i++)
+    {
+        sample = fluid_list_get(list);
+
+        if(sample->end > sample->start)
+        {
+            modified = sample;
+            modified_idx = i;
+            break;
+        }
+    }
+
+    TEST_ASSERT(modified != NULL);
+    modified_length = modified->end - modified->start;
+    modified_value = modified->data[modified->start];
+
+    fluid_msleep(1100);
+    modify_sample(defsfont, modified);
+
+    /* only the modified sample is loaded again */
+    TEST_ASSERT(fluid_synth_sfreload(synth, id) == id);
+    defsfont = get_defsfont(synth, id);
+    TEST_ASSERT(get_sample_data(defsfont, reloaded_data) == count);
+
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT((reloaded_data[i] == data[i]) == (i != modified_idx));
+    }
+
+    sample = fluid_list_get(fluid_list_nth(defsfont->sample, modified_idx));
+    TEST_ASSERT(sample->end - sample->start == modified_length);
+    TEST_ASSERT((sample->data[sample->start] ^ modified_value) == 0x5555);
+
+    /* without the setting, the SoundFont is loaded completely again */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.incremental-reload", 0));
+    TEST_ASSERT(fluid_synth_sfreload(synth, id) == id);
+    TEST_ASSERT(get_defsfont(synth, id)->sampledata != NULL);
+    TEST_ASSERT(fluid_synth_sfreload(synth, id) == id);
+
+    delete_fluid_synth(synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
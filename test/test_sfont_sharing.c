@@ -0,0 +1,215 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_list.h"
+
+static fluid_defsfont_t *get_defsfont(fluid_synth_t *synth, int id)
+{
+    fluid_sfont_t *sfont = fluid_synth_get_sfont_by_id(synth, id);
+
+    TEST_ASSERT(sfont != NULL);
+    return fluid_sfont_get_data(sfont);
+}
+
+static int count_loaded_samples(fluid_defsfont_t *defsfont)
+{
+    fluid_list_t *list;
+    int count = 0;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        if(((fluid_sample_t *)fluid_list_get(list))->data != NULL)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static void render(fluid_synth_t *synth, int id, float *buf)
+{
+    static const test_note_t notes[] =
+    {
+        { 0, -1, 60, 127 },
+        { 1, -1, 67, 100 }
+    };
+
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 0));
+    TEST_SUCCESS(fluid_synth_program_select(synth, 1, id, 0, 42));
+    TEST_RENDER(synth, notes, buf);
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+}
+
+// tests that the synths loading a SoundFont with synth.sfont-sharing use the same
+// presets and samples, but keep their own SoundFont ID, bank offset and pinned presets
+static void test_sharing(fluid_settings_t *settings)
+{
+    static float buf[TEST_RENDER_FRAMES * 2], shared_buf[TEST_RENDER_FRAMES * 2];
+    fluid_synth_t *synth1, *synth2;
+    fluid_defsfont_t *defsfont1, *defsfont2;
+    fluid_preset_t *preset1, *preset2;
+    int id1, id2;
+
+    synth1 = new_fluid_synth(settings);
+    synth2 = new_fluid_synth(settings);
+    TEST_ASSERT(synth1 != NULL && synth2 != NULL);
+
+    /* make the SoundFont IDs differ */
+    TEST_SUCCESS(id1 = fluid_synth_sfload(synth1, TEST_SOUNDFONT, 1));
+    TEST_SUCCESS(fluid_synth_sfunload(synth1, id1, 1));
+    TEST_SUCCESS(id1 = fluid_synth_sfload(synth1, TEST_SOUNDFONT, 1));
+    TEST_ASSERT(fluid_defsfont_count_shared() == 1);
+
+    TEST_SUCCESS(id2 = fluid_synth_sfload(synth2, TEST_SOUNDFONT, 1));
+    TEST_ASSERT(fluid_defsfont_count_shared() == 1);
+    TEST_ASSERT(id1 != id2);
+
+    defsfont1 = get_defsfont(synth1, id1);
+    defsfont2 = get_defsfont(synth2, id2);
+    TEST_ASSERT(defsfont1 != defsfont2);
+    TEST_ASSERT(defsfont1->sample == defsfont2->sample);
+    TEST_ASSERT(defsfont1->preset_count == defsfont2->preset_count);
+
+    preset1 = fluid_sfont_get_preset(fluid_synth_get_sfont_by_id(synth1, id1), 0, 42);
+    preset2 = fluid_sfont_get_preset(fluid_synth_get_sfont_by_id(synth2, id2), 0, 42);
+    TEST_ASSERT(preset1 != NULL && preset2 != NULL);
+    TEST_ASSERT(preset1 != preset2);
+    TEST_ASSERT(fluid_preset_get_data(preset1) == fluid_preset_get_data(preset2));
+    TEST_ASSERT(fluid_preset_get_sfont(preset1) == fluid_synth_get_sfont_by_id(synth1, id1));
+    TEST_ASSERT(fluid_preset_get_sfont(preset2) == fluid_synth_get_sfont_by_id(synth2, id2));
+
+    /* the bank offset is per synth */
+    TEST_SUCCESS(fluid_synth_set_bank_offset(synth1, id1, 100));
+    TEST_ASSERT(fluid_synth_get_bank_offset(synth1, id1) == 100);
+    TEST_ASSERT(fluid_synth_get_bank_offset(synth2, id2) == 0);
+    TEST_SUCCESS(fluid_synth_set_bank_offset(synth1, id1, 0));
+
+    /* presets are pinned per synth, samples stay loaded while any synth uses them */
+    if(count_loaded_samples(defsfont1) == 0)
+    {
+        TEST_SUCCESS(fluid_synth_pin_preset(synth1, id1, 0, 42));
+        TEST_ASSERT(count_loaded_samples(defsfont1) == 4);
+        TEST_SUCCESS(fluid_synth_pin_preset(synth1, id1, 0, 42));
+        TEST_SUCCESS(fluid_synth_pin_preset(synth2, id2, 0, 42));
+        TEST_ASSERT(count_loaded_samples(defsfont2) == 4);
+
+        TEST_SUCCESS(fluid_synth_unpin_preset(synth1, id1, 0, 42));
+        TEST_SUCCESS(fluid_synth_unpin_preset(synth1, id1, 0, 42));
+        TEST_ASSERT(count_loaded_samples(defsfont1) == 4);
+        TEST_SUCCESS(fluid_synth_unpin_preset(synth2, id2, 0, 42));
+        TEST_ASSERT(count_loaded_samples(defsfont1) == 0);
+
+        /* unloading the SoundFont unpins the presets of that synth only */
+        TEST_SUCCESS(fluid_synth_pin_preset(synth1, id1, 0, 42));
+        TEST_SUCCESS(fluid_synth_pin_preset(synth2, id2, 0, 40));
+        TEST_ASSERT(count_loaded_samples(defsfont2) == 5);
+        TEST_SUCCESS(fluid_synth_sfunload(synth1, id1, 1));
+        TEST_ASSERT(count_loaded_samples(defsfont2) == 1);
+        TEST_SUCCESS(id1 = fluid_synth_sfload(synth1, TEST_SOUNDFONT, 1));
+        TEST_SUCCESS(fluid_synth_unpin_preset(synth2, id2, 0, 40));
+        TEST_ASSERT(count_loaded_samples(defsfont2) == 0);
+    }
+
+    /* both synths play the same data */
+    render(synth1, id1, buf);
+    render(synth2, id2, shared_buf);
+    test_compare_render(buf, shared_buf);
+
+    /* the data stays loaded as long as any synth uses it */
+    delete_fluid_synth(synth1);
+    TEST_ASSERT(fluid_defsfont_count_shared() == 1);
+
+    synth1 = new_fluid_synth(settings);
+    TEST_ASSERT(synth1 != NULL);
+    TEST_SUCCESS(id1 = fluid_synth_sfload(synth1, TEST_SOUNDFONT, 1));
+    TEST_ASSERT(get_defsfont(synth1, id1)->sample == defsfont2->sample);
+    render(synth1, id1, shared_buf);
+    test_compare_render(buf, shared_buf);
+
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+    TEST_ASSERT(fluid_defsfont_count_shared() == 0);
+}
+
+// tests that a legato passage on one synth doesn't make the other synths
+// sharing the SoundFont skip the zones reused by the legato voices
+static void test_legato(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth1, *synth2;
+    int count;
+
+    synth1 = new_fluid_synth(settings);
+    synth2 = new_fluid_synth(settings);
+    TEST_ASSERT(synth1 != NULL && synth2 != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth1, TEST_SOUNDFONT, 1));
+    TEST_SUCCESS(fluid_synth_sfload(synth2, TEST_SOUNDFONT, 1));
+
+    TEST_SUCCESS(fluid_synth_reset_basic_channel(synth1, -1));
+    TEST_SUCCESS(fluid_synth_set_basic_channel(synth1, 0, FLUID_CHANNEL_MODE_OMNIOFF_MONO, 1));
+    TEST_SUCCESS(fluid_synth_set_legato_mode(synth1, 0, FLUID_CHANNEL_LEGATO_MODE_MULTI_RETRIGGER));
+
+    TEST_SUCCESS(fluid_synth_noteon(synth1, 0, 60, 100));
+    count = fluid_synth_get_active_voice_count(synth1);
+    TEST_ASSERT(count > 0);
+
+    /* the voices of key 60 play key 61 */
+    TEST_SUCCESS(fluid_synth_noteon(synth1, 0, 61, 100));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth1) == count);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth2, 0, 61, 100));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth2) == count);
+
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+    TEST_ASSERT(fluid_defsfont_count_shared() == 0);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_settings_t *other_settings = new_fluid_settings();
+    fluid_synth_t *synth, *other_synth;
+    int id, other_id;
+
+    TEST_ASSERT(settings != NULL && other_settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sfont-sharing", 1));
+    TEST_SUCCESS(fluid_settings_setint(other_settings, "synth.sfont-sharing", 1));
+
+    test_sharing(settings);
+    test_legato(settings);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    test_sharing(settings);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    /* SoundFonts loaded with different settings aren't shared */
+    synth = new_fluid_synth(settings);
+    other_synth = new_fluid_synth(other_settings);
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    TEST_SUCCESS(other_id = fluid_synth_sfload(other_synth, TEST_SOUNDFONT, 1));
+    TEST_ASSERT(fluid_defsfont_count_shared() == 2);
+    TEST_ASSERT(get_defsfont(synth, id)->sample != get_defsfont(other_synth, other_id)->sample);
+
+    delete_fluid_synth(other_synth);
+
+    /* not even if only the sample cache directory differs */
+    TEST_SUCCESS(fluid_settings_setint(other_settings, "synth.dynamic-sample-loading", 1));
+    TEST_SUCCESS(fluid_settings_setstr(other_settings, "synth.sample-cache-dir", "sfont_sharing_cache"));
+    other_synth = new_fluid_synth(other_settings);
+    TEST_SUCCESS(other_id = fluid_synth_sfload(other_synth, TEST_SOUNDFONT, 1));
+    TEST_ASSERT(fluid_defsfont_count_shared() == 2);
+    TEST_ASSERT(get_defsfont(synth, id)->sample != get_defsfont(other_synth, other_id)->sample);
+
+    delete_fluid_synth(synth);
+    delete_fluid_synth(other_synth);
+    TEST_ASSERT(fluid_defsfont_count_shared() == 0);
+
+    delete_fluid_settings(settings);
+    delete_fluid_settings(other_settings);
+
+    return EXIT_SUCCESS;
+}
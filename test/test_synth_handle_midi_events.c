@@ -0,0 +1,78 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "fluidsynth_priv.h"
+#include "fluid_midi.h"
+
+enum { COUNT = 8 };
+
+/* Test that a batch of MIDI events is handled like the single events */
+int main(void)
+{
+    int i, val;
+    fluid_midi_event_t *events[COUNT];
+    fluid_synth_t *synth;
+    fluid_settings_t *settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    for(i = 0; i < COUNT; i++)
+    {
+        events[i] = new_fluid_midi_event();
+        TEST_ASSERT(events[i] != NULL);
+        fluid_midi_event_set_channel(events[i], 0);
+    }
+
+    /* a controller change followed by note-ons */
+    fluid_midi_event_set_type(events[0], CONTROL_CHANGE);
+    fluid_midi_event_set_control(events[0], 7);
+    fluid_midi_event_set_value(events[0], 42);
+
+    for(i = 1; i < COUNT; i++)
+    {
+        fluid_midi_event_set_type(events[i], NOTE_ON);
+        fluid_midi_event_set_key(events[i], 50 + i);
+        fluid_midi_event_set_velocity(events[i], 100);
+    }
+
+    TEST_SUCCESS(fluid_synth_handle_midi_events(synth, events, COUNT));
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 0, 7, &val));
+    TEST_ASSERT(val == 42);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) >= COUNT - 1);
+
+    /* the note-offs are handled, although an event in between fails */
+    for(i = 1; i < COUNT; i++)
+    {
+        fluid_midi_event_set_type(events[i], NOTE_OFF);
+    }
+
+    fluid_midi_event_set_type(events[0], NOTE_ON);
+    fluid_midi_event_set_channel(events[0], 999);
+    TEST_ASSERT(fluid_synth_handle_midi_events(synth, events, COUNT) == FLUID_FAILED);
+
+    {
+        fluid_voice_t *voices[64];
+        FLUID_MEMSET(voices, 0, sizeof(voices));
+        fluid_synth_get_voicelist(synth, voices, 64, -1);
+
+        for(i = 0; i < 64 && voices[i] != NULL; i++)
+        {
+            TEST_ASSERT(!fluid_voice_is_on(voices[i]));
+        }
+    }
+
+    TEST_SUCCESS(fluid_synth_handle_midi_events(synth, events, 0));
+    TEST_ASSERT(fluid_synth_handle_midi_events(synth, NULL, 1) == FLUID_FAILED);
+
+    for(i = 0; i < COUNT; i++)
+    {
+        delete_fluid_midi_event(events[i]);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "fluidsynth_priv.h"
+#include "fluid_midi.h"
+#include <string.h>
+
+/* SAMPLES is a multiple of the internal block size, so that every check starts aligned */
+enum { PERIOD = 100, PERIODS = 32, SAMPLES = PERIOD * PERIODS };
+
+/* Renders SAMPLES frames in periods that are no multiple of the internal block size,
+ * returns the index of the first non-silent frame or -1 */
+static int render_first_sound(fluid_synth_t *synth, float *left, float *right)
+{
+    int i;
+    float *dry[2];
+
+    FLUID_MEMSET(left, 0, SAMPLES * sizeof(float));
+    FLUID_MEMSET(right, 0, SAMPLES * sizeof(float));
+
+    for(i = 0; i < PERIODS; i++)
+    {
+        dry[0] = &left[i * PERIOD];
+        dry[1] = &right[i * PERIOD];
+        TEST_SUCCESS(fluid_synth_process(synth, PERIOD, 0, NULL, 2, dry));
+    }
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        if(left[i] != 0.0f || right[i] != 0.0f)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void check_onset(fluid_synth_t *synth, int prerender, int frame, int expected_onset)
+{
+    static float left[SAMPLES], right[SAMPLES];
+    float *dry[2] = { left, right };
+    int onset, bufsize = fluid_synth_get_internal_bufsize(synth);
+
+    /* misalign the synth's internal buffer against the period */
+    if(prerender > 0)
+    {
+        TEST_SUCCESS(fluid_synth_process(synth, prerender, 0, NULL, 2, dry));
+    }
+
+    TEST_SUCCESS(fluid_synth_noteon_at(synth, 0, 60, 127, frame));
+    TEST_SUCCESS(fluid_synth_noteoff_at(synth, 0, 60, frame + 1000));
+
+    onset = render_first_sound(synth, left, right);
+
+    /* the mixer fades in the amplitude from zero, allow for a few samples of silence */
+    TEST_ASSERT(onset >= expected_onset);
+    TEST_ASSERT(onset < expected_onset + 4);
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+    render_first_sound(synth, left, right);
+
+    /* realign for the next check */
+    if(prerender % bufsize != 0)
+    {
+        TEST_SUCCESS(fluid_synth_process(synth, bufsize - prerender % bufsize, 0, NULL, 2, dry));
+    }
+}
+
+/* Test that timestamped note-ons start sample-accurately */
+int main(void)
+{
+    fluid_midi_event_t *event;
+    fluid_synth_t *synth;
+    fluid_settings_t *settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    check_onset(synth, 0, 0, 0);
+    check_onset(synth, 0, 37, 37);
+    check_onset(synth, 0, 64, 64);
+    check_onset(synth, 0, 1001, 1001);
+    check_onset(synth, 13, 60, 60);
+    check_onset(synth, 50, 250, 250);
+    check_onset(synth, 63, 127, 127);
+
+    /* the first 64 - 13 frames have been rendered already, the note starts right after them */
+    check_onset(synth, 13, 5, 64 - 13);
+
+    /* invalid arguments */
+    TEST_ASSERT(fluid_synth_noteon_at(synth, 0, 60, 127, -1) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_noteon_at(synth, 999, 60, 127, 0) == FLUID_FAILED);
+
+    event = new_fluid_midi_event();
+    TEST_ASSERT(event != NULL);
+    TEST_SUCCESS(fluid_midi_event_set_sysex(event, (void *)"\x7f\x7f\x04\x01\x00\x00", 6, 0));
+    TEST_ASSERT(fluid_synth_handle_midi_event_at(synth, event, 0) == FLUID_FAILED);
+
+    /* a controller change is applied to the synth right away, but its effect on
+     * the playing voices is held back until its block */
+    {
+        static float left[512], right[512];
+        float *dry[2] = { left, right };
+        float before = 0, after = 0;
+        int i, val;
+
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+
+        fluid_midi_event_set_type(event, CONTROL_CHANGE);
+        fluid_midi_event_set_channel(event, 0);
+        fluid_midi_event_set_control(event, 7);
+        fluid_midi_event_set_value(event, 0);
+        TEST_SUCCESS(fluid_synth_handle_midi_event_at(synth, event, 256));
+
+        TEST_SUCCESS(fluid_synth_get_cc(synth, 0, 7, &val));
+        TEST_ASSERT(val == 0);
+        TEST_SUCCESS(fluid_synth_process(synth, 512, 0, NULL, 2, dry));
+
+        for(i = 192; i < 256; i++)
+        {
+            before = (FLUID_FABS(left[i]) > before) ? FLUID_FABS(left[i]) : before;
+        }
+
+        for(i = 384; i < 512; i++)
+        {
+            after = (FLUID_FABS(left[i]) > after) ? FLUID_FABS(left[i]) : after;
+        }
+
+        TEST_ASSERT(before > 0);
+        TEST_ASSERT(after < before / 100);
+    }
+
+    delete_fluid_midi_event(event);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+/* waits for the voice allocator to prepare the next chunk of voices */
+static int wait_for_spare_chunk(fluid_synth_t *synth)
+{
+    int i;
+
+    for(i = 0; i < 500; i++)
+    {
+        if(fluid_atomic_pointer_get(&synth->voice_chunk_spare) != NULL)
+        {
+            return TRUE;
+        }
+
+        fluid_msleep(10);
+    }
+
+    return FALSE;
+}
+
+/* Test that the voice pool grows up to synth.polyphony-max instead of killing voices */
+int main(void)
+{
+    int key;
+    fluid_synth_t *synth;
+    fluid_settings_t *settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 4));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony-max", 100));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_SUCCESS(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+
+    TEST_ASSERT(fluid_synth_get_polyphony(synth) == 4);
+    TEST_ASSERT(wait_for_spare_chunk(synth));
+
+    /* exceed the initial polyphony, nothing must be killed */
+    for(key = 30; key < 40; key++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, key, 100));
+    }
+
+    TEST_ASSERT(fluid_synth_get_polyphony(synth) > 4);
+    TEST_ASSERT(fluid_synth_get_polyphony(synth) <= 100);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) >= 10);
+
+    /* keep playing until the ceiling is reached */
+    for(key = 40; key < 127 && fluid_synth_get_polyphony(synth) < 100; key++)
+    {
+        if(fluid_atomic_pointer_get(&synth->voice_chunk_spare) == NULL && synth->nvoice < 100)
+        {
+            TEST_ASSERT(wait_for_spare_chunk(synth));
+        }
+
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, key, 100));
+    }
+
+    TEST_ASSERT(fluid_synth_get_polyphony(synth) == 100);
+
+    /* the pool never exceeds the ceiling, voices are killed from now on */
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 60, 100));
+    TEST_ASSERT(fluid_synth_get_polyphony(synth) == 100);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) <= 100);
+
+    /* shrinking and growing the polyphony explicitly still works */
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 8));
+    TEST_ASSERT(fluid_synth_get_polyphony(synth) == 8);
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 200));
+    TEST_ASSERT(fluid_synth_get_polyphony(synth) == 200);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}